@@ -0,0 +1,213 @@
+/**
+ * @file benchmarks/sunshine_bench.cpp
+ * @brief End-to-end capture and encode benchmark driven by the replay capture backend.
+ */
+// standard includes
+#include <array>
+#include <iomanip>
+#include <iostream>
+#include <string_view>
+#include <thread>
+
+// local includes
+#include "src/config.h"
+#include "src/globals.h"
+#include "src/logging.h"
+#include "src/platform/common.h"
+#include "src/stat_trackers.h"
+#include "src/thread_safe.h"
+#include "src/video.h"
+
+using namespace std::literals;
+
+namespace {
+  void print_usage(const char *name) {
+    std::cerr
+      << "Usage: "sv << name << " <clip> <width> <height> [options]\n"sv
+      << "\n"sv
+      << "The clip is a headerless file of 32-bit BGRX frames, e.g.:\n"sv
+      << "  ffmpeg -i input.mkv -f rawvideo -pix_fmt bgr0 clip.raw\n"sv
+      << "\n"sv
+      << "Options:\n"sv
+      << "  --fps <n>         Replay and encode framerate (default: 60)\n"sv
+      << "  --fast            Replay frames as fast as the encoder consumes them\n"sv
+      << "  --seconds <n>     Duration of the measurement (default: 10)\n"sv
+      << "  --codec <name>    h264, hevc or av1 (default: h264)\n"sv
+      << "  --encoder <name>  Encoder to use (default: software)\n"sv
+      << "  --bitrate <kbps>  Target bitrate (default: 20000)\n"sv;
+  }
+
+  enum stage_e : int {
+    capture_to_convert,
+    convert,
+    encode,
+    packet_queue,
+    total,
+    stage_count
+  };
+
+  constexpr std::array<std::string_view, stage_count> stage_names {
+    "capture_to_convert"sv,
+    "convert"sv,
+    "encode"sv,
+    "packet_queue"sv,
+    "total"sv,
+  };
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc < 4) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  int fps = 60;
+  bool fast = false;
+  int seconds = 10;
+  int video_format = 0;
+  int bitrate = 20000;
+  std::string encoder = "software";
+
+  try {
+    for (int x = 4; x < argc; ++x) {
+      std::string_view arg = argv[x];
+      auto next = [&]() -> std::string_view {
+        if (x + 1 >= argc) {
+          throw std::invalid_argument {std::string {arg}};
+        }
+        return argv[++x];
+      };
+
+      if (arg == "--fps"sv) {
+        fps = std::stoi(std::string {next()});
+      } else if (arg == "--fast"sv) {
+        fast = true;
+      } else if (arg == "--seconds"sv) {
+        seconds = std::stoi(std::string {next()});
+      } else if (arg == "--codec"sv) {
+        auto codec = next();
+        video_format = codec == "av1"sv ? 2 : codec == "hevc"sv ? 1 : 0;
+      } else if (arg == "--encoder"sv) {
+        encoder = next();
+      } else if (arg == "--bitrate"sv) {
+        bitrate = std::stoi(std::string {next()});
+      } else {
+        throw std::invalid_argument {std::string {arg}};
+      }
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "Invalid argument: "sv << e.what() << std::endl;
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  mail::man = std::make_shared<safe::mail_raw_t>();
+  auto log_deinit_guard = logging::init(2, "sunshine-bench.log");
+
+  config::video.capture = "replay";
+  config::video.encoder = encoder;
+  config::video.encoder_cache = false;
+  config::video.replay.file = argv[1];
+  config::video.replay.width = std::stoi(argv[2]);
+  config::video.replay.height = std::stoi(argv[3]);
+  config::video.replay.framerate = fps;
+  config::video.replay.fast = fast;
+
+  auto platf_deinit_guard = platf::init();
+  if (!platf_deinit_guard) {
+    std::cerr << "Failed to initialize the replay capture backend"sv << std::endl;
+    return 1;
+  }
+
+  if (video::probe_encoders()) {
+    std::cerr << "No working encoder found"sv << std::endl;
+    return 1;
+  }
+
+  // In fast mode the encoder still drops frames arriving faster than the configured framerate,
+  // so raise it far enough that the encoder becomes the bottleneck.
+  auto encode_fps = fast ? 1000 : fps;
+
+  video::config_t config {};
+  config.width = config::video.replay.width;
+  config.height = config::video.replay.height;
+  config.framerate = encode_fps;
+  config.bitrate = bitrate;
+  config.slicesPerFrame = 1;
+  config.numRefFrames = 1;
+  config.encoderCscMode = 0;
+  config.videoFormat = video_format;
+  config.dynamicRange = 0;
+  config.chromaSamplingType = 0;
+  config.enableIntraRefresh = 0;
+  config.encodingFramerate = encode_fps * 1000;
+
+  auto mail = std::make_shared<safe::mail_raw_t>();
+  auto shutdown_event = mail->event<bool>(mail::shutdown);
+  auto packets = mail::man->ring_queue<video::packet_t>(mail::video_packets);
+
+  std::thread capture_thread {[&]() {
+    video::capture(mail, config, nullptr);
+  }};
+
+  std::array<stat_trackers::latency_histogram, stage_count> stages;
+  std::uint64_t frames = 0;
+  std::uint64_t bytes = 0;
+
+  auto collect = [&](stage_e stage, const auto &from, const auto &to) {
+    if (from && to) {
+      stages[stage].collect(*to - *from);
+    }
+  };
+
+  auto start = std::chrono::steady_clock::now();
+  auto end = start + std::chrono::seconds {seconds};
+  while (std::chrono::steady_clock::now() < end) {
+    auto packet = packets->pop(100ms);
+    if (!packet) {
+      continue;
+    }
+
+    auto dequeued = std::optional {std::chrono::steady_clock::now()};
+    auto &timing = packet->timing;
+
+    collect(capture_to_convert, packet->frame_timestamp, timing.convert_start);
+    collect(convert, timing.convert_start, timing.convert_end);
+    collect(encode, timing.encode_start, timing.encode_end);
+    collect(packet_queue, timing.encode_end, dequeued);
+    collect(total, packet->frame_timestamp, dequeued);
+
+    ++frames;
+    bytes += packet->data_size();
+  }
+  auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  shutdown_event->raise(true);
+  packets->stop();
+  capture_thread.join();
+
+  auto to_ms = [](std::chrono::microseconds duration) {
+    return duration.count() / 1000.0;
+  };
+
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << "encoder: "sv << encoder << ", "sv << config.width << 'x' << config.height
+            << (fast ? ", fast replay"s : ", "s + std::to_string(fps) + " fps replay"s) << std::endl;
+  std::cout << "frames: "sv << frames << " in "sv << elapsed << "s ("sv << frames / elapsed << " fps, "sv
+            << bytes * 8 / elapsed / 1000000 << " Mbps)"sv << std::endl;
+  std::cout << std::endl;
+  std::cout << std::left << std::setw(20) << "stage (ms)"sv << std::right
+            << std::setw(10) << "avg"sv << std::setw(10) << "p50"sv << std::setw(10) << "p95"sv
+            << std::setw(10) << "p99"sv << std::setw(10) << "max"sv << std::endl;
+  for (int x = 0; x < stage_count; ++x) {
+    auto &histogram = stages[x];
+    std::cout << std::left << std::setw(20) << stage_names[x] << std::right
+              << std::setw(10) << to_ms(histogram.average())
+              << std::setw(10) << to_ms(histogram.percentile(0.50))
+              << std::setw(10) << to_ms(histogram.percentile(0.95))
+              << std::setw(10) << to_ms(histogram.percentile(0.99))
+              << std::setw(10) << to_ms(histogram.max()) << std::endl;
+  }
+
+  return 0;
+}
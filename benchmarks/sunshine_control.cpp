@@ -0,0 +1,204 @@
+/**
+ * @file benchmarks/sunshine_control.cpp
+ * @brief Benchmark for decrypting and dispatching the encrypted control stream messages of a session.
+ */
+// standard includes
+#include <array>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <list>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// local includes
+#include "src/crypto.h"
+
+using namespace std::literals;
+
+namespace {
+  void print_usage(const char *name) {
+    std::cerr
+      << "Usage: "sv << name << " [options]\n"sv
+      << "\n"sv
+      << "Options:\n"sv
+      << "  --messages <n>    Messages decrypted and dispatched in every phase (default: 1000000)\n"sv
+      << "  --size <n>        Size of the plaintext of each message in bytes, a relative mouse move is 18 (default: 18)\n"sv;
+  }
+
+  constexpr std::uint16_t INPUT_DATA = 0x0206;
+
+  using handler_t = std::function<void(const std::string_view &)>;
+
+  /**
+   * @brief Builds the IV the way the client does for SS_ENC_CONTROL_V2.
+   */
+  void control_iv(crypto::aes_t &iv, std::uint32_t seq) {
+    iv.resize(12);
+    std::copy_n((std::uint8_t *) &seq, sizeof(seq), std::begin(iv));
+    iv[10] = 'C';
+    iv[11] = 'C';
+  }
+
+  /**
+   * @brief Encrypted input messages, each with its own sequence number.
+   */
+  std::vector<std::string> encrypt_messages(crypto::cipher::gcm_t &cipher, int messages, int size) {
+    std::string plaintext(size + 4, '\0');
+    *(std::uint16_t *) plaintext.data() = INPUT_DATA;
+
+    std::vector<std::string> result;
+    result.reserve(messages);
+
+    crypto::aes_t iv;
+    std::vector<std::uint8_t> tagged_cipher(crypto::cipher::round_to_pkcs7_padded(plaintext.size()) + crypto::cipher::tag_size);
+    for (int x = 0; x < messages; ++x) {
+      control_iv(iv, x);
+      auto len = cipher.encrypt(plaintext, tagged_cipher.data(), &iv);
+      result.emplace_back((char *) tagged_cipher.data(), crypto::cipher::tag_size + len);
+    }
+
+    return result;
+  }
+
+  /**
+   * @brief Decrypt every message and call the handler of its type, like the control thread does.
+   * @param decrypt Decrypts a message, returns an empty view if verification fails.
+   * @param dispatch Calls the handler of a message type.
+   */
+  template<class D, class H>
+  std::chrono::nanoseconds run_phase(const std::vector<std::string> &messages, D &&decrypt, H &&dispatch) {
+    crypto::aes_t iv;
+
+    auto start = std::chrono::steady_clock::now();
+    for (std::uint32_t x = 0; x < messages.size(); ++x) {
+      control_iv(iv, x);
+
+      auto plaintext = decrypt(messages[x], iv);
+      if (plaintext.size() < 4) {
+        std::cerr << "Failed to verify tag"sv << std::endl;
+        std::exit(1);
+      }
+
+      dispatch(*(std::uint16_t *) plaintext.data(), plaintext.substr(4));
+    }
+
+    return std::chrono::steady_clock::now() - start;
+  }
+
+  void print_phase(std::string_view name, std::chrono::nanoseconds duration, std::size_t messages) {
+    auto seconds = std::chrono::duration<double>(duration).count();
+    std::cout << std::setw(22) << std::left << name << std::right << ": "sv
+              << messages / seconds / 1e3 << " k messages/s, "sv
+              << std::chrono::duration<double, std::nano>(duration).count() / messages << " ns per message"sv << std::endl;
+  }
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  int messages = 1000000;
+  int size = 18;
+
+  try {
+    for (int x = 1; x < argc; ++x) {
+      std::string_view arg = argv[x];
+      auto next = [&]() -> std::string {
+        if (x + 1 >= argc) {
+          throw std::invalid_argument {std::string {arg}};
+        }
+        return argv[++x];
+      };
+
+      if (arg == "--messages"sv) {
+        messages = std::stoi(next());
+      } else if (arg == "--size"sv) {
+        size = std::stoi(next());
+      } else {
+        throw std::invalid_argument {std::string {arg}};
+      }
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "Invalid argument: "sv << e.what() << std::endl;
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  crypto::aes_t key(16, 0x5A);
+  crypto::cipher::gcm_t client {key, false};
+  auto encrypted = encrypt_messages(client, messages, size);
+
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << messages << " messages with "sv << size << " bytes of input each, on a single core"sv << std::endl;
+
+  // Decrypting into a new vector for every message, dispatched by hash map and queued as an owned vector
+  {
+    crypto::cipher::gcm_t server {key, false};
+    std::vector<std::uint8_t> plaintext;
+    std::list<std::vector<std::uint8_t>> input_queue;
+
+    std::unordered_map<std::uint16_t, handler_t> handlers;
+    handlers.emplace(INPUT_DATA, [&](const std::string_view &payload) {
+      input_queue.emplace_back(std::begin(payload), std::end(payload));
+      input_queue.pop_front();
+    });
+
+    auto duration = run_phase(
+      encrypted,
+      [&](const std::string_view &message, crypto::aes_t &iv) {
+        plaintext = {};
+        server.decrypt(message, plaintext, &iv);
+        return std::string_view {(char *) plaintext.data(), plaintext.size()};
+      },
+      [&](std::uint16_t type, const std::string_view &payload) {
+        if (auto handler = handlers.find(type); handler != std::end(handlers)) {
+          handler->second(payload);
+        }
+      }
+    );
+    print_phase("allocating"sv, duration, encrypted.size());
+  }
+
+  // Decrypting into a buffer reused for every message, dispatched by flat table and queued into recycled entries
+  {
+    crypto::cipher::gcm_t server {key, false};
+    std::vector<std::uint8_t> plaintext;
+    std::list<std::vector<std::uint8_t>> input_queue;
+    std::list<std::vector<std::uint8_t>> free_input_entries;
+
+    std::array<std::uint8_t, std::numeric_limits<std::uint16_t>::max() + 1> type_to_handler {};
+    std::vector<handler_t> handlers;
+    handlers.emplace_back([&](const std::string_view &payload) {
+      if (free_input_entries.empty()) {
+        input_queue.emplace_back();
+      } else {
+        input_queue.splice(std::end(input_queue), free_input_entries, std::begin(free_input_entries));
+      }
+      input_queue.back().assign(std::begin(payload), std::end(payload));
+      free_input_entries.splice(std::end(free_input_entries), input_queue, std::begin(input_queue));
+    });
+    type_to_handler[INPUT_DATA] = 1;
+
+    auto duration = run_phase(
+      encrypted,
+      [&](const std::string_view &message, crypto::aes_t &iv) {
+        auto size = crypto::cipher::round_to_pkcs7_padded(message.size() - crypto::cipher::tag_size);
+        if (plaintext.size() < size) {
+          plaintext.resize(size);
+        }
+
+        auto len = server.decrypt(message, plaintext.data(), &iv);
+        return std::string_view {(char *) plaintext.data(), (std::size_t) std::max(len, 0)};
+      },
+      [&](std::uint16_t type, const std::string_view &payload) {
+        if (auto handler = type_to_handler[type]) {
+          handlers[handler - 1](payload);
+        }
+      }
+    );
+    print_phase("scratch buffer"sv, duration, encrypted.size());
+  }
+
+  return 0;
+}
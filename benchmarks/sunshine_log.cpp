@@ -0,0 +1,136 @@
+/**
+ * @file benchmarks/sunshine_log.cpp
+ * @brief Benchmark for the cost of log calls made from the stream threads.
+ */
+// standard includes
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// local includes
+#include "src/logging.h"
+
+using namespace std::literals;
+
+namespace {
+  void print_usage(const char *name) {
+    std::cerr
+      << "Usage: "sv << name << " [options]\n"sv
+      << "\n"sv
+      << "Options:\n"sv
+      << "  --threads <n>   Number of concurrently logging threads (default: 4)\n"sv
+      << "  --records <n>   Log calls made by each thread in every phase (default: 100000)\n"sv
+      << "  --console       Write the records to the console too, like the service does\n"sv;
+  }
+
+  struct phase_t {
+    std::vector<std::chrono::nanoseconds> calls;
+    std::chrono::nanoseconds drain;
+    std::uint64_t dropped;
+  };
+
+  /**
+   * @brief Log like the video and audio threads do, timing every call.
+   */
+  phase_t run_phase(logging::logger_t &logger, int threads, int records) {
+    auto dropped = logging::dropped_records();
+
+    std::vector<std::vector<std::chrono::nanoseconds>> timings(threads);
+    std::vector<std::thread> workers;
+    for (int x = 0; x < threads; ++x) {
+      workers.emplace_back([&, x]() {
+        auto &calls = timings[x];
+        calls.reserve(records);
+
+        for (int y = 0; y < records; ++y) {
+          auto start = std::chrono::steady_clock::now();
+          BOOST_LOG(logger) << "Frame "sv << y << " of stream "sv << x << ": "sv << 1.5 * y << " ms"sv;
+          calls.push_back(std::chrono::steady_clock::now() - start);
+        }
+      });
+    }
+    for (auto &worker : workers) {
+      worker.join();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    logging::log_flush();
+
+    phase_t phase;
+    phase.drain = std::chrono::steady_clock::now() - start;
+    phase.dropped = logging::dropped_records() - dropped;
+    for (auto &calls : timings) {
+      phase.calls.insert(std::end(phase.calls), std::begin(calls), std::end(calls));
+    }
+    std::sort(std::begin(phase.calls), std::end(phase.calls));
+
+    return phase;
+  }
+
+  void print_phase(std::string_view name, const phase_t &phase) {
+    auto percentile = [&](double p) {
+      return phase.calls[std::min(phase.calls.size() - 1, (std::size_t) (p * phase.calls.size()))].count();
+    };
+
+    std::chrono::nanoseconds total {};
+    for (auto &call : phase.calls) {
+      total += call;
+    }
+
+    std::cout << name << ": "sv << total.count() / (double) phase.calls.size() << " ns/call (p50 "sv << percentile(0.5)
+              << " ns, p99 "sv << percentile(0.99) << " ns, max "sv << phase.calls.back().count() << " ns), "sv
+              << phase.dropped << " dropped, "sv
+              << std::chrono::duration<double, std::milli>(phase.drain).count() << " ms to drain"sv << std::endl;
+  }
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  int threads = 4;
+  int records = 100000;
+  bool console = false;
+
+  try {
+    for (int x = 1; x < argc; ++x) {
+      std::string_view arg = argv[x];
+      auto next = [&]() -> std::string {
+        if (x + 1 >= argc) {
+          throw std::invalid_argument {std::string {arg}};
+        }
+        return argv[++x];
+      };
+
+      if (arg == "--threads"sv) {
+        threads = std::stoi(next());
+      } else if (arg == "--records"sv) {
+        records = std::stoi(next());
+      } else if (arg == "--console"sv) {
+        console = true;
+      } else {
+        throw std::invalid_argument {std::string {arg}};
+      }
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "Invalid argument: "sv << e.what() << std::endl;
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  // The records of the unfiltered phase would drown the results
+  std::cout.setstate(console ? std::ios::goodbit : std::ios::badbit);
+  auto log_deinit_guard = logging::init(2, "sunshine-log.log");
+
+  auto filtered = run_phase(debug, threads, records);
+  auto unfiltered = run_phase(info, threads, records);
+
+  std::cout.clear();
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << threads << " threads, "sv << records << " records per thread"sv << std::endl;
+  print_phase("filtered"sv, filtered);
+  print_phase("unfiltered"sv, unfiltered);
+
+  return 0;
+}
@@ -0,0 +1,114 @@
+/**
+ * @file benchmarks/sunshine_loopback.cpp
+ * @brief Streaming benchmark driving a full session through a headless loopback client.
+ */
+// standard includes
+#include <iostream>
+#include <string_view>
+
+// local includes
+#include "src/config.h"
+#include "src/globals.h"
+#include "src/logging.h"
+#include "src/thread_safe.h"
+#include "tests/tests_loopback_client.h"
+
+using namespace std::literals;
+
+namespace {
+  void print_usage(const char *name) {
+    std::cerr
+      << "Usage: "sv << name << " [options]\n"sv
+      << "\n"sv
+      << "Options:\n"sv
+      << "  --clip <file> <width> <height>  Replay a raw BGRX clip instead of a synthetic one\n"sv
+      << "  --fps <n>                       Stream framerate (default: 60)\n"sv
+      << "  --seconds <n>                   Duration of the measurement (default: 10)\n"sv
+      << "  --bitrate <kbps>                Requested bitrate (default: 10000)\n"sv
+      << "  --packet-size <n>               Video packet size (default: 1024)\n"sv
+      << "  --encrypt                       Enable video encryption\n"sv
+      << "  --loss <probability>            Drop received video packets at random (default: 0)\n"sv
+      << "  --seed <n>                      Seed for the synthetic loss (default: 1)\n"sv
+      << "  --fec <percentage>              FEC percentage used by the host (default: 20)\n"sv
+      << "  --fec-early-send                Send data shards before computing parity\n"sv;
+  }
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  loopback::options_t options;
+  std::filesystem::path clip;
+  int seconds = 10;
+  int fec_percentage = 20;
+  bool fec_early_send = false;
+
+  try {
+    for (int x = 1; x < argc; ++x) {
+      std::string_view arg = argv[x];
+      auto next = [&]() -> std::string {
+        if (x + 1 >= argc) {
+          throw std::invalid_argument {std::string {arg}};
+        }
+        return argv[++x];
+      };
+
+      if (arg == "--clip"sv) {
+        clip = next();
+        options.width = std::stoi(next());
+        options.height = std::stoi(next());
+      } else if (arg == "--fps"sv) {
+        options.fps = std::stoi(next());
+      } else if (arg == "--seconds"sv) {
+        seconds = std::stoi(next());
+      } else if (arg == "--bitrate"sv) {
+        options.bitrate = std::stoi(next());
+      } else if (arg == "--packet-size"sv) {
+        options.packet_size = std::stoi(next());
+      } else if (arg == "--encrypt"sv) {
+        options.encrypt_video = true;
+      } else if (arg == "--loss"sv) {
+        options.loss = std::stod(next());
+      } else if (arg == "--seed"sv) {
+        options.seed = std::stoul(next());
+      } else if (arg == "--fec"sv) {
+        fec_percentage = std::stoi(next());
+      } else if (arg == "--fec-early-send"sv) {
+        fec_early_send = true;
+      } else {
+        throw std::invalid_argument {std::string {arg}};
+      }
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "Invalid argument: "sv << e.what() << std::endl;
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  mail::man = std::make_shared<safe::mail_raw_t>();
+  auto log_deinit_guard = logging::init(2, "sunshine-loopback.log");
+
+  auto host = loopback::host_t::start(clip, options);
+  if (!host) {
+    std::cerr << "Failed to start the loopback host"sv << std::endl;
+    return 1;
+  }
+
+  // The host restores the original configuration when it's destroyed
+  config::stream.fec_percentage = fec_percentage;
+  config::stream.fec_early_send = fec_early_send;
+
+  loopback::client_t client {host->launch(options), options};
+  if (client.connect()) {
+    std::cerr << "Failed to connect to the loopback host"sv << std::endl;
+    return 1;
+  }
+
+  auto report = client.receive(std::chrono::seconds {seconds});
+  client.disconnect();
+
+  std::cout << options.width << 'x' << options.height << " @ "sv << options.fps << " fps, "sv
+            << options.bitrate << " Kbps, "sv << fec_percentage << "% FEC"sv
+            << (options.encrypt_video ? ", encrypted"sv : ""sv) << std::endl;
+  report.print(std::cout);
+
+  return 0;
+}
@@ -0,0 +1,243 @@
+/**
+ * @file benchmarks/sunshine_mouse.cpp
+ * @brief Benchmark for relative mouse motion passed to the virtual mouse on Linux.
+ */
+// standard includes
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// platform includes
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+// lib includes
+#include <libevdev/libevdev.h>
+
+// local includes
+#include "src/config.h"
+#include "src/globals.h"
+#include "src/logging.h"
+#include "src/platform/common.h"
+
+using namespace std::literals;
+
+namespace {
+  void print_usage(const char *name) {
+    std::cerr
+      << "Usage: "sv << name << " [options]\n"sv
+      << "\n"sv
+      << "Options:\n"sv
+      << "  --rate <n>        Relative moves per second sent by the client, like a mouse polled at n Hz (default: 8000)\n"sv
+      << "  --seconds <n>     Duration of every phase (default: 5)\n"sv
+      << "  --window <us>     Coalescing window compared with passing every move through (default: 1000)\n"sv;
+  }
+
+  constexpr auto DEVICE_NAME = "Mouse passthrough"sv;
+
+  struct evdev_t {
+    ~evdev_t() {
+      if (dev) {
+        libevdev_free(dev);
+      }
+      if (fd >= 0) {
+        close(fd);
+      }
+    }
+
+    int fd = -1;
+    libevdev *dev = nullptr;
+  };
+
+  /**
+   * @brief Open the event node of the virtual mouse, udev may take a moment to create it.
+   */
+  bool open_device(evdev_t &evdev) {
+    auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (std::chrono::steady_clock::now() < deadline) {
+      std::error_code ec;
+      for (auto &entry : std::filesystem::directory_iterator {"/dev/input", ec}) {
+        if (!entry.path().filename().string().starts_with("event"sv)) {
+          continue;
+        }
+
+        int fd = open(entry.path().c_str(), O_RDONLY | O_NONBLOCK);
+        if (fd < 0) {
+          continue;
+        }
+
+        libevdev *dev = nullptr;
+        if (libevdev_new_from_fd(fd, &dev) == 0 && libevdev_get_name(dev) == DEVICE_NAME) {
+          evdev.fd = fd;
+          evdev.dev = dev;
+          return true;
+        }
+
+        if (dev) {
+          libevdev_free(dev);
+        }
+        close(fd);
+      }
+
+      std::this_thread::sleep_for(100ms);
+    }
+
+    return false;
+  }
+
+  struct phase_t {
+    std::uint64_t moves;
+    std::uint64_t reports;
+    std::vector<std::chrono::nanoseconds> latencies;
+  };
+
+  /**
+   * @brief Send a move of one pixel at a fixed rate, while reading the reports of the virtual mouse.
+   * @details Every pixel of REL_X read back completes the oldest move not reported yet,
+   * which gives the latency of each move from the call into the platform to the evdev node.
+   */
+  phase_t run_phase(platf::input_t &input, evdev_t &evdev, int rate, int seconds) {
+    auto interval = std::chrono::nanoseconds(1s) / rate;
+    auto moves = (std::size_t) rate * seconds;
+
+    std::vector<std::chrono::steady_clock::time_point> sent(moves);
+    std::atomic_size_t sent_count = 0;
+    std::atomic_bool sending = true;
+
+    phase_t phase {};
+    phase.latencies.reserve(moves);
+
+    std::thread reader {[&]() {
+      std::size_t reported = 0;
+      bool motion = false;
+
+      // Keep reading for a moment after the last move, the pending motion is flushed with a delay
+      auto done = std::chrono::steady_clock::time_point::max();
+      while (std::chrono::steady_clock::now() < done) {
+        if (!sending && done == std::chrono::steady_clock::time_point::max()) {
+          done = std::chrono::steady_clock::now() + 100ms;
+        }
+
+        pollfd pfd {evdev.fd, POLLIN, 0};
+        if (poll(&pfd, 1, 10) <= 0) {
+          continue;
+        }
+
+        input_event ev;
+        while (libevdev_next_event(evdev.dev, LIBEVDEV_READ_FLAG_NORMAL, &ev) == LIBEVDEV_READ_STATUS_SUCCESS) {
+          auto now = std::chrono::steady_clock::now();
+
+          if (ev.type == EV_REL && ev.code == REL_X) {
+            motion = true;
+            auto last = std::min(reported + ev.value, sent_count.load());
+            for (; reported < last; ++reported) {
+              phase.latencies.push_back(now - sent[reported]);
+            }
+          } else if (ev.type == EV_SYN && ev.code == SYN_REPORT && motion) {
+            motion = false;
+            ++phase.reports;
+          }
+        }
+      }
+    }};
+
+    auto next = std::chrono::steady_clock::now();
+    for (std::size_t x = 0; x < moves; ++x) {
+      std::this_thread::sleep_until(next);
+      next += interval;
+
+      sent[x] = std::chrono::steady_clock::now();
+      ++sent_count;
+      platf::move_mouse(input, 1, 0);
+    }
+    sending = false;
+    reader.join();
+
+    phase.moves = moves;
+    std::sort(std::begin(phase.latencies), std::end(phase.latencies));
+
+    return phase;
+  }
+
+  void print_phase(std::string_view name, const phase_t &phase, int seconds) {
+    auto percentile = [&](double p) {
+      if (phase.latencies.empty()) {
+        return 0.0;
+      }
+      return std::chrono::duration<double, std::micro>(phase.latencies[std::min(phase.latencies.size() - 1, (std::size_t) (p * phase.latencies.size()))]).count();
+    };
+
+    std::cout << std::setw(18) << std::left << name << std::right << ": "sv
+              << (double) phase.moves / seconds << " moves/s, "sv
+              << (double) phase.reports / seconds << " reports/s, "sv
+              << phase.moves - phase.latencies.size() << " moves lost, latency p50 "sv << percentile(0.5)
+              << " us, p99 "sv << percentile(0.99) << " us"sv << std::endl;
+  }
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  int rate = 8000;
+  int seconds = 5;
+  int window = 1000;
+
+  try {
+    for (int x = 1; x < argc; ++x) {
+      std::string_view arg = argv[x];
+      auto next = [&]() -> std::string {
+        if (x + 1 >= argc) {
+          throw std::invalid_argument {std::string {arg}};
+        }
+        return argv[++x];
+      };
+
+      if (arg == "--rate"sv) {
+        rate = std::stoi(next());
+      } else if (arg == "--seconds"sv) {
+        seconds = std::stoi(next());
+      } else if (arg == "--window"sv) {
+        window = std::stoi(next());
+      } else {
+        throw std::invalid_argument {std::string {arg}};
+      }
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "Invalid argument: "sv << e.what() << std::endl;
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  auto log_deinit_guard = logging::init(2, "sunshine-mouse.log");
+  task_pool.start(1);
+
+  int result = 0;
+  {
+    auto input = platf::input();
+
+    evdev_t evdev;
+    if (!open_device(evdev)) {
+      std::cerr << "Unable to open the virtual mouse, is /dev/uinput writable?"sv << std::endl;
+      result = 1;
+    } else {
+      std::cout << std::fixed << std::setprecision(2);
+      std::cout << rate << " moves/s for "sv << seconds << " seconds"sv << std::endl;
+
+      config::input.mouse_coalesce_window = 0us;
+      print_phase("passthrough"sv, run_phase(input, evdev, rate, seconds), seconds);
+
+      config::input.mouse_coalesce_window = std::chrono::microseconds(window);
+      print_phase("window "s + std::to_string(window) + " us"s, run_phase(input, evdev, rate, seconds), seconds);
+    }
+  }
+
+  task_pool.stop();
+  task_pool.join();
+
+  return result;
+}
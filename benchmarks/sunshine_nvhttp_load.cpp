@@ -0,0 +1,168 @@
+/**
+ * @file benchmarks/sunshine_nvhttp_load.cpp
+ * @brief Load benchmark for the serverinfo and applist responses polled by Moonlight clients.
+ */
+// standard includes
+#include <atomic>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// lib includes
+#include <nlohmann/json.hpp>
+
+// local includes
+#include "src/config.h"
+#include "src/file_handler.h"
+#include "src/globals.h"
+#include "src/logging.h"
+#include "src/nvhttp.h"
+#include "src/process.h"
+#include "src/thread_safe.h"
+#include "src/uuid.h"
+
+using namespace std::literals;
+
+namespace {
+  void print_usage(const char *name) {
+    std::cerr
+      << "Usage: "sv << name << " [options]\n"sv
+      << "\n"sv
+      << "Options:\n"sv
+      << "  --apps <n>            Number of apps in the generated app list (default: 300)\n"sv
+      << "  --clients <n>         Number of concurrently polling clients (default: 8)\n"sv
+      << "  --seconds <n>         Duration of the measurement (default: 5)\n"sv
+      << "  --invalidate-ms <n>   Invalidate the cache periodically, like session changes do (default: never)\n"sv
+      << "  --uncached            Invalidate the cache before every poll\n"sv;
+  }
+
+  std::filesystem::path write_apps(int count) {
+    nlohmann::json tree;
+    tree["version"] = 2;
+    tree["env"] = nlohmann::json::object();
+    tree["apps"] = nlohmann::json::array();
+    for (int x = 0; x < count; ++x) {
+      tree["apps"].push_back({
+        {"name", "Benchmark App "s + std::to_string(x)},
+        {"uuid", uuid_util::uuid_t::generate().string()},
+      });
+    }
+
+    auto path = std::filesystem::temp_directory_path() / "sunshine-nvhttp-load-apps.json";
+    file_handler::write_file(path.string().c_str(), tree.dump());
+
+    return path;
+  }
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  int app_count = 300;
+  int clients = 8;
+  int seconds = 5;
+  int invalidate_ms = 0;
+  bool uncached = false;
+
+  try {
+    for (int x = 1; x < argc; ++x) {
+      std::string_view arg = argv[x];
+      auto next = [&]() -> std::string {
+        if (x + 1 >= argc) {
+          throw std::invalid_argument {std::string {arg}};
+        }
+        return argv[++x];
+      };
+
+      if (arg == "--apps"sv) {
+        app_count = std::stoi(next());
+      } else if (arg == "--clients"sv) {
+        clients = std::stoi(next());
+      } else if (arg == "--seconds"sv) {
+        seconds = std::stoi(next());
+      } else if (arg == "--invalidate-ms"sv) {
+        invalidate_ms = std::stoi(next());
+      } else if (arg == "--uncached"sv) {
+        uncached = true;
+      } else {
+        throw std::invalid_argument {std::string {arg}};
+      }
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "Invalid argument: "sv << e.what() << std::endl;
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  mail::man = std::make_shared<safe::mail_raw_t>();
+  auto log_deinit_guard = logging::init(2, "sunshine-nvhttp-load.log");
+
+  auto apps_file = write_apps(app_count);
+  proc::refresh(apps_file.string(), false);
+  std::filesystem::remove(apps_file);
+
+  // Each client polls serverinfo over HTTPS and HTTP, then the app list, like Moonlight does
+  nvhttp::serverinfo_key_t https_key;
+  https_key.https = true;
+  https_key.pair_status = 1;
+  https_key.perm = crypto::PERM::_all;
+  https_key.local_address = "127.0.0.1";
+
+  nvhttp::serverinfo_key_t http_key;
+  http_key.local_address = "127.0.0.1";
+
+  nvhttp::applist_key_t applist_key;
+  applist_key.perm = crypto::PERM::_all;
+
+  std::atomic_bool stop {false};
+  std::atomic<std::uint64_t> requests {0};
+  std::atomic<std::uint64_t> bytes {0};
+
+  auto start = std::chrono::steady_clock::now();
+
+  std::vector<std::thread> threads;
+  for (int x = 0; x < clients; ++x) {
+    threads.emplace_back([&]() {
+      std::uint64_t count = 0;
+      std::uint64_t size = 0;
+      while (!stop.load(std::memory_order_relaxed)) {
+        if (uncached) {
+          nvhttp::invalidate_response_cache();
+        }
+        size += nvhttp::get_serverinfo(https_key)->size();
+        size += nvhttp::get_serverinfo(http_key)->size();
+        size += nvhttp::get_applist(applist_key)->size();
+        count += 3;
+      }
+
+      requests += count;
+      bytes += size;
+    });
+  }
+
+  auto end = start + std::chrono::seconds {seconds};
+  while (std::chrono::steady_clock::now() < end) {
+    if (invalidate_ms > 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds {invalidate_ms});
+      nvhttp::invalidate_response_cache();
+    } else {
+      std::this_thread::sleep_until(end);
+    }
+  }
+
+  stop = true;
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << app_count << " apps, "sv << clients << " clients, "sv
+            << (uncached ? "uncached"s : invalidate_ms > 0 ? "invalidated every "s + std::to_string(invalidate_ms) + " ms"s : "cached"s)
+            << std::endl;
+  std::cout << "requests: "sv << requests << " in "sv << elapsed << "s ("sv << requests / elapsed << " requests/s, "sv
+            << bytes / elapsed / 1000000 << " MB/s)"sv << std::endl;
+
+  return 0;
+}
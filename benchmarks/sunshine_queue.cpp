@@ -0,0 +1,163 @@
+/**
+ * @file benchmarks/sunshine_queue.cpp
+ * @brief Benchmark for the queues passing packets between the threads of the media pipeline.
+ */
+// standard includes
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// local includes
+#include "src/thread_safe.h"
+
+using namespace std::literals;
+
+namespace {
+  void print_usage(const char *name) {
+    std::cerr
+      << "Usage: "sv << name << " [options]\n"sv
+      << "\n"sv
+      << "Options:\n"sv
+      << "  --producers <n>   Number of threads raising elements, like encoders of concurrent sessions (default: 4)\n"sv
+      << "  --elements <n>    Elements raised by each producer in every phase (default: 200000)\n"sv
+      << "  --capacity <n>    Capacity of the queues (default: 32)\n"sv;
+  }
+
+  /**
+   * @brief Stands in for a packet, heap allocated like video::packet_t.
+   */
+  struct element_t {
+    std::chrono::steady_clock::time_point raised;
+  };
+
+  struct phase_t {
+    std::chrono::nanoseconds duration;
+    std::uint64_t delivered;
+    std::vector<std::chrono::nanoseconds> latencies;
+  };
+
+  /**
+   * @brief Raise elements from several threads at full speed while a single thread pops them.
+   */
+  template<class Q>
+  phase_t run_phase(Q &queue, int producers, int elements) {
+    std::atomic_int running = producers;
+    std::vector<std::thread> threads;
+
+    phase_t phase {};
+    phase.latencies.reserve((std::size_t) producers * elements);
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread consumer {[&]() {
+      while (true) {
+        auto element = queue.pop(10ms);
+        if (!element) {
+          if (running == 0 && !queue.peek()) {
+            break;
+          }
+          continue;
+        }
+
+        phase.latencies.push_back(std::chrono::steady_clock::now() - element->raised);
+      }
+    }};
+
+    for (int x = 0; x < producers; ++x) {
+      threads.emplace_back([&]() {
+        for (int y = 0; y < elements; ++y) {
+          queue.raise(std::make_unique<element_t>(std::chrono::steady_clock::now()));
+        }
+        --running;
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    consumer.join();
+
+    phase.duration = std::chrono::steady_clock::now() - start;
+    phase.delivered = phase.latencies.size();
+    std::sort(std::begin(phase.latencies), std::end(phase.latencies));
+
+    return phase;
+  }
+
+  void print_phase(std::string_view name, const phase_t &phase, std::uint64_t raised) {
+    auto percentile = [&](double p) {
+      if (phase.latencies.empty()) {
+        return 0.0;
+      }
+      return std::chrono::duration<double, std::micro>(phase.latencies[std::min(phase.latencies.size() - 1, (std::size_t) (p * phase.latencies.size()))]).count();
+    };
+
+    auto seconds = std::chrono::duration<double>(phase.duration).count();
+    std::cout << std::setw(18) << std::left << name << std::right << ": "sv
+              << raised / seconds / 1e6 << " M raised/s, "sv
+              << phase.delivered / seconds / 1e6 << " M delivered/s, "sv
+              << raised - phase.delivered << " dropped, latency p50 "sv << percentile(0.5)
+              << " us, p99 "sv << percentile(0.99) << " us"sv << std::endl;
+  }
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  int producers = 4;
+  int elements = 200000;
+  int capacity = 32;
+
+  try {
+    for (int x = 1; x < argc; ++x) {
+      std::string_view arg = argv[x];
+      auto next = [&]() -> std::string {
+        if (x + 1 >= argc) {
+          throw std::invalid_argument {std::string {arg}};
+        }
+        return argv[++x];
+      };
+
+      if (arg == "--producers"sv) {
+        producers = std::stoi(next());
+      } else if (arg == "--elements"sv) {
+        elements = std::stoi(next());
+      } else if (arg == "--capacity"sv) {
+        capacity = std::stoi(next());
+      } else {
+        throw std::invalid_argument {std::string {arg}};
+      }
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "Invalid argument: "sv << e.what() << std::endl;
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  using element_ptr = std::unique_ptr<element_t>;
+  auto raised = (std::uint64_t) producers * elements;
+
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << producers << " producers, "sv << elements << " elements per producer, capacity "sv << capacity << std::endl;
+
+  {
+    safe::queue_t<element_ptr> queue {(std::uint32_t) capacity};
+    print_phase("mutex"sv, run_phase(queue, producers, elements), raised);
+  }
+  {
+    safe::ring_queue_t<element_ptr> queue {(std::uint32_t) capacity, safe::overflow_e::drop_oldest};
+    print_phase("ring drop_oldest"sv, run_phase(queue, producers, elements), raised);
+  }
+  {
+    safe::ring_queue_t<element_ptr> queue {(std::uint32_t) capacity, safe::overflow_e::drop_newest};
+    print_phase("ring drop_newest"sv, run_phase(queue, producers, elements), raised);
+  }
+  {
+    safe::ring_queue_t<element_ptr> queue {(std::uint32_t) capacity, safe::overflow_e::block};
+    print_phase("ring block"sv, run_phase(queue, producers, elements), raised);
+  }
+
+  return 0;
+}
@@ -0,0 +1,170 @@
+/**
+ * @file benchmarks/sunshine_recv.cpp
+ * @brief Benchmark for receiving the pings of many clients on the video and audio sockets.
+ */
+// standard includes
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string_view>
+#include <vector>
+
+// lib includes
+#include <boost/asio.hpp>
+
+// local includes
+#include "src/platform/common.h"
+
+using namespace std::literals;
+namespace asio = boost::asio;
+using udp = asio::ip::udp;
+
+namespace {
+  void print_usage(const char *name) {
+    std::cerr
+      << "Usage: "sv << name << " [options]\n"sv
+      << "\n"sv
+      << "Options:\n"sv
+      << "  --clients <n>     Sockets sending pings, like clients of concurrent sessions (default: 16)\n"sv
+      << "  --datagrams <n>   Pings sent by all clients together in every phase (default: 1000000)\n"sv
+      << "  --burst <n>       Pings queued on the socket before receiving them (default: 1000)\n"sv
+      << "  --batch <n>       Datagrams received with a single call in the batched phase (default: 16)\n"sv;
+  }
+
+  // The size of SS_PING, a payload of 16 bytes followed by a sequence number
+  constexpr std::size_t PING_SIZE = 20;
+
+  struct phase_t {
+    std::chrono::nanoseconds duration;
+    std::uint64_t received;
+    std::uint64_t calls;
+  };
+
+  /**
+   * @brief Let the clients queue a burst of pings on the socket, then time receiving them.
+   * @details Only receiving is timed, sending the pings would otherwise limit the rate.
+   * @param receive Receives the datagrams waiting on the socket, returns how many it received.
+   */
+  template<class R>
+  phase_t run_phase(asio::io_context &io, udp::socket &sock, int clients, int datagrams, int burst, R &&receive) {
+    std::vector<udp::socket> senders;
+    for (int x = 0; x < clients; ++x) {
+      senders.emplace_back(io, udp::endpoint {asio::ip::address_v4::loopback(), 0});
+    }
+
+    std::array<char, PING_SIZE> ping {};
+    auto destination = sock.local_endpoint();
+
+    phase_t phase {};
+    for (int sent = 0; sent < datagrams; sent += burst) {
+      auto count = std::min(burst, datagrams - sent);
+      for (int x = 0; x < count; ++x) {
+        senders[x % clients].send_to(asio::buffer(ping), destination);
+      }
+
+      int received = 0;
+      auto start = std::chrono::steady_clock::now();
+      while (received < count) {
+        auto batch = receive();
+        if (batch <= 0) {
+          // Whatever is still missing was dropped
+          break;
+        }
+        received += batch;
+        ++phase.calls;
+      }
+      phase.duration += std::chrono::steady_clock::now() - start;
+      phase.received += received;
+    }
+
+    return phase;
+  }
+
+  void print_phase(std::string_view name, const phase_t &phase, int datagrams) {
+    auto seconds = std::chrono::duration<double>(phase.duration).count();
+    std::cout << std::setw(18) << std::left << name << std::right << ": "sv
+              << phase.received / seconds / 1e3 << " k datagrams/s, "sv
+              << std::chrono::duration<double, std::nano>(phase.duration).count() / std::max<std::uint64_t>(phase.received, 1) << " ns per datagram, "sv
+              << (double) phase.received / std::max<std::uint64_t>(phase.calls, 1) << " datagrams per call, "sv
+              << datagrams - phase.received << " lost"sv << std::endl;
+  }
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  int clients = 16;
+  int datagrams = 1000000;
+  int burst = 1000;
+  int batch_size = 16;
+
+  try {
+    for (int x = 1; x < argc; ++x) {
+      std::string_view arg = argv[x];
+      auto next = [&]() -> std::string {
+        if (x + 1 >= argc) {
+          throw std::invalid_argument {std::string {arg}};
+        }
+        return argv[++x];
+      };
+
+      if (arg == "--clients"sv) {
+        clients = std::stoi(next());
+      } else if (arg == "--datagrams"sv) {
+        datagrams = std::stoi(next());
+      } else if (arg == "--burst"sv) {
+        burst = std::stoi(next());
+      } else if (arg == "--batch"sv) {
+        batch_size = std::stoi(next());
+      } else {
+        throw std::invalid_argument {std::string {arg}};
+      }
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "Invalid argument: "sv << e.what() << std::endl;
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  asio::io_context io;
+  udp::socket sock {io, udp::endpoint {asio::ip::address_v4::loopback(), 0}};
+  sock.set_option(asio::socket_base::receive_buffer_size(4 * 1024 * 1024));
+  sock.non_blocking(true);
+
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << datagrams << " pings from "sv << clients << " clients"sv << std::endl;
+
+  // Receiving one datagram per call, like the receive thread used to
+  {
+    std::array<char, 2048> buf;
+    udp::endpoint peer;
+
+    auto phase = run_phase(io, sock, clients, datagrams, burst, [&]() {
+      boost::system::error_code ec;
+      sock.receive_from(asio::buffer(buf), peer, 0, ec);
+      return ec ? 0 : 1;
+    });
+    print_phase("receive_from"sv, phase, datagrams);
+  }
+
+  // Receiving every datagram waiting with a single call, up to a batch
+  {
+    std::vector<std::array<char, 2048>> bufs(batch_size);
+    std::vector<platf::recv_info_t> batch;
+    for (auto &buf : bufs) {
+      batch.push_back({buf.data(), buf.size()});
+    }
+
+    if (platf::recv_batch((std::uintptr_t) sock.native_handle(), batch) < 0) {
+      std::cout << "Batched receives aren't supported on this platform"sv << std::endl;
+      return 0;
+    }
+
+    auto phase = run_phase(io, sock, clients, datagrams, burst, [&]() {
+      return platf::recv_batch((std::uintptr_t) sock.native_handle(), batch);
+    });
+    print_phase("batch "s + std::to_string(batch_size), phase, datagrams);
+  }
+
+  return 0;
+}
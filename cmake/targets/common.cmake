@@ -78,6 +78,11 @@ if(BUILD_TESTS)
     add_subdirectory(tests)
 endif()
 
+# benchmarks
+if(BUILD_BENCHMARKS)
+    add_subdirectory(benchmarks)
+endif()
+
 # custom compile flags, must be after adding tests
 
 if (NOT BUILD_TESTS)
@@ -86,14 +91,20 @@ else()
     set(TEST_DIR "${CMAKE_SOURCE_DIR}/tests")
 endif()
 
+if (NOT BUILD_BENCHMARKS)
+    set(BENCHMARK_DIR "")
+else()
+    set(BENCHMARK_DIR "${CMAKE_SOURCE_DIR}/benchmarks")
+endif()
+
 # src/upnp
 set_source_files_properties("${CMAKE_SOURCE_DIR}/src/upnp.cpp"
-        DIRECTORY "${CMAKE_SOURCE_DIR}" "${TEST_DIR}"
+        DIRECTORY "${CMAKE_SOURCE_DIR}" "${TEST_DIR}" "${BENCHMARK_DIR}"
         PROPERTIES COMPILE_FLAGS -Wno-pedantic)
 
 # third-party/nanors
 set_source_files_properties("${CMAKE_SOURCE_DIR}/src/rswrapper.c"
-        DIRECTORY "${CMAKE_SOURCE_DIR}" "${TEST_DIR}"
+        DIRECTORY "${CMAKE_SOURCE_DIR}" "${TEST_DIR}" "${BENCHMARK_DIR}"
         PROPERTIES COMPILE_FLAGS "-ftree-vectorize -funroll-loops")
 
 # third-party/ViGEmClient
@@ -104,7 +115,7 @@ string(APPEND VIGEM_COMPILE_FLAGS "-Wno-class-memaccess ")
 string(APPEND VIGEM_COMPILE_FLAGS "-Wno-unused-function ")
 string(APPEND VIGEM_COMPILE_FLAGS "-Wno-unused-variable ")
 set_source_files_properties("${CMAKE_SOURCE_DIR}/third-party/ViGEmClient/src/ViGEmClient.cpp"
-        DIRECTORY "${CMAKE_SOURCE_DIR}" "${TEST_DIR}"
+        DIRECTORY "${CMAKE_SOURCE_DIR}" "${TEST_DIR}" "${BENCHMARK_DIR}"
         PROPERTIES
         COMPILE_DEFINITIONS "UNICODE=1;ERROR_INVALID_DEVICE_OBJECT_PARAMETER=650"
         COMPILE_FLAGS ${VIGEM_COMPILE_FLAGS})
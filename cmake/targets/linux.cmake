@@ -13,6 +13,7 @@ target_sources(sunshine PRIVATE
   "${CMAKE_SOURCE_DIR}/src/platform/linux/kmsgrab.cpp"
   "${CMAKE_SOURCE_DIR}/src/platform/linux/misc.cpp"
   "${CMAKE_SOURCE_DIR}/src/platform/linux/publish.cpp"
+  "${CMAKE_SOURCE_DIR}/src/platform/linux/replaygrab.cpp"
   "${CMAKE_SOURCE_DIR}/src/platform/linux/vaapi.cpp"
   "${CMAKE_SOURCE_DIR}/src/platform/linux/wayland.cpp"
   "${CMAKE_SOURCE_DIR}/src/platform/linux/wlgrab.cpp"
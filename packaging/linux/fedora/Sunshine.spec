@@ -48,6 +48,7 @@ BuildRequires: pulseaudio-libs-devel
 BuildRequires: rpm-build
 BuildRequires: systemd-udev
 BuildRequires: systemd-rpm-macros
+BuildRequires: zlib-devel
 %{?sysusers_requires_compat}
 BuildRequires: wget
 BuildRequires: which
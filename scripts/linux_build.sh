@@ -121,6 +121,7 @@ function add_arch_deps() {
     'opus'
     'udev'
     'wayland'
+    'zlib'
   )
 
   if [ "$skip_libva" == 0 ]; then
@@ -174,6 +175,7 @@ function add_debian_based_deps() {
     "udev"
     "wget"  # necessary for cuda install with `run` file
     "xvfb"  # necessary for headless unit testing
+    "zlib1g-dev"
   )
 
   if [ "$skip_libva" == 0 ]; then
@@ -240,6 +242,7 @@ function add_fedora_deps() {
     "wget"  # necessary for cuda install with `run` file
     "which"  # necessary for cuda install with `run` file
     "xorg-x11-server-Xvfb"  # necessary for headless unit testing
+    "zlib-devel"
   )
 
   if [ "$skip_libva" == 0 ]; then
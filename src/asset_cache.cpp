@@ -0,0 +1,290 @@
+/**
+ * @file src/asset_cache.cpp
+ * @brief Definitions for the in-memory cache of the static Web UI files.
+ */
+// standard includes
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+
+// lib includes
+#include <boost/algorithm/string.hpp>
+#include <zlib.h>
+
+// local includes
+#include "asset_cache.h"
+#include "confighttp.h"
+#include "crypto.h"
+#include "logging.h"
+#include "utility.h"
+
+using namespace std::literals;
+
+namespace asset_cache {
+  namespace fs = std::filesystem;
+
+  /**
+   * @brief Files smaller than this fit in a single packet, compressing them isn't worth a Vary header.
+   */
+  constexpr std::size_t MIN_GZIP_SIZE = 1024;
+
+  /**
+   * @brief Keep the compressed variant only if it's at most this fraction of the original size.
+   */
+  constexpr double MAX_GZIP_RATIO = 0.9;
+
+  /**
+   * @brief The request paths remembered, symbolic links and case insensitive file systems spell a file in many ways.
+   */
+  constexpr std::size_t MAX_ALIASES = 1024;
+
+  /**
+   * @brief Check whether a MIME type is worth compressing, images and fonts other than SVG and TTF already are.
+   */
+  bool compressible(std::string_view content_type) {
+    return content_type.starts_with("text/"sv) ||
+           content_type == "application/javascript"sv ||
+           content_type == "application/json"sv ||
+           content_type == "image/svg+xml"sv ||
+           content_type == "image/x-icon"sv ||
+           content_type == "font/ttf"sv;
+  }
+
+  /**
+   * @brief Get a quoted strong entity tag for the given data.
+   */
+  std::string make_etag(std::string_view data, std::string_view suffix = {}) {
+    auto hash = crypto::hash(data);
+    return "\""s + util::hex_vec(std::begin(hash), std::begin(hash) + 8, true) + std::string {suffix} + "\""s;
+  }
+
+  /**
+   * @brief Check whether a path lies within a directory, both paths have to be canonical.
+   */
+  bool is_within(const fs::path &root, const fs::path &file) {
+    auto [root_end, file_end] = std::mismatch(std::begin(root), std::end(root), std::begin(file), std::end(file));
+
+    // A trailing separator of the root shows up as an empty element
+    return root_end == std::end(root) || (root_end->empty() && std::next(root_end) == std::end(root));
+  }
+
+  cache_t::cache_t(fs::path root, std::chrono::milliseconds revalidate_interval):
+      root {std::move(root)},
+      revalidate_interval {revalidate_interval} {
+  }
+
+  lookup_t cache_t::get(std::string_view path) {
+    // Requests for the same file share one entry, regardless of how they spell its path
+    while (path.starts_with('/')) {
+      path.remove_prefix(1);
+    }
+    auto key = fs::path {path}.lexically_normal().generic_string();
+
+    auto now = std::chrono::steady_clock::now();
+    fs::path file;
+    {
+      std::lock_guard lg {mutex};
+
+      auto entry = find(key);
+      if (entry) {
+        if (now - entry->checked < revalidate_interval) {
+          return {status_e::ok, entry->asset};
+        }
+
+        file = entry->file;
+      }
+    }
+
+    if (!file.empty()) {
+      std::error_code ec;
+      auto last_write_time = fs::last_write_time(file, ec);
+
+      std::lock_guard lg {mutex};
+      auto entry = find(key);
+      if (!ec && entry && entry->asset->last_write_time == last_write_time) {
+        entry->checked = now;
+        return {status_e::ok, entry->asset};
+      }
+    }
+
+    // Missing, modified or deleted files are loaded again
+    return load(key);
+  }
+
+  cache_t::entry_t *cache_t::find(const std::string &path) {
+    auto key = aliases.find(path);
+    if (key == std::end(aliases)) {
+      return nullptr;
+    }
+
+    auto it = entries.find(key->second);
+    return it == std::end(entries) ? nullptr : &it->second;
+  }
+
+  void cache_t::alias(const std::string &path, const std::string &key) {
+    if (aliases.size() >= MAX_ALIASES && !aliases.contains(path)) {
+      aliases.clear();
+    }
+    aliases.insert_or_assign(path, key);
+  }
+
+  lookup_t cache_t::load(const std::string &path) {
+    std::error_code ec;
+
+    auto canonical_root = fs::weakly_canonical(root, ec);
+    auto file = fs::weakly_canonical(canonical_root / fs::path(path).relative_path(), ec);
+    if (ec) {
+      return {status_e::not_found, nullptr};
+    }
+    if (!is_within(canonical_root, file)) {
+      BOOST_LOG(warning) << "Someone requested a path "sv << file << " that is outside "sv << root;
+      return {status_e::outside_root, nullptr};
+    }
+
+    auto key = file.string();
+    auto last_write_time = fs::last_write_time(file, ec);
+    if (ec || !fs::is_regular_file(file, ec)) {
+      std::lock_guard lg {mutex};
+      aliases.erase(path);
+      entries.erase(key);
+
+      return {status_e::not_found, nullptr};
+    }
+
+    {
+      // Another spelling of the path may have loaded the file already
+      std::lock_guard lg {mutex};
+      auto it = entries.find(key);
+      if (it != std::end(entries) && it->second.asset->last_write_time == last_write_time) {
+        it->second.checked = std::chrono::steady_clock::now();
+        alias(path, key);
+
+        return {status_e::ok, it->second.asset};
+      }
+    }
+
+    auto extension = file.extension().string();
+    auto mime_type = extension.empty() ? std::end(mime_types) : mime_types.find(boost::algorithm::to_lower_copy(extension.substr(1)));
+    if (mime_type == std::end(mime_types)) {
+      return {status_e::unsupported_type, nullptr};
+    }
+
+    std::ifstream in {file, std::ios::binary};
+    if (!in) {
+      return {status_e::not_found, nullptr};
+    }
+
+    auto asset = std::make_shared<asset_t>();
+    asset->content_type = mime_type->second;
+    if (asset->content_type == "text/html"sv) {
+      asset->content_type += "; charset=utf-8"sv;
+    }
+    asset->content.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    asset->etag = make_etag(asset->content);
+    asset->last_write_time = last_write_time;
+
+    if (asset->content.size() >= MIN_GZIP_SIZE && compressible(asset->content_type)) {
+      auto compressed = gzip(asset->content);
+      if (!compressed.empty() && compressed.size() <= asset->content.size() * MAX_GZIP_RATIO) {
+        asset->gzip_content = std::move(compressed);
+        asset->gzip_etag = make_etag(asset->content, "-gzip"sv);
+      }
+    }
+
+    BOOST_LOG(verbose) << "Cached "sv << file << ": "sv << asset->content.size() << " bytes, "sv
+                       << asset->gzip_content.size() << " bytes compressed"sv;
+
+    std::lock_guard lg {mutex};
+    entries.insert_or_assign(key, entry_t {asset, file, std::chrono::steady_clock::now()});
+    alias(path, key);
+
+    return {status_e::ok, std::move(asset)};
+  }
+
+  void cache_t::clear() {
+    std::lock_guard lg {mutex};
+    aliases.clear();
+    entries.clear();
+  }
+
+  std::string gzip(std::string_view data) {
+    z_stream stream {};
+
+    // 16 added to the window bits selects the gzip wrapper instead of zlib's
+    if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK) {
+      return {};
+    }
+    auto fg = util::fail_guard([&stream]() {
+      deflateEnd(&stream);
+    });
+
+    std::string compressed;
+    compressed.resize(deflateBound(&stream, data.size()));
+
+    stream.next_in = (Bytef *) data.data();
+    stream.avail_in = (uInt) data.size();
+    stream.next_out = (Bytef *) compressed.data();
+    stream.avail_out = (uInt) compressed.size();
+
+    if (deflate(&stream, Z_FINISH) != Z_STREAM_END) {
+      return {};
+    }
+
+    compressed.resize(stream.total_out);
+    return compressed;
+  }
+
+  bool accepts_encoding(std::string_view accept_encoding, std::string_view coding) {
+    bool wildcard = false;
+
+    while (!accept_encoding.empty()) {
+      auto end = accept_encoding.find(',');
+      auto element = accept_encoding.substr(0, end);
+      accept_encoding.remove_prefix(end == std::string_view::npos ? accept_encoding.size() : end + 1);
+
+      // e.g. " gzip;q=0.5"
+      auto params = element.find(';');
+      auto name = boost::algorithm::trim_copy(std::string {element.substr(0, params)});
+
+      bool rejected = false;
+      if (params != std::string_view::npos) {
+        auto q = boost::algorithm::erase_all_copy(std::string {element.substr(params + 1)}, " ");
+        if (boost::algorithm::istarts_with(q, "q=")) {
+          rejected = std::strtod(q.c_str() + 2, nullptr) <= 0;
+        }
+      }
+
+      if (boost::algorithm::iequals(name, coding)) {
+        return !rejected;
+      }
+      if (name == "*") {
+        wildcard = !rejected;
+      }
+    }
+
+    return wildcard;
+  }
+
+  bool etag_matches(std::string_view if_none_match, std::string_view etag) {
+    if (boost::algorithm::trim_copy(std::string {if_none_match}) == "*") {
+      return true;
+    }
+
+    // If-None-Match uses the weak comparison, so a W/ prefix is ignored
+    while (!if_none_match.empty()) {
+      auto end = if_none_match.find(',');
+      auto tag = boost::algorithm::trim_copy(std::string {if_none_match.substr(0, end)});
+      if_none_match.remove_prefix(end == std::string_view::npos ? if_none_match.size() : end + 1);
+
+      if (tag.starts_with("W/")) {
+        tag.erase(0, 2);
+      }
+      if (tag == etag) {
+        return true;
+      }
+    }
+
+    return false;
+  }
+}  // namespace asset_cache
@@ -0,0 +1,125 @@
+/**
+ * @file src/asset_cache.h
+ * @brief Declarations for the in-memory cache of the static Web UI files.
+ */
+#pragma once
+
+// standard includes
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+/**
+ * @brief In-memory cache of static files, precompressed and tagged for conditional requests.
+ */
+namespace asset_cache {
+  /**
+   * @brief A cached file.
+   */
+  struct asset_t {
+    std::string content_type;
+    std::string content;
+    std::string etag;  ///< Quoted strong validator of content
+    std::string gzip_content;  ///< Empty if compressing doesn't make the file noticeably smaller
+    std::string gzip_etag;  ///< Quoted strong validator of gzip_content
+    std::filesystem::file_time_type last_write_time;
+  };
+
+  using asset_ptr_t = std::shared_ptr<const asset_t>;
+
+  enum class status_e {
+    ok,  ///< The asset was found
+    not_found,  ///< The file doesn't exist
+    outside_root,  ///< The path leads outside of the cached directory
+    unsupported_type,  ///< The file extension has no known MIME type
+  };
+
+  struct lookup_t {
+    status_e status;
+    asset_ptr_t asset;  ///< nullptr unless status is ok
+  };
+
+  /**
+   * @brief Cache of the files below a directory, loaded on first use.
+   * @details Files are checked for modifications at most once per revalidation interval,
+   *          so a hit doesn't touch the filesystem.
+   */
+  class cache_t {
+  public:
+    static constexpr std::chrono::seconds REVALIDATE_INTERVAL {2};
+
+    /**
+     * @param root The directory the paths are relative to.
+     * @param revalidate_interval How long a file is served without checking for modifications.
+     */
+    explicit cache_t(std::filesystem::path root, std::chrono::milliseconds revalidate_interval = REVALIDATE_INTERVAL);
+
+    /**
+     * @brief Get a file below the root directory.
+     * @param path The path relative to the root, a leading slash is ignored.
+     * @return The lookup result.
+     * @examples
+     * asset_cache::cache_t cache {WEB_DIR};
+     * auto lookup = cache.get("/index.html");
+     * @examples_end
+     */
+    lookup_t get(std::string_view path);
+
+    /**
+     * @brief Forget all cached files.
+     */
+    void clear();
+
+  private:
+    struct entry_t {
+      asset_ptr_t asset;
+      std::filesystem::path file;
+      std::chrono::steady_clock::time_point checked;
+    };
+
+    lookup_t load(const std::string &path);
+    entry_t *find(const std::string &path);
+    void alias(const std::string &path, const std::string &key);
+
+    std::filesystem::path root;
+    std::chrono::milliseconds revalidate_interval;
+
+    std::mutex mutex;
+    std::unordered_map<std::string, std::string> aliases;  ///< Normalized request paths to the key of their entry
+    std::unordered_map<std::string, entry_t> entries;  ///< By canonical file path
+  };
+
+  /**
+   * @brief Compress data to the gzip format.
+   * @param data The data to compress.
+   * @return The compressed data, empty on failure.
+   */
+  std::string gzip(std::string_view data);
+
+  /**
+   * @brief Check whether an Accept-Encoding header allows a content coding.
+   * @param accept_encoding The value of the header.
+   * @param coding The content coding, e.g. "gzip".
+   * @return true if the coding is listed, or covered by "*", without a zero quality value.
+   * @examples
+   * asset_cache::accepts_encoding("gzip, deflate, br", "gzip");  // true
+   * asset_cache::accepts_encoding("gzip;q=0, identity", "gzip");  // false
+   * @examples_end
+   */
+  bool accepts_encoding(std::string_view accept_encoding, std::string_view coding);
+
+  /**
+   * @brief Check whether an If-None-Match header matches an entity tag.
+   * @param if_none_match The value of the header.
+   * @param etag The quoted entity tag of the current representation.
+   * @return true if the client's copy is current.
+   * @examples
+   * asset_cache::etag_matches("W/\"abc\", \"def\"", "\"abc\"");  // true
+   * @examples_end
+   */
+  bool etag_matches(std::string_view if_none_match, std::string_view etag);
+}  // namespace asset_cache
@@ -14,13 +14,14 @@
 #include "globals.h"
 #include "logging.h"
 #include "platform/common.h"
+#include "thread_placement.h"
 #include "thread_safe.h"
 #include "utility.h"
 
 namespace audio {
   using namespace std::literals;
   using opus_t = util::safe_ptr<OpusMSEncoder, opus_multistream_encoder_destroy>;
-  using sample_queue_t = std::shared_ptr<safe::queue_t<std::vector<float>>>;
+  using sample_queue_t = std::shared_ptr<safe::ring_queue_t<std::vector<float>>>;
 
   static int start_audio_control(audio_ctx_t &ctx);
   static void stop_audio_control(audio_ctx_t &);
@@ -84,14 +85,14 @@ namespace audio {
   };
 
   void encodeThread(sample_queue_t samples, config_t config, void *channel_data) {
-    auto packets = mail::man->queue<packet_t>(mail::audio_packets);
+    auto packets = mail::man->ring_queue<packet_t>(mail::audio_packets);
     auto stream = stream_configs[map_stream(config.channels, config.flags[config_t::HIGH_QUALITY])];
     if (config.flags[config_t::CUSTOM_SURROUND_PARAMS]) {
       apply_surround_params(stream, config.customStreamParams);
     }
 
     // Encoding takes place on this thread
-    platf::adjust_thread_priority(platf::thread_priority_e::high);
+    auto placement = thread_placement::apply(thread_placement::role_e::audio, platf::thread_priority_e::high);
 
     opus_t opus {opus_multistream_encoder_create(
       stream.sampleRate,
@@ -205,15 +206,19 @@ namespace audio {
     init_failure_fg.disable();
 
     // Capture takes place on this thread
-    platf::adjust_thread_priority(platf::thread_priority_e::critical);
+    auto placement = thread_placement::apply(thread_placement::role_e::audio, platf::thread_priority_e::critical);
 
-    auto samples = std::make_shared<sample_queue_t::element_type>(30);
+    sample_queue_t samples = mail->ring_queue<std::vector<float>>(mail::audio_samples, 30, safe::overflow_e::drop_oldest);
     std::thread thread {encodeThread, samples, config, channel_data};
 
     auto fg = util::fail_guard([&]() {
       samples->stop();
       thread.join();
 
+      if (auto stats = samples->stats(); stats.dropped) {
+        BOOST_LOG(warning) << "Dropped "sv << stats.dropped << " of "sv << stats.raised << " captured audio frames, the encoder couldn't keep up"sv;
+      }
+
       shutdown_event->view();
     });
 
@@ -250,9 +255,17 @@ namespace audio {
     }
   }
 
-  audio_ctx_ref_t get_audio_ctx_ref() {
+  safe::shared_t<audio_ctx_t> &audio_ctx_shared() {
     static auto control_shared {safe::make_shared<audio_ctx_t>(start_audio_control, stop_audio_control)};
-    return control_shared.ref();
+    return control_shared;
+  }
+
+  audio_ctx_ref_t get_audio_ctx_ref() {
+    return audio_ctx_shared().ref();
+  }
+
+  audio_ctx_ref_t get_existing_audio_ctx_ref() {
+    return audio_ctx_shared().ref_existing();
   }
 
   bool is_audio_ctx_sink_available(const audio_ctx_t &ctx) {
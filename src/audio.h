@@ -91,6 +91,13 @@ namespace audio {
    */
   audio_ctx_ref_t get_audio_ctx_ref();
 
+  /**
+   * @brief Get another reference to the audio context, only if it is already in use.
+   * @returns A shared pointer reference to audio context, empty if nothing holds the audio context.
+   * @note Unlike `get_audio_ctx_ref()`, this never captures the audio sink.
+   */
+  audio_ctx_ref_t get_existing_audio_ctx_ref();
+
   /**
    * @brief Check if the audio sink held by audio context is available.
    * @returns True if available (and can probably be restored), false otherwise.
@@ -8,6 +8,8 @@
 #include <fstream>
 #include <functional>
 #include <iostream>
+#include <set>
+#include <sstream>
 #include <thread>
 #include <unordered_map>
 #include <utility>
@@ -515,6 +517,16 @@ namespace config {
     "1920x1080x60",  // fallback_mode
     false, // isolated Display
     false, // ignore_encoder_probe_failure
+    true,  // encoder_cache
+    false,  // encoder_cache_revalidate
+
+    {
+      {},  // file
+      0,  // width
+      0,  // height
+      0,  // framerate
+      false,  // fast
+    },  // replay
   };
 
   audio_t audio {
@@ -528,10 +540,13 @@ namespace config {
 
   stream_t stream {
     10s,  // ping_timeout
+    0ms,  // resume_grace_period
+    0us,  // pacing_spin_tail
 
     APPS_JSON_PATH,
 
     20,  // fecPercentage
+    false,  // fec_early_send
 
     ENCRYPTION_MODE_NEVER,  // lan_encryption_mode
     ENCRYPTION_MODE_OPPORTUNISTIC,  // wan_encryption_mode
@@ -571,7 +586,9 @@ namespace config {
     true,  // controller enabled
     true,  // always send scancodes
     true,  // high resolution scrolling
+    1000us,  // mouse_coalesce_window
     true,  // native pen/touch support
+    1000us,  // touch_coalesce_window
     false, // enable input only mode
     true, // forward_rumble
   };
@@ -598,8 +615,34 @@ namespace config {
     {},  // prep commands
     {},  // state commands
     {},  // server commands
+    {},  // capture_cpus
+    {},  // encode_cpus
+    {},  // audio_cpus
+    {},  // network_cpus
+    false,  // realtime_threads
+  };
+
+  /**
+   * @brief The values of all configuration structs, parsed together.
+   */
+  struct snapshot_t {
+    video_t video;
+    audio_t audio;
+    stream_t stream;
+    nvhttp_t nvhttp;
+    input_t input;
+    sunshine_t sunshine;
   };
 
+  // Copied before any option is applied, reload() parses the file on top of them
+  const snapshot_t defaults {video, audio, stream, nvhttp, input, sunshine};
+
+  // The options in effect, as parsed from the file and the command line
+  std::unordered_map<std::string, std::string> applied_vars;
+
+  // Options from the command line take precedence over the file, on every reload as well
+  std::unordered_map<std::string, std::string> cmd_line_vars;
+
   bool endline(char ch) {
     return ch == '\r' || ch == '\n';
   }
@@ -1047,21 +1090,67 @@ namespace config {
     }
   }
 
-  int apply_flags(const char *line) {
+  /**
+   * @brief Parse a list of CPUs in the format of taskset, e.g. "0-3,8,10-11".
+   */
+  void cpu_list_f(std::unordered_map<std::string, std::string> &vars, const std::string &name, std::vector<int> &input) {
+    std::string tmp;
+    string_f(vars, name, tmp);
+
+    if (tmp.empty()) {
+      return;
+    }
+
+    std::vector<int> cpus;
+    std::istringstream ranges {tmp};
+    for (std::string range; std::getline(ranges, range, ',');) {
+      int first;
+      int last;
+      try {
+        std::size_t pos;
+        first = std::stoi(range, &pos);
+        last = first;
+
+        // Either a single CPU or an inclusive range
+        auto dash = range.find_first_not_of(" \t"sv, pos);
+        if (dash != std::string::npos && range[dash] == '-') {
+          auto rest = range.substr(dash + 1);
+          last = std::stoi(rest, &pos);
+          dash = rest.find_first_not_of(" \t"sv, pos);
+        }
+        if (dash != std::string::npos || last < first) {
+          throw std::invalid_argument {range};
+        }
+      } catch (const std::exception &) {
+        BOOST_LOG(warning) << "config: ["sv << name << "] expected a list of CPUs like 0-3,8 --> not "sv << tmp;
+        return;
+      }
+
+      for (int cpu = std::max(first, 0); cpu <= last && cpu < 1024; ++cpu) {
+        cpus.emplace_back(cpu);
+      }
+    }
+
+    std::sort(std::begin(cpus), std::end(cpus));
+    cpus.erase(std::unique(std::begin(cpus), std::end(cpus)), std::end(cpus));
+    input = std::move(cpus);
+  }
+
+  int apply_flags(const char *line, std::bitset<flag::FLAG_SIZE> &flags = sunshine.flags) {
     int ret = 0;
     while (*line != '\0') {
       switch (*line) {
         case '0':
-          config::sunshine.flags[config::flag::PIN_STDIN].flip();
+          flags[config::flag::PIN_STDIN].flip();
           break;
         case '1':
-          config::sunshine.flags[config::flag::FRESH_STATE].flip();
+          flags[config::flag::FRESH_STATE].flip();
           break;
         case '2':
-          config::sunshine.flags[config::flag::FORCE_VIDEO_HEADER_REPLACE].flip();
+          flags[config::flag::FORCE_VIDEO_HEADER_REPLACE].flip();
           break;
         case 'p':
-          config::sunshine.flags[config::flag::UPNP].flip();
+          flags[config::flag::UPNP].flip();
           break;
         default:
           BOOST_LOG(warning) << "config: Unrecognized flag: ["sv << *line << ']' << std::endl;
@@ -1084,19 +1173,17 @@ namespace config {
     return opts;
   }
 
-  void apply_config(std::unordered_map<std::string, std::string> &&vars) {
-    if (!fs::exists(stream.file_apps.c_str())) {
-      fs::copy_file(SUNSHINE_ASSETS_DIR "/apps.json", stream.file_apps);
-    }
-
-    for (auto &[name, val] : vars) {
-    #ifdef _WIN32
-      BOOST_LOG(info) << "config: ["sv << name << "] -- ["sv << utf8ToAcp(val) << ']';
-    #else
-      BOOST_LOG(info) << "config: ["sv << name << "] -- ["sv << val << ']';
-    #endif
-      modified_config_settings[name] = val;
-    }
+  /**
+   * @brief Parse the options into a snapshot, the options are removed from vars as they're parsed.
+   */
+  void apply_vars(snapshot_t &snapshot, std::unordered_map<std::string, std::string> &vars) {
+    // The names below refer to the snapshot, not to the live configuration
+    auto &video = snapshot.video;
+    auto &audio = snapshot.audio;
+    auto &stream = snapshot.stream;
+    auto &nvhttp = snapshot.nvhttp;
+    auto &input = snapshot.input;
+    auto &sunshine = snapshot.sunshine;
 
     bool_f(vars, "headless_mode", video.headless_mode);
     bool_f(vars, "limit_framerate", video.limit_framerate);
@@ -1201,21 +1288,29 @@ namespace config {
     string_f(vars, "fallback_mode", video.fallback_mode);
     bool_f(vars, "isolated_virtual_display_option", video.isolated_virtual_display_option);
     bool_f(vars, "ignore_encoder_probe_failure", video.ignore_encoder_probe_failure);
+    bool_f(vars, "encoder_cache", video.encoder_cache);
+    bool_f(vars, "encoder_cache_revalidate", video.encoder_cache_revalidate);
+
+    path_f(vars, "replay_file", video.replay.file);
+    int_between_f(vars, "replay_width", video.replay.width, {0, 16384});
+    int_between_f(vars, "replay_height", video.replay.height, {0, 16384});
+    int_between_f(vars, "replay_framerate", video.replay.framerate, {0, 1000});
+    bool_f(vars, "replay_fast", video.replay.fast);
 
     path_f(vars, "pkey", nvhttp.pkey);
     path_f(vars, "cert", nvhttp.cert);
     string_f(vars, "sunshine_name", nvhttp.sunshine_name);
-    path_f(vars, "log_path", config::sunshine.log_file);
+    path_f(vars, "log_path", sunshine.log_file);
     path_f(vars, "file_state", nvhttp.file_state);
 
     // Must be run after "file_state"
-    config::sunshine.credentials_file = config::nvhttp.file_state;
-    path_f(vars, "credentials_file", config::sunshine.credentials_file);
+    sunshine.credentials_file = nvhttp.file_state;
+    path_f(vars, "credentials_file", sunshine.credentials_file);
 
     string_f(vars, "external_ip", nvhttp.external_ip);
-    list_prep_cmd_f(vars, "global_prep_cmd", config::sunshine.prep_cmds);
-    list_prep_cmd_f(vars, "global_state_cmd", config::sunshine.state_cmds);
-    list_server_cmd_f(vars, "server_cmd", config::sunshine.server_cmds);
+    list_prep_cmd_f(vars, "global_prep_cmd", sunshine.prep_cmds);
+    list_prep_cmd_f(vars, "global_state_cmd", sunshine.state_cmds);
+    list_server_cmd_f(vars, "server_cmd", sunshine.server_cmds);
 
     string_f(vars, "audio_sink", audio.sink);
     string_f(vars, "virtual_sink", audio.virtual_sink);
@@ -1232,11 +1327,24 @@ namespace config {
       stream.ping_timeout = std::chrono::milliseconds(to);
     }
 
+    int grace_period = -1;
+    int_between_f(vars, "resume_grace_period", grace_period, {0, 10 * 60 * 1000});
+    if (grace_period != -1) {
+      stream.resume_grace_period = std::chrono::milliseconds(grace_period);
+    }
+
+    int spin_tail = -1;
+    int_between_f(vars, "pacing_spin_tail", spin_tail, {0, 1000});
+    if (spin_tail != -1) {
+      stream.pacing_spin_tail = std::chrono::microseconds(spin_tail);
+    }
+
     int_between_f(vars, "lan_encryption_mode", stream.lan_encryption_mode, {0, 2});
     int_between_f(vars, "wan_encryption_mode", stream.wan_encryption_mode, {0, 2});
 
     path_f(vars, "file_apps", stream.file_apps);
     int_between_f(vars, "fec_percentage", stream.fec_percentage, {1, 255});
+    bool_f(vars, "fec_early_send", stream.fec_early_send);
 
     map_int_int_f(vars, "keybindings"s, input.keybindings);
 
@@ -1260,7 +1368,7 @@ namespace config {
     double_between_f(vars, "key_repeat_frequency", repeat_frequency, {0, std::numeric_limits<double>::max()});
 
     if (repeat_frequency > 0) {
-      config::input.key_repeat_period = std::chrono::duration<double> {1 / repeat_frequency};
+      input.key_repeat_period = std::chrono::duration<double> {1 / repeat_frequency};
     }
 
     to = -1;
@@ -1281,7 +1389,21 @@ namespace config {
     bool_f(vars, "always_send_scancodes", input.always_send_scancodes);
 
     bool_f(vars, "high_resolution_scrolling", input.high_resolution_scrolling);
+
+    int coalesce_window = -1;
+    int_between_f(vars, "mouse_coalesce_window", coalesce_window, {0, 16666});
+    if (coalesce_window != -1) {
+      input.mouse_coalesce_window = std::chrono::microseconds(coalesce_window);
+    }
+
     bool_f(vars, "native_pen_touch", input.native_pen_touch);
+
+    coalesce_window = -1;
+    int_between_f(vars, "touch_coalesce_window", coalesce_window, {0, 16666});
+    if (coalesce_window != -1) {
+      input.touch_coalesce_window = std::chrono::microseconds(coalesce_window);
+    }
+
     bool_f(vars, "enable_input_only_mode", input.enable_input_only_mode);
 
     bool_f(vars, "hide_tray_controls", sunshine.hide_tray_controls);
@@ -1290,6 +1412,11 @@ namespace config {
     bool_f(vars, "envvar_compatibility_mode", sunshine.envvar_compatibility_mode);
     bool_f(vars, "notify_pre_releases", sunshine.notify_pre_releases);
     bool_f(vars, "legacy_ordering", sunshine.legacy_ordering);
+    cpu_list_f(vars, "capture_cpus", sunshine.capture_cpus);
+    cpu_list_f(vars, "encode_cpus", sunshine.encode_cpus);
+    cpu_list_f(vars, "audio_cpus", sunshine.audio_cpus);
+    cpu_list_f(vars, "network_cpus", sunshine.network_cpus);
+    bool_f(vars, "realtime_threads", sunshine.realtime_threads);
     bool_f(vars, "forward_rumble", input.forward_rumble);
 
     int port = sunshine.port;
@@ -1302,10 +1429,10 @@ namespace config {
     bool_f(vars, "upnp"s, upnp);
 
     if (upnp) {
-      config::sunshine.flags[config::flag::UPNP].flip();
+      sunshine.flags[flag::UPNP].flip();
     }
 
-    string_restricted_f(vars, "locale", config::sunshine.locale, {
+    string_restricted_f(vars, "locale", sunshine.locale, {
                                                                    "bg"sv,  // Bulgarian
                                                                    "cs"sv,  // Czech
                                                                    "de"sv,  // German
@@ -1357,7 +1484,7 @@ namespace config {
 
     auto it = vars.find("flags"s);
     if (it != std::end(vars)) {
-      apply_flags(it->second.c_str());
+      apply_flags(it->second.c_str(), sunshine.flags);
 
       vars.erase(it);
     }
@@ -1367,11 +1494,149 @@ namespace config {
         std::cout << "Warning: Unrecognized configurable option ["sv << var << ']' << std::endl;
       }
     }
+  }
+
+  void apply_config(std::unordered_map<std::string, std::string> &&vars) {
+    if (!fs::exists(stream.file_apps.c_str())) {
+      fs::copy_file(SUNSHINE_ASSETS_DIR "/apps.json", stream.file_apps);
+    }
+
+    for (auto &[name, val] : vars) {
+    #ifdef _WIN32
+      BOOST_LOG(info) << "config: ["sv << name << "] -- ["sv << utf8ToAcp(val) << ']';
+    #else
+      BOOST_LOG(info) << "config: ["sv << name << "] -- ["sv << val << ']';
+    #endif
+      modified_config_settings[name] = val;
+    }
+    applied_vars = vars;
+
+    snapshot_t snapshot {video, audio, stream, nvhttp, input, sunshine};
+    apply_vars(snapshot, vars);
+
+    video = std::move(snapshot.video);
+    audio = std::move(snapshot.audio);
+    stream = std::move(snapshot.stream);
+    nvhttp = std::move(snapshot.nvhttp);
+    input = std::move(snapshot.input);
+    sunshine = std::move(snapshot.sunshine);
 
     ::video::active_hevc_mode = video.hevc_mode;
     ::video::active_av1_mode = video.av1_mode;
   }
 
+// Copies a scalar field of the snapshot to the live configuration
+#define LIVE_OPTION(name, field) \
+  { \
+    name##sv, [](const snapshot_t &snapshot) { \
+      field = snapshot.field; \
+    } \
+  }
+
+  /**
+   * @brief Options read whenever they're used, or when a stream starts, so they can change at runtime.
+   * @details Every other option takes effect after a restart. Only scalar fields are listed,
+   *          other threads may read them while they're overwritten.
+   */
+  const std::unordered_map<std::string_view, void (*)(const snapshot_t &)> live_options {
+    {"min_log_level"sv, [](const snapshot_t &snapshot) {
+       sunshine.min_log_level = snapshot.sunshine.min_log_level;
+       logging::set_min_level(sunshine.min_log_level);
+     }},
+    LIVE_OPTION("limit_framerate", video.limit_framerate),
+    LIVE_OPTION("double_refreshrate", video.double_refreshrate),
+    LIVE_OPTION("max_bitrate", video.max_bitrate),
+    LIVE_OPTION("dd_config_revert_on_disconnect", video.dd.config_revert_on_disconnect),
+    LIVE_OPTION("stream_audio", audio.stream),
+    LIVE_OPTION("ping_timeout", stream.ping_timeout),
+    LIVE_OPTION("resume_grace_period", stream.resume_grace_period),
+    LIVE_OPTION("pacing_spin_tail", stream.pacing_spin_tail),
+    LIVE_OPTION("lan_encryption_mode", stream.lan_encryption_mode),
+    LIVE_OPTION("wan_encryption_mode", stream.wan_encryption_mode),
+    LIVE_OPTION("fec_percentage", stream.fec_percentage),
+    LIVE_OPTION("fec_early_send", stream.fec_early_send),
+    LIVE_OPTION("back_button_timeout", input.back_button_timeout),
+    LIVE_OPTION("key_repeat_delay", input.key_repeat_delay),
+    LIVE_OPTION("key_repeat_frequency", input.key_repeat_period),
+    LIVE_OPTION("ds4_back_as_touchpad_click", input.ds4_back_as_touchpad_click),
+    LIVE_OPTION("motion_as_ds4", input.motion_as_ds4),
+    LIVE_OPTION("touchpad_as_ds4", input.touchpad_as_ds4),
+    LIVE_OPTION("mouse", input.mouse),
+    LIVE_OPTION("keyboard", input.keyboard),
+    LIVE_OPTION("controller", input.controller),
+    LIVE_OPTION("always_send_scancodes", input.always_send_scancodes),
+    LIVE_OPTION("high_resolution_scrolling", input.high_resolution_scrolling),
+    LIVE_OPTION("mouse_coalesce_window", input.mouse_coalesce_window),
+    LIVE_OPTION("native_pen_touch", input.native_pen_touch),
+    LIVE_OPTION("touch_coalesce_window", input.touch_coalesce_window),
+    LIVE_OPTION("enable_input_only_mode", input.enable_input_only_mode),
+    LIVE_OPTION("forward_rumble", input.forward_rumble),
+    LIVE_OPTION("enable_pairing", sunshine.enable_pairing),
+    LIVE_OPTION("legacy_ordering", sunshine.legacy_ordering),
+    LIVE_OPTION("notify_pre_releases", sunshine.notify_pre_releases),
+    LIVE_OPTION("realtime_threads", sunshine.realtime_threads),
+  };
+
+#undef LIVE_OPTION
+
+  reload_result_t reload() {
+    auto vars = parse_config(file_handler::read_file(sunshine.config_file.c_str()));
+    for (auto &[name, value] : cmd_line_vars) {
+      vars.insert_or_assign(name, value);
+    }
+
+    // Sorted, so the result lists the options in a stable order
+    std::set<std::string> changed;
+    for (auto &[name, value] : vars) {
+      auto it = applied_vars.find(name);
+      if (it == std::end(applied_vars) || it->second != value) {
+        changed.insert(name);
+      }
+    }
+    for (auto &[name, _] : applied_vars) {
+      if (!vars.contains(name)) {
+        changed.insert(name);
+      }
+    }
+
+    reload_result_t result;
+    if (changed.empty()) {
+      return result;
+    }
+
+    // Removed options fall back to their defaults
+    snapshot_t snapshot {defaults};
+    auto unparsed = vars;
+    apply_vars(snapshot, unparsed);
+
+    for (auto &name : changed) {
+      auto option = live_options.find(name);
+      if (option == std::end(live_options)) {
+        // Still differs from the applied value, so it's reported again until the restart
+        result.restart_required.push_back(name);
+        continue;
+      }
+
+      option->second(snapshot);
+      result.applied.push_back(name);
+
+      auto value = vars.find(name);
+      if (value == std::end(vars)) {
+        BOOST_LOG(info) << "config: ["sv << name << "] -- reset to default"sv;
+        applied_vars.erase(name);
+      } else {
+        BOOST_LOG(info) << "config: ["sv << name << "] -- ["sv << value->second << ']';
+        applied_vars.insert_or_assign(name, value->second);
+      }
+    }
+
+    for (auto &name : result.restart_required) {
+      BOOST_LOG(info) << "config: ["sv << name << "] changed, it takes effect after a restart"sv;
+    }
+
+    return result;
+  }
+
   int parse(int argc, char *argv[]) {
     std::unordered_map<std::string, std::string> cmd_vars;
 #ifdef _WIN32
@@ -1446,6 +1711,7 @@ namespace config {
       // Read config file
       auto vars = parse_config(file_handler::read_file(sunshine.config_file.c_str()));
 
+      cmd_line_vars = cmd_vars;
       for (auto &[name, value] : cmd_vars) {
         vars.insert_or_assign(std::move(name), std::move(value));
       }
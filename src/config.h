@@ -148,6 +148,16 @@ namespace config {
     std::string fallback_mode;
     bool isolated_virtual_display_option;
     bool ignore_encoder_probe_failure;
+    bool encoder_cache;  ///< Reuse encoder capabilities from a previous probe when GPUs and drivers are unchanged.
+    bool encoder_cache_revalidate;  ///< Verify cached encoder capabilities in the background.
+
+    struct {
+      std::string file;  ///< Raw BGRX clip served by the replay capture backend.
+      int width;
+      int height;
+      int framerate;  ///< Replay framerate, 0 to follow the framerate requested by the client.
+      bool fast;  ///< Serve frames as fast as the encoder consumes them.
+    } replay;
   };
 
   struct audio_t {
@@ -165,10 +175,13 @@ namespace config {
 
   struct stream_t {
     std::chrono::milliseconds ping_timeout;
+    std::chrono::milliseconds resume_grace_period;  ///< How long the capture and the paused app state outlive the last session.
+    std::chrono::microseconds pacing_spin_tail;  ///< The end of a pacing sleep spent spinning instead of sleeping, Linux only.
 
     std::string file_apps;
 
     int fec_percentage;
+    bool fec_early_send;  ///< Send the data shards of each FEC block before computing its parity shards.
 
     // Video encryption settings for LAN and WAN streams
     int lan_encryption_mode;
@@ -209,7 +222,9 @@ namespace config {
     bool always_send_scancodes;
 
     bool high_resolution_scrolling;
+    std::chrono::microseconds mouse_coalesce_window;  ///< Relative motion and scrolling within it are emitted together, Linux only
     bool native_pen_touch;
+    std::chrono::microseconds touch_coalesce_window;  ///< Touch and pen moves within it are passed on together as one frame
 
     bool enable_input_only_mode;
     bool forward_rumble;
@@ -285,6 +300,13 @@ namespace config {
     std::vector<prep_cmd_t> prep_cmds;
     std::vector<prep_cmd_t> state_cmds;
     std::vector<server_cmd_t> server_cmds;
+
+    // CPUs the threads of each part of the media pipeline are restricted to, empty to leave them unrestricted
+    std::vector<int> capture_cpus;
+    std::vector<int> encode_cpus;
+    std::vector<int> audio_cpus;
+    std::vector<int> network_cpus;
+    bool realtime_threads;  ///< Schedule the streaming threads with SCHED_FIFO where permitted
   };
 
   extern video_t video;
@@ -296,4 +318,22 @@ namespace config {
 
   int parse(int argc, char *argv[]);
   std::unordered_map<std::string, std::string> parse_config(const std::string_view &file_content);
+
+  /**
+   * @brief The options that changed when the configuration file was reloaded.
+   */
+  struct reload_result_t {
+    std::vector<std::string> applied;  ///< In effect now, or when the next stream starts
+    std::vector<std::string> restart_required;  ///< In effect after a restart
+  };
+
+  /**
+   * @brief Read the configuration file again, and apply the changed options that can change at runtime.
+   * @details Options given on the command line keep their value.
+   * @return The changed options.
+   * @examples
+   * auto result = config::reload();
+   * @examples_end
+   */
+  reload_result_t reload();
 }  // namespace config
@@ -24,8 +24,10 @@
 #include <Simple-Web-Server/server_https.hpp>
 
 // local includes
+#include "asset_cache.h"
 #include "config.h"
 #include "confighttp.h"
+#include "cover_cache.h"
 #include "crypto.h"
 #include "display_device.h"
 #include "file_handler.h"
@@ -36,6 +38,9 @@
 #include "nvhttp.h"
 #include "platform/common.h"
 #include "process.h"
+#include "rtsp.h"
+#include "stream.h"
+#include "thread_placement.h"
 #include "utility.h"
 #include "uuid.h"
 
@@ -286,6 +291,65 @@ namespace confighttp {
     return true;
   }
 
+  // Pages and images are only served by their own routes, so they're kept apart from the assets
+  static asset_cache::cache_t web_pages {WEB_DIR};
+  static asset_cache::cache_t web_assets {WEB_DIR "assets"};
+
+  /**
+   * @brief Send a file of the Web UI from memory.
+   * @details Answers 304 Not Modified when the client's copy is current, and sends the precompressed
+   *          variant when the client accepts gzip.
+   * @param response The HTTP response object.
+   * @param request The HTTP request object.
+   * @param cache The cache holding the file.
+   * @param path The path of the file, relative to the directory of the cache.
+   * @param headers Additional headers for the response.
+   */
+  void send_asset(resp_https_t response, req_https_t request, asset_cache::cache_t &cache, std::string_view path, SimpleWeb::CaseInsensitiveMultimap headers = {}) {
+    auto lookup = cache.get(path);
+    switch (lookup.status) {
+      case asset_cache::status_e::ok:
+        break;
+      case asset_cache::status_e::not_found:
+        not_found(response, request);
+        return;
+      case asset_cache::status_e::outside_root:
+      case asset_cache::status_e::unsupported_type:
+        bad_request(response, request);
+        return;
+    }
+    auto &asset = *lookup.asset;
+
+    auto accept_encoding = request->header.find("Accept-Encoding");
+    bool use_gzip = !asset.gzip_content.empty() &&
+                    accept_encoding != std::end(request->header) &&
+                    asset_cache::accepts_encoding(accept_encoding->second, "gzip"sv);
+    auto &etag = use_gzip ? asset.gzip_etag : asset.etag;
+
+    headers.emplace("Content-Type", asset.content_type);
+    headers.emplace("X-Frame-Options", "DENY");
+    headers.emplace("Content-Security-Policy", "frame-ancestors 'none';");
+    // Always revalidate, not every file below assets has a content hash in its name
+    headers.emplace("Cache-Control", "no-cache");
+    headers.emplace("ETag", etag);
+    if (!asset.gzip_content.empty()) {
+      headers.emplace("Vary", "Accept-Encoding");
+    }
+
+    auto if_none_match = request->header.find("If-None-Match");
+    if (if_none_match != std::end(request->header) && asset_cache::etag_matches(if_none_match->second, etag)) {
+      response->write(SimpleWeb::StatusCode::redirection_not_modified, headers);
+      return;
+    }
+
+    if (use_gzip) {
+      headers.emplace("Content-Encoding", "gzip");
+      response->write(SimpleWeb::StatusCode::success_ok, asset.gzip_content, headers);
+    } else {
+      response->write(SimpleWeb::StatusCode::success_ok, asset.content, headers);
+    }
+  }
+
   /**
    * @brief Get the index page.
    * @param response The HTTP response object.
@@ -298,12 +362,7 @@ namespace confighttp {
 
     print_req(request);
 
-    std::string content = file_handler::read_file(WEB_DIR "index.html");
-    SimpleWeb::CaseInsensitiveMultimap headers;
-    headers.emplace("Content-Type", "text/html; charset=utf-8");
-    headers.emplace("X-Frame-Options", "DENY");
-    headers.emplace("Content-Security-Policy", "frame-ancestors 'none';");
-    response->write(content, headers);
+    send_asset(response, request, web_pages, "index.html");
   }
 
   /**
@@ -318,12 +377,7 @@ namespace confighttp {
 
     print_req(request);
 
-    std::string content = file_handler::read_file(WEB_DIR "pin.html");
-    SimpleWeb::CaseInsensitiveMultimap headers;
-    headers.emplace("Content-Type", "text/html; charset=utf-8");
-    headers.emplace("X-Frame-Options", "DENY");
-    headers.emplace("Content-Security-Policy", "frame-ancestors 'none';");
-    response->write(content, headers);
+    send_asset(response, request, web_pages, "pin.html");
   }
 
   /**
@@ -338,13 +392,9 @@ namespace confighttp {
 
     print_req(request);
 
-    std::string content = file_handler::read_file(WEB_DIR "apps.html");
     SimpleWeb::CaseInsensitiveMultimap headers;
-    headers.emplace("Content-Type", "text/html; charset=utf-8");
-    headers.emplace("X-Frame-Options", "DENY");
-    headers.emplace("Content-Security-Policy", "frame-ancestors 'none';");
     headers.emplace("Access-Control-Allow-Origin", "https://images.igdb.com/");
-    response->write(content, headers);
+    send_asset(response, request, web_pages, "apps.html", std::move(headers));
   }
 
   /**
@@ -359,12 +409,7 @@ namespace confighttp {
 
     print_req(request);
 
-    std::string content = file_handler::read_file(WEB_DIR "clients.html");
-    SimpleWeb::CaseInsensitiveMultimap headers;
-    headers.emplace("Content-Type", "text/html; charset=utf-8");
-    headers.emplace("X-Frame-Options", "DENY");
-    headers.emplace("Content-Security-Policy", "frame-ancestors 'none';");
-    response->write(content, headers);
+    send_asset(response, request, web_pages, "clients.html");
   }
 
   /**
@@ -379,12 +424,7 @@ namespace confighttp {
 
     print_req(request);
 
-    std::string content = file_handler::read_file(WEB_DIR "config.html");
-    SimpleWeb::CaseInsensitiveMultimap headers;
-    headers.emplace("Content-Type", "text/html; charset=utf-8");
-    headers.emplace("X-Frame-Options", "DENY");
-    headers.emplace("Content-Security-Policy", "frame-ancestors 'none';");
-    response->write(content, headers);
+    send_asset(response, request, web_pages, "config.html");
   }
 
   /**
@@ -399,12 +439,7 @@ namespace confighttp {
 
     print_req(request);
 
-    std::string content = file_handler::read_file(WEB_DIR "password.html");
-    SimpleWeb::CaseInsensitiveMultimap headers;
-    headers.emplace("Content-Type", "text/html; charset=utf-8");
-    headers.emplace("X-Frame-Options", "DENY");
-    headers.emplace("Content-Security-Policy", "frame-ancestors 'none';");
-    response->write(content, headers);
+    send_asset(response, request, web_pages, "password.html");
   }
 
   /**
@@ -424,12 +459,7 @@ namespace confighttp {
       return;
     }
 
-    std::string content = file_handler::read_file(WEB_DIR "login.html");
-    SimpleWeb::CaseInsensitiveMultimap headers;
-    headers.emplace("Content-Type", "text/html; charset=utf-8");
-    headers.emplace("X-Frame-Options", "DENY");
-    headers.emplace("Content-Security-Policy", "frame-ancestors 'none';");
-    response->write(content, headers);
+    send_asset(response, request, web_pages, "login.html");
   }
 
   /**
@@ -445,12 +475,7 @@ namespace confighttp {
       return;
     }
 
-    std::string content = file_handler::read_file(WEB_DIR "welcome.html");
-    SimpleWeb::CaseInsensitiveMultimap headers;
-    headers.emplace("Content-Type", "text/html; charset=utf-8");
-    headers.emplace("X-Frame-Options", "DENY");
-    headers.emplace("Content-Security-Policy", "frame-ancestors 'none';");
-    response->write(content, headers);
+    send_asset(response, request, web_pages, "welcome.html");
   }
 
   /**
@@ -465,12 +490,7 @@ namespace confighttp {
 
     print_req(request);
 
-    std::string content = file_handler::read_file(WEB_DIR "troubleshooting.html");
-    SimpleWeb::CaseInsensitiveMultimap headers;
-    headers.emplace("Content-Type", "text/html; charset=utf-8");
-    headers.emplace("X-Frame-Options", "DENY");
-    headers.emplace("Content-Security-Policy", "frame-ancestors 'none';");
-    response->write(content, headers);
+    send_asset(response, request, web_pages, "troubleshooting.html");
   }
 
   /**
@@ -481,42 +501,18 @@ namespace confighttp {
   void getFaviconImage(resp_https_t response, req_https_t request) {
     print_req(request);
 
-    std::ifstream in(WEB_DIR "images/apollo.ico", std::ios::binary);
-    SimpleWeb::CaseInsensitiveMultimap headers;
-    headers.emplace("Content-Type", "image/x-icon");
-    headers.emplace("X-Frame-Options", "DENY");
-    headers.emplace("Content-Security-Policy", "frame-ancestors 'none';");
-    response->write(SimpleWeb::StatusCode::success_ok, in, headers);
+    send_asset(response, request, web_pages, "images/apollo.ico");
   }
 
   /**
    * @brief Get the Apollo logo image.
    * @param response The HTTP response object.
    * @param request The HTTP request object.
-   *
-   * @todo combine function with getFaviconImage and possibly getNodeModules
-   * @todo use mime_types map
    */
   void getApolloLogoImage(resp_https_t response, req_https_t request) {
     print_req(request);
 
-    std::ifstream in(WEB_DIR "images/logo-apollo-45.png", std::ios::binary);
-    SimpleWeb::CaseInsensitiveMultimap headers;
-    headers.emplace("Content-Type", "image/png");
-    headers.emplace("X-Frame-Options", "DENY");
-    headers.emplace("Content-Security-Policy", "frame-ancestors 'none';");
-    response->write(SimpleWeb::StatusCode::success_ok, in, headers);
-  }
-
-  /**
-   * @brief Check if a path is a child of another path.
-   * @param base The base path.
-   * @param query The path to check.
-   * @return True if the path is a child of the base path, false otherwise.
-   */
-  bool isChildPath(fs::path const &base, fs::path const &query) {
-    auto relPath = fs::relative(base, query);
-    return *(relPath.begin()) != fs::path("..");
+    send_asset(response, request, web_pages, "images/logo-apollo-45.png");
   }
 
   /**
@@ -527,38 +523,8 @@ namespace confighttp {
   void getNodeModules(resp_https_t response, req_https_t request) {
     print_req(request);
 
-    fs::path webDirPath(WEB_DIR);
-    fs::path nodeModulesPath(webDirPath / "assets");
-
-    // .relative_path is needed to shed any leading slash that might exist in the request path
-    auto filePath = fs::weakly_canonical(webDirPath / fs::path(request->path).relative_path());
-
-    // Don't do anything if file does not exist or is outside the assets directory
-    if (!isChildPath(filePath, nodeModulesPath)) {
-      BOOST_LOG(warning) << "Someone requested a path " << filePath << " that is outside the assets folder";
-      bad_request(response, request);
-      return;
-    }
-
-    if (!fs::exists(filePath)) {
-      not_found(response, request);
-      return;
-    }
-
-    auto relPath = fs::relative(filePath, webDirPath);
-    // get the mime type from the file extension mime_types map
-    // remove the leading period from the extension
-    auto mimeType = mime_types.find(relPath.extension().string().substr(1));
-    if (mimeType == mime_types.end()) {
-      bad_request(response, request);
-      return;
-    }
-    SimpleWeb::CaseInsensitiveMultimap headers;
-    headers.emplace("Content-Type", mimeType->second);
-    headers.emplace("X-Frame-Options", "DENY");
-    headers.emplace("Content-Security-Policy", "frame-ancestors 'none';");
-    std::ifstream in(filePath.string(), std::ios::binary);
-    response->write(SimpleWeb::StatusCode::success_ok, in, headers);
+    // The route only matches paths below /assets/
+    send_asset(response, request, web_assets, std::string_view {request->path}.substr("/assets/"sv.size()));
   }
 
   /**
@@ -646,6 +612,9 @@ namespace confighttp {
 
       // Migrate/merge the new app into the file tree.
       proc::migrate_apps(&fileTree, &inputTree);
+      if (inputTree.contains("image-path") && inputTree["image-path"].is_string()) {
+        cover_cache::covers().invalidate(proc::validate_app_image_path(inputTree["image-path"].get<std::string>()));
+      }
 
       // Write the updated file tree back to disk.
       file_handler::write_file(config::stream.file_apps.c_str(), fileTree.dump(4));
@@ -876,6 +845,94 @@ namespace confighttp {
     send_response(response, output_tree);
   }
 
+  /**
+   * @brief Get per-stage frame latency statistics and the time to the first frame for the active streaming sessions.
+   * @param response The HTTP response object.
+   * @param request The HTTP request object.
+   *
+   * The "pacing_overshoot" stage is how late the send pacing of a frame woke up past its deadline,
+   * see the `pacing_spin_tail` option.
+   *
+   * @api_examples{/api/stats/latency| GET| null}
+   */
+  void getLatencyStats(resp_https_t response, req_https_t request) {
+    if (!authenticate(response, request)) {
+      return;
+    }
+
+    print_req(request);
+
+    nlohmann::json sessions = nlohmann::json::array();
+    for (auto &uuid : rtsp_stream::get_all_session_uuids()) {
+      if (auto session = rtsp_stream::find_session(uuid)) {
+        sessions.push_back(stream::session::latency_stats(*session));
+      }
+    }
+
+    nlohmann::json output_tree;
+    output_tree["sessions"] = sessions;
+    output_tree["status"] = true;
+    send_response(response, output_tree);
+  }
+
+  /**
+   * @brief Get the drop counters and high watermarks of the queues between the capture, encode and broadcast threads.
+   * @param response The HTTP response object.
+   * @param request The HTTP request object.
+   *
+   * The "queues" shared by all sessions hold the encoded video and audio packets,
+   * the queues of each session hold its captured images and audio samples.
+   * Each session also counts the controller states forwarded to its virtual gamepads,
+   * and those suppressed because they didn't change since the last one forwarded.
+   *
+   * @api_examples{/api/stats/queues| GET| null}
+   */
+  void getQueueStats(resp_https_t response, req_https_t request) {
+    if (!authenticate(response, request)) {
+      return;
+    }
+
+    print_req(request);
+
+    nlohmann::json sessions = nlohmann::json::array();
+    for (auto &uuid : rtsp_stream::get_all_session_uuids()) {
+      if (auto session = rtsp_stream::find_session(uuid)) {
+        sessions.push_back(stream::session::queue_stats(*session));
+      }
+    }
+
+    nlohmann::json output_tree;
+    output_tree["queues"] = stream::queue_stats(*mail::man);
+    output_tree["sessions"] = sessions;
+    output_tree["status"] = true;
+    send_response(response, output_tree);
+  }
+
+  /**
+   * @brief Get the scheduling and CPU placement of the capture, encode, audio and network threads running now.
+   * @param response The HTTP response object.
+   * @param request The HTTP request object.
+   *
+   * Every thread reports its role, the priority it asked for and the scheduling it got,
+   * which falls back to a nice value when SCHED_FIFO isn't permitted.
+   * "cpus" is empty when the thread isn't restricted, and "numa_node" is the node its memory is preferably taken from.
+   * See the `capture_cpus`, `encode_cpus`, `audio_cpus`, `network_cpus` and `realtime_threads` options.
+   *
+   * @api_examples{/api/stats/threads| GET| null}
+   */
+  void getThreadStats(resp_https_t response, req_https_t request) {
+    if (!authenticate(response, request)) {
+      return;
+    }
+
+    print_req(request);
+
+    nlohmann::json output_tree;
+    output_tree["threads"] = thread_placement::report();
+    output_tree["status"] = true;
+    send_response(response, output_tree);
+  }
+
   /**
    * @brief Update client information.
    * @param response The HTTP response object.
@@ -1043,6 +1100,9 @@ namespace confighttp {
    *
    * @attention{It is recommended to ONLY save the config settings that differ from the default behavior.}
    *
+   * Changed settings that can change at runtime are applied right away. The response lists them in `applied`,
+   * and the settings that take effect after a restart in `restart_required`.
+   *
    * @api_examples{/api/config| POST| {"key":"value"}}
    */
   void saveConfig(resp_https_t response, req_https_t request) {
@@ -1069,7 +1129,16 @@ namespace confighttp {
         config_stream << k << " = " << (v.is_string() ? v.get<std::string>() : v.dump()) << std::endl;
       }
       file_handler::write_file(config::sunshine.config_file.c_str(), config_stream.str());
+
+      // Options that can change at runtime are in effect right away, the others need a restart
+      auto reloaded = config::reload();
+      if (!reloaded.applied.empty()) {
+        nvhttp::invalidate_response_cache();
+      }
+
       output_tree["status"] = true;
+      output_tree["applied"] = reloaded.applied;
+      output_tree["restart_required"] = reloaded.restart_required;
       send_response(response, output_tree);
     } catch (std::exception &e) {
       BOOST_LOG(warning) << "SaveConfig: "sv << e.what();
@@ -1115,9 +1184,11 @@ namespace confighttp {
         }
       } else {
         auto data = SimpleWeb::Crypto::Base64::decode(input_tree.value("data", ""));
-        std::ofstream imgfile(path);
+        std::ofstream imgfile(path, std::ios::binary);
         imgfile.write(data.data(), static_cast<int>(data.size()));
       }
+      // The modification time alone may not change if the cover is replaced twice within a second
+      cover_cache::covers().invalidate(path);
       output_tree["status"] = true;
       output_tree["path"] = path;
       send_response(response, output_tree);
@@ -1128,11 +1199,52 @@ namespace confighttp {
   }
 
   /**
-   * @brief Get the logs from the log file.
+   * @brief Send the next chunk of a file, and schedule the following one once it has been written to the socket.
+   * @param response The HTTP response object, its header must already have been written.
+   * @param in The file, positioned at the next byte to send.
+   * @param remaining The number of bytes left to send.
+   */
+  void send_file_chunks(resp_https_t response, std::shared_ptr<std::ifstream> in, std::uint64_t remaining) {
+    constexpr std::uint64_t CHUNK_SIZE = 128 * 1024;
+
+    std::vector<char> buffer(std::min(remaining, CHUNK_SIZE));
+    in->read(buffer.data(), buffer.size());
+    auto read = in->gcount();
+    if (read <= 0) {
+      // The file shrank, the client will notice the content is shorter than announced
+      response->close_connection_after_response = true;
+      return;
+    }
+
+    response->write(buffer.data(), read);
+    remaining -= read;
+    if (remaining == 0) {
+      return;
+    }
+
+    response->send([response, in, remaining](const SimpleWeb::error_code &ec) {
+      if (!ec) {
+        send_file_chunks(response, in, remaining);
+      }
+    });
+  }
+
+  /**
+   * @brief Get the logs.
    * @param response The HTTP response object.
    * @param request The HTTP request object.
    *
-   * @api_examples{/api/logs| GET| null}
+   * Without query parameters the log file is sent in chunks, and a single byte range may be requested
+   * with the `Range` header, e.g. `Range: bytes=-65536` for the end of the file.
+   *
+   * With any of the following query parameters, recent records are sent from memory instead of the file:
+   * - `since`: only records after this sequence number, as returned by the `X-Log-Sequence` header of the previous response
+   * - `level`: only records of this level or above, from 0 (verbose) to 5 (fatal)
+   * - `limit`: at most this many of the newest matching records, 10000 by default
+   *
+   * The `X-Log-Truncated` header is `true` when matching records were left out.
+   *
+   * @api_examples{/api/logs?since=1200&level=2| GET| null}
    */
   void getLogs(resp_https_t response, req_https_t request) {
     if (!authenticate(response, request)) {
@@ -1140,7 +1252,7 @@ namespace confighttp {
     }
 
     print_req(request);
-    std::string content = file_handler::read_file(config::sunshine.log_file.c_str());
+
     SimpleWeb::CaseInsensitiveMultimap headers;
     std::string contentType = "text/plain";
   #ifdef _WIN32
@@ -1150,7 +1262,69 @@ namespace confighttp {
     headers.emplace("Content-Type", contentType);
     headers.emplace("X-Frame-Options", "DENY");
     headers.emplace("Content-Security-Policy", "frame-ancestors 'none';");
-    response->write(SimpleWeb::StatusCode::success_ok, content, headers);
+
+    auto args = request->parse_query_string();
+    if (args.count("since") || args.count("level") || args.count("limit")) {
+      logging::log_tail_t tail;
+      try {
+        tail = logging::tail(
+          std::stoull(nvhttp::get_arg(args, "since", "0")),
+          std::stoi(nvhttp::get_arg(args, "level", "0")),
+          std::stoull(nvhttp::get_arg(args, "limit", "10000"))
+        );
+      } catch (std::exception &e) {
+        BOOST_LOG(warning) << "GetLogs: "sv << e.what();
+        bad_request(response, request, "Invalid log query");
+        return;
+      }
+
+      std::string content;
+      for (auto &record : tail.records) {
+        content += record.text;
+        content += '\n';
+      }
+
+      headers.emplace("X-Log-Sequence", std::to_string(tail.last_sequence));
+      headers.emplace("X-Log-Truncated", tail.truncated ? "true" : "false");
+      response->write(SimpleWeb::StatusCode::success_ok, content, headers);
+      return;
+    }
+
+    auto in = std::make_shared<std::ifstream>(config::sunshine.log_file, std::ios::binary);
+    std::error_code ec;
+    std::uint64_t size = in->is_open() ? fs::file_size(config::sunshine.log_file, ec) : 0;
+    if (ec) {
+      size = 0;
+    }
+
+    std::uint64_t begin = 0;
+    std::uint64_t end = size;
+    auto status = SimpleWeb::StatusCode::success_ok;
+
+    headers.emplace("Accept-Ranges", "bytes");
+
+    auto range = request->header.find("Range");
+    if (range != std::end(request->header)) {
+      auto byte_range = http::parse_byte_range(range->second, size);
+      if (!byte_range) {
+        headers.emplace("Content-Range", "bytes */" + std::to_string(size));
+        response->write(SimpleWeb::StatusCode::client_error_range_not_satisfiable, headers);
+        return;
+      }
+
+      std::tie(begin, end) = *byte_range;
+      status = SimpleWeb::StatusCode::success_partial_content;
+      headers.emplace("Content-Range", "bytes " + std::to_string(begin) + '-' + std::to_string(end - 1) + '/' + std::to_string(size));
+    }
+
+    // The log keeps growing while it's sent, only what existed when the request arrived is included
+    headers.emplace("Content-Length", std::to_string(end - begin));
+    response->write(status, headers);
+
+    if (end > begin) {
+      in->seekg(begin);
+      send_file_chunks(response, in, end - begin);
+    }
   }
 
   /**
@@ -1551,6 +1725,9 @@ namespace confighttp {
     server.resource["^/api/clients/update$"]["POST"] = updateClient;
     server.resource["^/api/clients/unpair$"]["POST"] = unpair;
     server.resource["^/api/clients/disconnect$"]["POST"] = disconnect;
+    server.resource["^/api/stats/latency$"]["GET"] = getLatencyStats;
+    server.resource["^/api/stats/queues$"]["GET"] = getQueueStats;
+    server.resource["^/api/stats/threads$"]["GET"] = getThreadStats;
     server.resource["^/api/covers/upload$"]["POST"] = uploadCover;
     server.resource["^/images/apollo.ico$"]["GET"] = getFaviconImage;
     server.resource["^/images/logo-apollo-45.png$"]["GET"] = getApolloLogoImage;
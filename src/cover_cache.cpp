@@ -0,0 +1,622 @@
+/**
+ * @file src/cover_cache.cpp
+ * @brief Definitions for the cache of the app cover images served to Moonlight.
+ */
+// standard includes
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <thread>
+
+// lib includes
+#include <zlib.h>
+
+// local includes
+#include "cover_cache.h"
+#include "crypto.h"
+#include "logging.h"
+#include "platform/common.h"
+#include "utility.h"
+
+using namespace std::literals;
+
+namespace cover_cache {
+  namespace fs = std::filesystem;
+
+  constexpr auto PNG_SIGNATURE = "\x89PNG\r\n\x1a\n"sv;
+
+  /**
+   * @brief Larger images are rejected instead of decoded, no cover needs more.
+   * @details Decoding and scaling take up to 40 bytes per pixel, about 160 MiB at this size.
+   */
+  constexpr std::uint64_t MAX_PIXELS = 2048 * 2048;
+
+  std::uint32_t read_u32(const char *data) {
+    auto bytes = (const std::uint8_t *) data;
+    return (std::uint32_t) bytes[0] << 24 | (std::uint32_t) bytes[1] << 16 | (std::uint32_t) bytes[2] << 8 | bytes[3];
+  }
+
+  void write_u32(std::string &out, std::uint32_t value) {
+    out.push_back((char) (value >> 24));
+    out.push_back((char) (value >> 16));
+    out.push_back((char) (value >> 8));
+    out.push_back((char) value);
+  }
+
+  void write_chunk(std::string &out, std::string_view type, std::string_view data) {
+    write_u32(out, (std::uint32_t) data.size());
+
+    auto begin = out.size();
+    out.append(type);
+    out.append(data);
+
+    // The CRC covers the chunk type and data, but not the length
+    auto crc = crc32(0, (const Bytef *) out.data() + begin, (uInt) (out.size() - begin));
+    write_u32(out, (std::uint32_t) crc);
+  }
+
+  std::uint8_t paeth(int a, int b, int c) {
+    auto p = a + b - c;
+    auto pa = std::abs(p - a);
+    auto pb = std::abs(p - b);
+    auto pc = std::abs(p - c);
+
+    if (pa <= pb && pa <= pc) {
+      return (std::uint8_t) a;
+    }
+    return (std::uint8_t) (pb <= pc ? b : c);
+  }
+
+  /**
+   * @brief Get the size of a PNG from its header, without decoding it.
+   */
+  std::optional<std::pair<int, int>> png_size(std::string_view data) {
+    // The IHDR chunk always comes first
+    if (!data.starts_with(PNG_SIGNATURE) || data.size() < 24 || data.substr(12, 4) != "IHDR"sv) {
+      return std::nullopt;
+    }
+
+    return std::make_pair((int) read_u32(data.data() + 16), (int) read_u32(data.data() + 20));
+  }
+
+  /**
+   * @brief Scale one line of premultiplied RGBA pixels, every output pixel is the average of the area it covers.
+   */
+  void resample(const float *in, int in_length, std::size_t in_step, float *out, int out_length, std::size_t out_step) {
+    auto ratio = (double) in_length / out_length;
+
+    for (int x = 0; x < out_length; ++x) {
+      auto begin = x * ratio;
+      auto end = std::min((x + 1) * ratio, (double) in_length);
+
+      std::array<double, 4> sum {};
+      for (auto y = (int) begin; y < end; ++y) {
+        auto weight = std::min(end, y + 1.0) - std::max(begin, (double) y);
+        for (int c = 0; c < 4; ++c) {
+          sum[c] += in[y * in_step + c] * weight;
+        }
+      }
+
+      for (int c = 0; c < 4; ++c) {
+        out[x * out_step + c] = (float) (sum[c] / (end - begin));
+      }
+    }
+  }
+
+  cache_t::cache_t(fs::path disk_dir, std::size_t max_memory):
+      disk_dir {std::move(disk_dir)},
+      max_memory {max_memory} {
+  }
+
+  cover_ptr_t cache_t::get(const fs::path &image) {
+    auto key = image.lexically_normal().string();
+
+    std::error_code ec;
+    auto last_write_time = fs::last_write_time(image, ec);
+    auto file_size = ec ? 0 : fs::file_size(image, ec);
+    if (ec) {
+      invalidate(image);
+      return nullptr;
+    }
+
+    {
+      std::lock_guard lg {mutex};
+
+      auto it = entries.find(key);
+      if (it != std::end(entries)) {
+        auto &cover = it->second->cover;
+        if (cover->last_write_time == last_write_time && cover->file_size == file_size) {
+          lru.splice(std::begin(lru), lru, it->second);
+          return cover;
+        }
+      }
+    }
+
+    // Covers are loaded one at a time, so concurrent requests can't multiply the memory needed for scaling
+    std::lock_guard load_lg {load_mutex};
+
+    // A concurrent request for the same image may have loaded it while this one waited
+    {
+      std::lock_guard lg {mutex};
+
+      auto it = entries.find(key);
+      if (it != std::end(entries)) {
+        auto &cover = it->second->cover;
+        if (cover->last_write_time == last_write_time && cover->file_size == file_size) {
+          lru.splice(std::begin(lru), lru, it->second);
+          return cover;
+        }
+      }
+    }
+
+    auto cover = load(image, last_write_time, file_size);
+    if (!cover) {
+      return nullptr;
+    }
+
+    std::lock_guard lg {mutex};
+
+    auto it = entries.find(key);
+    if (it != std::end(entries)) {
+      memory -= it->second->cover->content.size();
+      lru.erase(it->second);
+      entries.erase(it);
+    }
+
+    lru.push_front(entry_t {key, cover});
+    entries.emplace(key, std::begin(lru));
+    memory += cover->content.size();
+
+    // The most recent cover stays, even if it exceeds the budget on its own
+    while (memory > max_memory && lru.size() > 1) {
+      auto &oldest = lru.back();
+      memory -= oldest.cover->content.size();
+      entries.erase(oldest.key);
+      lru.pop_back();
+    }
+
+    return cover;
+  }
+
+  cover_ptr_t cache_t::load(const fs::path &image, fs::file_time_type last_write_time, std::uintmax_t file_size) {
+    std::ifstream in {image, std::ios::binary};
+    if (!in) {
+      BOOST_LOG(warning) << "Couldn't open cover image "sv << image;
+      return nullptr;
+    }
+    std::string source {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+
+    auto cover = std::make_shared<cover_t>();
+    cover->content_type = sniff_content_type(source);
+    cover->last_write_time = last_write_time;
+    cover->file_size = file_size;
+
+    auto size = png_size(source);
+    if (size && (size->first > MAX_WIDTH || size->second > MAX_HEIGHT)) {
+      // The name of a scaled cover changes along with its source, outdated ones are pruned eventually
+      fs::path cached;
+      if (!disk_dir.empty()) {
+        auto hash = crypto::hash(
+          image.lexically_normal().string() + '|' + std::to_string(last_write_time.time_since_epoch().count()) + '|' +
+          std::to_string(file_size) + '|' + std::to_string(MAX_WIDTH) + 'x' + std::to_string(MAX_HEIGHT)
+        );
+        cached = disk_dir / (util::hex_vec(std::begin(hash), std::begin(hash) + 16, true) + ".png");
+
+        std::ifstream cached_in {cached, std::ios::binary};
+        if (cached_in) {
+          cover->content.assign(std::istreambuf_iterator<char>(cached_in), std::istreambuf_iterator<char>());
+        }
+        if (!cover->content.starts_with(PNG_SIGNATURE)) {
+          cover->content.clear();
+        }
+      }
+
+      if (cover->content.empty()) {
+        auto decoded = decode_png(source);
+        if (decoded) {
+          auto scaled = fit(*decoded, MAX_WIDTH, MAX_HEIGHT);
+          auto encoded = encode_png(scaled);
+
+          if (!encoded.empty() && encoded.size() < source.size()) {
+            BOOST_LOG(verbose) << "Scaled cover "sv << image << " from "sv << decoded->width << 'x' << decoded->height
+                               << " to "sv << scaled.width << 'x' << scaled.height << ": "sv
+                               << source.size() << " -> "sv << encoded.size() << " bytes"sv;
+
+            cover->content = std::move(encoded);
+            if (!cached.empty()) {
+              store(cached, cover->content);
+            }
+          }
+        } else {
+          BOOST_LOG(debug) << "Serving cover "sv << image << " unscaled, it's too large or its PNG variant isn't supported"sv;
+        }
+      }
+    }
+
+    if (cover->content.empty()) {
+      cover->content = std::move(source);
+    }
+
+    auto hash = crypto::hash(cover->content);
+    cover->etag = "\""s + util::hex_vec(std::begin(hash), std::begin(hash) + 8, true) + "\""s;
+
+    return cover;
+  }
+
+  void cache_t::store(const fs::path &file, std::string_view content) {
+    std::error_code ec;
+    fs::create_directories(disk_dir, ec);
+
+    // Written under a temporary name, so a crash can't leave a truncated cover behind
+    auto temp = file;
+    temp += "." + std::to_string(std::hash<std::thread::id> {}(std::this_thread::get_id())) + ".tmp";
+    {
+      std::ofstream out {temp, std::ios::binary | std::ios::trunc};
+      out.write(content.data(), (std::streamsize) content.size());
+      if (!out) {
+        BOOST_LOG(warning) << "Couldn't write scaled cover to "sv << temp;
+        out.close();
+        fs::remove(temp, ec);
+        return;
+      }
+    }
+    fs::rename(temp, file, ec);
+    if (ec) {
+      BOOST_LOG(warning) << "Couldn't write scaled cover to "sv << file << ": "sv << ec.message();
+      fs::remove(temp, ec);
+      return;
+    }
+
+    std::vector<std::pair<fs::file_time_type, fs::path>> files;
+    for (auto &entry : fs::directory_iterator {disk_dir, ec}) {
+      if (entry.path().extension() == ".png") {
+        files.emplace_back(entry.last_write_time(ec), entry.path());
+      }
+    }
+    if (files.size() <= MAX_DISK_FILES) {
+      return;
+    }
+
+    std::sort(std::begin(files), std::end(files));
+    for (auto it = std::begin(files); it != std::end(files) - MAX_DISK_FILES; ++it) {
+      fs::remove(it->second, ec);
+    }
+  }
+
+  void cache_t::invalidate(const fs::path &image) {
+    std::lock_guard lg {mutex};
+
+    auto it = entries.find(image.lexically_normal().string());
+    if (it == std::end(entries)) {
+      return;
+    }
+
+    memory -= it->second->cover->content.size();
+    lru.erase(it->second);
+    entries.erase(it);
+  }
+
+  void cache_t::clear() {
+    std::lock_guard lg {mutex};
+
+    entries.clear();
+    lru.clear();
+    memory = 0;
+  }
+
+  std::size_t cache_t::memory_usage() {
+    std::lock_guard lg {mutex};
+    return memory;
+  }
+
+  cache_t &covers() {
+    static cache_t cache {platf::appdata() / "covers" / "cache"};
+    return cache;
+  }
+
+  std::string_view sniff_content_type(std::string_view data) {
+    if (data.starts_with("\xFF\xD8\xFF"sv)) {
+      return "image/jpeg"sv;
+    }
+    if (data.starts_with("GIF87a"sv) || data.starts_with("GIF89a"sv)) {
+      return "image/gif"sv;
+    }
+    if (data.size() >= 12 && data.starts_with("RIFF"sv) && data.substr(8, 4) == "WEBP"sv) {
+      return "image/webp"sv;
+    }
+
+    return "image/png"sv;
+  }
+
+  std::optional<image_t> decode_png(std::string_view data) {
+    if (!data.starts_with(PNG_SIGNATURE)) {
+      return std::nullopt;
+    }
+    data.remove_prefix(PNG_SIGNATURE.size());
+
+    int width = 0;
+    int height = 0;
+    int bit_depth = 0;
+    int color_type = -1;
+    std::vector<std::array<std::uint8_t, 4>> palette;
+    std::string compressed;
+
+    while (data.size() >= 12) {
+      auto length = read_u32(data.data());
+      if (length > data.size() - 12) {
+        return std::nullopt;
+      }
+      auto type = data.substr(4, 4);
+      auto chunk = data.substr(8, length);
+      data.remove_prefix(12 + length);
+
+      if (type == "IHDR"sv) {
+        if (chunk.size() < 13) {
+          return std::nullopt;
+        }
+        width = (int) read_u32(chunk.data());
+        height = (int) read_u32(chunk.data() + 4);
+        bit_depth = (std::uint8_t) chunk[8];
+        color_type = (std::uint8_t) chunk[9];
+
+        // Interlacing, as well as unknown compression and filter methods, aren't supported
+        if (chunk[10] != 0 || chunk[11] != 0 || chunk[12] != 0) {
+          return std::nullopt;
+        }
+      } else if (type == "PLTE"sv) {
+        for (std::size_t x = 0; x + 3 <= chunk.size(); x += 3) {
+          palette.push_back({(std::uint8_t) chunk[x], (std::uint8_t) chunk[x + 1], (std::uint8_t) chunk[x + 2], 255});
+        }
+      } else if (type == "tRNS"sv) {
+        // Only the alpha values of a palette are supported, not the transparent color of the other types
+        if (color_type != 3) {
+          return std::nullopt;
+        }
+        for (std::size_t x = 0; x < chunk.size() && x < palette.size(); ++x) {
+          palette[x][3] = (std::uint8_t) chunk[x];
+        }
+      } else if (type == "IDAT"sv) {
+        compressed.append(chunk);
+      } else if (type == "IEND"sv) {
+        break;
+      }
+    }
+
+    int channels;
+    switch (color_type) {
+      case 0:  // Grayscale
+      case 3:  // Palette
+        channels = 1;
+        break;
+      case 2:  // RGB
+        channels = 3;
+        break;
+      case 4:  // Grayscale and alpha
+        channels = 2;
+        break;
+      case 6:  // RGBA
+        channels = 4;
+        break;
+      default:
+        return std::nullopt;
+    }
+
+    if (width <= 0 || height <= 0 || (std::uint64_t) width * height > MAX_PIXELS ||
+        !(bit_depth == 8 || (bit_depth == 16 && color_type != 3)) || (color_type == 3 && palette.empty())) {
+      return std::nullopt;
+    }
+
+    auto sample_size = bit_depth / 8;
+    auto pixel_size = channels * sample_size;
+    auto stride = (std::size_t) width * pixel_size;
+
+    // Every row starts with its filter type
+    std::vector<std::uint8_t> raw((stride + 1) * height);
+    uLongf raw_size = (uLongf) raw.size();
+    if (uncompress(raw.data(), &raw_size, (const Bytef *) compressed.data(), (uLong) compressed.size()) != Z_OK || raw_size != raw.size()) {
+      return std::nullopt;
+    }
+
+    image_t image {width, height, std::vector<std::uint8_t>((std::size_t) width * height * 4)};
+
+    const std::uint8_t *previous = nullptr;
+    for (int y = 0; y < height; ++y) {
+      auto filter = raw[y * (stride + 1)];
+      auto row = raw.data() + y * (stride + 1) + 1;
+
+      for (std::size_t x = 0; x < stride; ++x) {
+        int a = x >= (std::size_t) pixel_size ? row[x - pixel_size] : 0;
+        int b = previous ? previous[x] : 0;
+        int c = previous && x >= (std::size_t) pixel_size ? previous[x - pixel_size] : 0;
+
+        switch (filter) {
+          case 0:
+            break;
+          case 1:
+            row[x] += a;
+            break;
+          case 2:
+            row[x] += b;
+            break;
+          case 3:
+            row[x] += (a + b) / 2;
+            break;
+          case 4:
+            row[x] += paeth(a, b, c);
+            break;
+          default:
+            return std::nullopt;
+        }
+      }
+
+      auto out = image.pixels.data() + (std::size_t) y * width * 4;
+      for (int x = 0; x < width; ++x, out += 4) {
+        // Of 16-bit samples, only the most significant byte is kept
+        auto sample = [&](int channel) {
+          return row[(x * channels + channel) * sample_size];
+        };
+
+        switch (color_type) {
+          case 0:
+            out[0] = out[1] = out[2] = sample(0);
+            out[3] = 255;
+            break;
+          case 2:
+            out[0] = sample(0);
+            out[1] = sample(1);
+            out[2] = sample(2);
+            out[3] = 255;
+            break;
+          case 3:
+            {
+              auto &color = palette[std::min<std::size_t>(sample(0), palette.size() - 1)];
+              std::copy(std::begin(color), std::end(color), out);
+              break;
+            }
+          case 4:
+            out[0] = out[1] = out[2] = sample(0);
+            out[3] = sample(1);
+            break;
+          case 6:
+            out[0] = sample(0);
+            out[1] = sample(1);
+            out[2] = sample(2);
+            out[3] = sample(3);
+            break;
+        }
+      }
+
+      previous = row;
+    }
+
+    return image;
+  }
+
+  std::string encode_png(const image_t &image) {
+    bool opaque = true;
+    for (std::size_t x = 3; x < image.pixels.size(); x += 4) {
+      if (image.pixels[x] != 255) {
+        opaque = false;
+        break;
+      }
+    }
+
+    int channels = opaque ? 3 : 4;
+    auto stride = (std::size_t) image.width * channels;
+
+    std::vector<std::uint8_t> previous(stride);
+    std::vector<std::uint8_t> current(stride);
+    std::array<std::vector<std::uint8_t>, 5> candidates;
+    for (auto &candidate : candidates) {
+      candidate.resize(stride);
+    }
+
+    std::vector<std::uint8_t> filtered;
+    filtered.reserve((stride + 1) * image.height);
+    for (int y = 0; y < image.height; ++y) {
+      auto in = image.pixels.data() + (std::size_t) y * image.width * 4;
+      for (int x = 0; x < image.width; ++x) {
+        std::copy_n(in + x * 4, channels, current.data() + x * channels);
+      }
+
+      // Pick the filter with the smallest sum of absolute differences, the heuristic libpng uses as well
+      std::size_t best = 0;
+      long best_sum = -1;
+      for (std::size_t filter = 0; filter < candidates.size(); ++filter) {
+        auto &candidate = candidates[filter];
+
+        long sum = 0;
+        for (std::size_t x = 0; x < stride; ++x) {
+          int a = x >= (std::size_t) channels ? current[x - channels] : 0;
+          int b = y > 0 ? previous[x] : 0;
+          int c = y > 0 && x >= (std::size_t) channels ? previous[x - channels] : 0;
+
+          std::uint8_t predicted = filter == 0 ? 0 :
+                                   filter == 1 ? a :
+                                   filter == 2 ? b :
+                                   filter == 3 ? (a + b) / 2 :
+                                                 paeth(a, b, c);
+          candidate[x] = current[x] - predicted;
+          sum += std::abs((std::int8_t) candidate[x]);
+        }
+
+        if (best_sum < 0 || sum < best_sum) {
+          best = filter;
+          best_sum = sum;
+        }
+      }
+
+      filtered.push_back((std::uint8_t) best);
+      filtered.insert(std::end(filtered), std::begin(candidates[best]), std::end(candidates[best]));
+      std::swap(previous, current);
+    }
+
+    std::string compressed;
+    uLongf compressed_size = compressBound((uLong) filtered.size());
+    compressed.resize(compressed_size);
+    if (compress2((Bytef *) compressed.data(), &compressed_size, filtered.data(), (uLong) filtered.size(), Z_BEST_COMPRESSION) != Z_OK) {
+      return {};
+    }
+    compressed.resize(compressed_size);
+
+    std::string header;
+    write_u32(header, (std::uint32_t) image.width);
+    write_u32(header, (std::uint32_t) image.height);
+    header.push_back(8);  // Bit depth
+    header.push_back(opaque ? 2 : 6);  // Color type
+    header.append(3, '\0');  // Compression, filter and interlace methods
+
+    std::string png {PNG_SIGNATURE};
+    write_chunk(png, "IHDR"sv, header);
+    write_chunk(png, "IDAT"sv, compressed);
+    write_chunk(png, "IEND"sv, {});
+
+    return png;
+  }
+
+  image_t fit(const image_t &image, int max_width, int max_height) {
+    if (image.width <= max_width && image.height <= max_height) {
+      return image;
+    }
+
+    auto scale = std::min((double) max_width / image.width, (double) max_height / image.height);
+    auto width = std::clamp((int) std::lround(image.width * scale), 1, max_width);
+    auto height = std::clamp((int) std::lround(image.height * scale), 1, max_height);
+
+    // Averaging premultiplied colors keeps the invisible color of transparent pixels from bleeding in
+    std::vector<float> source(image.pixels.size());
+    for (std::size_t x = 0; x < image.pixels.size(); x += 4) {
+      auto alpha = image.pixels[x + 3] / 255.0f;
+      source[x] = image.pixels[x] * alpha;
+      source[x + 1] = image.pixels[x + 1] * alpha;
+      source[x + 2] = image.pixels[x + 2] * alpha;
+      source[x + 3] = image.pixels[x + 3];
+    }
+
+    std::vector<float> rows((std::size_t) width * image.height * 4);
+    for (int y = 0; y < image.height; ++y) {
+      resample(&source[(std::size_t) y * image.width * 4], image.width, 4, &rows[(std::size_t) y * width * 4], width, 4);
+    }
+
+    std::vector<float> scaled((std::size_t) width * height * 4);
+    for (int x = 0; x < width; ++x) {
+      resample(&rows[x * 4], image.height, (std::size_t) width * 4, &scaled[x * 4], height, (std::size_t) width * 4);
+    }
+
+    image_t result {width, height, std::vector<std::uint8_t>(scaled.size())};
+    for (std::size_t x = 0; x < scaled.size(); x += 4) {
+      auto alpha = scaled[x + 3];
+      for (int c = 0; c < 3; ++c) {
+        auto value = alpha > 0 ? scaled[x + c] * 255.0f / alpha : 0.0f;
+        result.pixels[x + c] = (std::uint8_t) std::clamp(std::lround(value), 0L, 255L);
+      }
+      result.pixels[x + 3] = (std::uint8_t) std::clamp(std::lround(alpha), 0L, 255L);
+    }
+
+    return result;
+  }
+}  // namespace cover_cache
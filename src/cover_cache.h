@@ -0,0 +1,151 @@
+/**
+ * @file src/cover_cache.h
+ * @brief Declarations for the cache of the app cover images served to Moonlight.
+ */
+#pragma once
+
+// standard includes
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Cover images scaled down to the size clients display them at, cached in memory and on disk.
+ */
+namespace cover_cache {
+  /**
+   * @brief A decoded image, 8-bit RGBA with straight alpha.
+   */
+  struct image_t {
+    int width;
+    int height;
+    std::vector<std::uint8_t> pixels;  ///< width * height * 4 bytes, rows top to bottom
+  };
+
+  /**
+   * @brief An encoded cover, ready to be sent.
+   */
+  struct cover_t {
+    std::string content_type;
+    std::string content;
+    std::string etag;  ///< Quoted strong validator of content
+    std::filesystem::file_time_type last_write_time;  ///< Of the source image
+    std::uintmax_t file_size;  ///< Of the source image
+  };
+
+  using cover_ptr_t = std::shared_ptr<const cover_t>;
+
+  /**
+   * @brief Bounded LRU cache of covers, keyed by the path of the source image.
+   * @details Every lookup compares the modification time and size of the source image,
+   *          so covers replaced behind the cache's back are picked up as well.
+   *          Scaled covers are also kept in a directory, so they aren't scaled again after a restart.
+   */
+  class cache_t {
+  public:
+    static constexpr std::size_t MAX_MEMORY = 32 * 1024 * 1024;
+
+    /**
+     * @brief Larger covers are scaled down to fit, twice the size of the box art tiles of the Moonlight clients.
+     */
+    static constexpr int MAX_WIDTH = 600;
+    static constexpr int MAX_HEIGHT = 800;
+
+    /**
+     * @brief Scaled covers beyond this count are removed from the disk cache, oldest first.
+     */
+    static constexpr std::size_t MAX_DISK_FILES = 256;
+
+    /**
+     * @param disk_dir The directory for the scaled covers, empty to keep them in memory only.
+     * @param max_memory The upper bound of the size of the covers kept in memory.
+     */
+    explicit cache_t(std::filesystem::path disk_dir, std::size_t max_memory = MAX_MEMORY);
+
+    /**
+     * @brief Get the cover for an image file.
+     * @param image The path of the image.
+     * @return The cover, nullptr if the image can't be read.
+     * @examples
+     * auto cover = cover_cache::covers().get(proc::proc.get_app_image(app_id));
+     * @examples_end
+     */
+    cover_ptr_t get(const std::filesystem::path &image);
+
+    /**
+     * @brief Forget the cover of an image, e.g. because the image was replaced.
+     * @param image The path of the image.
+     */
+    void invalidate(const std::filesystem::path &image);
+
+    /**
+     * @brief Forget all covers kept in memory.
+     */
+    void clear();
+
+    /**
+     * @brief Get the total size of the covers kept in memory.
+     */
+    std::size_t memory_usage();
+
+  private:
+    struct entry_t {
+      std::string key;
+      cover_ptr_t cover;
+    };
+
+    cover_ptr_t load(const std::filesystem::path &image, std::filesystem::file_time_type last_write_time, std::uintmax_t file_size);
+    void store(const std::filesystem::path &file, std::string_view content);
+
+    std::filesystem::path disk_dir;
+    std::size_t max_memory;
+
+    std::mutex load_mutex;  ///< Held while loading a cover, outside of mutex
+    std::mutex mutex;
+    std::list<entry_t> lru;  ///< Most recently used first
+    std::unordered_map<std::string, std::list<entry_t>::iterator> entries;
+    std::size_t memory = 0;
+  };
+
+  /**
+   * @brief Get the cache used for the app covers, its disk cache is below the covers directory.
+   */
+  cache_t &covers();
+
+  /**
+   * @brief Get the MIME type of an image from its signature.
+   * @param data The image file.
+   * @return The MIME type, "image/png" if the format isn't recognized.
+   */
+  std::string_view sniff_content_type(std::string_view data);
+
+  /**
+   * @brief Decode a non-interlaced PNG with 8 or 16 bits per channel, or an 8-bit palette, of up to 4 megapixels.
+   * @param data The PNG file.
+   * @return The image, std::nullopt for other PNG variants and invalid data.
+   */
+  std::optional<image_t> decode_png(std::string_view data);
+
+  /**
+   * @brief Encode an image as PNG, without the alpha channel if the image is opaque.
+   * @param image The image.
+   * @return The PNG file, empty on failure.
+   */
+  std::string encode_png(const image_t &image);
+
+  /**
+   * @brief Scale an image down to fit a bounding box, keeping its aspect ratio.
+   * @param image The image.
+   * @param max_width The width of the bounding box.
+   * @param max_height The height of the bounding box.
+   * @return The scaled image, or a copy of the image if it already fits.
+   */
+  image_t fit(const image_t &image, int max_width, int max_height);
+}  // namespace cover_cache
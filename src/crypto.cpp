@@ -24,6 +24,7 @@ namespace crypto {
 
   void cert_chain_t::clear() {
     _certs.clear();
+    _verified.clear();
   }
 
   static int openssl_verify_cb(int ok, X509_STORE_CTX *ctx) {
@@ -51,10 +52,25 @@ namespace crypto {
    * Moonlight to be able to use Sunshine
    *
    * To circumvent this, x509_store_t instance will be created for each instance of the certificates.
+   *
+   * Moonlight opens a new connection for every request, so certificates that were verified once
+   * are remembered by fingerprint until the chain is cleared, which happens whenever a client is unpaired.
    * @param cert The certificate to verify.
    * @return nullptr if the certificate is valid, otherwise an error string.
    */
   const char * cert_chain_t::verify(x509_t::element_type *cert, p_named_cert_t& named_cert_out) {
+    sha256_t fingerprint;
+    unsigned int fingerprint_size = fingerprint.size();
+    bool has_fingerprint = X509_digest(cert, EVP_sha256(), fingerprint.data(), &fingerprint_size) == 1;
+
+    if (has_fingerprint) {
+      auto it = _verified.find(fingerprint);
+      if (it != std::end(_verified)) {
+        named_cert_out = it->second;
+        return nullptr;
+      }
+    }
+
     int err_code = 0;
     for (auto &[named_cert_p, x509_store] : _certs) {
       auto fg = util::fail_guard([this]() {
@@ -72,6 +88,10 @@ namespace crypto {
       auto err = X509_verify_cert(_cert_ctx.get());
 
       if (err == 1) {
+        if (has_fingerprint) {
+          _verified.emplace(fingerprint, named_cert_p);
+        }
+
         named_cert_out = named_cert_p;
         return nullptr;
       }
@@ -145,6 +165,30 @@ namespace crypto {
     }
 
     int gcm_t::decrypt(const std::string_view &tagged_cipher, std::vector<std::uint8_t> &plaintext, aes_t *iv) {
+      if (tagged_cipher.size() < tag_size) {
+        return -1;
+      }
+
+      plaintext.resize(round_to_pkcs7_padded(tagged_cipher.size() - tag_size));
+
+      auto len = decrypt(tagged_cipher, plaintext.data(), iv);
+      if (len < 0) {
+        return -1;
+      }
+
+      plaintext.resize(len);
+      return 0;
+    }
+
+    /**
+     * This function decrypts the given tagged ciphertext using the AES key in GCM mode into a caller provided buffer,
+     * so a buffer reused for every message doesn't need to be allocated for each of them.
+     */
+    int gcm_t::decrypt(const std::string_view &tagged_cipher, std::uint8_t *plaintext, aes_t *iv) {
+      if (tagged_cipher.size() < tag_size) {
+        return -1;
+      }
+
       if (!decrypt_ctx && init_decrypt_gcm(decrypt_ctx, &key, iv, padding)) {
         return -1;
       }
@@ -152,17 +196,15 @@ namespace crypto {
       // Calling with cipher == nullptr results in a parameter change
       // without requiring a reallocation of the internal cipher ctx.
       if (EVP_DecryptInit_ex(decrypt_ctx.get(), nullptr, nullptr, nullptr, iv->data()) != 1) {
-        return false;
+        return -1;
       }
 
       auto cipher = tagged_cipher.substr(tag_size);
       auto tag = tagged_cipher.substr(0, tag_size);
 
-      plaintext.resize(round_to_pkcs7_padded(cipher.size()));
-
       int update_outlen, final_outlen;
 
-      if (EVP_DecryptUpdate(decrypt_ctx.get(), plaintext.data(), &update_outlen, (const std::uint8_t *) cipher.data(), cipher.size()) != 1) {
+      if (EVP_DecryptUpdate(decrypt_ctx.get(), plaintext, &update_outlen, (const std::uint8_t *) cipher.data(), cipher.size()) != 1) {
         return -1;
       }
 
@@ -170,12 +212,11 @@ namespace crypto {
         return -1;
       }
 
-      if (EVP_DecryptFinal_ex(decrypt_ctx.get(), plaintext.data() + update_outlen, &final_outlen) != 1) {
+      if (EVP_DecryptFinal_ex(decrypt_ctx.get(), plaintext + update_outlen, &final_outlen) != 1) {
         return -1;
       }
 
-      plaintext.resize(update_outlen + final_outlen);
-      return 0;
+      return update_outlen + final_outlen;
     }
 
     /**
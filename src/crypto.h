@@ -6,6 +6,7 @@
 
 // standard includes
 #include <array>
+#include <map>
 
 // lib includes
 #include <list>
@@ -147,6 +148,9 @@ namespace crypto {
   private:
     std::vector<std::pair<p_named_cert_t, x509_store_t>> _certs;
     x509_store_ctx_t _cert_ctx;
+
+    // Certificates that passed verification, by SHA-256 fingerprint
+    std::map<sha256_t, p_named_cert_t> _verified;
   };
 
   namespace cipher {
@@ -207,6 +211,16 @@ namespace crypto {
       int encrypt(const std::string_view &plaintext, std::uint8_t *tagged_cipher, aes_t *iv);
 
       int decrypt(const std::string_view &cipher, std::vector<std::uint8_t> &plaintext, aes_t *iv);
+
+      /**
+       * @brief Decrypts the tagged cipher using AES GCM mode.
+       * length of plaintext must be at least: round_to_pkcs7_padded(tagged_cipher.size() - crypto::cipher::tag_size)
+       * @param tagged_cipher The GCM tag followed by the ciphertext.
+       * @param plaintext The buffer where the resulting plaintext will be written.
+       * @param iv The initialization vector to be used for the decryption.
+       * @return The length of the plaintext written into plaintext. Returns -1 in case of an error.
+       */
+      int decrypt(const std::string_view &tagged_cipher, std::uint8_t *plaintext, aes_t *iv);
     };
 
     class cbc_t: public cipher_t {
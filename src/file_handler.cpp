@@ -4,12 +4,26 @@
  */
 
 // standard includes
+#include <cstdio>
 #include <filesystem>
 #include <fstream>
+#include <random>
+#include <unordered_map>
+
+#ifdef _WIN32
+  #include <io.h>
+#else
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
 
 // local includes
 #include "file_handler.h"
+#include "globals.h"
 #include "logging.h"
+#include "utility.h"
+
+using namespace std::literals;
 
 namespace file_handler {
   std::string get_parent_directory(const std::string &path) {
@@ -53,4 +67,151 @@ namespace file_handler {
 
     return 0;
   }
+
+  int write_file_atomic(const char *path, const std::string_view &contents) {
+    // Concurrent writers, even from other processes, each get a temporary file of their own
+    std::random_device random;
+    auto temp_path = std::string {path} + '.' + std::to_string(random()) + std::to_string(random()) + ".tmp";
+
+    auto file = std::fopen(temp_path.c_str(), "wb");
+    if (!file) {
+      BOOST_LOG(error) << "Couldn't open "sv << temp_path << " for writing"sv;
+      return -1;
+    }
+    auto fg = util::fail_guard([&]() {
+      if (file) {
+        std::fclose(file);
+      }
+      std::error_code ec;
+      std::filesystem::remove(temp_path, ec);
+    });
+
+    if (std::fwrite(contents.data(), 1, contents.size(), file) != contents.size() || std::fflush(file) != 0) {
+      BOOST_LOG(error) << "Couldn't write "sv << temp_path;
+      return -1;
+    }
+
+    // Without this, the rename may reach the disk before the contents do
+#ifdef _WIN32
+    auto synced = _commit(_fileno(file)) == 0;
+#else
+    auto synced = fsync(fileno(file)) == 0;
+#endif
+    if (!synced) {
+      BOOST_LOG(error) << "Couldn't flush "sv << temp_path << " to disk"sv;
+      return -1;
+    }
+
+    std::fclose(file);
+    file = nullptr;
+
+    std::error_code ec;
+    std::filesystem::rename(temp_path, path, ec);
+    if (ec) {
+      BOOST_LOG(error) << "Couldn't replace "sv << path << ": "sv << ec.message();
+      std::filesystem::remove(temp_path, ec);
+      return -1;
+    }
+    fg.disable();
+
+#ifndef _WIN32
+    // Persist the rename itself
+    auto parent = std::filesystem::path {path}.parent_path();
+    auto dir = open(parent.empty() ? "." : parent.c_str(), O_RDONLY);
+    if (dir >= 0) {
+      fsync(dir);
+      close(dir);
+    }
+#endif
+
+    return 0;
+  }
+
+  int update_file_atomic(const std::string &path, const update_t &update) {
+    static std::mutex path_mutexes_mutex;
+    static std::unordered_map<std::string, std::mutex> path_mutexes;
+
+    std::unique_lock path_ul {[&]() -> std::mutex & {
+      std::lock_guard lg {path_mutexes_mutex};
+      return path_mutexes[std::filesystem::absolute(path).lexically_normal().string()];
+    }()};
+
+    std::string current;
+    if (std::filesystem::exists(path)) {
+      std::ifstream in {path, std::ios::binary};
+      current.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    try {
+      return write_file_atomic(path.c_str(), update(current));
+    } catch (std::exception &e) {
+      BOOST_LOG(error) << "Couldn't update "sv << path << ": "sv << e.what();
+      return -1;
+    }
+  }
+
+  deferred_writer_t::deferred_writer_t(std::chrono::milliseconds delay):
+      delay {delay} {
+  }
+
+  deferred_writer_t::~deferred_writer_t() {
+    decltype(tasks) pending_tasks;
+    {
+      std::lock_guard lg {pending_mutex};
+      pending_tasks = std::move(tasks);
+    }
+
+    // A task that can't be cancelled anymore is running, and must be done with this writer first
+    for (auto &task : pending_tasks) {
+      if (!task_pool.cancel(task.task_id)) {
+        task.future.wait();
+      }
+    }
+
+    flush();
+  }
+
+  void deferred_writer_t::write(std::string path, update_t update) {
+    std::unique_lock ul {pending_mutex};
+
+    // An update for another file can't replace the pending one
+    if (pending_update && pending_path != path) {
+      ul.unlock();
+      flush();
+      ul.lock();
+    }
+
+    pending_path = std::move(path);
+    pending_update = std::move(update);
+
+    if (!scheduled) {
+      scheduled = true;
+
+      std::erase_if(tasks, [](auto &task) {
+        return task.future.wait_for(std::chrono::seconds::zero()) == std::future_status::ready;
+      });
+      tasks.push_back(task_pool.pushDelayed(&deferred_writer_t::flush, delay, this));
+    }
+  }
+
+  int deferred_writer_t::flush() {
+    std::lock_guard write_lg {write_mutex};
+
+    std::string path;
+    update_t update;
+    {
+      std::lock_guard lg {pending_mutex};
+
+      path = std::move(pending_path);
+      update = std::move(pending_update);
+      pending_update = nullptr;
+      scheduled = false;
+    }
+
+    if (!update) {
+      return 0;
+    }
+
+    return update_file_atomic(path, update);
+  }
 }  // namespace file_handler
@@ -5,7 +5,15 @@
 #pragma once
 
 // standard includes
+#include <chrono>
+#include <functional>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <vector>
+
+// local includes
+#include "task_pool.h"
 
 /**
  * @brief Responsible for file handling functions.
@@ -51,4 +59,85 @@ namespace file_handler {
    * @examples_end
    */
   int write_file(const char *path, const std::string_view &contents);
+
+  /**
+   * @brief Writes a file atomically, a crash leaves either the old or the new contents behind.
+   * @details The contents are written to a temporary file next to it and flushed to disk,
+   *          before the temporary file replaces the file.
+   * @param path The path of the file.
+   * @param contents The contents to write.
+   * @return ``0`` on success, ``-1`` on failure.
+   * @examples
+   * int write_status = write_file_atomic("path/to/file", "file contents");
+   * @examples_end
+   */
+  int write_file_atomic(const char *path, const std::string_view &contents);
+
+  /**
+   * @brief Computes the new contents of a file from its current contents.
+   */
+  using update_t = std::function<std::string(const std::string &current)>;
+
+  /**
+   * @brief Read a file, update its contents and write it atomically.
+   * @details Updates of the same file through this function or a deferred_writer_t take turns,
+   *          so none of them is based on contents another one is about to replace.
+   * @param path The path of the file.
+   * @param update Computes the new contents, the file is left unchanged if it throws.
+   * @return ``0`` on success, ``-1`` on failure.
+   * @examples
+   * int write_status = update_file_atomic("path/to/file", [](const std::string &current) { return current + "line\n"; });
+   * @examples_end
+   */
+  int update_file_atomic(const std::string &path, const update_t &update);
+
+  /**
+   * @brief Writes a file on the task pool, a burst of updates results in a single write.
+   */
+  class deferred_writer_t {
+  public:
+    using update_t = file_handler::update_t;
+
+    /**
+     * @param delay How long to wait for further updates before writing.
+     */
+    explicit deferred_writer_t(std::chrono::milliseconds delay);
+
+    /**
+     * @brief Cancel the scheduled write, and write the pending update now.
+     */
+    ~deferred_writer_t();
+
+    /**
+     * @brief Schedule a write, replacing the update that is still pending.
+     * @details The file is read again right before writing,
+     *          so changes other code makes to the file in the meantime are kept.
+     * @param path The path of the file.
+     * @param update Computes the new contents.
+     * @examples
+     * writer.write("path/to/file", [](const std::string &current) { return current + "line\n"; });
+     * @examples_end
+     */
+    void write(std::string path, update_t update);
+
+    /**
+     * @brief Write the pending update now.
+     * @return ``0`` on success or if nothing is pending, ``-1`` on failure.
+     */
+    int flush();
+
+  private:
+    std::chrono::milliseconds delay;
+
+    std::mutex pending_mutex;
+    std::string pending_path;
+    update_t pending_update;
+    bool scheduled = false;
+
+    // Tasks that may still call flush(), the destructor cancels or waits for them
+    std::vector<task_pool_util::TaskPool::timer_task_t<int>> tasks;
+
+    // Held while writing, so an older update can't overwrite a newer one
+    std::mutex write_mutex;
+  };
 }  // namespace file_handler
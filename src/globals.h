@@ -55,6 +55,8 @@ namespace mail {
   MAIL(invalidate_ref_frames);
   MAIL(gamepad_feedback);
   MAIL(hdr);
+  MAIL(video_images);
+  MAIL(audio_samples);
 #undef MAIL
 
 }  // namespace mail
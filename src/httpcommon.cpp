@@ -5,7 +5,9 @@
 #define BOOST_BIND_GLOBAL_PLACEHOLDERS
 
 // standard includes
+#include <charconv>
 #include <filesystem>
+#include <sstream>
 #include <utility>
 
 // lib includes
@@ -68,25 +70,36 @@ namespace http {
   }
 
   int save_user_creds(const std::string &file, const std::string &username, const std::string &password, bool run_our_mouth) {
-    pt::ptree outputTree;
-
-    if (fs::exists(file)) {
-      try {
-        pt::read_json(file, outputTree);
-      } catch (std::exception &e) {
-        BOOST_LOG(error) << "Couldn't read user credentials: "sv << e.what();
-        return -1;
+    // The file is shared with the pairing state, so it must never be left half written
+    // nor replaced with contents the pairing state writer is about to overwrite
+    bool read_failed = false;
+    auto status = file_handler::update_file_atomic(file, [&](const std::string &current) {
+      pt::ptree outputTree;
+      if (!current.empty()) {
+        try {
+          std::istringstream in {current};
+          pt::read_json(in, outputTree);
+        } catch (std::exception &e) {
+          BOOST_LOG(error) << "Couldn't read user credentials: "sv << e.what();
+          read_failed = true;
+          throw;
+        }
       }
-    }
 
-    auto salt = crypto::rand_alphabet(16);
-    outputTree.put("username", username);
-    outputTree.put("salt", salt);
-    outputTree.put("password", util::hex(crypto::hash(password + salt)).to_string());
-    try {
-      pt::write_json(file, outputTree);
-    } catch (std::exception &e) {
-      BOOST_LOG(error) << "error writing to the credentials file, perhaps try this again as an administrator? Details: "sv << e.what();
+      auto salt = crypto::rand_alphabet(16);
+      outputTree.put("username", username);
+      outputTree.put("salt", salt);
+      outputTree.put("password", util::hex(crypto::hash(password + salt)).to_string());
+
+      std::stringstream out;
+      pt::write_json(out, outputTree);
+      return out.str();
+    });
+
+    if (status) {
+      if (!read_failed) {
+        BOOST_LOG(error) << "error writing to the credentials file, perhaps try this again as an administrator?"sv;
+      }
       return -1;
     }
 
@@ -235,4 +248,53 @@ namespace http {
     curl_url_cleanup(curlu);
     return result;
   }
+
+  std::optional<std::pair<std::uint64_t, std::uint64_t>> parse_byte_range(std::string_view header, std::uint64_t size) {
+    constexpr auto prefix = "bytes="sv;
+    if (!header.starts_with(prefix)) {
+      return std::nullopt;
+    }
+    header.remove_prefix(prefix.size());
+
+    auto dash = header.find('-');
+    if (dash == std::string_view::npos) {
+      return std::nullopt;
+    }
+
+    auto parse = [](std::string_view number) -> std::optional<std::uint64_t> {
+      std::uint64_t value;
+      auto [ptr, ec] = std::from_chars(number.data(), number.data() + number.size(), value);
+      if (number.empty() || ec != std::errc {} || ptr != number.data() + number.size()) {
+        return std::nullopt;
+      }
+      return value;
+    };
+
+    auto first = header.substr(0, dash);
+    auto last = header.substr(dash + 1);
+
+    // Suffix range: the last N bytes
+    if (first.empty()) {
+      auto length = parse(last);
+      if (!length || *length == 0 || size == 0) {
+        return std::nullopt;
+      }
+      return std::make_pair(size - std::min(*length, size), size);
+    }
+
+    auto begin = parse(first);
+    if (!begin || *begin >= size) {
+      return std::nullopt;
+    }
+
+    if (last.empty()) {
+      return std::make_pair(*begin, size);
+    }
+
+    auto end = parse(last);
+    if (!end || *end < *begin) {
+      return std::nullopt;
+    }
+    return std::make_pair(*begin, std::min(*end + 1, size));
+  }
 }  // namespace http
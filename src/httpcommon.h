@@ -4,6 +4,12 @@
  */
 #pragma once
 
+// standard includes
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <utility>
+
 // lib includes
 #include <curl/curl.h>
 
@@ -28,6 +34,14 @@ namespace http {
   std::string url_escape(const std::string &url);
   std::string url_get_host(const std::string &url);
 
+  /**
+   * @brief Parse the value of a `Range` request header holding a single byte range.
+   * @param header The header value, e.g. `bytes=100-`, `bytes=100-199` or `bytes=-500`.
+   * @param size The size of the requested resource.
+   * @return The half-open range [begin, end) to send, or std::nullopt if the range is invalid or can't be satisfied.
+   */
+  std::optional<std::pair<std::uint64_t, std::uint64_t>> parse_byte_range(std::string_view header, std::uint64_t size);
+
   extern std::string unique_id;
   extern uuid_util::uuid_t uuid;
   extern net::net_e origin_web_ui_allowed;
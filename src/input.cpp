@@ -9,6 +9,7 @@ extern "C" {
 }
 
 // standard includes
+#include <atomic>
 #include <bitset>
 #include <chrono>
 #include <cmath>
@@ -38,6 +39,9 @@ using namespace std::literals;
 namespace input {
 
   constexpr auto MAX_GAMEPADS = std::min((std::size_t) platf::MAX_GAMEPADS, sizeof(std::int16_t) * 8);
+
+  // Processed input messages kept for reuse, enough for the messages queued up while the OS is slow to take input
+  constexpr std::size_t MAX_FREE_INPUT_ENTRIES = 64;
 #define DISABLE_LEFT_BUTTON_DELAY ((thread_pool_util::ThreadPool::task_id_t) 0x01)
 #define ENABLE_LEFT_BUTTON_DELAY nullptr
 
@@ -138,6 +142,7 @@ namespace input {
       }
     }
 
+    /// The state last passed to the virtual gamepad, new states are only forwarded when they differ
     platf::gamepad_state_t gamepad_state;
 
     thread_pool_util::ThreadPool::task_id_t back_timeout_id;
@@ -152,6 +157,30 @@ namespace input {
     button_state_e back_button_state;
   };
 
+  /**
+   * @brief Maps the normalized touch and pen coordinates of the client onto the touch port.
+   * @details Computed once whenever the touch port changes, instead of for every event.
+   */
+  struct touch_transform_t {
+    platf::touch_port_t abs_port;
+    float width, height;
+    float offset_x, offset_y;
+    float scale_x, scale_y;
+    std::pair<float, float> contact_area_scalar;
+  };
+
+  /**
+   * @brief Touch and pen moves held back until the end of the coalescing window.
+   * @details Only used on the task pool thread, which passes all input to the OS.
+   */
+  struct pending_contacts_t {
+    std::chrono::steady_clock::time_point window_end;
+    bool flush_scheduled;
+
+    std::vector<platf::touch_input_t> touches;  ///< The latest move of each contact, at most one per pointer ID
+    std::optional<platf::pen_input_t> pen;
+  };
+
   struct input_t {
     enum shortkey_e {
       CTRL = 0x1,  ///< Control key
@@ -171,6 +200,8 @@ namespace input {
         feedback_queue {std::move(feedback_queue)},
         mouse_left_button_timeout {},
         touch_port {{0, 0, 0, 0}, 0, 0, 1.0f},
+        touch_transform {},
+        pending_contacts {},
         accumulated_vscroll_delta {},
         accumulated_hscroll_delta {} {
     }
@@ -185,14 +216,20 @@ namespace input {
     platf::feedback_queue_t feedback_queue;
 
     std::list<std::vector<uint8_t>> input_queue;
+    std::list<std::vector<uint8_t>> free_input_entries;  ///< Processed entries, reused so queueing a message doesn't allocate
     std::mutex input_queue_lock;
 
     thread_pool_util::ThreadPool::task_id_t mouse_left_button_timeout;
 
     input::touch_port_t touch_port;
+    touch_transform_t touch_transform;
+    pending_contacts_t pending_contacts;
 
     int32_t accumulated_vscroll_delta;
     int32_t accumulated_hscroll_delta;
+
+    std::atomic_uint64_t gamepad_updates_forwarded {};
+    std::atomic_uint64_t gamepad_updates_suppressed {};
   };
 
   /**
@@ -450,6 +487,72 @@ namespace input {
     platf::move_mouse(platf_input, util::endian::big(packet->deltaX), util::endian::big(packet->deltaY));
   }
 
+  /**
+   * @brief Pass the pending touch and pen moves to the OS, back to back as a single frame.
+   * @param input The input context.
+   */
+  void flush_contacts(input_t &input) {
+    auto &pending = input.pending_contacts;
+
+    for (auto &touch : pending.touches) {
+      platf::touch_update(input.client_context.get(), input.touch_transform.abs_port, touch);
+    }
+    pending.touches.clear();
+
+    if (pending.pen) {
+      platf::pen_update(input.client_context.get(), input.touch_transform.abs_port, *pending.pen);
+      pending.pen.reset();
+    }
+  }
+
+  /**
+   * @brief Take over a new touch port, if there is one.
+   * @param input The input context.
+   */
+  void update_touch_port(input_t &input) {
+    if (!input.touch_port_event->peek()) {
+      return;
+    }
+
+    // The pending moves were mapped onto the previous touch port
+    flush_contacts(input);
+
+    auto &touch_port = input.touch_port;
+    touch_port = *input.touch_port_event->pop();
+
+    input.touch_transform = {
+      {touch_port.offset_x, touch_port.offset_y, touch_port.env_width, touch_port.env_height},
+      (float) touch_port.width,
+      (float) touch_port.height,
+      touch_port.client_offsetX,
+      touch_port.client_offsetY,
+      touch_port.scalar_inv / touch_port.env_width,
+      touch_port.scalar_inv / touch_port.env_height,
+      {touch_port.env_width / 65535.f, touch_port.env_height / 65535.f},
+    };
+  }
+
+  /**
+   * @brief Converts normalized client touch or pen coordinates into coordinates normalized to the touch port.
+   * @param input The input context.
+   * @param x The horizontal coordinate in the range 0..1.
+   * @param y The vertical coordinate in the range 0..1.
+   * @return The coordinate pair if a touchport is available.
+   */
+  std::optional<std::pair<float, float>> client_to_touch_transform(input_t &input, float x, float y) {
+    update_touch_port(input);
+    if (!input.touch_port) {
+      BOOST_LOG(verbose) << "Ignoring early absolute input without a touch port"sv;
+      return std::nullopt;
+    }
+
+    auto &transform = input.touch_transform;
+    x = std::clamp(x * transform.width, transform.offset_x, transform.width - transform.offset_x);
+    y = std::clamp(y * transform.height, transform.offset_y, transform.height - transform.offset_y);
+
+    return std::pair {(x - transform.offset_x) * transform.scale_x, (y - transform.offset_y) * transform.scale_y};
+  }
+
   /**
    * @brief Converts client coordinates on the specified surface into screen coordinates.
    * @param input The input context.
@@ -458,11 +561,9 @@ namespace input {
    * @return The host-relative coordinate pair if a touchport is available.
    */
   std::optional<std::pair<float, float>> client_to_touchport(std::shared_ptr<input_t> &input, const std::pair<float, float> &val, const std::pair<float, float> &size) {
-    auto &touch_port_event = input->touch_port_event;
+    update_touch_port(*input);
+
     auto &touch_port = input->touch_port;
-    if (touch_port_event->peek()) {
-      touch_port = *touch_port_event->pop();
-    }
     if (!touch_port) {
       BOOST_LOG(verbose) << "Ignoring early absolute input without a touch port"sv;
       return std::nullopt;
@@ -866,7 +967,56 @@ namespace input {
       return;
     }
 
+    // A new virtual gamepad starts out in the neutral state
     input->gamepads[packet->controllerNumber].id = id;
+    input->gamepads[packet->controllerNumber].gamepad_state = {};
+  }
+
+  /**
+   * @brief Check if a touch or pen event only moves a contact, rather than changing its state.
+   */
+  bool is_move(std::uint8_t eventType) {
+    return eventType == LI_TOUCH_EVENT_MOVE || eventType == LI_TOUCH_EVENT_HOVER;
+  }
+
+  /**
+   * @brief Decide whether a touch or pen move is held back until the end of the coalescing window.
+   * @details The first move after a quiet window is passed to the OS right away. Later moves within
+   * the window replace the pending move of their contact, and the pending moves of all contacts are
+   * passed on together once the window ends, like a single multi-touch frame.
+   * @param input The input context.
+   * @return `true` if the caller must store the move as pending instead of passing it on.
+   */
+  bool defer_contact_move(std::shared_ptr<input_t> &input) {
+    auto &pending = input->pending_contacts;
+    auto window = config::input.touch_coalesce_window;
+    auto now = std::chrono::steady_clock::now();
+
+    if (window.count() <= 0 || now >= pending.window_end) {
+      flush_contacts(*input);
+      pending.window_end = now + window;
+      return false;
+    }
+
+    if (!pending.flush_scheduled) {
+      pending.flush_scheduled = true;
+      task_pool.pushDelayed([weak_input = std::weak_ptr {input}]() {
+        auto input = weak_input.lock();
+        if (!input) {
+          return;
+        }
+
+        auto &pending = input->pending_contacts;
+        pending.flush_scheduled = false;
+        flush_contacts(*input);
+
+        // Whatever arrives next starts a new window
+        pending.window_end = std::chrono::steady_clock::now() + config::input.touch_coalesce_window;
+      },
+                            pending.window_end - now);
+    }
+
+    return true;
   }
 
   /**
@@ -880,23 +1030,11 @@ namespace input {
     }
 
     // Convert the client normalized coordinates to touchport coordinates
-    auto coords = client_to_touchport(input, {from_clamped_netfloat(packet->x, 0.0f, 1.0f) * 65535.f, from_clamped_netfloat(packet->y, 0.0f, 1.0f) * 65535.f}, {65535.f, 65535.f});
+    auto coords = client_to_touch_transform(*input, from_clamped_netfloat(packet->x, 0.0f, 1.0f), from_clamped_netfloat(packet->y, 0.0f, 1.0f));
     if (!coords) {
       return;
     }
 
-    auto &touch_port = input->touch_port;
-    platf::touch_port_t abs_port {
-      touch_port.offset_x,
-      touch_port.offset_y,
-      touch_port.env_width,
-      touch_port.env_height
-    };
-
-    // Renormalize the coordinates
-    coords->first /= abs_port.width;
-    coords->second /= abs_port.height;
-
     // Normalize rotation value to 0-359 degree range
     auto rotation = util::endian::little(packet->rotation);
     if (rotation != LI_ROT_UNKNOWN) {
@@ -908,7 +1046,7 @@ namespace input {
       {from_clamped_netfloat(packet->contactAreaMajor, 0.0f, 1.0f) * 65535.f,
        from_clamped_netfloat(packet->contactAreaMinor, 0.0f, 1.0f) * 65535.f},
       rotation,
-      {abs_port.width / 65535.f, abs_port.height / 65535.f}
+      input->touch_transform.contact_area_scalar
     );
 
     platf::touch_input_t touch {
@@ -922,7 +1060,26 @@ namespace input {
       contact_area.second,
     };
 
-    platf::touch_update(input->client_context.get(), abs_port, touch);
+    auto &pending = input->pending_contacts;
+    auto pending_touch = std::find_if(std::begin(pending.touches), std::end(pending.touches), [&](const platf::touch_input_t &other) {
+      return other.pointerId == touch.pointerId;
+    });
+
+    if (is_move(touch.eventType) && (pending_touch == std::end(pending.touches) || pending_touch->eventType == touch.eventType)) {
+      if (defer_contact_move(input)) {
+        if (pending_touch == std::end(pending.touches)) {
+          pending.touches.push_back(touch);
+        } else {
+          *pending_touch = touch;
+        }
+        return;
+      }
+    } else {
+      // Contacts going down or up must not overtake the moves before them
+      flush_contacts(*input);
+    }
+
+    platf::touch_update(input->client_context.get(), input->touch_transform.abs_port, touch);
   }
 
   /**
@@ -936,23 +1093,11 @@ namespace input {
     }
 
     // Convert the client normalized coordinates to touchport coordinates
-    auto coords = client_to_touchport(input, {from_clamped_netfloat(packet->x, 0.0f, 1.0f) * 65535.f, from_clamped_netfloat(packet->y, 0.0f, 1.0f) * 65535.f}, {65535.f, 65535.f});
+    auto coords = client_to_touch_transform(*input, from_clamped_netfloat(packet->x, 0.0f, 1.0f), from_clamped_netfloat(packet->y, 0.0f, 1.0f));
     if (!coords) {
       return;
     }
 
-    auto &touch_port = input->touch_port;
-    platf::touch_port_t abs_port {
-      touch_port.offset_x,
-      touch_port.offset_y,
-      touch_port.env_width,
-      touch_port.env_height
-    };
-
-    // Renormalize the coordinates
-    coords->first /= abs_port.width;
-    coords->second /= abs_port.height;
-
     // Normalize rotation value to 0-359 degree range
     auto rotation = util::endian::little(packet->rotation);
     if (rotation != LI_ROT_UNKNOWN) {
@@ -964,7 +1109,7 @@ namespace input {
       {from_clamped_netfloat(packet->contactAreaMajor, 0.0f, 1.0f) * 65535.f,
        from_clamped_netfloat(packet->contactAreaMinor, 0.0f, 1.0f) * 65535.f},
       rotation,
-      {abs_port.width / 65535.f, abs_port.height / 65535.f}
+      input->touch_transform.contact_area_scalar
     );
 
     platf::pen_input_t pen {
@@ -980,7 +1125,22 @@ namespace input {
       contact_area.second,
     };
 
-    platf::pen_update(input->client_context.get(), abs_port, pen);
+    // Only moves that keep the buttons and the tool of the pending move can replace it
+    auto &pending = input->pending_contacts;
+    auto replaces_pending = !pending.pen || (pending.pen->eventType == pen.eventType &&
+                                             pending.pen->penButtons == pen.penButtons &&
+                                             pending.pen->toolType == pen.toolType);
+
+    if (is_move(pen.eventType) && replaces_pending) {
+      if (defer_contact_move(input)) {
+        pending.pen = pen;
+        return;
+      }
+    } else {
+      flush_contacts(*input);
+    }
+
+    platf::pen_update(input->client_context.get(), input->touch_transform.abs_port, pen);
   }
 
   /**
@@ -1105,6 +1265,7 @@ namespace input {
       }
 
       gamepad.id = id;
+      gamepad.gamepad_state = {};
     } else if (!(packet->activeGamepadMask & (1 << packet->controllerNumber)) && gamepad.id >= 0) {
       // If this is the final event for a gamepad being removed, free the gamepad and return.
       free_gamepad(platf_input, gamepad.id);
@@ -1188,7 +1349,15 @@ namespace input {
       }
     }
 
+    // Clients resend the full state at a high rate even when nothing changed. This compares
+    // against the state last forwarded, so it also holds for states merged by batch().
+    if (gamepad_state == gamepad.gamepad_state) {
+      input->gamepad_updates_suppressed.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+
     platf::gamepad_update(platf_input, gamepad.id, gamepad_state);
+    input->gamepad_updates_forwarded.fetch_add(1, std::memory_order_relaxed);
 
     gamepad.gamepad_state = gamepad_state;
   }
@@ -1319,17 +1488,23 @@ namespace input {
       return batch_result_e::terminate_batch;
     }
 
-    // Don't batch beyond state changing events
-    if (src->eventType != LI_TOUCH_EVENT_MOVE &&
-        src->eventType != LI_TOUCH_EVENT_HOVER) {
+    // Cancelling all contacts also ends this one
+    if (src->eventType == LI_TOUCH_EVENT_CANCEL_ALL) {
       return batch_result_e::terminate_batch;
     }
 
-    // Batched events must be the same pointer ID
+    // Contacts are independent of each other, so events of other contacts
+    // don't stop batching the moves of this one
     if (dest->pointerId != src->pointerId) {
       return batch_result_e::not_batchable;
     }
 
+    // Don't batch beyond state changing events of this contact
+    if (src->eventType != LI_TOUCH_EVENT_MOVE &&
+        src->eventType != LI_TOUCH_EVENT_HOVER) {
+      return batch_result_e::terminate_batch;
+    }
+
     // The pointer must be in the same state
     if (dest->eventType != src->eventType) {
       return batch_result_e::terminate_batch;
@@ -1474,13 +1649,26 @@ namespace input {
     }
   }
 
+  /**
+   * @brief Move a queued entry to the free entries, or drop it if there are enough of them already.
+   * @param input The input context, its input_queue_lock must be held.
+   * @param entry The entry of the input queue.
+   */
+  void recycle_input_entry(input_t &input, std::list<std::vector<uint8_t>>::iterator entry) {
+    if (input.free_input_entries.size() < MAX_FREE_INPUT_ENTRIES) {
+      input.free_input_entries.splice(std::end(input.free_input_entries), input.input_queue, entry);
+    } else {
+      input.input_queue.erase(entry);
+    }
+  }
+
   /**
    * @brief Called on a thread pool thread to process an input message.
    * @param input The input context pointer.
    */
   void passthrough_next_message(std::shared_ptr<input_t> input) {
     // 'entry' backs the 'payload' pointer, so they must remain in scope together
-    std::vector<uint8_t> entry;
+    std::list<std::vector<uint8_t>> entry;
     PNV_INPUT_HEADER payload;
 
     // Lock the input queue while batching, but release it before sending
@@ -1495,23 +1683,23 @@ namespace input {
       }
 
       // Pop off the first entry, which we will send
-      entry = input->input_queue.front();
-      payload = (PNV_INPUT_HEADER) entry.data();
-      input->input_queue.pop_front();
+      entry.splice(std::end(entry), input->input_queue, std::begin(input->input_queue));
+      payload = (PNV_INPUT_HEADER) entry.front().data();
 
       // Try to batch with remaining items on the queue
       auto i = input->input_queue.begin();
       while (i != input->input_queue.end()) {
-        auto batchable_entry = *i;
-        auto batchable_payload = (PNV_INPUT_HEADER) batchable_entry.data();
+        auto batchable_payload = (PNV_INPUT_HEADER) i->data();
 
         auto batch_result = batch(payload, batchable_payload);
         if (batch_result == batch_result_e::terminate_batch) {
           // Stop batching
           break;
         } else if (batch_result == batch_result_e::batched) {
-          // Erase this entry since it was batched
-          i = input->input_queue.erase(i);
+          // Recycle this entry since it was batched
+          auto next = std::next(i);
+          recycle_input_entry(*input, i);
+          i = next;
         } else {
           // We couldn't batch this entry, but try to batch later entries.
           i++;
@@ -1569,6 +1757,11 @@ namespace input {
         passthrough(input, (PSS_CONTROLLER_BATTERY_PACKET) payload);
         break;
     }
+
+    std::lock_guard<std::mutex> lg(input->input_queue_lock);
+    if (input->free_input_entries.size() < MAX_FREE_INPUT_ENTRIES) {
+      input->free_input_entries.splice(std::end(input->free_input_entries), entry);
+    }
   }
 
   /**
@@ -1576,7 +1769,7 @@ namespace input {
    * @param input The input context pointer.
    * @param input_data The input message.
    */
-  void passthrough(std::shared_ptr<input_t> &input, std::vector<std::uint8_t> &&input_data, const crypto::PERM& permission) {
+  void passthrough(std::shared_ptr<input_t> &input, const std::string_view &input_data, const crypto::PERM& permission) {
     // No input permissions at all
     if (!(permission & crypto::PERM::_all_inputs)) {
       return;
@@ -1638,7 +1831,14 @@ namespace input {
 
     {
       std::lock_guard<std::mutex> lg(input->input_queue_lock);
-      input->input_queue.push_back(std::move(input_data));
+      if (input->free_input_entries.empty()) {
+        input->input_queue.emplace_back();
+      } else {
+        input->input_queue.splice(std::end(input->input_queue), input->free_input_entries, std::begin(input->free_input_entries));
+      }
+
+      // Assigning keeps the capacity of a recycled entry
+      input->input_queue.back().assign(std::begin(input_data), std::end(input_data));
     }
     task_pool.push(passthrough_next_message, input);
   }
@@ -1706,4 +1906,11 @@ namespace input {
 
     return input;
   }
+
+  gamepad_stats_t gamepad_stats(const std::shared_ptr<input_t> &input) {
+    return {
+      input->gamepad_updates_forwarded.load(std::memory_order_relaxed),
+      input->gamepad_updates_suppressed.load(std::memory_order_relaxed),
+    };
+  }
 }  // namespace input
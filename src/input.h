@@ -17,7 +17,7 @@ namespace input {
 
   void print(void *input);
   void reset(std::shared_ptr<input_t> &input);
-  void passthrough(std::shared_ptr<input_t> &input, std::vector<std::uint8_t> &&input_data, const crypto::PERM& permission);
+  void passthrough(std::shared_ptr<input_t> &input, const std::string_view &input_data, const crypto::PERM& permission);
 
   [[nodiscard]] std::unique_ptr<platf::deinit_t> init();
 
@@ -25,6 +25,18 @@ namespace input {
 
   std::shared_ptr<input_t> alloc(safe::mail_t mail);
 
+  struct gamepad_stats_t {
+    std::uint64_t forwarded;  ///< Controller states passed to the virtual gamepads
+    std::uint64_t suppressed;  ///< Controller states dropped because they matched the last forwarded state
+  };
+
+  /**
+   * @brief Get the number of controller states forwarded and suppressed for a client.
+   * @param input The input context of the client.
+   * @return The counters since the input context was allocated.
+   */
+  gamepad_stats_t gamepad_stats(const std::shared_ptr<input_t> &input);
+
   struct touch_port_t: public platf::touch_port_t {
     int env_width, env_height;
 
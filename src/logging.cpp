@@ -3,10 +3,17 @@
  * @brief Definitions for logging related functions.
  */
 // standard includes
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <deque>
 #include <fstream>
 #include <filesystem>
+#include <functional>
 #include <iomanip>
 #include <iostream>
+#include <memory>
+#include <mutex>
 
 // lib includes
 #include <boost/core/null_deleter.hpp>
@@ -29,21 +36,389 @@ using namespace std::literals;
 
 namespace bl = boost::log;
 
-boost::shared_ptr<boost::log::sinks::asynchronous_sink<boost::log::sinks::text_ostream_backend>> sink;
-
-bl::sources::severity_logger<int> verbose(0);  // Dominating output
-bl::sources::severity_logger<int> debug(1);  // Follow what is happening
-bl::sources::severity_logger<int> info(2);  // Should be informed about
-bl::sources::severity_logger<int> warning(3);  // Strange events
-bl::sources::severity_logger<int> error(4);  // Recoverable errors
-bl::sources::severity_logger<int> fatal(5);  // Unrecoverable errors
+logging::logger_t verbose(0);  // Dominating output
+logging::logger_t debug(1);  // Follow what is happening
+logging::logger_t info(2);  // Should be informed about
+logging::logger_t warning(3);  // Strange events
+logging::logger_t error(4);  // Recoverable errors
+logging::logger_t fatal(5);  // Unrecoverable errors
 #ifdef SUNSHINE_TESTS
-bl::sources::severity_logger<int> tests(10);  // Automatic tests output
+logging::logger_t tests(10);  // Automatic tests output
 #endif
 
 BOOST_LOG_ATTRIBUTE_KEYWORD(severity, "Severity", int)
 
 namespace logging {
+  /**
+   * @brief Bounded in-memory history of formatted records, one per log level.
+   */
+  class log_ring_t {
+  public:
+    /**
+     * @brief Formatted text kept for each level before the oldest records are evicted.
+     */
+    static constexpr std::size_t BYTES_PER_LEVEL = 2 * 1024 * 1024;
+
+    void push(int level, const std::string &text) {
+      std::lock_guard lg {mutex};
+
+      auto &history = histories[slot(level)];
+      history.bytes += text.size();
+      history.records.push_back(log_record_t {++last_sequence, level, text});
+
+      while (history.bytes > BYTES_PER_LEVEL && history.records.size() > 1) {
+        auto &oldest = history.records.front();
+        history.bytes -= oldest.text.size();
+        history.last_evicted = oldest.sequence;
+        history.records.pop_front();
+      }
+    }
+
+    log_tail_t tail(std::uint64_t after, int min_level, std::size_t max_records) {
+      log_tail_t result {{}, 0, false};
+
+      std::lock_guard lg {mutex};
+      result.last_sequence = last_sequence;
+
+      for (auto x = slot(min_level); x < histories.size(); ++x) {
+        auto &history = histories[x];
+        if (history.last_evicted > after) {
+          result.truncated = true;
+        }
+
+        // Records are in sequence order, so only the newest ones need to be visited
+        auto begin = std::upper_bound(std::begin(history.records), std::end(history.records), after, [](std::uint64_t sequence, const log_record_t &record) {
+          return sequence < record.sequence;
+        });
+        if ((std::size_t) std::distance(begin, std::end(history.records)) > max_records) {
+          begin = std::end(history.records) - max_records;
+          result.truncated = true;
+        }
+
+        result.records.insert(std::end(result.records), begin, std::end(history.records));
+      }
+
+      std::sort(std::begin(result.records), std::end(result.records), [](const log_record_t &l, const log_record_t &r) {
+        return l.sequence < r.sequence;
+      });
+      if (result.records.size() > max_records) {
+        result.records.erase(std::begin(result.records), std::end(result.records) - max_records);
+        result.truncated = true;
+      }
+
+      return result;
+    }
+
+  private:
+    struct history_t {
+      std::deque<log_record_t> records;
+      std::size_t bytes = 0;
+      std::uint64_t last_evicted = 0;
+    };
+
+    // Levels above fatal, i.e. the tests output, share the history of fatal
+    static std::size_t slot(int level) {
+      return std::clamp(level, 0, 5);
+    }
+
+    std::mutex mutex;
+    std::uint64_t last_sequence = 0;
+    std::array<history_t, 6> histories;
+  };
+
+  static log_ring_t ring;
+
+  /**
+   * @brief Queueing strategy of the log sink, every logging thread owns a bounded single-producer buffer.
+   * @details Logging never takes a lock or waits for the writer thread. The writer merges the buffers
+   *          in the order the records were logged, and records that don't fit in a full buffer are dropped.
+   */
+  class per_thread_queue_t {
+  public:
+    /**
+     * @brief Records each thread can have waiting for the writer thread.
+     */
+    static constexpr std::size_t RECORDS_PER_THREAD = 4096;
+
+    std::uint64_t dropped() const {
+      std::lock_guard lg {buffers_mutex};
+
+      auto total = retired_dropped;
+      for (auto &buffer : buffers) {
+        total += buffer->dropped.load(std::memory_order_relaxed);
+      }
+
+      return total;
+    }
+
+    /**
+     * @brief Call the given function on the writer thread whenever it runs out of records.
+     */
+    void on_idle(std::function<void()> &&callback) {
+      std::lock_guard lg {wake_mutex};
+      idle_callback = std::make_shared<std::function<void()>>(std::move(callback));
+    }
+
+  protected:
+    per_thread_queue_t() = default;
+
+    template<class ArgsT>
+    explicit per_thread_queue_t(const ArgsT &) {
+    }
+
+    bool try_enqueue(const bl::record_view &rec) {
+      // The core would retry a rejected record with enqueue(), so a dropped record counts as accepted
+      enqueue(rec);
+      return true;
+    }
+
+    void enqueue(const bl::record_view &rec) {
+      auto &buffer = local_buffer();
+
+      auto head = buffer.head.load(std::memory_order_relaxed);
+      if (head - buffer.tail.load(std::memory_order_acquire) == RECORDS_PER_THREAD) {
+        buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+
+      auto &slot = buffer.slots[head % RECORDS_PER_THREAD];
+      slot.sequence = next_sequence.fetch_add(1, std::memory_order_relaxed);
+      slot.record = rec;
+      buffer.head.store(head + 1, std::memory_order_release);
+
+      // Pairs with the fence in dequeue_ready(), either the writer sees the record or we see it sleeping
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (sleeping.load(std::memory_order_relaxed)) {
+        std::lock_guard lg {wake_mutex};
+        woken = true;
+        wake_cv.notify_one();
+      }
+    }
+
+    bool try_dequeue_ready(bl::record_view &rec) {
+      return pop(rec);
+    }
+
+    bool try_dequeue(bl::record_view &rec) {
+      return pop(rec);
+    }
+
+    bool dequeue_ready(bl::record_view &rec) {
+      while (true) {
+        if (pop(rec)) {
+          return true;
+        }
+
+        // The writer thread is already running when the callback is set
+        std::unique_lock ul {wake_mutex};
+        if (auto callback = idle_callback) {
+          ul.unlock();
+          (*callback)();
+          ul.lock();
+        }
+
+        sleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (pop(rec)) {
+          sleeping.store(false, std::memory_order_relaxed);
+          return true;
+        }
+
+        wake_cv.wait(ul, [this]() {
+          return woken || interrupted;
+        });
+        sleeping.store(false, std::memory_order_relaxed);
+        woken = false;
+
+        if (interrupted) {
+          interrupted = false;
+          return false;
+        }
+      }
+    }
+
+    void interrupt_dequeue() {
+      std::lock_guard lg {wake_mutex};
+      interrupted = true;
+      wake_cv.notify_one();
+    }
+
+  private:
+    struct slot_t {
+      std::uint64_t sequence;
+      bl::record_view record;
+    };
+
+    struct buffer_t {
+      std::array<slot_t, RECORDS_PER_THREAD> slots;
+      std::atomic<std::size_t> head {0};  ///< Next slot to fill, only written by the owning thread
+      std::atomic<std::size_t> tail {0};  ///< Next slot to read, only written by the writer thread
+      std::atomic<std::uint64_t> dropped {0};
+      std::atomic_bool orphaned {false};  ///< The owning thread exited or moved on to another sink
+    };
+
+    /**
+     * @brief The buffer of the calling thread, registered on its first record.
+     */
+    buffer_t &local_buffer() {
+      struct local_t {
+        std::uint64_t queue_id = 0;
+        std::shared_ptr<buffer_t> buffer;
+
+        ~local_t() {
+          if (buffer) {
+            buffer->orphaned.store(true, std::memory_order_release);
+          }
+        }
+      };
+
+      static thread_local local_t local;
+
+      // The sink is recreated when the logging system is reinitialized, possibly at the same address
+      if (local.queue_id != id) {
+        if (local.buffer) {
+          local.buffer->orphaned.store(true, std::memory_order_release);
+        }
+
+        local.queue_id = id;
+        local.buffer = std::make_shared<buffer_t>();
+
+        std::lock_guard lg {buffers_mutex};
+        buffers.push_back(local.buffer);
+        buffers_version.fetch_add(1, std::memory_order_release);
+      }
+
+      return *local.buffer;
+    }
+
+    /**
+     * @brief Take the oldest record of all buffers.
+     */
+    bool pop(bl::record_view &rec) {
+      if (buffers_version.load(std::memory_order_acquire) != snapshot_version) {
+        std::lock_guard lg {buffers_mutex};
+        snapshot = buffers;
+        snapshot_version = buffers_version.load(std::memory_order_relaxed);
+      }
+
+      buffer_t *oldest = nullptr;
+      std::uint64_t oldest_sequence = 0;
+      for (auto &buffer : snapshot) {
+        auto tail = buffer->tail.load(std::memory_order_relaxed);
+        if (tail == buffer->head.load(std::memory_order_acquire)) {
+          continue;
+        }
+
+        auto sequence = buffer->slots[tail % RECORDS_PER_THREAD].sequence;
+        if (!oldest || sequence < oldest_sequence) {
+          oldest = buffer.get();
+          oldest_sequence = sequence;
+        }
+      }
+
+      if (!oldest) {
+        prune();
+        return false;
+      }
+
+      auto tail = oldest->tail.load(std::memory_order_relaxed);
+      rec = std::move(oldest->slots[tail % RECORDS_PER_THREAD].record);
+      oldest->tail.store(tail + 1, std::memory_order_release);
+
+      return true;
+    }
+
+    /**
+     * @brief Forget the drained buffers of threads that won't log into them again.
+     */
+    void prune() {
+      auto drained = [](const std::shared_ptr<buffer_t> &buffer) {
+        return buffer->orphaned.load(std::memory_order_acquire) &&
+               buffer->tail.load(std::memory_order_relaxed) == buffer->head.load(std::memory_order_acquire);
+      };
+
+      if (std::none_of(std::begin(snapshot), std::end(snapshot), drained)) {
+        return;
+      }
+
+      std::lock_guard lg {buffers_mutex};
+      std::erase_if(buffers, [&](const std::shared_ptr<buffer_t> &buffer) {
+        if (!drained(buffer)) {
+          return false;
+        }
+
+        retired_dropped += buffer->dropped.load(std::memory_order_relaxed);
+        return true;
+      });
+      snapshot = buffers;
+      snapshot_version = buffers_version.fetch_add(1, std::memory_order_release) + 1;
+    }
+
+    inline static std::atomic<std::uint64_t> next_id {1};
+    const std::uint64_t id = next_id.fetch_add(1, std::memory_order_relaxed);
+
+    inline static std::atomic<std::uint64_t> next_sequence {0};
+
+    mutable std::mutex buffers_mutex;
+    std::vector<std::shared_ptr<buffer_t>> buffers;
+    std::atomic<std::uint64_t> buffers_version {0};
+    std::uint64_t retired_dropped = 0;
+
+    // Only touched by the thread feeding the backend
+    std::vector<std::shared_ptr<buffer_t>> snapshot;
+    std::uint64_t snapshot_version = 0;
+
+    std::mutex wake_mutex;
+    std::shared_ptr<std::function<void()>> idle_callback;
+    std::condition_variable wake_cv;
+    std::atomic_bool sleeping {false};
+    bool woken = false;
+    bool interrupted = false;
+  };
+
+  /**
+   * @brief Sink backend of the writer thread, every record is formatted once for the console, the log file and the in-memory history.
+   */
+  class writer_backend_t: public bl::sinks::basic_formatted_sink_backend<char, bl::sinks::combine_requirements<bl::sinks::synchronized_feeding, bl::sinks::flushing>::type> {
+  public:
+    void add_stream(const boost::shared_ptr<std::ostream> &stream) {
+      streams.push_back(stream);
+    }
+
+    void consume(const bl::record_view &view, const string_type &text) {
+      for (auto &stream : streams) {
+        stream->write(text.data(), text.size());
+        stream->put('\n');
+      }
+      dirty = true;
+
+      ring.push(view.attribute_values()["Severity"].extract<int>().get(), text);
+    }
+
+    /**
+     * @brief Flush the streams, once the writer thread has caught up rather than after every record.
+     */
+    void flush() {
+      if (!dirty) {
+        return;
+      }
+
+      for (auto &stream : streams) {
+        stream->flush();
+      }
+      dirty = false;
+    }
+
+  private:
+    std::vector<boost::shared_ptr<std::ostream>> streams;
+    bool dirty = false;
+  };
+
+  using sink_t = bl::sinks::asynchronous_sink<writer_backend_t, per_thread_queue_t>;
+
+  static boost::shared_ptr<sink_t> sink;
+
   deinit_t::~deinit_t() {
     deinit();
   }
@@ -123,7 +498,7 @@ namespace logging {
     setup_av_logging(min_log_level);
     setup_libdisplaydevice_logging(min_log_level);
 
-    sink = boost::make_shared<text_sink>();
+    sink = boost::make_shared<sink_t>();
 
 #ifndef SUNSHINE_TESTS
     boost::shared_ptr<std::ostream> stream {&std::cout, boost::null_deleter()};
@@ -133,14 +508,33 @@ namespace logging {
     sink->set_filter(severity >= min_log_level);
     sink->set_formatter(&formatter);
 
-    // Flush after each log record to ensure log file contents on disk isn't stale.
+    // Flush whenever the writer thread runs out of records to ensure log file contents on disk isn't stale.
     // This is particularly important when running from a Windows service.
-    sink->locked_backend()->auto_flush(true);
+    sink->on_idle([frontend = sink.get(), reported = std::uint64_t {0}]() mutable {
+      frontend->locked_backend()->flush();
 
+      if (auto dropped = frontend->dropped(); dropped > reported) {
+        BOOST_LOG(warning) << "Dropped "sv << dropped - reported << " log records, the log writer couldn't keep up"sv;
+        reported = dropped;
+      }
+    });
+
+    min_level = min_log_level;
     bl::core::get()->add_sink(sink);
+
     return std::make_unique<deinit_t>();
   }
 
+  void set_min_level(int min_log_level) {
+    setup_av_logging(min_log_level);
+    setup_libdisplaydevice_logging(min_log_level);
+
+    if (sink) {
+      sink->set_filter(severity >= min_log_level);
+    }
+    min_level = min_log_level;
+  }
+
   void setup_av_logging(int min_log_level) {
     if (min_log_level >= 1) {
       av_log_set_level(AV_LOG_QUIET);
@@ -205,6 +599,14 @@ namespace logging {
     }
   }
 
+  std::uint64_t dropped_records() {
+    return sink ? sink->dropped() : 0;
+  }
+
+  log_tail_t tail(std::uint64_t after, int min_level, std::size_t max_records) {
+    return ring.tail(after, min_level, max_records);
+  }
+
   void print_help(const char *name) {
     std::cout
       << "Usage: "sv << name << " [options] [/path/to/configuration_file] [--cmd]"sv << std::endl
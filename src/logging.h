@@ -4,20 +4,86 @@
  */
 #pragma once
 
+// standard includes
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
 // lib includes
 #include <boost/log/common.hpp>
 #include <boost/log/sinks.hpp>
+#include <boost/log/sources/severity_feature.hpp>
+
+namespace logging {
+  /**
+   * @brief Records below this level are discarded by the loggers before anything is formatted.
+   */
+  inline std::atomic_int min_level {0};
+
+  /**
+   * @brief Logger feature comparing the severity against min_level before a record is opened.
+   * @details Boost.Log only rejects a record after the core has locked its attribute sets and run its filters,
+   *          which is too expensive for the verbose records logged from the stream threads.
+   */
+  template<class BaseT>
+  class basic_level_gate_logger: public BaseT {
+    using base_type = BaseT;
+
+  public:
+    basic_level_gate_logger() = default;
+
+    basic_level_gate_logger(const basic_level_gate_logger &that):
+        base_type(static_cast<const base_type &>(that)) {
+    }
+
+    template<class ArgsT>
+    explicit basic_level_gate_logger(const ArgsT &args):
+        base_type(args) {
+    }
 
-using text_sink = boost::log::sinks::asynchronous_sink<boost::log::sinks::text_ostream_backend>;
+  protected:
+    template<class ArgsT>
+    boost::log::record open_record_unlocked(const ArgsT &args) {
+      if (args[boost::log::keywords::severity | this->default_severity()] < min_level.load(std::memory_order_relaxed)) {
+        return boost::log::record();
+      }
+
+      return base_type::open_record_unlocked(args);
+    }
+  };
+
+  /**
+   * @brief Feature tag for basic_level_gate_logger, it has to come before the severity feature.
+   */
+  struct level_gate {
+    template<class BaseT>
+    struct apply {
+      using type = basic_level_gate_logger<BaseT>;
+    };
+  };
+
+  /**
+   * @brief Severity logger type of the global loggers.
+   */
+  class logger_t: public boost::log::sources::basic_composite_logger<char, logger_t, boost::log::sources::single_thread_model, boost::log::sources::features<level_gate, boost::log::sources::severity<int>>> {
+    using logger_base_t = boost::log::sources::basic_composite_logger<char, logger_t, boost::log::sources::single_thread_model, boost::log::sources::features<level_gate, boost::log::sources::severity<int>>>;
+
+  public:
+    explicit logger_t(int level):
+        logger_base_t(boost::log::keywords::severity = level) {
+    }
+  };
+}  // namespace logging
 
-extern boost::log::sources::severity_logger<int> verbose;
-extern boost::log::sources::severity_logger<int> debug;
-extern boost::log::sources::severity_logger<int> info;
-extern boost::log::sources::severity_logger<int> warning;
-extern boost::log::sources::severity_logger<int> error;
-extern boost::log::sources::severity_logger<int> fatal;
+extern logging::logger_t verbose;
+extern logging::logger_t debug;
+extern logging::logger_t info;
+extern logging::logger_t warning;
+extern logging::logger_t error;
+extern logging::logger_t fatal;
 #ifdef SUNSHINE_TESTS
-extern boost::log::sources::severity_logger<int> tests;
+extern logging::logger_t tests;
 #endif
 
 #include "config.h"
@@ -56,6 +122,15 @@ namespace logging {
    */
   [[nodiscard]] std::unique_ptr<deinit_t> init(int min_log_level, const std::string &log_file);
 
+  /**
+   * @brief Change the minimum log level of the running logging system.
+   * @param min_log_level The minimum log level to output.
+   * @examples
+   * set_min_level(1);
+   * @examples_end
+   */
+  void set_min_level(int min_log_level);
+
   /**
    * @brief Setup AV logging.
    * @param min_log_level The log level.
@@ -76,6 +151,48 @@ namespace logging {
    */
   void log_flush();
 
+  /**
+   * @brief Get the number of records dropped since the logging system was initialized.
+   * @details Every thread logs into a bounded buffer of its own; when the writer thread falls behind,
+   *          records that don't fit are dropped instead of blocking the thread that logged them.
+   * @return The number of dropped records.
+   * @examples
+   * auto dropped = logging::dropped_records();
+   * @examples_end
+   */
+  std::uint64_t dropped_records();
+
+  /**
+   * @brief A formatted log record kept in memory for the Web UI.
+   */
+  struct log_record_t {
+    std::uint64_t sequence;  ///< Increases by one with every record, starting at 1
+    int level;
+    std::string text;
+  };
+
+  /**
+   * @brief Result of a query for recent log records.
+   */
+  struct log_tail_t {
+    std::vector<log_record_t> records;  ///< Oldest first
+    std::uint64_t last_sequence;  ///< Sequence of the newest record logged so far, to resume from
+    bool truncated;  ///< Matching records were evicted from memory or left out because of the record limit
+  };
+
+  /**
+   * @brief Get recent log records from memory, without touching the log file.
+   * @details Every level keeps its own bounded history, so a flood of verbose records doesn't evict the errors.
+   * @param after Only return records with a greater sequence number, 0 for all of them.
+   * @param min_level Only return records of this level or above.
+   * @param max_records Return at most this many of the newest matching records.
+   * @return The matching records.
+   * @examples
+   * auto warnings = logging::tail(0, 3, 1000);
+   * @examples_end
+   */
+  log_tail_t tail(std::uint64_t after, int min_level, std::size_t max_records);
+
   /**
    * @brief Print help to stdout.
    * @param name The name of the program.
@@ -101,7 +218,7 @@ namespace logging {
   template<typename T>
   class min_max_avg_periodic_logger {
   public:
-    min_max_avg_periodic_logger(boost::log::sources::severity_logger<int> &severity, std::string_view message, std::string_view units, std::chrono::seconds interval_in_seconds = std::chrono::seconds(20)):
+    min_max_avg_periodic_logger(logger_t &severity, std::string_view message, std::string_view units, std::chrono::seconds interval_in_seconds = std::chrono::seconds(20)):
         severity(severity),
         message(message),
         units(units),
@@ -140,7 +257,7 @@ namespace logging {
     }
 
   private:
-    std::reference_wrapper<boost::log::sources::severity_logger<int>> severity;
+    std::reference_wrapper<logger_t> severity;
     std::string message;
     std::string units;
     std::chrono::seconds interval;
@@ -165,7 +282,7 @@ namespace logging {
    */
   class time_delta_periodic_logger {
   public:
-    time_delta_periodic_logger(boost::log::sources::severity_logger<int> &severity, std::string_view message, std::chrono::seconds interval_in_seconds = std::chrono::seconds(20)):
+    time_delta_periodic_logger(logger_t &severity, std::string_view message, std::chrono::seconds interval_in_seconds = std::chrono::seconds(20)):
         logger(severity, message, "ms", interval_in_seconds) {
     }
 
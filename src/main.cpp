@@ -18,6 +18,7 @@
 #include "main.h"
 #include "nvhttp.h"
 #include "process.h"
+#include "stream.h"
 #include "system_tray.h"
 #include "upnp.h"
 #include "uuid.h"
@@ -413,6 +414,9 @@ int main(int argc, char *argv[]) {
   configThread.join();
   rtspThread.join();
 
+  // The task ending the resume grace period would be dropped with the task pool
+  stream::session::shutdown();
+
   task_pool.stop();
   task_pool.join();
 
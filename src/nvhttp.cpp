@@ -6,7 +6,10 @@
 #define BOOST_BIND_GLOBAL_PLACEHOLDERS
 
 // standard includes
+#include <atomic>
 #include <filesystem>
+#include <map>
+#include <mutex>
 #include <string>
 #include <utility>
 #include <string>
@@ -20,7 +23,9 @@
 #include <Simple-Web-Server/server_http.hpp>
 
 // local includes
+#include "asset_cache.h"
 #include "config.h"
+#include "cover_cache.h"
 #include "display_device.h"
 #include "file_handler.h"
 #include "globals.h"
@@ -64,6 +69,10 @@ namespace nvhttp {
   static std::string otp_device_name;
   static std::chrono::time_point<std::chrono::steady_clock> otp_creation_time;
 
+  // Sessions are only resumed by the server that created them
+  constexpr auto TLS_SESSION_ID_CONTEXT = "sunshine-nvhttp"sv;
+  constexpr auto TLS_SESSION_TIMEOUT = 2h;
+
   class SunshineHTTPSServer: public SimpleWeb::ServerBase<SunshineHTTPS> {
   public:
     SunshineHTTPSServer(const std::string &certification_file, const std::string &private_key_file):
@@ -74,6 +83,14 @@ namespace nvhttp {
       context.set_options(boost::asio::ssl::context::no_tlsv1_1);
       context.use_certificate_chain_file(certification_file);
       context.use_private_key_file(private_key_file, boost::asio::ssl::context::pem);
+
+      // Moonlight opens a new connection for every request, let it resume its TLS session
+      // with a session ticket or ID instead of performing a full handshake each time.
+      // The client certificate is still verified on every connection, so unpairing takes effect immediately.
+      auto ssl_ctx = context.native_handle();
+      SSL_CTX_set_session_cache_mode(ssl_ctx, SSL_SESS_CACHE_SERVER);
+      SSL_CTX_set_session_id_context(ssl_ctx, (const unsigned char *) TLS_SESSION_ID_CONTEXT.data(), TLS_SESSION_ID_CONTEXT.size());
+      SSL_CTX_set_timeout(ssl_ctx, std::chrono::duration_cast<std::chrono::seconds>(TLS_SESSION_TIMEOUT).count());
     }
 
     std::function<bool(std::shared_ptr<Request>, SSL*)> verify;
@@ -150,6 +167,16 @@ namespace nvhttp {
   client_t client_root;
   std::atomic<uint32_t> session_id_counter;
 
+  /**
+   * @brief The "root" node of the state file as last loaded or saved, it may not have reached the disk yet.
+   */
+  nlohmann::json state_root;
+
+  /**
+   * @brief Writes the state file on the task pool, so pairing and device updates don't wait for the disk.
+   */
+  file_handler::deferred_writer_t state_writer {500ms};
+
   using resp_https_t = std::shared_ptr<typename SimpleWeb::ServerBase<SunshineHTTPS>::Response>;
   using req_https_t = std::shared_ptr<typename SimpleWeb::ServerBase<SunshineHTTPS>::Request>;
   using resp_http_t = std::shared_ptr<typename SimpleWeb::ServerBase<SimpleWeb::HTTP>::Response>;
@@ -204,23 +231,7 @@ namespace nvhttp {
 
   void save_state() {
     nlohmann::json root = nlohmann::json::object();
-    // If the state file exists, try to read it.
-    if (fs::exists(config::nvhttp.file_state)) {
-      try {
-        std::ifstream in(config::nvhttp.file_state);
-        in >> root;
-      } catch (std::exception &e) {
-        BOOST_LOG(error) << "Couldn't read "sv << config::nvhttp.file_state << ": "sv << e.what();
-        return;
-      }
-    }
-
-    // Erase any previous "root" key.
-    root.erase("root");
-
-    // Create a new "root" object and set the unique id.
-    root["root"] = nlohmann::json::object();
-    root["root"]["uniqueid"] = http::unique_id;
+    root["uniqueid"] = http::unique_id;
 
     client_t &client = client_root;
     nlohmann::json named_cert_nodes = nlohmann::json::array();
@@ -274,45 +285,51 @@ namespace nvhttp {
       }
     }
 
-    root["root"]["named_devices"] = named_cert_nodes;
+    root["named_devices"] = named_cert_nodes;
+    state_root = root;
 
-    try {
-      std::ofstream out(config::nvhttp.file_state);
-      out << root.dump(4);  // Pretty-print with an indent of 4 spaces.
-    } catch (std::exception &e) {
-      BOOST_LOG(error) << "Couldn't write "sv << config::nvhttp.file_state << ": "sv << e.what();
-      return;
-    }
+    // The other keys, e.g. the credentials of the Web UI, are kept as they are on disk.
+    // A file that can't be parsed is left alone, rather than losing them.
+    state_writer.write(config::nvhttp.file_state, [root = std::move(root)](const std::string &current) {
+      auto tree = current.empty() ? nlohmann::json::object() : nlohmann::json::parse(current);
+      tree["root"] = root;
+      return tree.dump(4);  // Pretty-print with an indent of 4 spaces.
+    });
   }
 
   void load_state() {
-    if (!fs::exists(config::nvhttp.file_state)) {
-      BOOST_LOG(info) << "File "sv << config::nvhttp.file_state << " doesn't exist"sv;
-      http::unique_id = uuid_util::uuid_t::generate().string();
-      return;
-    }
+    // Once saved, the state is taken from memory, the file may still be waiting to be written
+    if (state_root.is_null()) {
+      if (!fs::exists(config::nvhttp.file_state)) {
+        BOOST_LOG(info) << "File "sv << config::nvhttp.file_state << " doesn't exist"sv;
+        http::unique_id = uuid_util::uuid_t::generate().string();
+        return;
+      }
 
-    nlohmann::json tree;
-    try {
-      std::ifstream in(config::nvhttp.file_state);
-      in >> tree;
-    } catch (std::exception &e) {
-      BOOST_LOG(error) << "Couldn't read "sv << config::nvhttp.file_state << ": "sv << e.what();
-      return;
-    }
+      nlohmann::json tree;
+      try {
+        std::ifstream in(config::nvhttp.file_state);
+        in >> tree;
+      } catch (std::exception &e) {
+        BOOST_LOG(error) << "Couldn't read "sv << config::nvhttp.file_state << ": "sv << e.what();
+        return;
+      }
 
-    // Check that the file contains a "root.uniqueid" value.
-    if (!tree.contains("root") || !tree["root"].contains("uniqueid")) {
-      http::uuid = uuid_util::uuid_t::generate();
-      http::unique_id = http::uuid.string();
-      return;
+      // Check that the file contains a "root.uniqueid" value.
+      if (!tree.contains("root") || !tree["root"].contains("uniqueid")) {
+        http::uuid = uuid_util::uuid_t::generate();
+        http::unique_id = http::uuid.string();
+        return;
+      }
+
+      state_root = tree["root"];
     }
 
-    std::string uid = tree["root"]["uniqueid"];
+    nlohmann::json root = state_root;
+
+    std::string uid = root["uniqueid"];
     http::uuid = uuid_util::uuid_t::parse(uid);
     http::unique_id = uid;
-
-    nlohmann::json root = tree["root"];
     client_t client;  // Local client to load into
 
     // Import from the old format if available.
@@ -878,22 +895,61 @@ namespace nvhttp {
     return true;
   }
 
-  template<class T>
-  void serverinfo(std::shared_ptr<typename SimpleWeb::ServerBase<T>::Response> response, std::shared_ptr<typename SimpleWeb::ServerBase<T>::Request> request) {
-    print_req<T>(request);
+  /**
+   * @brief Pre-rendered responses, valid for as long as the cache generation doesn't change.
+   */
+  template<class K>
+  class response_cache_t {
+  public:
+    /**
+     * @brief Responses for distinct keys beyond this count are rendered but not cached.
+     * @details Keys only vary with the permissions of the paired clients and the local addresses of the host,
+     * so this is never reached in practice.
+     */
+    static constexpr std::size_t MAX_ENTRIES = 64;
+
+    template<class F>
+    response_buffer_t get(const K &key, std::uint64_t generation, F &&render) {
+      {
+        std::lock_guard lg {mutex};
+        if (generation != this->generation) {
+          responses.clear();
+          this->generation = generation;
+        }
 
-    int pair_status = 0;
-    if constexpr (std::is_same_v<SunshineHTTPS, T>) {
-      auto args = request->parse_query_string();
-      auto clientID = args.find("uniqueid"s);
+        auto it = responses.find(key);
+        if (it != std::end(responses)) {
+          return it->second;
+        }
+      }
 
-      if (clientID != std::end(args)) {
-        pair_status = 1;
+      // Render outside the lock, concurrent misses for the same key are harmless
+      auto response = std::make_shared<const std::string>(render(key));
+
+      std::lock_guard lg {mutex};
+      // Don't cache a response that may have been rendered from stale state
+      if (generation == this->generation && responses.size() < MAX_ENTRIES) {
+        responses.emplace(key, response);
       }
+
+      return response;
     }
 
-    auto local_endpoint = request->local_endpoint();
+  private:
+    std::mutex mutex;
+    std::uint64_t generation = 0;
+    std::map<K, response_buffer_t> responses;
+  };
+
+  static std::atomic<std::uint64_t> response_generation {1};
+  static response_cache_t<serverinfo_key_t> serverinfo_cache;
+  static response_cache_t<applist_key_t> applist_cache;
+
+  void invalidate_response_cache() {
+    ++response_generation;
+  }
 
+  std::string render_serverinfo(const serverinfo_key_t &key) {
     pt::ptree tree;
 
     tree.put("root.<xmlattr>.status_code", 200);
@@ -908,11 +964,10 @@ namespace nvhttp {
 
     // Only include the MAC address for requests sent from paired clients over HTTPS.
     // For HTTP requests, use a placeholder MAC address that Moonlight knows to ignore.
-    if constexpr (std::is_same_v<SunshineHTTPS, T>) {
-      tree.put("root.mac", platf::get_mac_address(net::addr_to_normalized_string(local_endpoint.address())));
+    if (key.https) {
+      tree.put("root.mac", platf::get_mac_address(key.local_address));
 
-      auto named_cert_p = get_verified_cert(request);
-      if (!!(named_cert_p->perm & PERM::server_cmd)) {
+      if (!!(key.perm & PERM::server_cmd)) {
         pt::ptree& root_node = tree.get_child("root");
 
         if (config::sunshine.server_cmds.size() > 0) {
@@ -923,19 +978,13 @@ namespace nvhttp {
             root_node.push_back(std::make_pair("ServerCommand", cmd_node));
           }
         }
-      } else {
-        BOOST_LOG(debug) << "Permission Get ServerCommand denied for [" << named_cert_p->name << "] (" << (uint32_t)named_cert_p->perm << ")";
       }
 
-      tree.put("root.Permission", std::to_string((uint32_t)named_cert_p->perm));
+      tree.put("root.Permission", std::to_string((uint32_t)key.perm));
 
     #ifdef _WIN32
       tree.put("root.VirtualDisplayCapable", true);
-      if (!!(named_cert_p->perm & PERM::_all_actions)) {
-        tree.put("root.VirtualDisplayDriverReady", proc::vDisplayDriverStatus == VDISPLAY::DRIVER_STATUS::OK);
-      } else {
-        tree.put("root.VirtualDisplayDriverReady", true);
-      }
+      tree.put("root.VirtualDisplayDriverReady", key.vdisplay_ready);
     #endif
     } else {
       tree.put("root.mac", "00:00:00:00:00:00");
@@ -951,12 +1000,149 @@ namespace nvhttp {
     // have that implemented. For now, we will emulate the behavior of GFE+GS-IPv6-Forwarder,
     // which returns 127.0.0.1 as LocalIP for IPv6 connections. Moonlight clients with IPv6
     // support know to ignore this bogus address.
-    if (local_endpoint.address().is_v6() && !local_endpoint.address().to_v6().is_v4_mapped()) {
+    boost::system::error_code ec;
+    auto local_address = boost::asio::ip::make_address(key.local_address, ec);
+    if (local_address.is_v6() && !local_address.to_v6().is_v4_mapped()) {
       tree.put("root.LocalIP", "127.0.0.1");
     } else {
-      tree.put("root.LocalIP", net::addr_to_normalized_string(local_endpoint.address()));
+      tree.put("root.LocalIP", key.local_address);
+    }
+
+    tree.put("root.ServerCodecModeSupport", key.codec_mode_flags);
+    tree.put("root.PairStatus", key.pair_status);
+
+    if (key.https) {
+      tree.put("root.currentgame", key.current_appid);
+      tree.put("root.currentgameuuid", proc::proc.get_running_app_uuid());
+      tree.put("root.state", key.current_appid > 0 ? "SUNSHINE_SERVER_BUSY" : "SUNSHINE_SERVER_FREE");
+    } else {
+      tree.put("root.currentgame", 0);
+      tree.put("root.currentgameuuid", "");
+      tree.put("root.state", "SUNSHINE_SERVER_FREE");
     }
 
+    std::ostringstream data;
+
+    pt::write_xml(data, tree);
+    return data.str();
+  }
+
+  std::string render_applist(const applist_key_t &key) {
+    pt::ptree tree;
+
+    auto &apps = tree.add_child("root", pt::ptree {});
+
+    apps.put("<xmlattr>.status_code", 200);
+
+    if (!!(key.perm & PERM::_all_actions)) {
+      auto current_appid = key.current_appid;
+      auto should_hide_inactive_apps = config::input.enable_input_only_mode && current_appid > 0 && current_appid != proc::input_only_app_id;
+
+      // A copy, proc::refresh() may replace the list while it is rendered
+      auto app_list = proc::proc.get_apps();
+
+      size_t bits;
+      if (key.enable_legacy_ordering) {
+        bits = zwpad::pad_width_for_count(app_list.size());
+      }
+
+      for (size_t i = 0; i < app_list.size(); i++) {
+        auto& app = app_list[i];
+        auto appid = util::from_view(app.id);
+        if (should_hide_inactive_apps) {
+          if (
+            appid != current_appid
+            && appid != proc::input_only_app_id
+            && appid != proc::terminate_app_id
+          ) {
+            continue;
+          }
+        } else {
+          if (appid == proc::terminate_app_id) {
+            continue;
+          }
+        }
+
+        std::string app_name;
+        if (key.enable_legacy_ordering) {
+          app_name = zwpad::pad_for_ordering(app.name, bits, i);
+        } else {
+          app_name = app.name;
+        }
+
+        pt::ptree app_node;
+
+        app_node.put("IsHdrSupported"s, key.hdr_supported ? 1 : 0);
+        app_node.put("AppTitle"s, app_name);
+        app_node.put("UUID", app.uuid);
+        app_node.put("IDX", app.idx);
+        app_node.put("ID", app.id);
+
+        apps.push_back(std::make_pair("App", std::move(app_node)));
+      }
+    } else {
+      pt::ptree app_node;
+
+      app_node.put("IsHdrSupported"s, 0);
+      app_node.put("AppTitle"s, "Permission Denied");
+      app_node.put("UUID", "");
+      app_node.put("IDX", "0");
+      app_node.put("ID", "114514");
+
+      apps.push_back(std::make_pair("App", std::move(app_node)));
+    }
+
+    std::ostringstream data;
+
+    pt::write_xml(data, tree);
+    return data.str();
+  }
+
+  response_buffer_t get_serverinfo(const serverinfo_key_t &key) {
+    return serverinfo_cache.get(key, response_generation, render_serverinfo);
+  }
+
+  response_buffer_t get_applist(const applist_key_t &key) {
+    return applist_cache.get(key, response_generation, render_applist);
+  }
+
+  template<class T>
+  void serverinfo(std::shared_ptr<typename SimpleWeb::ServerBase<T>::Response> response, std::shared_ptr<typename SimpleWeb::ServerBase<T>::Request> request) {
+    print_req<T>(request);
+
+    serverinfo_key_t key;
+    key.https = std::is_same_v<SunshineHTTPS, T>;
+
+    if constexpr (std::is_same_v<SunshineHTTPS, T>) {
+      auto args = request->parse_query_string();
+      auto clientID = args.find("uniqueid"s);
+
+      if (clientID != std::end(args)) {
+        key.pair_status = 1;
+      }
+
+      auto named_cert_p = get_verified_cert(request);
+      if (!(named_cert_p->perm & PERM::server_cmd)) {
+        BOOST_LOG(debug) << "Permission Get ServerCommand denied for [" << named_cert_p->name << "] (" << (uint32_t)named_cert_p->perm << ")";
+      }
+      key.perm = named_cert_p->perm;
+
+    #ifdef _WIN32
+      key.vdisplay_ready = !(named_cert_p->perm & PERM::_all_actions) || proc::vDisplayDriverStatus == VDISPLAY::DRIVER_STATUS::OK;
+    #endif
+
+      // Checking whether the app is still running may terminate it, which invalidates the cache,
+      // so this must happen before the cache is looked up.
+      key.current_appid = proc::proc.running();
+      // When input only mode is enabled, the only resume method should be launching the same app again.
+      if (config::input.enable_input_only_mode && key.current_appid != proc::input_only_app_id) {
+        key.current_appid = 0;
+      }
+    }
+
+    auto local_endpoint = request->local_endpoint();
+    key.local_address = net::addr_to_normalized_string(local_endpoint.address());
+
     uint32_t codec_mode_flags = SCM_H264;
     if (video::last_encoder_probe_supported_yuv444_for_codec[0]) {
       codec_mode_flags |= SCM_H264_HIGH8_444;
@@ -985,30 +1171,13 @@ namespace nvhttp {
         codec_mode_flags |= SCM_AV1_HIGH10_444;
       }
     }
-    tree.put("root.ServerCodecModeSupport", codec_mode_flags);
-
-    tree.put("root.PairStatus", pair_status);
-
-    if constexpr (std::is_same_v<SunshineHTTPS, T>) {
-      int current_appid = proc::proc.running();
-      // When input only mode is enabled, the only resume method should be launching the same app again.
-      if (config::input.enable_input_only_mode && current_appid != proc::input_only_app_id) {
-        current_appid = 0;
-      }
-      tree.put("root.currentgame", current_appid);
-      tree.put("root.currentgameuuid", proc::proc.get_running_app_uuid());
-      tree.put("root.state", current_appid > 0 ? "SUNSHINE_SERVER_BUSY" : "SUNSHINE_SERVER_FREE");
-    } else {
-      tree.put("root.currentgame", 0);
-      tree.put("root.currentgameuuid", "");
-      tree.put("root.state", "SUNSHINE_SERVER_FREE");
-    }
+    key.codec_mode_flags = codec_mode_flags;
 
-    std::ostringstream data;
-
-    pt::write_xml(data, tree);
-    response->write(data.str());
-    response->close_connection_after_response = true;
+    auto data = get_serverinfo(key);
+    response->write(*data);
+    // Plain HTTP polls carry no client identity, so the client may keep the connection alive for the next one.
+    // HTTPS connections can't be reused: the verified certificate is only attached to the first request.
+    response->close_connection_after_response = std::is_same_v<SunshineHTTPS, T>;
   }
 
   nlohmann::json get_all_clients() {
@@ -1068,83 +1237,21 @@ namespace nvhttp {
   void applist(resp_https_t response, req_https_t request) {
     print_req<SunshineHTTPS>(request);
 
-    pt::ptree tree;
-
-    auto g = util::fail_guard([&]() {
-      std::ostringstream data;
-
-      pt::write_xml(data, tree);
-      response->write(data.str());
-      response->close_connection_after_response = true;
-    });
-
-    auto &apps = tree.add_child("root", pt::ptree {});
-
-    apps.put("<xmlattr>.status_code", 200);
+    applist_key_t key;
 
     auto named_cert_p = get_verified_cert(request);
+    key.perm = named_cert_p->perm;
     if (!!(named_cert_p->perm & PERM::_all_actions)) {
-      auto current_appid = proc::proc.running();
-      auto should_hide_inactive_apps = config::input.enable_input_only_mode && current_appid > 0 && current_appid != proc::input_only_app_id;
-
-      auto app_list = proc::proc.get_apps();
-
-      bool enable_legacy_ordering = config::sunshine.legacy_ordering && named_cert_p->enable_legacy_ordering;
-      size_t bits;
-      if (enable_legacy_ordering) {
-        bits = zwpad::pad_width_for_count(app_list.size());
-      }
-
-      for (size_t i = 0; i < app_list.size(); i++) {
-        auto& app = app_list[i];
-        auto appid = util::from_view(app.id);
-        if (should_hide_inactive_apps) {
-          if (
-            appid != current_appid
-            && appid != proc::input_only_app_id
-            && appid != proc::terminate_app_id
-          ) {
-            continue;
-          }
-        } else {
-          if (appid == proc::terminate_app_id) {
-            continue;
-          }
-        }
-
-        std::string app_name;
-        if (enable_legacy_ordering) {
-          app_name = zwpad::pad_for_ordering(app.name, bits, i);
-        } else {
-          app_name = app.name;
-        }
-
-        pt::ptree app_node;
-
-        app_node.put("IsHdrSupported"s, video::active_hevc_mode == 3 ? 1 : 0);
-        app_node.put("AppTitle"s, app_name);
-        app_node.put("UUID", app.uuid);
-        app_node.put("IDX", app.idx);
-        app_node.put("ID", app.id);
-
-        apps.push_back(std::make_pair("App", std::move(app_node)));
-      }
+      key.enable_legacy_ordering = config::sunshine.legacy_ordering && named_cert_p->enable_legacy_ordering;
+      key.current_appid = proc::proc.running();
+      key.hdr_supported = video::active_hevc_mode == 3;
     } else {
       BOOST_LOG(debug) << "Permission ListApp denied for [" << named_cert_p->name << "] (" << (uint32_t)named_cert_p->perm << ")";
-
-      pt::ptree app_node;
-
-      app_node.put("IsHdrSupported"s, 0);
-      app_node.put("AppTitle"s, "Permission Denied");
-      app_node.put("UUID", "");
-      app_node.put("IDX", "0");
-      app_node.put("ID", "114514");
-
-      apps.push_back(std::make_pair("App", std::move(app_node)));
-
-      return;
     }
 
+    auto data = get_applist(key);
+    response->write(*data);
+    response->close_connection_after_response = true;
   }
 
   void launch(bool &host_audio, resp_https_t response, req_https_t request) {
@@ -1281,7 +1388,8 @@ namespace nvhttp {
           launch_session->input_only = true;
         }
 
-        if (no_active_sessions && !proc::proc.virtual_display) {
+        // Within the resume grace period the display is still set up for the last session
+        if (no_active_sessions && !stream::session::claim_warm(*launch_session) && !proc::proc.virtual_display) {
           display_device::configure_display(config::video, *launch_session);
           if (video::probe_encoders()) {
             tree.put("root.resume", 0);
@@ -1398,9 +1506,10 @@ namespace nvhttp {
       launch_session->input_only = true;
     }
 
-    if (no_active_sessions && !proc::proc.virtual_display) {
+    if (no_active_sessions && !stream::session::claim_warm(*launch_session) && !proc::proc.virtual_display) {
       // We want to prepare display only if there are no active sessions
       // and the current session isn't virtual display at the moment.
+      // Within the resume grace period the display is still set up for the last session.
       // This should be done before probing encoders as it could change the active displays.
       display_device::configure_display(config::video, *launch_session);
 
@@ -1496,13 +1605,28 @@ namespace nvhttp {
 
     auto args = request->parse_query_string();
     auto app_image = proc::proc.get_app_image(util::from_view(get_arg(args, "appid")));
+    auto cover = cover_cache::covers().get(app_image);
 
     fg.disable();
 
-    std::ifstream in(app_image, std::ios::binary);
+    if (!cover) {
+      response->write(SimpleWeb::StatusCode::client_error_not_found);
+      response->close_connection_after_response = true;
+      return;
+    }
+
     SimpleWeb::CaseInsensitiveMultimap headers;
-    headers.emplace("Content-Type", "image/png");
-    response->write(SimpleWeb::StatusCode::success_ok, in, headers);
+    headers.emplace("Content-Type", cover->content_type);
+    // Covers can change at any time, clients revalidate their copy with the tag
+    headers.emplace("Cache-Control", "private, no-cache");
+    headers.emplace("ETag", cover->etag);
+
+    auto if_none_match = request->header.find("If-None-Match");
+    if (if_none_match != std::end(request->header) && asset_cache::etag_matches(if_none_match->second, cover->etag)) {
+      response->write(SimpleWeb::StatusCode::redirection_not_modified, headers);
+    } else {
+      response->write(SimpleWeb::StatusCode::success_ok, cover->content, headers);
+    }
     response->close_connection_after_response = true;
   }
 
@@ -1663,7 +1787,8 @@ namespace nvhttp {
         X509_NAME_oneline(X509_get_subject_name(x509.get()), subject_name, sizeof(subject_name));
 
         if (verified) {
-          BOOST_LOG(debug) << subject_name << " -- "sv << "verified, device name: "sv << named_cert_p->name;
+          BOOST_LOG(debug) << subject_name << " -- "sv << "verified, device name: "sv << named_cert_p->name
+                           << (SSL_session_reused(ssl) ? ", resumed TLS session"sv : ""sv);
         } else {
           BOOST_LOG(debug) << subject_name << " -- "sv << "denied"sv;
         }
@@ -1751,6 +1876,8 @@ namespace nvhttp {
 
     ssl.join();
     tcp.join();
+
+    state_writer.flush();
   }
 
   std::string request_otp(const std::string& passphrase, const std::string& deviceName) {
@@ -8,7 +8,9 @@
 // standard includes
 #include <string>
 #include <chrono>
+#include <cstdint>
 #include <list>
+#include <memory>
 
 // lib includes
 #include <boost/property_tree/ptree.hpp>
@@ -72,6 +74,61 @@ namespace nvhttp {
   std::shared_ptr<rtsp_stream::launch_session_t>
   make_launch_session(bool host_audio, bool input_only, const args_t &args, const crypto::named_cert_t* named_cert_p);
 
+  /**
+   * @brief A pre-rendered XML response body, shared between all requests it's served to.
+   */
+  using response_buffer_t = std::shared_ptr<const std::string>;
+
+  /**
+   * @brief Everything a `/serverinfo` response depends on besides the cache generation.
+   */
+  struct serverinfo_key_t {
+    bool https = false;
+    int pair_status = 0;
+    crypto::PERM perm = crypto::PERM::_no;
+    std::string local_address;  ///< Normalized address of the local endpoint the request arrived on
+    std::uint32_t codec_mode_flags = 0;
+    int current_appid = 0;  ///< Running app as reported to the client
+    bool vdisplay_ready = false;
+
+    auto operator<=>(const serverinfo_key_t &) const = default;
+  };
+
+  /**
+   * @brief Everything an `/applist` response depends on besides the cache generation.
+   */
+  struct applist_key_t {
+    crypto::PERM perm = crypto::PERM::_no;
+    bool enable_legacy_ordering = false;
+    int current_appid = 0;  ///< Running app as returned by `proc::proc.running()`
+    bool hdr_supported = false;
+
+    auto operator<=>(const applist_key_t &) const = default;
+  };
+
+  /**
+   * @brief Get the `/serverinfo` response for a key, rendering it on a cache miss.
+   * @param key The request inputs.
+   * @return The response body.
+   */
+  response_buffer_t get_serverinfo(const serverinfo_key_t &key);
+
+  /**
+   * @brief Get the `/applist` response for a key, rendering it on a cache miss.
+   * @param key The request inputs.
+   * @return The response body.
+   */
+  response_buffer_t get_applist(const applist_key_t &key);
+
+  /**
+   * @brief Drop all cached `/serverinfo` and `/applist` responses.
+   * @details Must be called whenever the app list, the configuration or the running app changes.
+   * @examples
+   * nvhttp::invalidate_response_cache();
+   * @examples_end
+   */
+  void invalidate_response_cache();
+
   /**
    * @brief Setup the nvhttp server.
    * @param pkey
@@ -9,7 +9,9 @@
 #include <filesystem>
 #include <functional>
 #include <mutex>
+#include <optional>
 #include <string>
+#include <vector>
 
 // lib includes
 #include <boost/core/noncopyable.hpp>
@@ -290,6 +292,8 @@ namespace platf {
     std::int16_t lsY;
     std::int16_t rsX;
     std::int16_t rsY;
+
+    bool operator==(const gamepad_state_t &) const = default;
   };
 
   struct gamepad_id_t {
@@ -604,6 +608,12 @@ namespace platf {
    */
   bool needs_encoder_reenumeration();
 
+  /**
+   * @brief Describe the installed GPUs and their drivers.
+   * @return A string that changes whenever GPUs or drivers change, or an empty string if unknown.
+   */
+  std::string gpu_fingerprint();
+
   boost::process::v1::child run_command(bool elevated, bool interactive, const std::string &cmd, boost::filesystem::path &working_dir, const boost::process::v1::environment &env, FILE *file, std::error_code &ec, boost::process::v1::group *group);
 
   enum class thread_priority_e : int {
@@ -612,7 +622,27 @@ namespace platf {
     high,  ///< High priority
     critical  ///< Critical priority
   };
-  void adjust_thread_priority(thread_priority_e priority);
+
+  /**
+   * @brief Change the scheduling of the calling thread.
+   * @param priority The priority of the thread.
+   * @return The scheduling in effect afterwards, for diagnostics.
+   */
+  std::string adjust_thread_priority(thread_priority_e priority);
+
+  /**
+   * @brief Restrict the calling thread to a set of CPUs.
+   * @param cpus The CPUs the thread may run on.
+   * @return `true` if the thread was restricted to them.
+   */
+  bool set_thread_affinity(const std::vector<int> &cpus);
+
+  /**
+   * @brief Prefer the NUMA node of a set of CPUs for the memory allocated by the calling thread.
+   * @param cpus The CPUs the thread runs on.
+   * @return The NUMA node, or `std::nullopt` if the CPUs span several nodes or NUMA isn't available.
+   */
+  std::optional<int> prefer_local_memory(const std::vector<int> &cpus);
 
   // Allow OS-specific actions to be taken to prepare for streaming
   void streaming_will_start();
@@ -710,6 +740,25 @@ namespace platf {
 
   bool send(send_info_t &send_info);
 
+  struct recv_info_t {
+    // Receives a single datagram
+    char *buffer;
+    size_t buffer_size;
+
+    // Filled in for every datagram received
+    size_t size;
+    boost::asio::ip::address source_address;
+    uint16_t source_port;
+  };
+
+  /**
+   * @brief Receive the datagrams waiting on a non-blocking socket with a single call, one per element of the batch.
+   * @param native_socket The native socket handle.
+   * @param batch The buffers to receive into, the received datagrams fill them from the front.
+   * @return The number of datagrams received, 0 if none were waiting, or -1 if batched receives aren't supported.
+   */
+  int recv_batch(std::uintptr_t native_socket, std::vector<recv_info_t> &batch);
+
   enum class qos_data_type_e : int {
     audio,  ///< Audio
     video  ///< Video
@@ -859,6 +908,17 @@ namespace platf {
      */
     virtual void sleep_for(const std::chrono::nanoseconds &duration) = 0;
 
+    /**
+     * @brief Sleep until the deadline, returns right away if it already passed
+     * @param deadline Time to wake up at
+     */
+    virtual void sleep_until(const std::chrono::steady_clock::time_point &deadline) {
+      auto now = std::chrono::steady_clock::now();
+      if (deadline > now) {
+        sleep_for(deadline - now);
+      }
+    }
+
     /**
      * @brief Check if platform-specific timer backend has been initialized successfully
      * @return `true` on success, `false` on error
@@ -779,12 +779,13 @@ namespace cuda {
           handle.reset();
         });
 
+        auto timer = platf::create_high_precision_timer();
         sleep_overshoot_logger.reset();
 
         while (true) {
           auto now = std::chrono::steady_clock::now();
           if (next_frame > now) {
-            std::this_thread::sleep_for(next_frame - now);
+            timer->sleep_until(next_frame);
             sleep_overshoot_logger.first_point(next_frame);
             sleep_overshoot_logger.second_point_now_and_log();
           }
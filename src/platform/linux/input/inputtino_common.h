@@ -4,6 +4,11 @@
  */
 #pragma once
 
+// standard includes
+#include <chrono>
+#include <memory>
+#include <mutex>
+
 // lib includes
 #include <boost/locale.hpp>
 #include <inputtino/input.hpp>
@@ -25,6 +30,31 @@ namespace platf {
     std::unique_ptr<joypads_t> joypad;
     gamepad_feedback_msg_t last_rumble;
     gamepad_feedback_msg_t last_rgb_led;
+
+    /// The state last written to the device, so only the buttons and axes that changed are written
+    gamepad_state_t last_state {};
+  };
+
+  struct input_raw_t;
+
+  /**
+   * @brief Relative motion and scrolling not yet passed to the virtual mouse.
+   * @details Shared with the delayed flush on the task pool, which must not outlive the devices.
+   */
+  struct mouse_coalesce_t {
+    std::mutex mutex;
+
+    /// The devices to flush to, cleared when they are destroyed
+    input_raw_t *raw;
+
+    int delta_x = 0;
+    int delta_y = 0;
+    int scroll = 0;
+    int hscroll = 0;
+
+    /// Until then motion and scrolling are accumulated, afterwards the next event passes through right away
+    std::chrono::steady_clock::time_point window_end;
+    bool flush_scheduled = false;
   };
 
   struct input_raw_t {
@@ -41,7 +71,10 @@ namespace platf {
           .product_id = 0xDEAD,
           .version = 0x111,
         })),
-        gamepads(MAX_GAMEPADS) {
+        gamepads(MAX_GAMEPADS),
+        mouse_coalesce(std::make_shared<mouse_coalesce_t>()) {
+      mouse_coalesce->raw = this;
+
       if (!mouse) {
         BOOST_LOG(warning) << "Unable to create virtual mouse: " << mouse.getErrorMessage();
       }
@@ -50,7 +83,10 @@ namespace platf {
       }
     }
 
-    ~input_raw_t() = default;
+    ~input_raw_t() {
+      std::lock_guard lg {mouse_coalesce->mutex};
+      mouse_coalesce->raw = nullptr;
+    }
 
     // All devices are wrapped in Result because it might be that we aren't able to create them (ex: udev permission denied)
     inputtino::Result<inputtino::Mouse> mouse;
@@ -61,6 +97,8 @@ namespace platf {
      * The pointer is shared because that state will be shared with background threads that deal with rumble and LED
      */
     std::vector<std::shared_ptr<joypad_state>> gamepads;
+
+    std::shared_ptr<mouse_coalesce_t> mouse_coalesce;
   };
 
   struct client_input_raw_t: public client_input_t {
@@ -184,13 +184,24 @@ namespace platf::gamepad {
       return;
     }
 
-    std::visit([gamepad_state](inputtino::Joypad &gc) {
-      gc.set_pressed_buttons(gamepad_state.buttonFlags);
-      gc.set_stick(inputtino::Joypad::LS, gamepad_state.lsX, gamepad_state.lsY);
-      gc.set_stick(inputtino::Joypad::RS, gamepad_state.rsX, gamepad_state.rsY);
-      gc.set_triggers(gamepad_state.lt, gamepad_state.rt);
+    // Every call writes its own report, so skip those that wouldn't change anything
+    auto &last = gamepad->last_state;
+    std::visit([&gamepad_state, &last](inputtino::Joypad &gc) {
+      if (gamepad_state.buttonFlags != last.buttonFlags) {
+        gc.set_pressed_buttons(gamepad_state.buttonFlags);
+      }
+      if (gamepad_state.lsX != last.lsX || gamepad_state.lsY != last.lsY) {
+        gc.set_stick(inputtino::Joypad::LS, gamepad_state.lsX, gamepad_state.lsY);
+      }
+      if (gamepad_state.rsX != last.rsX || gamepad_state.rsY != last.rsY) {
+        gc.set_stick(inputtino::Joypad::RS, gamepad_state.rsX, gamepad_state.rsY);
+      }
+      if (gamepad_state.lt != last.lt || gamepad_state.rt != last.rt) {
+        gc.set_triggers(gamepad_state.lt, gamepad_state.rt);
+      }
     },
                *gamepad->joypad);
+    last = gamepad_state;
   }
 
   void touch(input_raw_t *raw, const gamepad_touch_t &touch) {
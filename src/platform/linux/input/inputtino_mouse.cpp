@@ -11,6 +11,7 @@
 #include "inputtino_common.h"
 #include "inputtino_mouse.h"
 #include "src/config.h"
+#include "src/globals.h"
 #include "src/logging.h"
 #include "src/platform/common.h"
 #include "src/utility.h"
@@ -19,14 +20,95 @@ using namespace std::literals;
 
 namespace platf::mouse {
 
+  namespace {
+    /**
+     * @brief Pass the accumulated motion and scrolling to the virtual mouse, one call for each of them.
+     * @note The caller must hold `coalesce.mutex`.
+     */
+    void flush_locked(mouse_coalesce_t &coalesce) {
+      auto raw = coalesce.raw;
+      if (!raw || !raw->mouse) {
+        coalesce.delta_x = coalesce.delta_y = coalesce.scroll = coalesce.hscroll = 0;
+        return;
+      }
+
+      if (coalesce.delta_x || coalesce.delta_y) {
+        (*raw->mouse).move(coalesce.delta_x, coalesce.delta_y);
+        coalesce.delta_x = coalesce.delta_y = 0;
+      }
+      if (coalesce.scroll) {
+        (*raw->mouse).vertical_scroll(coalesce.scroll);
+        coalesce.scroll = 0;
+      }
+      if (coalesce.hscroll) {
+        (*raw->mouse).horizontal_scroll(coalesce.hscroll);
+        coalesce.hscroll = 0;
+      }
+    }
+
+    void delayed_flush(const std::weak_ptr<mouse_coalesce_t> &weak_coalesce) {
+      auto coalesce = weak_coalesce.lock();
+      if (!coalesce) {
+        return;
+      }
+
+      std::lock_guard lg {coalesce->mutex};
+      coalesce->flush_scheduled = false;
+      flush_locked(*coalesce);
+
+      // Whatever arrives next starts a new window
+      coalesce->window_end = std::chrono::steady_clock::now() + config::input.mouse_coalesce_window;
+    }
+
+    /**
+     * @brief Accumulate relative motion or scrolling.
+     * @details The first event after a quiet window passes through right away, so a single
+     * movement is not delayed. Events following it within the window are summed up and passed
+     * through together once it ends.
+     * @param accumulate Adds the event to the pending state.
+     */
+    template<class F>
+    void coalesce(input_raw_t *raw, F &&accumulate) {
+      auto &coalesce = *raw->mouse_coalesce;
+      auto window = config::input.mouse_coalesce_window;
+      auto now = std::chrono::steady_clock::now();
+
+      std::lock_guard lg {coalesce.mutex};
+      accumulate(coalesce);
+
+      if (window.count() <= 0 || now >= coalesce.window_end) {
+        flush_locked(coalesce);
+        coalesce.window_end = now + window;
+        return;
+      }
+
+      if (!coalesce.flush_scheduled) {
+        coalesce.flush_scheduled = true;
+        task_pool.pushDelayed(&delayed_flush, coalesce.window_end - now, std::weak_ptr {raw->mouse_coalesce});
+      }
+    }
+
+    /**
+     * @brief Pass pending motion through before an event that depends on the cursor position.
+     */
+    void flush(input_raw_t *raw) {
+      std::lock_guard lg {raw->mouse_coalesce->mutex};
+      flush_locked(*raw->mouse_coalesce);
+    }
+  }  // namespace
+
   void move(input_raw_t *raw, int deltaX, int deltaY) {
     if (raw->mouse) {
-      (*raw->mouse).move(deltaX, deltaY);
+      coalesce(raw, [&](mouse_coalesce_t &coalesce) {
+        coalesce.delta_x += deltaX;
+        coalesce.delta_y += deltaY;
+      });
     }
   }
 
   void move_abs(input_raw_t *raw, const touch_port_t &touch_port, float x, float y) {
     if (raw->mouse) {
+      flush(raw);
       (*raw->mouse).move_abs(x, y, touch_port.width, touch_port.height);
     }
   }
@@ -54,6 +136,9 @@ namespace platf::mouse {
           BOOST_LOG(warning) << "Unknown mouse button: " << button;
           return;
       }
+
+      // The click must land where the cursor is on the client
+      flush(raw);
       if (release) {
         (*raw->mouse).release(btn_type);
       } else {
@@ -64,13 +149,17 @@ namespace platf::mouse {
 
   void scroll(input_raw_t *raw, int high_res_distance) {
     if (raw->mouse) {
-      (*raw->mouse).vertical_scroll(high_res_distance);
+      coalesce(raw, [&](mouse_coalesce_t &coalesce) {
+        coalesce.scroll += high_res_distance;
+      });
     }
   }
 
   void hscroll(input_raw_t *raw, int high_res_distance) {
     if (raw->mouse) {
-      (*raw->mouse).horizontal_scroll(high_res_distance);
+      coalesce(raw, [&](mouse_coalesce_t &coalesce) {
+        coalesce.hscroll += high_res_distance;
+      });
     }
   }
 
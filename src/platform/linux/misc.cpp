@@ -9,6 +9,8 @@
 #endif
 
 // standard includes
+#include <atomic>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 
@@ -16,8 +18,16 @@
 #include <arpa/inet.h>
 #include <dlfcn.h>
 #include <ifaddrs.h>
+#include <linux/mempolicy.h>
 #include <netinet/udp.h>
+#include <pthread.h>
 #include <pwd.h>
+#include <sched.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include <sys/utsname.h>
 
 // lib includes
 #include <boost/asio/ip/address.hpp>
@@ -359,8 +369,124 @@ std::string get_local_ip_for_gateway() {
     }
   }
 
-  void adjust_thread_priority(thread_priority_e priority) {
-    // Unimplemented
+  namespace {
+    /**
+     * @brief Every thread fails the same way to get its priority, only the first failure is worth a warning.
+     */
+    logging::logger_t &priority_failure_log(std::atomic_bool &logged) {
+      return logged.exchange(true) ? debug : warning;
+    }
+  }  // namespace
+
+  std::string adjust_thread_priority(thread_priority_e priority) {
+    static std::atomic_bool fifo_failure_logged;
+    static std::atomic_bool nice_failure_logged;
+
+    int nice_value;
+    int fifo_priority = 0;
+
+    switch (priority) {
+      case thread_priority_e::low:
+        nice_value = 5;
+        break;
+      case thread_priority_e::normal:
+        nice_value = 0;
+        break;
+      case thread_priority_e::high:
+        nice_value = -5;
+        fifo_priority = 1;
+        break;
+      case thread_priority_e::critical:
+        nice_value = -10;
+        fifo_priority = 2;
+        break;
+      default:
+        BOOST_LOG(error) << "Unknown thread priority: "sv << (int) priority;
+        return "SCHED_OTHER"s;
+    }
+
+    // Real-time scheduling requires CAP_SYS_NICE or an RLIMIT_RTPRIO of at least the priority
+    if (config::sunshine.realtime_threads && fifo_priority) {
+      sched_param param {};
+      param.sched_priority = fifo_priority;
+
+      auto status = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+      if (!status) {
+        return "SCHED_FIFO "s + std::to_string(fifo_priority);
+      }
+
+      // BOOST_LOG evaluates the logger more than once
+      auto &log = priority_failure_log(fifo_failure_logged);
+      BOOST_LOG(log) << "Unable to use SCHED_FIFO, falling back to a nice value: "sv << std::strerror(status);
+    }
+
+    // A negative nice value requires CAP_SYS_NICE or RLIMIT_NICE, it's only attempted by those who asked for real-time threads
+    if (!config::sunshine.realtime_threads) {
+      nice_value = std::max(nice_value, 0);
+    }
+
+    // The nice value of a thread is set through its thread ID
+    auto tid = (id_t) syscall(SYS_gettid);
+    if (setpriority(PRIO_PROCESS, tid, nice_value)) {
+      auto &log = priority_failure_log(nice_failure_logged);
+      BOOST_LOG(log) << "Unable to set the nice value of the thread to "sv << nice_value << ": "sv << std::strerror(errno);
+      errno = 0;
+      nice_value = getpriority(PRIO_PROCESS, tid);
+    }
+
+    return "SCHED_OTHER nice "s + std::to_string(nice_value);
+  }
+
+  bool set_thread_affinity(const std::vector<int> &cpus) {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (auto cpu : cpus) {
+      if (cpu >= 0 && cpu < CPU_SETSIZE) {
+        CPU_SET(cpu, &cpu_set);
+      }
+    }
+
+    auto status = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+    if (status) {
+      BOOST_LOG(warning) << "Unable to set the CPU affinity of the thread: "sv << std::strerror(status);
+      return false;
+    }
+
+    return true;
+  }
+
+  std::optional<int> prefer_local_memory(const std::vector<int> &cpus) {
+    std::optional<int> node;
+    for (auto cpu : cpus) {
+      std::error_code ec;
+      std::optional<int> cpu_node;
+      for (auto &entry : fs::directory_iterator {"/sys/devices/system/cpu/cpu"s + std::to_string(cpu), ec}) {
+        auto name = entry.path().filename().string();
+        if (name.starts_with("node"sv)) {
+          cpu_node = util::from_view(std::string_view {name}.substr(4));
+          break;
+        }
+      }
+
+      // Without a node the kernel was built without NUMA support
+      if (!cpu_node || (node && *node != *cpu_node)) {
+        return std::nullopt;
+      }
+      node = cpu_node;
+    }
+
+    if (!node || *node >= sizeof(unsigned long) * 8) {
+      return std::nullopt;
+    }
+
+    // Pages are still taken from other nodes when this one runs out
+    unsigned long nodemask = 1UL << *node;
+    if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, &nodemask, sizeof(nodemask) * 8)) {
+      BOOST_LOG(warning) << "Unable to prefer memory of NUMA node "sv << *node << ": "sv << std::strerror(errno);
+      return std::nullopt;
+    }
+
+    return node;
   }
 
   void streaming_will_start() {
@@ -653,6 +779,60 @@ std::string get_local_ip_for_gateway() {
     }
   }
 
+  int recv_batch(std::uintptr_t native_socket, std::vector<recv_info_t> &batch) {
+    auto sockfd = (int) native_socket;
+
+    struct mmsghdr msgs[batch.size()];
+    struct iovec iovs[batch.size()];
+    struct sockaddr_storage addrs[batch.size()];
+    for (size_t i = 0; i < batch.size(); i++) {
+      iovs[i].iov_base = batch[i].buffer;
+      iovs[i].iov_len = batch[i].buffer_size;
+
+      msgs[i] = {};
+      msgs[i].msg_hdr.msg_name = &addrs[i];
+      msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+      msgs[i].msg_hdr.msg_iov = &iovs[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    int msgs_received;
+    do {
+      // A pending ICMP error of an earlier send is reported instead of the datagrams, they're still waiting afterwards
+      msgs_received = recvmmsg(sockfd, msgs, batch.size(), MSG_DONTWAIT, nullptr);
+    } while (msgs_received < 0 && (errno == ECONNREFUSED || errno == EINTR));
+
+    if (msgs_received < 0) {
+      if (errno == ENOSYS) {
+        return -1;
+      }
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        BOOST_LOG(warning) << "recvmmsg() failed: "sv << errno;
+      }
+      return 0;
+    }
+
+    for (int i = 0; i < msgs_received; i++) {
+      batch[i].size = msgs[i].msg_len;
+
+      if (addrs[i].ss_family == AF_INET6) {
+        auto addr_v6 = (struct sockaddr_in6 *) &addrs[i];
+
+        boost::asio::ip::address_v6::bytes_type bytes;
+        memcpy(bytes.data(), &addr_v6->sin6_addr, bytes.size());
+        batch[i].source_address = boost::asio::ip::address_v6 {bytes, addr_v6->sin6_scope_id};
+        batch[i].source_port = ntohs(addr_v6->sin6_port);
+      } else {
+        auto addr_v4 = (struct sockaddr_in *) &addrs[i];
+
+        batch[i].source_address = boost::asio::ip::address_v4 {ntohl(addr_v4->sin_addr.s_addr)};
+        batch[i].source_port = ntohs(addr_v4->sin_port);
+      }
+    }
+
+    return msgs_received;
+  }
+
   bool send(send_info_t &send_info) {
     auto sockfd = (int) send_info.native_socket;
     struct msghdr msg = {};
@@ -876,6 +1056,7 @@ std::string get_local_ip_for_gateway() {
 #ifdef SUNSHINE_BUILD_X11
       X11,  ///< X11
 #endif
+      REPLAY,  ///< Recorded clip
       MAX_FLAGS  ///< The maximum number of flags
     };
   }  // namespace source
@@ -918,7 +1099,13 @@ std::string get_local_ip_for_gateway() {
   }
 #endif
 
+  std::vector<std::string> replay_display_names();
+  std::shared_ptr<display_t> replay_display(mem_type_e hwdevice_type, const std::string &display_name, const video::config_t &config);
+
   std::vector<std::string> display_names(mem_type_e hwdevice_type) {
+    if (sources[source::REPLAY]) {
+      return replay_display_names();
+    }
 #ifdef SUNSHINE_BUILD_CUDA
     // display using NvFBC only supports mem_type_e::cuda
     if (sources[source::NVFBC] && hwdevice_type == mem_type_e::cuda) {
@@ -952,7 +1139,62 @@ std::string get_local_ip_for_gateway() {
     return true;
   }
 
+  std::string gpu_fingerprint() {
+    auto read_line = [](const fs::path &path) {
+      std::ifstream in {path};
+      std::string line;
+      std::getline(in, line);
+      return line;
+    };
+
+    std::error_code ec;
+    std::vector<fs::path> cards;
+    for (auto &entry : fs::directory_iterator {"/sys/class/drm", ec}) {
+      auto name = entry.path().filename().string();
+
+      // Skip connectors such as card0-DP-1 and render nodes
+      if (name.rfind("card", 0) == 0 && name.find('-') == std::string::npos) {
+        cards.emplace_back(entry.path());
+      }
+    }
+    std::sort(std::begin(cards), std::end(cards));
+
+    std::stringstream ss;
+    for (auto &card : cards) {
+      auto device = card / "device";
+      ss << card.filename().string() << ':'
+         << read_line(device / "vendor") << ':'
+         << read_line(device / "device") << ':'
+         << read_line(device / "revision");
+
+      auto driver = fs::read_symlink(device / "driver", ec);
+      if (!ec) {
+        auto driver_name = driver.filename().string();
+        ss << ':' << driver_name << ':' << read_line(fs::path {"/sys/module"} / driver_name / "version");
+      }
+      ss << ';';
+    }
+
+    if (cards.empty()) {
+      return {};
+    }
+
+    // In-tree drivers don't report a module version, so the kernel release stands in for it
+    utsname uts;
+    if (!uname(&uts)) {
+      ss << uts.release << ';';
+    }
+
+    ss << read_line("/proc/driver/nvidia/version");
+
+    return ss.str();
+  }
+
   std::shared_ptr<display_t> display(mem_type_e hwdevice_type, const std::string &display_name, const video::config_t &config) {
+    if (sources[source::REPLAY]) {
+      BOOST_LOG(info) << "Replaying recorded clip instead of screencasting"sv;
+      return replay_display(hwdevice_type, display_name, config);
+    }
 #ifdef SUNSHINE_BUILD_CUDA
     if (sources[source::NVFBC] && hwdevice_type == mem_type_e::cuda) {
       BOOST_LOG(info) << "Screencasting with NvFBC"sv;
@@ -1005,6 +1247,17 @@ std::string get_local_ip_for_gateway() {
     }
 #endif
 
+    // Replay is never picked automatically, since it doesn't show what's on screen.
+    // Reset it explicitly, since init() may run again after the capture method changed.
+    sources[source::REPLAY] = false;
+    if (config::video.capture == "replay") {
+      if (!replay_display_names().empty()) {
+        sources[source::REPLAY] = true;
+      } else {
+        BOOST_LOG(error) << "Replay capture requires replay_file to be set"sv;
+      }
+    }
+
 #ifdef SUNSHINE_BUILD_CUDA
     if ((config::video.capture.empty() && sources.none()) || config::video.capture == "nvfbc") {
       if (verify_nvfbc()) {
@@ -1048,15 +1301,64 @@ std::string get_local_ip_for_gateway() {
     return std::make_unique<deinit_t>();
   }
 
+  /**
+   * @brief Sleeps on a timerfd armed with an absolute deadline, so the time spent between
+   * computing the deadline and going to sleep isn't added on top of it.
+   * @details The last `pacing_spin_tail` of every sleep is spent spinning, for when the
+   * scheduler wakes the thread up too late.
+   */
   class linux_high_precision_timer: public high_precision_timer {
   public:
+    linux_high_precision_timer() {
+      fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+      if (fd < 0) {
+        BOOST_LOG(warning) << "Unable to create high_precision_timer, falling back to sleep_until(): timerfd_create() failed: "sv << strerror(errno);
+        return;
+      }
+
+      // The default slack of 50us delays every wake-up of the calling thread, which is the one sleeping
+      prctl(PR_SET_TIMERSLACK, 1UL);
+    }
+
+    ~linux_high_precision_timer() {
+      if (fd >= 0) {
+        close(fd);
+      }
+    }
+
     void sleep_for(const std::chrono::nanoseconds &duration) override {
-      std::this_thread::sleep_for(duration);
+      sleep_until(std::chrono::steady_clock::now() + duration);
+    }
+
+    void sleep_until(const std::chrono::steady_clock::time_point &deadline) override {
+      auto wake_up = deadline - config::stream.pacing_spin_tail;
+
+      if (wake_up > std::chrono::steady_clock::now()) {
+        // std::chrono::steady_clock is CLOCK_MONOTONIC on Linux
+        auto since_epoch = std::chrono::duration_cast<std::chrono::nanoseconds>(wake_up.time_since_epoch());
+
+        itimerspec spec {};
+        spec.it_value.tv_sec = since_epoch.count() / 1000000000;
+        spec.it_value.tv_nsec = since_epoch.count() % 1000000000;
+
+        std::uint64_t expirations;
+        if (fd >= 0 && timerfd_settime(fd, TFD_TIMER_ABSTIME, &spec, nullptr) == 0) {
+          while (read(fd, &expirations, sizeof(expirations)) < 0 && errno == EINTR) {}
+        } else {
+          std::this_thread::sleep_until(wake_up);
+        }
+      }
+
+      while (std::chrono::steady_clock::now() < deadline) {}
     }
 
+    // Without a timerfd, sleeping falls back to std::this_thread::sleep_until()
     operator bool() override {
       return true;
     }
+
+  private:
+    int fd = -1;
   };
 
   std::unique_ptr<high_precision_timer> create_high_precision_timer() {
@@ -0,0 +1,251 @@
+/**
+ * @file src/platform/linux/replaygrab.cpp
+ * @brief Definitions for replaying a recorded raw clip as a capture source.
+ */
+// standard includes
+#include <cerrno>
+#include <cstring>
+#include <thread>
+
+// platform includes
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// local includes
+#include "cuda.h"
+#include "src/config.h"
+#include "src/logging.h"
+#include "src/platform/common.h"
+#include "src/video.h"
+#include "vaapi.h"
+
+using namespace std::literals;
+
+namespace platf {
+  namespace replay {
+    // The clip is stored as tightly packed BGRX frames, which is what the RAM encode devices consume
+    constexpr auto pixel_pitch = 4;
+
+    /**
+     * @brief Read-only mapping of a clip file.
+     */
+    class clip_t {
+    public:
+      clip_t() = default;
+      clip_t(const clip_t &) = delete;
+      clip_t &operator=(const clip_t &) = delete;
+
+      ~clip_t() {
+        if (data) {
+          munmap(data, size);
+        }
+      }
+
+      int init(const std::string &path, int width, int height) {
+        if (width <= 0 || height <= 0) {
+          BOOST_LOG(error) << "Replay: replay_width and replay_height must be set"sv;
+          return -1;
+        }
+
+        frame_size = (std::size_t) width * height * pixel_pitch;
+
+        auto fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+          BOOST_LOG(error) << "Replay: couldn't open ["sv << path << "]: "sv << strerror(errno);
+          return -1;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st)) {
+          BOOST_LOG(error) << "Replay: couldn't stat ["sv << path << "]: "sv << strerror(errno);
+          close(fd);
+          return -1;
+        }
+
+        size = st.st_size;
+        frame_count = size / frame_size;
+        if (frame_count == 0) {
+          BOOST_LOG(error) << "Replay: ["sv << path << "] is smaller than a single "sv << width << 'x' << height << " frame"sv;
+          close(fd);
+          return -1;
+        }
+
+        if (size % frame_size) {
+          BOOST_LOG(warning) << "Replay: ignoring "sv << size % frame_size << " trailing bytes in ["sv << path << ']';
+        }
+
+        // Fault the whole clip in up front so disk I/O doesn't show up in the capture timings
+        auto mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+        close(fd);
+
+        if (mapping == MAP_FAILED) {
+          BOOST_LOG(error) << "Replay: couldn't map ["sv << path << "]: "sv << strerror(errno);
+          return -1;
+        }
+
+        data = (std::uint8_t *) mapping;
+
+        return 0;
+      }
+
+      std::uint8_t *frame(std::size_t index) const {
+        return data + (index % frame_count) * frame_size;
+      }
+
+      std::uint8_t *data = nullptr;
+      std::size_t size = 0;
+      std::size_t frame_size = 0;
+      std::size_t frame_count = 0;
+    };
+
+    /**
+     * @brief Image pointing directly into the mapped clip.
+     * The image keeps the mapping alive, so it may outlive the display.
+     */
+    struct img_t: public platf::img_t {
+      std::shared_ptr<clip_t> clip;
+    };
+
+    class display_t: public platf::display_t {
+    public:
+      display_t(mem_type_e mem_type):
+          mem_type {mem_type} {
+      }
+
+      int init(const ::video::config_t &config) {
+        auto &replay = config::video.replay;
+
+        clip = std::make_shared<clip_t>();
+        if (clip->init(replay.file, replay.width, replay.height)) {
+          return -1;
+        }
+
+        width = env_width = replay.width;
+        height = env_height = replay.height;
+
+        fast = replay.fast;
+        auto framerate = replay.framerate > 0 ? replay.framerate : config.framerate;
+        delay = std::chrono::nanoseconds {1s} / std::max(framerate, 1);
+
+        BOOST_LOG(info) << "Replaying "sv << clip->frame_count << " frames of ["sv << replay.file << "] at "sv
+                        << width << 'x' << height << (fast ? " as fast as possible"s : " @ "s + std::to_string(framerate) + " fps"s);
+
+        return 0;
+      }
+
+      capture_e capture(const push_captured_image_cb_t &push_captured_image_cb, const pull_free_image_cb_t &pull_free_image_cb, bool *cursor) override {
+        auto next_frame = std::chrono::steady_clock::now();
+
+        auto timer = platf::create_high_precision_timer();
+        sleep_overshoot_logger.reset();
+
+        while (true) {
+          if (!fast) {
+            auto now = std::chrono::steady_clock::now();
+
+            if (next_frame > now) {
+              timer->sleep_until(next_frame);
+              sleep_overshoot_logger.first_point(next_frame);
+              sleep_overshoot_logger.second_point_now_and_log();
+            }
+
+            next_frame += delay;
+            if (next_frame < now) {  // some major slowdown happened; we couldn't keep up
+              next_frame = now + delay;
+            }
+          }
+
+          std::shared_ptr<platf::img_t> img_out;
+          if (!pull_free_image_cb(img_out)) {
+            return capture_e::interrupted;
+          }
+
+          fill_img(*img_out, frame_index++);
+
+          if (!push_captured_image_cb(std::move(img_out), true)) {
+            return capture_e::ok;
+          }
+        }
+
+        return capture_e::ok;
+      }
+
+      std::shared_ptr<platf::img_t> alloc_img() override {
+        auto img = std::make_shared<replay::img_t>();
+        img->clip = clip;
+        img->width = width;
+        img->height = height;
+        img->pixel_pitch = pixel_pitch;
+        img->row_pitch = width * pixel_pitch;
+
+        return img;
+      }
+
+      int dummy_img(platf::img_t *img) override {
+        if (!img) {
+          return -1;
+        }
+
+        fill_img(*img, 0);
+        return 0;
+      }
+
+      std::unique_ptr<avcodec_encode_device_t> make_avcodec_encode_device(pix_fmt_e pix_fmt) override {
+#ifdef SUNSHINE_BUILD_VAAPI
+        if (mem_type == mem_type_e::vaapi) {
+          return va::make_avcodec_encode_device(width, height, false);
+        }
+#endif
+
+#ifdef SUNSHINE_BUILD_CUDA
+        if (mem_type == mem_type_e::cuda) {
+          return cuda::make_avcodec_encode_device(width, height, false);
+        }
+#endif
+
+        return std::make_unique<avcodec_encode_device_t>();
+      }
+
+    private:
+      void fill_img(platf::img_t &img, std::size_t index) {
+        // Images are only ever read by the encode device, so they can alias the read-only mapping
+        img.data = clip->frame(index);
+        img.width = width;
+        img.height = height;
+        img.pixel_pitch = pixel_pitch;
+        img.row_pitch = width * pixel_pitch;
+        img.frame_timestamp = std::chrono::steady_clock::now();
+      }
+
+      mem_type_e mem_type;
+      std::shared_ptr<clip_t> clip;
+      std::chrono::nanoseconds delay;
+      std::size_t frame_index = 0;
+      bool fast = false;
+    };
+  }  // namespace replay
+
+  std::shared_ptr<display_t> replay_display(mem_type_e hwdevice_type, const std::string &display_name, const video::config_t &config) {
+    if (hwdevice_type != mem_type_e::system && hwdevice_type != mem_type_e::vaapi && hwdevice_type != mem_type_e::cuda) {
+      BOOST_LOG(error) << "Could not initialize replay display with the given hw device type"sv;
+      return nullptr;
+    }
+
+    auto disp = std::make_shared<replay::display_t>(hwdevice_type);
+    if (disp->init(config)) {
+      return nullptr;
+    }
+
+    return disp;
+  }
+
+  std::vector<std::string> replay_display_names() {
+    if (config::video.replay.file.empty()) {
+      return {};
+    }
+
+    return {"0"};
+  }
+}  // namespace platf
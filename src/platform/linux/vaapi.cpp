@@ -481,7 +481,7 @@ namespace va {
   } AVVAAPIDeviceContext;
 
   static void __log(void *level, const char *msg) {
-    BOOST_LOG(*(boost::log::sources::severity_logger<int> *) level) << msg;
+    BOOST_LOG(*(logging::logger_t *) level) << msg;
   }
 
   static void vaapi_hwdevice_ctx_free(AVHWDeviceContext *ctx) {
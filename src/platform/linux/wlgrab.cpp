@@ -127,13 +127,14 @@ namespace wl {
     platf::capture_e capture(const push_captured_image_cb_t &push_captured_image_cb, const pull_free_image_cb_t &pull_free_image_cb, bool *cursor) override {
       auto next_frame = std::chrono::steady_clock::now();
 
+      auto timer = platf::create_high_precision_timer();
       sleep_overshoot_logger.reset();
 
       while (true) {
         auto now = std::chrono::steady_clock::now();
 
         if (next_frame > now) {
-          std::this_thread::sleep_for(next_frame - now);
+          timer->sleep_until(next_frame);
           sleep_overshoot_logger.first_point(next_frame);
           sleep_overshoot_logger.second_point_now_and_log();
         }
@@ -257,13 +258,14 @@ namespace wl {
     platf::capture_e capture(const push_captured_image_cb_t &push_captured_image_cb, const pull_free_image_cb_t &pull_free_image_cb, bool *cursor) override {
       auto next_frame = std::chrono::steady_clock::now();
 
+      auto timer = platf::create_high_precision_timer();
       sleep_overshoot_logger.reset();
 
       while (true) {
         auto now = std::chrono::steady_clock::now();
 
         if (next_frame > now) {
-          std::this_thread::sleep_for(next_frame - now);
+          timer->sleep_until(next_frame);
           sleep_overshoot_logger.first_point(next_frame);
           sleep_overshoot_logger.second_point_now_and_log();
         }
@@ -2,6 +2,9 @@
  * @file src/platform/macos/display.mm
  * @brief Definitions for display capture on macOS.
  */
+// platform includes
+#include <sys/sysctl.h>
+
 // local includes
 #include "src/config.h"
 #include "src/logging.h"
@@ -215,4 +218,15 @@ namespace platf {
     // We don't track GPU state, so we will always reenumerate. Fortunately, it is fast on macOS.
     return true;
   }
+
+  std::string gpu_fingerprint() {
+    // VideoToolbox ships with the OS, so the hardware model and OS build identify the encoder
+    char model[256] {};
+    size_t model_size = sizeof(model) - 1;
+    if (sysctlbyname("hw.model", model, &model_size, nullptr, 0)) {
+      return {};
+    }
+
+    return std::string {model} + ';' + [[[NSProcessInfo processInfo] operatingSystemVersionString] UTF8String];
+  }
 }  // namespace platf
@@ -215,8 +215,18 @@ namespace platf {
     }
   }
 
-  void adjust_thread_priority(thread_priority_e priority) {
+  std::string adjust_thread_priority(thread_priority_e priority) {
     // Unimplemented
+    return "SCHED_OTHER"s;
+  }
+
+  bool set_thread_affinity(const std::vector<int> &cpus) {
+    // macOS only supports affinity tags, which don't select CPUs
+    return false;
+  }
+
+  std::optional<int> prefer_local_memory(const std::vector<int> &cpus) {
+    return std::nullopt;
   }
 
   void streaming_will_start() {
@@ -306,6 +316,11 @@ namespace platf {
     return false;
   }
 
+  int recv_batch(std::uintptr_t native_socket, std::vector<recv_info_t> &batch) {
+    // Fall back to unbatched receive calls
+    return -1;
+  }
+
   bool send(send_info_t &send_info) {
     auto sockfd = (int) send_info.native_socket;
     struct msghdr msg = {};
@@ -1086,6 +1086,35 @@ namespace platf {
     return display_names;
   }
 
+  std::string gpu_fingerprint() {
+    dxgi::factory1_t factory;
+    auto status = CreateDXGIFactory1(IID_IDXGIFactory1, (void **) &factory);
+    if (FAILED(status)) {
+      BOOST_LOG(error) << "Failed to create DXGIFactory1 [0x"sv << util::hex(status).to_string_view() << ']';
+      return {};
+    }
+
+    std::stringstream ss;
+    dxgi::adapter_t adapter;
+    for (int x = 0; factory->EnumAdapters1(x, &adapter) != DXGI_ERROR_NOT_FOUND; ++x) {
+      DXGI_ADAPTER_DESC1 adapter_desc;
+      adapter->GetDesc1(&adapter_desc);
+
+      // The user mode driver version changes with every driver update
+      LARGE_INTEGER umd_version {};
+      adapter->CheckInterfaceSupport(__uuidof(IDXGIDevice), &umd_version);
+
+      ss << to_utf8(adapter_desc.Description) << ':'
+         << util::hex(adapter_desc.VendorId).to_string_view() << ':'
+         << util::hex(adapter_desc.DeviceId).to_string_view() << ':'
+         << util::hex(adapter_desc.SubSysId).to_string_view() << ':'
+         << adapter_desc.Revision << ':'
+         << umd_version.QuadPart << ';';
+    }
+
+    return ss.str();
+  }
+
   /**
    * @brief Returns if GPUs/drivers have changed since the last call to this function.
    * @return `true` if a change has occurred or if it is unknown whether a change occurred.
@@ -1078,31 +1078,62 @@ namespace platf {
     }
   }
 
-  void adjust_thread_priority(thread_priority_e priority) {
+  std::string adjust_thread_priority(thread_priority_e priority) {
     int win32_priority;
+    std::string name;
 
     switch (priority) {
       case thread_priority_e::low:
         win32_priority = THREAD_PRIORITY_BELOW_NORMAL;
+        name = "THREAD_PRIORITY_BELOW_NORMAL"s;
         break;
       case thread_priority_e::normal:
         win32_priority = THREAD_PRIORITY_NORMAL;
+        name = "THREAD_PRIORITY_NORMAL"s;
         break;
       case thread_priority_e::high:
         win32_priority = THREAD_PRIORITY_ABOVE_NORMAL;
+        name = "THREAD_PRIORITY_ABOVE_NORMAL"s;
         break;
       case thread_priority_e::critical:
         win32_priority = THREAD_PRIORITY_HIGHEST;
+        name = "THREAD_PRIORITY_HIGHEST"s;
         break;
       default:
         BOOST_LOG(error) << "Unknown thread priority: "sv << (int) priority;
-        return;
+        return "THREAD_PRIORITY_NORMAL"s;
     }
 
     if (!SetThreadPriority(GetCurrentThread(), win32_priority)) {
       auto winerr = GetLastError();
       BOOST_LOG(warning) << "Unable to set thread priority to "sv << win32_priority << ": "sv << winerr;
+      return "THREAD_PRIORITY_NORMAL"s;
+    }
+
+    return name;
+  }
+
+  bool set_thread_affinity(const std::vector<int> &cpus) {
+    // Without processor groups, a thread only runs on the first 64 logical processors
+    DWORD_PTR mask = 0;
+    for (auto cpu : cpus) {
+      if (cpu >= 0 && cpu < sizeof(mask) * 8) {
+        mask |= (DWORD_PTR) 1 << cpu;
+      }
+    }
+
+    if (!mask || !SetThreadAffinityMask(GetCurrentThread(), mask)) {
+      auto winerr = GetLastError();
+      BOOST_LOG(warning) << "Unable to set the CPU affinity of the thread: "sv << winerr;
+      return false;
     }
+
+    return true;
+  }
+
+  std::optional<int> prefer_local_memory(const std::vector<int> &cpus) {
+    // Windows already allocates from the node of the processor a thread runs on
+    return std::nullopt;
   }
 
   void streaming_will_start() {
@@ -1508,6 +1539,11 @@ namespace platf {
     return WSASendMsg((SOCKET) send_info.native_socket, &msg, 0, &bytes_sent, nullptr, nullptr) != SOCKET_ERROR;
   }
 
+  int recv_batch(std::uintptr_t native_socket, std::vector<recv_info_t> &batch) {
+    // Fall back to unbatched receive calls
+    return -1;
+  }
+
   bool send(send_info_t &send_info) {
     WSAMSG msg;
 
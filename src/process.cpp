@@ -8,9 +8,13 @@
  #define BOOST_PROCESS_VERSION 1
 #endif
 // standard includes
+#include <atomic>
 #include <filesystem>
+#include <future>
+#include <mutex>
 #include <string>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
 // lib includes
@@ -29,6 +33,7 @@
 #include "display_device.h"
 #include "file_handler.h"
 #include "logging.h"
+#include "nvhttp.h"
 #include "platform/common.h"
 #include "process.h"
 #include "httpcommon.h"
@@ -170,12 +175,17 @@ namespace proc {
     allow_client_commands = false;
     placebo = true;
 
+    nvhttp::invalidate_response_cache();
+
 #if defined SUNSHINE_TRAY && SUNSHINE_TRAY >= 1
     system_tray::update_tray_playing(_app_name);
 #endif
   }
 
   int proc_t::execute(const ctx_t& app, std::shared_ptr<rtsp_stream::launch_session_t> launch_session) {
+    // The running app is reported by /serverinfo and /applist, whether or not the launch succeeds
+    auto invalidate_guard = util::fail_guard(nvhttp::invalidate_response_cache);
+
     if (_app_id == input_only_app_id) {
       terminate(false, false);
       std::this_thread::sleep_for(1s);
@@ -809,6 +819,8 @@ namespace proc {
       _saved_input_config.reset();
     }
 
+    nvhttp::invalidate_response_cache();
+
     if (needs_refresh) {
       refresh(config::stream.file_apps, false);
     }
@@ -1003,6 +1015,53 @@ namespace proc {
     return ss.str();
   }
 
+  /**
+   * @brief The SHA-256 of an image file, along with the state of the file it was calculated from.
+   */
+  struct image_hash_t {
+    std::filesystem::file_time_type last_write_time;
+    std::uintmax_t file_size;
+    std::string hash;
+  };
+
+  /**
+   * @brief The images remembered, far more than an app list has, the hashes of removed images are dropped with the rest.
+   */
+  constexpr std::size_t MAX_IMAGE_HASHES = 1024;
+
+  std::mutex image_hashes_mutex;
+  std::unordered_map<std::string, image_hash_t> image_hashes;
+
+  std::optional<std::string> calculate_image_hash(const std::string &file_path) {
+    std::error_code ec;
+    auto last_write_time = std::filesystem::last_write_time(file_path, ec);
+    auto file_size = ec ? 0 : std::filesystem::file_size(file_path, ec);
+    if (ec) {
+      return std::nullopt;
+    }
+
+    auto key = std::filesystem::path(file_path).lexically_normal().string();
+    {
+      std::lock_guard lg {image_hashes_mutex};
+      auto it = image_hashes.find(key);
+      if (it != std::end(image_hashes) && it->second.last_write_time == last_write_time && it->second.file_size == file_size) {
+        return it->second.hash;
+      }
+    }
+
+    // Hash outside the lock, so images of other apps can be hashed meanwhile
+    auto hash = calculate_sha256(file_path);
+    if (hash) {
+      std::lock_guard lg {image_hashes_mutex};
+      if (image_hashes.size() >= MAX_IMAGE_HASHES && !image_hashes.contains(key)) {
+        image_hashes.clear();
+      }
+      image_hashes.insert_or_assign(std::move(key), image_hash_t {last_write_time, file_size, *hash});
+    }
+
+    return hash;
+  }
+
   uint32_t calculate_crc32(const std::string &input) {
     boost::crc_32_type result;
     result.process_bytes(input.data(), input.length());
@@ -1015,7 +1074,7 @@ namespace proc {
     to_hash.push_back(app_name);
     auto file_path = validate_app_image_path(app_image_path);
     if (file_path != DEFAULT_APP_IMAGE_PATH) {
-      auto file_hash = calculate_sha256(file_path);
+      auto file_hash = calculate_image_hash(file_path);
       if (file_hash) {
         to_hash.push_back(file_hash.value());
       } else {
@@ -1040,6 +1099,31 @@ namespace proc {
     return std::make_tuple(id_no_index, id_with_index);
   }
 
+  std::vector<std::tuple<std::string, std::string>> calculate_app_ids(const std::vector<proc::ctx_t> &apps) {
+    std::vector<std::tuple<std::string, std::string>> possible_ids(apps.size());
+
+    // Most of the time goes into reading and hashing the images, which is spread over a few threads
+    auto workers = std::min<std::size_t>({apps.size(), std::max(std::thread::hardware_concurrency(), 1u), 8});
+    std::atomic_size_t next = 0;
+    auto worker = [&]() {
+      for (auto x = next++; x < apps.size(); x = next++) {
+        possible_ids[x] = calculate_app_id(apps[x].name, apps[x].image_path, (int) x);
+      }
+    };
+
+    std::vector<std::future<void>> futures;
+    for (std::size_t x = 1; x < workers; ++x) {
+      futures.emplace_back(std::async(std::launch::async, worker));
+    }
+    worker();
+
+    for (auto &future : futures) {
+      future.get();
+    }
+
+    return possible_ids;
+  }
+
   /**
    * @brief Migrate the applications stored in the file tree by merging in a new app.
    *
@@ -1362,21 +1446,13 @@ namespace proc {
           ctx.terminate_on_pause = app_node.value("terminate-on-pause", false);
           ctx.gamepad = app_node.value("gamepad", "");
 
-          // Calculate a unique application id.
-          auto possible_ids = calculate_app_id(name, ctx.image_path, i++);
-          if (ids.count(std::get<0>(possible_ids)) == 0) {
-            ctx.id = std::get<0>(possible_ids);
-          } else {
-            ctx.id = std::get<1>(possible_ids);
-          }
-          ids.insert(ctx.id);
-
           ctx.name = std::move(name);
           ctx.prep_cmds = std::move(prep_cmds);
           ctx.state_cmds = std::move(state_cmds);
           ctx.detached = std::move(detached);
 
           apps.emplace_back(std::move(ctx));
+          ++i;
         }
 
         fail_count = 0;
@@ -1414,6 +1490,18 @@ namespace proc {
       break;
     } while (fail_count < 3);
 
+    // Calculate unique application ids, collisions are resolved in the order of the apps.
+    // The apps parsed before giving up on the list are kept, so they need ids as well.
+    auto app_ids = calculate_app_ids(apps);
+    for (std::size_t x = 0; x < apps.size(); ++x) {
+      if (ids.count(std::get<0>(app_ids[x])) == 0) {
+        apps[x].id = std::get<0>(app_ids[x]);
+      } else {
+        apps[x].id = std::get<1>(app_ids[x]);
+      }
+      ids.insert(apps[x].id);
+    }
+
     if (fail_count > 0) {
       BOOST_LOG(warning) << "No applications configured, adding fallback Desktop entry.";
       proc::ctx_t ctx;
@@ -1585,5 +1673,7 @@ namespace proc {
     if (proc_opt) {
       proc = std::move(*proc_opt);
     }
+
+    nvhttp::invalidate_response_cache();
   }
 }  // namespace proc
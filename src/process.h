@@ -173,6 +173,29 @@ namespace proc {
    */
   std::tuple<std::string, std::string> calculate_app_id(const std::string &app_name, std::string app_image_path, int index);
 
+  /**
+   * @brief Calculate the ids of a list of apps, several apps at a time.
+   * @param apps The apps, the index of each app is its position in the list.
+   * @return The results of `calculate_app_id()` for each app, in the same order.
+   */
+  std::vector<std::tuple<std::string, std::string>> calculate_app_ids(const std::vector<proc::ctx_t> &apps);
+
+  /**
+   * @brief Calculate the SHA-256 of a file.
+   * @param filename The path of the file.
+   * @return The hex digest, std::nullopt on failure.
+   */
+  std::optional<std::string> calculate_sha256(const std::string &filename);
+
+  /**
+   * @brief Calculate the SHA-256 of an app image.
+   * @details The result is reused until the modification time or the size of the file change,
+   *          so unchanged images aren't read again whenever the app list is reloaded.
+   * @param file_path The path of the image.
+   * @return The hex digest, std::nullopt if the file can't be read.
+   */
+  std::optional<std::string> calculate_image_hash(const std::string &file_path);
+
   std::string validate_app_image_path(std::string app_image_path);
   void refresh(const std::string &file_name, bool needs_terminate = true);
   void migrate_apps(nlohmann::json* fileTree_p, nlohmann::json* inputTree_p);
@@ -2,6 +2,10 @@
  * @file src/stat_trackers.cpp
  * @brief Definitions for streaming statistic tracking.
  */
+// standard includes
+#include <algorithm>
+#include <cmath>
+
 // local includes
 #include "stat_trackers.h"
 
@@ -15,4 +19,49 @@ namespace stat_trackers {
     return boost::format("%1$.2f");
   }
 
+  void latency_histogram::collect(std::chrono::steady_clock::duration sample) {
+    auto sample_us = std::max(std::chrono::duration_cast<std::chrono::microseconds>(sample), std::chrono::microseconds {0});
+
+    auto bucket = std::min<std::size_t>(sample_us / bucket_width, bucket_count);
+    ++buckets[bucket];
+
+    ++samples;
+    sample_total += sample_us;
+    sample_max = std::max(sample_max, sample_us);
+  }
+
+  std::chrono::microseconds latency_histogram::percentile(double quantile) const {
+    if (samples == 0) {
+      return std::chrono::microseconds {0};
+    }
+
+    // Rank of the sample we're looking for, 1-based
+    auto rank = std::max<std::uint64_t>(1, (std::uint64_t) std::ceil(std::clamp(quantile, 0.0, 1.0) * samples));
+
+    std::uint64_t seen = 0;
+    for (std::size_t x = 0; x < bucket_count; ++x) {
+      seen += buckets[x];
+      if (seen >= rank) {
+        return std::min(bucket_width * (std::int64_t) (x + 1), sample_max);
+      }
+    }
+
+    return sample_max;
+  }
+
+  std::chrono::microseconds latency_histogram::average() const {
+    if (samples == 0) {
+      return std::chrono::microseconds {0};
+    }
+
+    return sample_total / samples;
+  }
+
+  void latency_histogram::reset() {
+    buckets.fill(0);
+    samples = 0;
+    sample_total = std::chrono::microseconds {0};
+    sample_max = std::chrono::microseconds {0};
+  }
+
 }  // namespace stat_trackers
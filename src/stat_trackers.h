@@ -5,7 +5,9 @@
 #pragma once
 
 // standard includes
+#include <array>
 #include <chrono>
+#include <cstdint>
 #include <functional>
 #include <limits>
 
@@ -50,4 +52,45 @@ namespace stat_trackers {
     } data;
   };
 
+  /**
+   * @brief Fixed-bucket histogram of latency samples.
+   *
+   * Samples are binned into 50us buckets up to 100ms, with everything above
+   * that landing in a single overflow bucket. Collecting a sample is O(1) and
+   * allocation-free, which keeps it cheap enough to call on every frame.
+   */
+  class latency_histogram {
+  public:
+    static constexpr std::chrono::microseconds bucket_width {50};
+    static constexpr std::size_t bucket_count = 2000;
+
+    void collect(std::chrono::steady_clock::duration sample);
+
+    /**
+     * @brief Get the latency below which the given fraction of samples fall.
+     * @param quantile The quantile to query, in the range [0, 1].
+     * @return The upper bound of the bucket containing the quantile, or zero if there are no samples.
+     *         Samples in the overflow bucket report the largest sample collected.
+     */
+    std::chrono::microseconds percentile(double quantile) const;
+
+    std::chrono::microseconds average() const;
+
+    std::chrono::microseconds max() const {
+      return sample_max;
+    }
+
+    std::uint64_t count() const {
+      return samples;
+    }
+
+    void reset();
+
+  private:
+    std::array<std::uint32_t, bucket_count + 1> buckets {};
+    std::uint64_t samples = 0;
+    std::chrono::microseconds sample_total {0};
+    std::chrono::microseconds sample_max {0};
+  };
+
 }  // namespace stat_trackers
@@ -4,9 +4,12 @@
  */
 
 // standard includes
+#include <atomic>
 #include <fstream>
 #include <future>
 #include <queue>
+#include <span>
+#include <unordered_map>
 
 // lib includes
 #include <boost/endian/arithmetic.hpp>
@@ -29,9 +32,10 @@ extern "C" {
 #include "network.h"
 #include "platform/common.h"
 #include "process.h"
+#include "stat_trackers.h"
 #include "stream.h"
-#include "sync.h"
 #include "system_tray.h"
+#include "thread_placement.h"
 #include "thread_safe.h"
 #include "utility.h"
 
@@ -91,6 +95,34 @@ namespace stream {
     audio  ///< Audio
   };
 
+  /**
+   * @brief Host-side stages of a video frame's lifetime tracked per session.
+   */
+  enum class latency_stage_e : int {
+    capture_to_convert,  ///< Frame captured until color conversion started
+    convert,  ///< Color conversion
+    encode,  ///< Encoder submit until the packet was returned
+    packet_queue,  ///< Packet waiting for the broadcast thread
+    fec,  ///< FEC shard generation
+    encrypt,  ///< Shard encryption
+    send,  ///< First packet sent until last packet sent, including pacing
+    total,  ///< Frame captured until last packet sent
+    pacing_overshoot,  ///< Latest wake-up of the pacing sleeps of a frame past their deadline
+    _count  ///< Number of stages
+  };
+
+  constexpr std::array<std::string_view, (int) latency_stage_e::_count> latency_stage_names {
+    "capture_to_convert"sv,
+    "convert"sv,
+    "encode"sv,
+    "packet_queue"sv,
+    "fec"sv,
+    "encrypt"sv,
+    "send"sv,
+    "total"sv,
+    "pacing_overshoot"sv,
+  };
+
 #pragma pack(push, 1)
 
   struct video_short_frame_header_t {
@@ -246,6 +278,23 @@ namespace stream {
 
   constexpr std::size_t MAX_AUDIO_PACKET_SIZE = 1400;
 
+  /**
+   * @brief How often the control thread checks the sessions for ping timeouts.
+   */
+  constexpr auto PING_TIMEOUT_CHECK_INTERVAL = 100ms;
+
+  /**
+   * @brief Capacity of the queues between the encoders and the broadcast threads, shared by all sessions.
+   * @details Enough for a few frames of every session at 240 FPS, and a few hundred ms of audio.
+   */
+  constexpr std::uint32_t VIDEO_PACKETS_CAPACITY = 32;
+  constexpr std::uint32_t AUDIO_PACKETS_CAPACITY = 64;
+
+  /**
+   * @brief Most datagrams received from the video or audio socket with a single call.
+   */
+  constexpr std::size_t RECV_BATCH_SIZE = 16;
+
   using audio_aes_t = std::array<char, round_to_pkcs7_padded(MAX_AUDIO_PACKET_SIZE)>;
 
   using av_session_id_t = std::variant<asio::ip::address, std::string>;  // IP address or SS-Ping-Payload from RTSP handshake
@@ -278,11 +327,38 @@ namespace stream {
       return !(bool) _host;
     }
 
-    // Get session associated with address.
+    using sessions_t = std::vector<session_t *>;
+
+    // Get session associated with the peer, it's attached to ENetPeer::data once claimed.
     // If none are found, try to find a session not yet claimed. (It will be marked by a port of value 0
     // If none of those are found, return nullptr
     session_t *get_session(const net::peer_t peer, uint32_t connect_data);
 
+    /**
+     * @brief Get a snapshot of all active sessions, including those still waiting for a peer to connect.
+     * @details Sessions are added and removed by publishing a new copy of the list,
+     *          so the snapshot never changes and reading it doesn't block anyone.
+     */
+    std::shared_ptr<const sessions_t> sessions() const {
+      return _sessions.load(std::memory_order_acquire);
+    }
+
+    void add_session(session_t *session) {
+      std::lock_guard lg {_sessions_mutex};
+
+      auto sessions = std::make_shared<sessions_t>(*_sessions.load(std::memory_order_relaxed));
+      sessions->push_back(session);
+      _sessions.store(std::move(sessions), std::memory_order_release);
+    }
+
+    void remove_session(session_t *session) {
+      std::lock_guard lg {_sessions_mutex};
+
+      auto sessions = std::make_shared<sessions_t>(*_sessions.load(std::memory_order_relaxed));
+      std::erase(*sessions, session);
+      _sessions.store(std::move(sessions), std::memory_order_release);
+    }
+
     // Circular dependency:
     //   iterate refers to session
     //   session refers to broadcast_ctx_t
@@ -300,7 +376,8 @@ namespace stream {
     void call(std::uint16_t type, session_t *session, const std::string_view &payload, bool reinjected);
 
     void map(uint16_t type, std::function<void(session_t *, const std::string_view &)> cb) {
-      _map_type_cb.emplace(type, std::move(cb));
+      _cbs.emplace_back(std::move(cb));
+      _type_to_cb[type] = (std::uint8_t) _cbs.size();
     }
 
     int send(const std::string_view &payload, net::peer_t peer) {
@@ -318,14 +395,13 @@ namespace stream {
       enet_host_flush(_host.get());
     }
 
-    // Callbacks
-    std::unordered_map<std::uint16_t, std::function<void(session_t *, const std::string_view &)>> _map_type_cb;
-
-    // All active sessions (including those still waiting for a peer to connect)
-    sync_util::sync_t<std::vector<session_t *>> _sessions;
+    // Callbacks, the index of the callback of each message type is one past its index in _cbs, 0 if it has none
+    std::array<std::uint8_t, std::numeric_limits<std::uint16_t>::max() + 1> _type_to_cb {};
+    std::vector<std::function<void(session_t *, const std::string_view &)>> _cbs;
 
-    // ENet peer to session mapping for sessions with a peer connected
-    sync_util::sync_t<std::map<net::peer_t, session_t *>> _peer_to_session;
+    // All active sessions (including those still waiting for a peer to connect), only replaced while holding _sessions_mutex
+    std::atomic<std::shared_ptr<const sessions_t>> _sessions {std::make_shared<const sessions_t>()};
+    std::mutex _sessions_mutex;
 
     ENetAddress _addr;
     net::host_t _host;
@@ -334,6 +410,9 @@ namespace stream {
   struct broadcast_ctx_t {
     message_queue_queue_t message_queue_queue;
 
+    safe::mail_raw_t::ring_queue_t<video::packet_t> video_packets;
+    safe::mail_raw_t::ring_queue_t<audio::packet_t> audio_packets;
+
     std::thread recv_thread;
     std::thread video_thread;
     std::thread audio_thread;
@@ -378,6 +457,20 @@ namespace stream {
       std::unique_ptr<platf::deinit_t> qos;
     } video;
 
+    struct {
+      std::mutex mutex;
+      std::array<stat_trackers::latency_histogram, (int) latency_stage_e::_count> stages;
+
+      std::chrono::steady_clock::time_point start_time;
+      std::optional<std::chrono::steady_clock::duration> time_to_first_frame;
+      bool warm_resume;  ///< The session took over the capture kept alive after the previous session
+    } latency;
+
+    struct {
+      std::unique_ptr<platf::deinit_t> capture;
+      audio::audio_ctx_ref_t audio;
+    } resumed;  ///< What the previous session kept running, held until the session ends
+
     struct {
       crypto::cipher::cbc_t cipher;
       std::string ping_payload;
@@ -401,6 +494,9 @@ namespace stream {
       crypto::aes_t incoming_iv;
       crypto::aes_t outgoing_iv;
 
+      // Incoming messages are decrypted into this buffer, it only grows so decrypting doesn't allocate
+      std::vector<std::uint8_t> plaintext;
+
       std::uint32_t connect_data;  // Used for new clients with ML_FF_SESSION_ID_V1
       std::string expected_peer_address;  // Only used for legacy clients without ML_FF_SESSION_ID_V1
 
@@ -412,6 +508,7 @@ namespace stream {
     } control;
 
     std::uint32_t launch_session_id;
+    session::launch_settings_t launch_settings;
     std::string device_name;
     std::string device_uuid;
     crypto::PERM permission;
@@ -488,21 +585,15 @@ namespace stream {
   static auto broadcast = safe::make_shared<broadcast_ctx_t>(start_broadcast, end_broadcast);
 
   session_t *control_server_t::get_session(const net::peer_t peer, uint32_t connect_data) {
-    {
-      // Fast path - look up existing session by peer
-      auto lg = _peer_to_session.lock();
-      auto it = _peer_to_session->find(peer);
-      if (it != _peer_to_session->end()) {
-        return it->second;
-      }
+    // Fast path - the peer already claimed its session
+    if (peer->data) {
+      return (session_t *) peer->data;
     }
 
     // Slow path - process new session
     TUPLE_2D(peer_port, peer_addr, platf::from_sockaddr_ex((sockaddr *) &peer->address.address));
-    auto lg = _sessions.lock();
-    for (auto pos = std::begin(*_sessions); pos != std::end(*_sessions); ++pos) {
-      auto session_p = *pos;
-
+    auto sessions_snapshot = sessions();
+    for (auto session_p : *sessions_snapshot) {
       // Skip sessions that are already established
       if (session_p->control.peer) {
         continue;
@@ -538,9 +629,8 @@ namespace stream {
       BOOST_LOG(debug) << "Control local address ["sv << local_address << ']';
       BOOST_LOG(debug) << "Control peer address ["sv << peer_addr << ':' << peer_port << ']';
 
-      // Insert this into the map for O(1) lookups in the future
-      auto ptslg = _peer_to_session.lock();
-      _peer_to_session->emplace(peer, session_p);
+      // Attach the session to the peer for O(1) lookups in the future
+      peer->data = session_p;
       return session_p;
     }
 
@@ -561,15 +651,15 @@ namespace stream {
       return;
     }
 
-    auto cb = _map_type_cb.find(type);
-    if (cb == std::end(_map_type_cb)) {
+    auto cb = _type_to_cb[type];
+    if (!cb) {
       BOOST_LOG(debug)
         << "type [Unknown] { "sv << util::hex(type).to_string_view() << " }"sv << std::endl
         << "---data---"sv << std::endl
         << util::hex_vec(payload) << std::endl
         << "---end data---"sv;
     } else {
-      cb->second(session, payload);
+      _cbs[cb - 1](session, payload);
     }
   }
 
@@ -578,6 +668,11 @@ namespace stream {
     auto res = enet_host_service(_host.get(), &event, timeout.count());
 
     if (res > 0) {
+      // ENet reuses the peers of closed connections
+      if (event.type == ENET_EVENT_TYPE_CONNECT) {
+        event.peer->data = nullptr;
+      }
+
       auto session = get_session(event.peer, event.data);
       if (!session) {
         BOOST_LOG(warning) << "Rejected connection from ["sv << platf::from_sockaddr((sockaddr *) &event.peer->address.address) << "]: it's not properly set up"sv;
@@ -608,6 +703,7 @@ namespace stream {
           if (session->state == session::state_e::RUNNING) {
             session::stop(*session);
           }
+          event.peer->data = nullptr;
           break;
         case ENET_EVENT_TYPE_NONE:
           break;
@@ -646,7 +742,12 @@ namespace stream {
       }
     };
 
-    static fec_t encode(const std::string_view &payload, size_t blocksize, size_t fecpercentage, size_t minparityshards, size_t prefixsize) {
+    /**
+     * @brief Lay out the data and parity shards for a FEC block without computing the parity.
+     * The data shards can be sent before encode_parity() is called, as long as they're
+     * not modified in place (e.g. by encryption) until the parity has been computed.
+     */
+    static fec_t prepare(const std::string_view &payload, size_t blocksize, size_t fecpercentage, size_t minparityshards, size_t prefixsize) {
       auto payload_size = payload.size();
 
       auto pad = payload_size % blocksize != 0;
@@ -699,16 +800,9 @@ namespace stream {
       // Add a payload buffer describing the shard buffer
       payload_buffers.emplace_back(std::begin(shards), shards.size());
 
-      if (fecpercentage != 0) {
-        // Point into our allocated buffer for the parity shards
-        for (auto x = 0; x < parity_shards; ++x) {
-          shards_p[data_shards + x] = (uint8_t *) &shards[(parity_shard_offset + x) * blocksize];
-        }
-
-        // packets = parity_shards + data_shards
-        rs_t rs {reed_solomon_new(data_shards, parity_shards)};
-
-        reed_solomon_encode(rs.get(), shards_p.begin(), nr_shards, blocksize);
+      // Point into our allocated buffer for the parity shards
+      for (auto x = 0; x < parity_shards; ++x) {
+        shards_p[data_shards + x] = (uint8_t *) &shards[(parity_shard_offset + x) * blocksize];
       }
 
       return {
@@ -723,6 +817,27 @@ namespace stream {
         std::move(payload_buffers),
       };
     }
+
+    /**
+     * @brief Compute the parity shards of a FEC block laid out by prepare().
+     */
+    static void encode_parity(fec_t &fec) {
+      if (fec.nr_shards == fec.data_shards) {
+        return;
+      }
+
+      // packets = parity_shards + data_shards
+      rs_t rs {reed_solomon_new(fec.data_shards, fec.nr_shards - fec.data_shards)};
+
+      reed_solomon_encode(rs.get(), fec.shards_p.begin(), fec.nr_shards, fec.blocksize);
+    }
+
+    static fec_t encode(const std::string_view &payload, size_t blocksize, size_t fecpercentage, size_t minparityshards, size_t prefixsize) {
+      auto fec = prepare(payload, blocksize, fecpercentage, minparityshards, prefixsize);
+      encode_parity(fec);
+
+      return fec;
+    }
   }  // namespace fec
 
   /**
@@ -927,6 +1042,32 @@ namespace stream {
     return 0;
   }
 
+  /**
+   * @brief Decrypt a control stream message into the scratch buffer of the session.
+   * @param session The session the message was received on.
+   * @param tagged_cipher The GCM tag followed by the ciphertext.
+   * @param iv The initialization vector of the message.
+   * @return The plaintext, valid until the next message of the session is decrypted. std::nullopt if it can't be verified.
+   */
+  static std::optional<std::string_view> decrypt_control(session_t *session, const std::string_view &tagged_cipher, crypto::aes_t &iv) {
+    if (tagged_cipher.size() < crypto::cipher::tag_size) {
+      return std::nullopt;
+    }
+
+    auto &plaintext = session->control.plaintext;
+    auto size = crypto::cipher::round_to_pkcs7_padded(tagged_cipher.size() - crypto::cipher::tag_size);
+    if (plaintext.size() < size) {
+      plaintext.resize(size);
+    }
+
+    auto len = session->control.cipher.decrypt(tagged_cipher, plaintext.data(), &iv);
+    if (len < 0) {
+      return std::nullopt;
+    }
+
+    return std::string_view {(char *) plaintext.data(), (std::size_t) len};
+  }
+
   void controlBroadcastThread(control_server_t *server) {
     server->map(packetTypes[IDX_PERIODIC_PING], [](session_t *session, const std::string_view &payload) {
       BOOST_LOG(verbose) << "type [IDX_PERIODIC_PING]"sv;
@@ -978,14 +1119,21 @@ namespace stream {
     server->map(packetTypes[IDX_INPUT_DATA], [&](session_t *session, const std::string_view &payload) {
       BOOST_LOG(debug) << "type [IDX_INPUT_DATA]"sv;
 
+      if (payload.size() < sizeof(int32_t)) {
+        BOOST_LOG(warning) << "Control: Runt packet"sv;
+        return;
+      }
+
       auto tagged_cipher_length = util::endian::big(*(int32_t *) payload.data());
+      if (tagged_cipher_length < 0 || (size_t) tagged_cipher_length > payload.size() - sizeof(tagged_cipher_length)) {
+        BOOST_LOG(warning) << "Control: Runt packet"sv;
+        return;
+      }
       std::string_view tagged_cipher {payload.data() + sizeof(tagged_cipher_length), (size_t) tagged_cipher_length};
 
-      std::vector<uint8_t> plaintext;
-
-      auto &cipher = session->control.cipher;
       auto &iv = session->control.legacy_input_enc_iv;
-      if (cipher.decrypt(tagged_cipher, plaintext, &iv)) {
+      auto plaintext = decrypt_control(session, tagged_cipher, iv);
+      if (!plaintext) {
         // something went wrong :(
 
         BOOST_LOG(error) << "Failed to verify tag"sv;
@@ -998,7 +1146,7 @@ namespace stream {
         std::copy(payload.end() - 16, payload.end(), std::begin(iv));
       }
 
-      input::passthrough(session->input, std::move(plaintext), session->permission);
+      input::passthrough(session->input, *plaintext, session->permission);
     });
 
     server->map(packetTypes[IDX_EXEC_SERVER_CMD], [server](session_t *session, const std::string_view &payload) {
@@ -1068,7 +1216,6 @@ namespace stream {
       auto tagged_cipher_length = length - 4;
       std::string_view tagged_cipher {(char *) header->payload(), (size_t) tagged_cipher_length};
 
-      auto &cipher = session->control.cipher;
       auto &iv = session->control.incoming_iv;
       if (session->config.encryptionFlagsEnabled & SS_ENC_CONTROL_V2) {
         // We use the deterministic IV construction algorithm specified in NIST SP 800-38D
@@ -1090,8 +1237,8 @@ namespace stream {
         iv[0] = (std::uint8_t) seq;
       }
 
-      std::vector<uint8_t> plaintext;
-      if (cipher.decrypt(tagged_cipher, plaintext, &iv)) {
+      auto plaintext = decrypt_control(session, tagged_cipher, iv);
+      if (!plaintext || plaintext->size() < 4) {
         // something went wrong :(
 
         BOOST_LOG(error) << "Failed to verify tag"sv;
@@ -1100,8 +1247,8 @@ namespace stream {
         return;
       }
 
-      auto type = *(std::uint16_t *) plaintext.data();
-      std::string_view next_payload {(char *) plaintext.data() + 4, plaintext.size() - 4};
+      auto type = *(std::uint16_t *) plaintext->data();
+      std::string_view next_payload = plaintext->substr(4);
 
       if (type == packetTypes[IDX_ENCRYPTED]) {
         BOOST_LOG(error) << "Bad packet type [IDX_ENCRYPTED] found"sv;
@@ -1111,82 +1258,81 @@ namespace stream {
 
       // IDX_INPUT_DATA callback will attempt to decrypt unencrypted data, therefore we need pass it directly
       if (type == packetTypes[IDX_INPUT_DATA]) {
-        plaintext.erase(std::begin(plaintext), std::begin(plaintext) + 4);
-        input::passthrough(session->input, std::move(plaintext), session->permission);
+        input::passthrough(session->input, next_payload, session->permission);
       } else {
         server->call(type, session, next_payload, true);
       }
     });
 
     // This thread handles latency-sensitive control messages
-    platf::adjust_thread_priority(platf::thread_priority_e::critical);
+    auto placement = thread_placement::apply(thread_placement::role_e::network, platf::thread_priority_e::critical);
 
     // Check for both the full shutdown event and the shutdown event for this
     // broadcast to ensure we can inform connected clients of our graceful
     // termination when we shut down.
     auto shutdown_event = mail::man->event<bool>(mail::shutdown);
     auto broadcast_shutdown_event = mail::man->event<bool>(mail::broadcast_shutdown);
+    auto next_ping_check = std::chrono::steady_clock::now();
     while (!shutdown_event->peek() && !broadcast_shutdown_event->peek()) {
       bool has_session_awaiting_peer = false;
 
-      {
-        auto lg = server->_sessions.lock();
-
-        auto now = std::chrono::steady_clock::now();
-
-        KITTY_WHILE_LOOP(auto pos = std::begin(*server->_sessions), pos != std::end(*server->_sessions), {
-          // Don't perform additional session processing if we're shutting down
-          if (shutdown_event->peek() || broadcast_shutdown_event->peek()) {
-            break;
-          }
-
-          auto session = *pos;
+      // The ping timeouts are in seconds, checking them on every ENet event would be a waste
+      auto now = std::chrono::steady_clock::now();
+      bool check_ping = now >= next_ping_check;
+      if (check_ping) {
+        next_ping_check = now + PING_TIMEOUT_CHECK_INTERVAL;
+      }
 
-          if (now > session->pingTimeout) {
-            auto address = session->control.peer ? platf::from_sockaddr((sockaddr *) &session->control.peer->address.address) : session->control.expected_peer_address;
-            BOOST_LOG(info) << address << ": Ping Timeout"sv;
-            session::stop(*session);
-          }
+      // Sessions are only removed from the list on this thread, so they outlive the snapshot
+      auto sessions = server->sessions();
+      for (auto session : *sessions) {
+        // Don't perform additional session processing if we're shutting down
+        if (shutdown_event->peek() || broadcast_shutdown_event->peek()) {
+          break;
+        }
 
-          if (session->state.load(std::memory_order_acquire) == session::state_e::STOPPING) {
-            pos = server->_sessions->erase(pos);
+        if (check_ping && now > session->pingTimeout) {
+          auto address = session->control.peer ? platf::from_sockaddr((sockaddr *) &session->control.peer->address.address) : session->control.expected_peer_address;
+          BOOST_LOG(info) << address << ": Ping Timeout"sv;
+          session::stop(*session);
+        }
 
-            if (session->control.peer) {
-              {
-                auto ptslg = server->_peer_to_session.lock();
-                server->_peer_to_session->erase(session->control.peer);
-              }
+        if (session->state.load(std::memory_order_acquire) == session::state_e::STOPPING) {
+          server->remove_session(session);
 
-              enet_peer_disconnect_now(session->control.peer, 0);
+          if (session->control.peer) {
+            // The peer may already be connected to another session
+            if (session->control.peer->data == session) {
+              session->control.peer->data = nullptr;
             }
 
-            session->controlEnd.raise(true);
-            continue;
+            enet_peer_disconnect_now(session->control.peer, 0);
           }
 
-          // Remember if we have a session that's waiting for a peer to connect to the
-          // control stream. This ensures the clients are properly notified even when
-          // the app terminates before they finish connecting.
-          if (!session->control.peer) {
-            has_session_awaiting_peer = true;
-          } else {
-            auto &feedback_queue = session->control.feedback_queue;
-            while (feedback_queue->peek()) {
-              auto feedback_msg = feedback_queue->pop();
-
-              send_feedback_msg(session, *feedback_msg);
-            }
+          session->controlEnd.raise(true);
+          continue;
+        }
 
-            auto &hdr_queue = session->control.hdr_queue;
-            while (session->control.peer && hdr_queue->peek()) {
-              auto hdr_info = hdr_queue->pop();
+        // Remember if we have a session that's waiting for a peer to connect to the
+        // control stream. This ensures the clients are properly notified even when
+        // the app terminates before they finish connecting.
+        if (!session->control.peer) {
+          has_session_awaiting_peer = true;
+        } else {
+          auto &feedback_queue = session->control.feedback_queue;
+          while (feedback_queue->peek()) {
+            auto feedback_msg = feedback_queue->pop();
 
-              send_hdr_mode(session, std::move(hdr_info));
-            }
+            send_feedback_msg(session, *feedback_msg);
           }
 
-          ++pos;
-        })
+          auto &hdr_queue = session->control.hdr_queue;
+          while (session->control.peer && hdr_queue->peek()) {
+            auto hdr_info = hdr_queue->pop();
+
+            send_hdr_mode(session, std::move(hdr_info));
+          }
+        }
       }
 
       // Don't break until any pending sessions either expire or connect
@@ -1210,10 +1356,8 @@ namespace stream {
     std::array<std::uint8_t, sizeof(control_encrypted_t) + crypto::cipher::round_to_pkcs7_padded(sizeof(plaintext)) + crypto::cipher::tag_size>
       encrypted_payload;
 
-    auto lg = server->_sessions.lock();
-    for (auto pos = std::begin(*server->_sessions); pos != std::end(*server->_sessions); ++pos) {
-      auto session = *pos;
-
+    auto sessions = server->sessions();
+    for (auto session : *sessions) {
       // We may not have gotten far enough to have an ENet connection yet
       if (session->control.peer) {
         auto payload = encode_control(session, util::view(plaintext), encrypted_payload);
@@ -1231,9 +1375,82 @@ namespace stream {
     server->flush();
   }
 
+  /**
+   * @brief The sessions waiting for a ping on a socket.
+   * @details Looked up for every datagram received, only changed between batches of datagrams.
+   */
+  class ping_routes_t {
+  public:
+    void update(const av_session_id_t &session_id, const message_queue_t &message_queue) {
+      if (auto address = std::get_if<asio::ip::address>(&session_id)) {
+        if (message_queue) {
+          _by_address.emplace(*address, message_queue);
+        } else {
+          _by_address.erase(*address);
+        }
+      } else {
+        auto &payload = std::get<std::string>(session_id);
+        if (message_queue) {
+          _by_payload.emplace(payload, message_queue);
+        } else {
+          _by_payload.erase(payload);
+        }
+      }
+    }
+
+    /**
+     * @brief Find the session a ping was sent to.
+     * @param address The address the ping was received from.
+     * @param datagram The ping.
+     * @return The message queue of the session, or nullptr if no session waits for the ping.
+     */
+    const message_queue_t *find(const asio::ip::address &address, std::string_view datagram) const {
+      if (datagram.size() == 4) {
+        // For legacy PING packets, find the matching session by address.
+        auto it = _by_address.find(address);
+        if (it != std::end(_by_address)) {
+          return &it->second;
+        }
+      } else if (datagram.size() >= sizeof(SS_PING)) {
+        auto ping = (PSS_PING) datagram.data();
+
+        // For new PING packets that include a client identifier, search by payload.
+        auto it = _by_payload.find(std::string_view {ping->payload, sizeof(ping->payload)});
+        if (it != std::end(_by_payload)) {
+          return &it->second;
+        }
+      }
+
+      return nullptr;
+    }
+
+  private:
+    struct address_hash_t {
+      std::size_t operator()(const asio::ip::address &address) const {
+        if (address.is_v4()) {
+          return std::hash<std::uint32_t> {}(address.to_v4().to_uint());
+        }
+
+        auto bytes = address.to_v6().to_bytes();
+        return std::hash<std::string_view> {}(std::string_view {(const char *) bytes.data(), bytes.size()});
+      }
+    };
+
+    struct payload_hash_t {
+      using is_transparent = void;
+
+      std::size_t operator()(std::string_view payload) const {
+        return std::hash<std::string_view> {}(payload);
+      }
+    };
+
+    std::unordered_map<asio::ip::address, message_queue_t, address_hash_t> _by_address;
+    std::unordered_map<std::string, message_queue_t, payload_hash_t, std::equal_to<>> _by_payload;
+  };
+
   void recvThread(broadcast_ctx_t &ctx) {
-    std::map<av_session_id_t, message_queue_t> peer_to_video_session;
-    std::map<av_session_id_t, message_queue_t> peer_to_audio_session;
+    ping_routes_t video_routes;
+    ping_routes_t audio_routes;
 
     auto &video_sock = ctx.video_sock;
     auto &audio_sock = ctx.audio_sock;
@@ -1243,94 +1460,179 @@ namespace stream {
 
     auto &io = ctx.io_context;
 
-    udp::endpoint peer;
-
-    std::array<char, 2048> buf[2];
-    std::function<void(const boost::system::error_code, size_t)> recv_func[2];
+    std::array<char, 2048> buf[2][RECV_BATCH_SIZE];
+    std::vector<platf::recv_info_t> batch[2];
+    std::function<void(const boost::system::error_code)> recv_func[2];
 
-    auto populate_peer_to_session = [&]() {
+    auto update_routes = [&]() {
       while (message_queue_queue->peek()) {
         auto message_queue_opt = message_queue_queue->pop();
         TUPLE_3D_REF(socket_type, session_id, message_queue, *message_queue_opt);
 
         switch (socket_type) {
           case socket_e::video:
-            if (message_queue) {
-              peer_to_video_session.emplace(session_id, message_queue);
-            } else {
-              peer_to_video_session.erase(session_id);
-            }
+            video_routes.update(session_id, message_queue);
             break;
           case socket_e::audio:
-            if (message_queue) {
-              peer_to_audio_session.emplace(session_id, message_queue);
-            } else {
-              peer_to_audio_session.erase(session_id);
-            }
+            audio_routes.update(session_id, message_queue);
             break;
         }
       }
     };
 
-    auto recv_func_init = [&](udp::socket &sock, int buf_elem, std::map<av_session_id_t, message_queue_t> &peer_to_session) {
-      recv_func[buf_elem] = [&, buf_elem](const boost::system::error_code &ec, size_t bytes) {
-        auto fg = util::fail_guard([&]() {
-          sock.async_receive_from(asio::buffer(buf[buf_elem]), peer, 0, recv_func[buf_elem]);
-        });
+    // Receives the datagrams waiting on the socket, one at a time when batched receives aren't supported.
+    // The sockets stay blocking for the broadcast threads sending on them, so without batched receives,
+    // a receive only goes ahead right after the socket was reported readable or with a datagram waiting.
+    auto receive = [&](udp::socket &sock, std::vector<platf::recv_info_t> &datagrams, bool readable) {
+      auto count = platf::recv_batch((std::uintptr_t) sock.native_handle(), datagrams);
+      if (count >= 0) {
+        return count;
+      }
 
-        auto type_str = buf_elem ? "AUDIO"sv : "VIDEO"sv;
-        BOOST_LOG(verbose) << "Recv: "sv << peer.address().to_string() << ':' << peer.port() << " :: " << type_str;
+      count = 0;
+      udp::endpoint peer;
+      while (count < (int) datagrams.size()) {
+        boost::system::error_code ec;
+        if (!readable && (!sock.available(ec) || ec)) {
+          break;
+        }
+        readable = false;
 
-        populate_peer_to_session();
+        auto bytes = sock.receive_from(asio::buffer(datagrams[count].buffer, datagrams[count].buffer_size), peer, 0, ec);
 
         // No data, yet no error
         if (ec == boost::system::errc::connection_refused || ec == boost::system::errc::connection_reset) {
-          return;
+          continue;
         }
 
-        if (ec || !bytes) {
+        if (ec) {
           BOOST_LOG(error) << "Couldn't receive data from udp socket: "sv << ec.message();
+          break;
+        }
+
+        datagrams[count].size = bytes;
+        datagrams[count].source_address = peer.address();
+        datagrams[count].source_port = peer.port();
+        ++count;
+      }
+
+      return count;
+    };
+
+    auto recv_func_init = [&](udp::socket &sock, int buf_elem, ping_routes_t &routes) {
+      for (auto &datagram : buf[buf_elem]) {
+        batch[buf_elem].push_back({datagram.data(), datagram.size()});
+      }
+
+      recv_func[buf_elem] = [&, buf_elem](const boost::system::error_code &ec) {
+        if (ec) {
+          if (ec != asio::error::operation_aborted) {
+            BOOST_LOG(error) << "Couldn't wait for data from udp socket: "sv << ec.message();
+          }
           return;
         }
 
-        if (bytes == 4) {
-          // For legacy PING packets, find the matching session by address.
-          auto it = peer_to_session.find(peer.address());
-          if (it != std::end(peer_to_session)) {
-            BOOST_LOG(debug) << "RAISE: "sv << peer.address().to_string() << ':' << peer.port() << " :: " << type_str;
-            it->second->raise(peer, std::string {buf[buf_elem].data(), bytes});
+        auto fg = util::fail_guard([&]() {
+          sock.async_wait(udp::socket::wait_read, recv_func[buf_elem]);
+        });
+
+        auto type_str = buf_elem ? "AUDIO"sv : "VIDEO"sv;
+
+        // A full batch may leave more datagrams waiting
+        int count;
+        bool readable = true;
+        do {
+          count = receive(sock, batch[buf_elem], readable);
+          readable = false;
+          if (count <= 0) {
+            break;
           }
-        } else if (bytes >= sizeof(SS_PING)) {
-          auto ping = (PSS_PING) buf[buf_elem].data();
-
-          // For new PING packets that include a client identifier, search by payload.
-          auto it = peer_to_session.find(std::string {ping->payload, sizeof(ping->payload)});
-          if (it != std::end(peer_to_session)) {
-            BOOST_LOG(debug) << "RAISE: "sv << peer.address().to_string() << ':' << peer.port() << " :: " << type_str;
-            it->second->raise(peer, std::string {buf[buf_elem].data(), bytes});
+
+          BOOST_LOG(verbose) << "Recv: "sv << count << " datagrams :: "sv << type_str;
+
+          update_routes();
+          for (auto &datagram : std::span {batch[buf_elem]}.first(count)) {
+            auto message_queue = routes.find(datagram.source_address, {datagram.buffer, datagram.size});
+            if (message_queue) {
+              udp::endpoint peer {datagram.source_address, datagram.source_port};
+              BOOST_LOG(debug) << "RAISE: "sv << peer.address().to_string() << ':' << peer.port() << " :: " << type_str;
+              (*message_queue)->raise(peer, std::string {datagram.buffer, datagram.size});
+            }
           }
-        }
+        } while (count == (int) batch[buf_elem].size());
       };
     };
 
-    recv_func_init(video_sock, 0, peer_to_video_session);
-    recv_func_init(audio_sock, 1, peer_to_audio_session);
+    recv_func_init(video_sock, 0, video_routes);
+    recv_func_init(audio_sock, 1, audio_routes);
 
-    video_sock.async_receive_from(asio::buffer(buf[0]), peer, 0, recv_func[0]);
-    audio_sock.async_receive_from(asio::buffer(buf[1]), peer, 0, recv_func[1]);
+    video_sock.async_wait(udp::socket::wait_read, recv_func[0]);
+    audio_sock.async_wait(udp::socket::wait_read, recv_func[1]);
 
     while (!broadcast_shutdown_event->peek()) {
       io.run();
     }
   }
 
+  /**
+   * @brief Timestamps collected by the broadcast thread while sending a single frame.
+   */
+  struct frame_send_timing_t {
+    std::optional<std::chrono::steady_clock::time_point> frame_timestamp;
+    std::chrono::steady_clock::time_point packet_popped;
+    std::chrono::steady_clock::duration fec {};
+    std::chrono::steady_clock::duration encrypt {};
+    std::optional<std::chrono::steady_clock::time_point> first_send;
+    std::optional<std::chrono::steady_clock::time_point> last_send;
+    std::optional<std::chrono::steady_clock::duration> pacing_overshoot;
+  };
+
+  /**
+   * @brief Add a sent frame's stage latencies to the session's histograms.
+   * @param session The session the frame was sent to.
+   * @param timing Encoder-side timestamps carried by the packet.
+   * @param send_timing Broadcast-side timestamps for the frame.
+   */
+  void collect_frame_latency(session_t &session, const video::frame_timing_t &timing, const frame_send_timing_t &send_timing) {
+    auto lg = std::lock_guard(session.latency.mutex);
+    auto &stages = session.latency.stages;
+
+    if (!session.latency.time_to_first_frame && send_timing.last_send) {
+      session.latency.time_to_first_frame = *send_timing.last_send - session.latency.start_time;
+      BOOST_LOG(info) << "Time to first frame: "sv << std::chrono::duration_cast<std::chrono::milliseconds>(*session.latency.time_to_first_frame).count()
+                      << "ms"sv << (session.latency.warm_resume ? " (warm resume)"sv : ""sv);
+    }
+
+    auto collect = [&](latency_stage_e stage, const auto &from, const auto &to) {
+      if (from && to) {
+        stages[(int) stage].collect(*to - *from);
+      }
+    };
+
+    collect(latency_stage_e::capture_to_convert, send_timing.frame_timestamp, timing.convert_start);
+    collect(latency_stage_e::convert, timing.convert_start, timing.convert_end);
+    collect(latency_stage_e::encode, timing.encode_start, timing.encode_end);
+    collect(latency_stage_e::packet_queue, timing.encode_end, std::optional {send_timing.packet_popped});
+    collect(latency_stage_e::send, send_timing.first_send, send_timing.last_send);
+    collect(latency_stage_e::total, send_timing.frame_timestamp, send_timing.last_send);
+
+    if (send_timing.pacing_overshoot) {
+      stages[(int) latency_stage_e::pacing_overshoot].collect(*send_timing.pacing_overshoot);
+    }
+
+    stages[(int) latency_stage_e::fec].collect(send_timing.fec);
+    if (session.video.cipher) {
+      stages[(int) latency_stage_e::encrypt].collect(send_timing.encrypt);
+    }
+  }
+
   void videoBroadcastThread(udp::socket &sock) {
     auto shutdown_event = mail::man->event<bool>(mail::broadcast_shutdown);
-    auto packets = mail::man->queue<video::packet_t>(mail::video_packets);
+    auto packets = mail::man->ring_queue<video::packet_t>(mail::video_packets);
     auto video_epoch = std::chrono::steady_clock::now();
 
     // Video traffic is sent on this thread
-    platf::adjust_thread_priority(platf::thread_priority_e::high);
+    auto placement = thread_placement::apply(thread_placement::role_e::network, platf::thread_priority_e::high);
 
     logging::min_max_avg_periodic_logger<double> frame_processing_latency_logger(debug, "Frame processing latency", "ms");
 
@@ -1355,6 +1657,10 @@ namespace stream {
 
       frame_network_latency_logger.first_point_now();
 
+      frame_send_timing_t send_timing;
+      send_timing.packet_popped = std::chrono::steady_clock::now();
+      send_timing.frame_timestamp = packet->frame_timestamp;
+
       auto session = (session_t *) packet->channel_data;
       auto lowseq = session->video.lowseq;
 
@@ -1502,16 +1808,46 @@ namespace stream {
             }
           }
 
-          frame_fec_latency_logger.first_point_now();
           // If video encryption is enabled, we allocate space for the encryption header before each shard
-          auto shards = fec::encode(current_payload, blocksize, fecPercentage, session->config.minRequiredFecPackets, session->video.cipher ? sizeof(video_packet_enc_prefix_t) : 0);
-          frame_fec_latency_logger.second_point_now_and_log();
+          auto shards = fec::prepare(current_payload, blocksize, fecPercentage, session->config.minRequiredFecPackets, session->video.cipher ? sizeof(video_packet_enc_prefix_t) : 0);
+
+          // With early sending, the data shards go out before the parity shards are computed.
+          // Parity must be computed over the plaintext, so encrypted data shards are written
+          // to a separate buffer instead of in place.
+          bool early_send = config::stream.fec_early_send && shards.data_shards != shards.size();
+          util::buffer_t<char> encrypted_data_shards;
+          std::vector<platf::buffer_descriptor_t> encrypted_payload_buffers;
+          if (early_send && session->video.cipher) {
+            encrypted_data_shards = util::buffer_t<char> {shards.data_shards * blocksize};
+            encrypted_payload_buffers.emplace_back(std::begin(encrypted_data_shards), encrypted_data_shards.size());
+            encrypted_payload_buffers.emplace_back(shards.data(shards.data_shards), (shards.size() - shards.data_shards) * blocksize);
+          }
+
+          auto shard_payload = [&](size_t x) {
+            if (encrypted_data_shards.size() && x < shards.data_shards) {
+              return &encrypted_data_shards[x * blocksize];
+            }
+
+            return shards.data(x);
+          };
+
+          auto encode_parity = [&]() {
+            frame_fec_latency_logger.first_point_now();
+            auto fec_start = std::chrono::steady_clock::now();
+            fec::encode_parity(shards);
+            send_timing.fec += std::chrono::steady_clock::now() - fec_start;
+            frame_fec_latency_logger.second_point_now_and_log();
+          };
+
+          if (!early_send) {
+            encode_parity();
+          }
 
           auto peer_address = session->video.peer.address();
           auto batch_info = platf::batched_send_info_t {
             shards.headers.begin(),
             shards.prefixsize,
-            shards.payload_buffers,
+            encrypted_data_shards.size() ? encrypted_payload_buffers : shards.payload_buffers,
             shards.blocksize,
             0,
             0,
@@ -1521,8 +1857,6 @@ namespace stream {
             session->localAddress,
           };
 
-          size_t next_shard_to_send = 0;
-
           // RTP video timestamps use a 90 KHz clock and the frame_timestamp from when the frame was captured
           // When a timestamp isn't available (duplicate frames), the timestamp from rate control is used instead.
           bool frame_is_dupe = false;
@@ -1533,92 +1867,117 @@ namespace stream {
           using rtp_tick = std::chrono::duration<uint32_t, std::ratio<1, 90000>>;
           uint32_t timestamp = std::chrono::round<rtp_tick>(*packet->frame_timestamp - video_epoch).count();
 
-          // set FEC info now that we know for sure what our percentage will be for this frame
-          for (auto x = 0; x < shards.size(); ++x) {
-            auto *inspect = (video_packet_raw_t *) shards.data(x);
-
-            inspect->packet.fecInfo =
-              (x << 12 |
-               shards.data_shards << 22 |
-               shards.percentage << 4);
-
-            inspect->rtp.header = 0x80 | FLAG_EXTENSION;
-            inspect->rtp.sequenceNumber = util::endian::big<uint16_t>(lowseq + x);
-            inspect->rtp.timestamp = util::endian::big<uint32_t>(timestamp);
+          auto send_shards = [&](size_t begin, size_t end) {
+            size_t next_shard_to_send = begin;
+
+            // set FEC info now that we know for sure what our percentage will be for this frame
+            for (auto x = begin; x < end; ++x) {
+              auto *inspect = (video_packet_raw_t *) shards.data(x);
+
+              inspect->packet.fecInfo =
+                (x << 12 |
+                 shards.data_shards << 22 |
+                 shards.percentage << 4);
+
+              inspect->rtp.header = 0x80 | FLAG_EXTENSION;
+              inspect->rtp.sequenceNumber = util::endian::big<uint16_t>(lowseq + x);
+              inspect->rtp.timestamp = util::endian::big<uint32_t>(timestamp);
+
+              inspect->packet.multiFecBlocks = (blockIndex << 4) | ((fec_blocks_needed - 1) << 6);
+              inspect->packet.frameIndex = packet->frame_index();
+
+              // Encrypt this shard if video encryption is enabled
+              if (session->video.cipher) {
+                // We use the deterministic IV construction algorithm specified in NIST SP 800-38D
+                // Section 8.2.1. The sequence number is our "invocation" field and the 'V' in the
+                // high bytes is the "fixed" field. Because each client provides their own unique
+                // key, our values in the fixed field need only uniquely identify each independent
+                // use of the client's key with AES-GCM in our code.
+                //
+                // The IV counter is 64 bits long which allows for 2^64 encrypted video packets
+                // to be sent to each client before the IV repeats.
+                std::copy_n((uint8_t *) &session->video.gcm_iv_counter, sizeof(session->video.gcm_iv_counter), std::begin(iv));
+                iv[11] = 'V';  // Video stream
+                session->video.gcm_iv_counter++;
+
+                // Encrypt the target buffer, in place unless the parity still needs the plaintext
+                auto encrypt_start = std::chrono::steady_clock::now();
+                auto *prefix = (video_packet_enc_prefix_t *) shards.prefix(x);
+                prefix->frameNumber = packet->frame_index();
+                std::copy(std::begin(iv), std::end(iv), prefix->iv);
+                session->video.cipher->encrypt(std::string_view {(char *) inspect, (size_t) blocksize}, prefix->tag, (uint8_t *) shard_payload(x), &iv);
+                send_timing.encrypt += std::chrono::steady_clock::now() - encrypt_start;
+              }
 
-            inspect->packet.multiFecBlocks = (blockIndex << 4) | ((fec_blocks_needed - 1) << 6);
-            inspect->packet.frameIndex = packet->frame_index();
+              if (x - next_shard_to_send + 1 >= send_batch_size ||
+                  x + 1 == end) {
+                // Do pacing within the frame.
+                // Also trigger pacing before the first send_batch() of the frame
+                // to account for the last send_batch() of the previous frame.
+                if (ratecontrol_group_packets_sent >= ratecontrol_packets_in_1ms ||
+                    ratecontrol_frame_packets_sent == 0) {
+                  auto due = ratecontrol_frame_start +
+                             std::chrono::duration_cast<std::chrono::nanoseconds>(1ms) *
+                               ratecontrol_frame_packets_sent / ratecontrol_packets_in_1ms;
+
+                  auto now = std::chrono::steady_clock::now();
+                  if (now < due) {
+                    std::chrono::steady_clock::time_point deadline = due;
+                    timer->sleep_until(deadline);
+
+                    auto overshoot = std::max<std::chrono::steady_clock::duration>(std::chrono::steady_clock::now() - deadline, 0ns);
+                    send_timing.pacing_overshoot = std::max(send_timing.pacing_overshoot.value_or(overshoot), overshoot);
+                  }
+
+                  ratecontrol_group_packets_sent = 0;
+                }
 
-            // Encrypt this shard if video encryption is enabled
-            if (session->video.cipher) {
-              // We use the deterministic IV construction algorithm specified in NIST SP 800-38D
-              // Section 8.2.1. The sequence number is our "invocation" field and the 'V' in the
-              // high bytes is the "fixed" field. Because each client provides their own unique
-              // key, our values in the fixed field need only uniquely identify each independent
-              // use of the client's key with AES-GCM in our code.
-              //
-              // The IV counter is 64 bits long which allows for 2^64 encrypted video packets
-              // to be sent to each client before the IV repeats.
-              std::copy_n((uint8_t *) &session->video.gcm_iv_counter, sizeof(session->video.gcm_iv_counter), std::begin(iv));
-              iv[11] = 'V';  // Video stream
-              session->video.gcm_iv_counter++;
-
-              // Encrypt the target buffer in place
-              auto *prefix = (video_packet_enc_prefix_t *) shards.prefix(x);
-              prefix->frameNumber = packet->frame_index();
-              std::copy(std::begin(iv), std::end(iv), prefix->iv);
-              session->video.cipher->encrypt(std::string_view {(char *) inspect, (size_t) blocksize}, prefix->tag, (uint8_t *) inspect, &iv);
-            }
+                size_t current_batch_size = x - next_shard_to_send + 1;
+                batch_info.block_offset = next_shard_to_send;
+                batch_info.block_count = current_batch_size;
 
-            if (x - next_shard_to_send + 1 >= send_batch_size ||
-                x + 1 == shards.size()) {
-              // Do pacing within the frame.
-              // Also trigger pacing before the first send_batch() of the frame
-              // to account for the last send_batch() of the previous frame.
-              if (ratecontrol_group_packets_sent >= ratecontrol_packets_in_1ms ||
-                  ratecontrol_frame_packets_sent == 0) {
-                auto due = ratecontrol_frame_start +
-                           std::chrono::duration_cast<std::chrono::nanoseconds>(1ms) *
-                             ratecontrol_frame_packets_sent / ratecontrol_packets_in_1ms;
-
-                auto now = std::chrono::steady_clock::now();
-                if (now < due) {
-                  timer->sleep_for(due - now);
+                if (!send_timing.first_send) {
+                  send_timing.first_send = std::chrono::steady_clock::now();
                 }
 
-                ratecontrol_group_packets_sent = 0;
-              }
-
-              size_t current_batch_size = x - next_shard_to_send + 1;
-              batch_info.block_offset = next_shard_to_send;
-              batch_info.block_count = current_batch_size;
-
-              frame_send_batch_latency_logger.first_point_now();
-              // Use a batched send if it's supported on this platform
-              if (!platf::send_batch(batch_info)) {
-                // Batched send is not available, so send each packet individually
-                BOOST_LOG(verbose) << "Falling back to unbatched send"sv;
-                for (auto y = 0; y < current_batch_size; y++) {
-                  auto send_info = platf::send_info_t {
-                    shards.prefix(next_shard_to_send + y),
-                    shards.prefixsize,
-                    shards.data(next_shard_to_send + y),
-                    shards.blocksize,
-                    (uintptr_t) sock.native_handle(),
-                    peer_address,
-                    session->video.peer.port(),
-                    session->localAddress,
-                  };
-
-                  platf::send(send_info);
+                frame_send_batch_latency_logger.first_point_now();
+                // Use a batched send if it's supported on this platform
+                if (!platf::send_batch(batch_info)) {
+                  // Batched send is not available, so send each packet individually
+                  BOOST_LOG(verbose) << "Falling back to unbatched send"sv;
+                  for (auto y = 0; y < current_batch_size; y++) {
+                    auto send_info = platf::send_info_t {
+                      shards.prefix(next_shard_to_send + y),
+                      shards.prefixsize,
+                      shard_payload(next_shard_to_send + y),
+                      shards.blocksize,
+                      (uintptr_t) sock.native_handle(),
+                      peer_address,
+                      session->video.peer.port(),
+                      session->localAddress,
+                    };
+
+                    platf::send(send_info);
+                  }
                 }
-              }
-              frame_send_batch_latency_logger.second_point_now_and_log();
+                frame_send_batch_latency_logger.second_point_now_and_log();
 
-              ratecontrol_group_packets_sent += current_batch_size;
-              ratecontrol_frame_packets_sent += current_batch_size;
-              next_shard_to_send = x + 1;
+                ratecontrol_group_packets_sent += current_batch_size;
+                ratecontrol_frame_packets_sent += current_batch_size;
+                next_shard_to_send = x + 1;
+              }
             }
+          };
+
+          if (early_send) {
+            // Reed-Solomon works on each byte offset independently, so filling in the
+            // headers of the data shards before computing the parity doesn't affect the
+            // recovery of their payload.
+            send_shards(0, shards.data_shards);
+            encode_parity();
+            send_shards(shards.data_shards, shards.size());
+          } else {
+            send_shards(0, shards.size());
           }
 
           // remember this in case the next frame comes immediately
@@ -1639,6 +1998,9 @@ namespace stream {
         });
 
         session->video.lowseq = lowseq;
+
+        send_timing.last_send = std::chrono::steady_clock::now();
+        collect_frame_latency(*session, packet->timing, send_timing);
       } catch (const std::exception &e) {
         BOOST_LOG(error) << "Broadcast video failed "sv << e.what();
         std::this_thread::sleep_for(100ms);
@@ -1650,7 +2012,7 @@ namespace stream {
 
   void audioBroadcastThread(udp::socket &sock) {
     auto shutdown_event = mail::man->event<bool>(mail::broadcast_shutdown);
-    auto packets = mail::man->queue<audio::packet_t>(mail::audio_packets);
+    auto packets = mail::man->ring_queue<audio::packet_t>(mail::audio_packets);
 
     audio_packet_t audio_packet;
     fec::rs_t rs {reed_solomon_new(RTPA_DATA_SHARDS, RTPA_FEC_SHARDS)};
@@ -1669,7 +2031,7 @@ namespace stream {
     audio_packet.rtp.ssrc = 0;
 
     // Audio traffic is sent on this thread
-    platf::adjust_thread_priority(platf::thread_priority_e::high);
+    auto placement = thread_placement::apply(thread_placement::role_e::network, platf::thread_priority_e::high);
 
     while (auto packet = packets->pop()) {
       if (shutdown_event->peek()) {
@@ -1803,6 +2165,13 @@ namespace stream {
 
     ctx.message_queue_queue = std::make_shared<message_queue_queue_t::element_type>(30);
 
+    // Dropping a keyframe would leave the clients without a picture until the next one, the encoder waits for room instead.
+    // Any other packet is dropped when the queue is full, the encoder then sends a keyframe so the clients can resync.
+    ctx.video_packets = mail::man->ring_queue<video::packet_t>(mail::video_packets, VIDEO_PACKETS_CAPACITY, safe::overflow_e::drop_newest, [](const video::packet_t &packet) {
+      return packet->is_idr();
+    });
+    ctx.audio_packets = mail::man->ring_queue<audio::packet_t>(mail::audio_packets, AUDIO_PACKETS_CAPACITY, safe::overflow_e::drop_oldest);
+
     ctx.video_thread = std::thread {videoBroadcastThread, std::ref(ctx.video_sock)};
     ctx.audio_thread = std::thread {audioBroadcastThread, std::ref(ctx.audio_sock)};
     ctx.control_thread = std::thread {controlBroadcastThread, &ctx.control_server};
@@ -1817,12 +2186,9 @@ namespace stream {
 
     broadcast_shutdown_event->raise(true);
 
-    auto video_packets = mail::man->queue<video::packet_t>(mail::video_packets);
-    auto audio_packets = mail::man->queue<audio::packet_t>(mail::audio_packets);
-
     // Minimize delay stopping video/audio threads
-    video_packets->stop();
-    audio_packets->stop();
+    ctx.video_packets->stop();
+    ctx.audio_packets->stop();
 
     ctx.message_queue_queue->stop();
     ctx.io_context.stop();
@@ -1830,8 +2196,14 @@ namespace stream {
     ctx.video_sock.close();
     ctx.audio_sock.close();
 
-    video_packets.reset();
-    audio_packets.reset();
+    for (auto &[id, stats] : mail::man->stats()) {
+      if (stats.dropped) {
+        BOOST_LOG(warning) << "Dropped "sv << stats.dropped << " of "sv << stats.raised << " elements raised into ["sv << id << "], the peak queue size was "sv << stats.high_watermark << '/' << stats.capacity;
+      }
+    }
+
+    ctx.video_packets.reset();
+    ctx.audio_packets.reset();
 
     BOOST_LOG(debug) << "Waiting for main listening thread to end..."sv;
     ctx.recv_thread.join();
@@ -1941,6 +2313,21 @@ namespace stream {
     audio::capture(session->mail, session->config.audio, session);
   }
 
+  nlohmann::json queue_stats(safe::mail_raw_t &mail) {
+    nlohmann::json queues = nlohmann::json::object();
+    for (auto &[id, stats] : mail.stats()) {
+      nlohmann::json queue;
+      queue["capacity"] = stats.capacity;
+      queue["size"] = stats.size;
+      queue["high_watermark"] = stats.high_watermark;
+      queue["raised"] = stats.raised;
+      queue["dropped"] = stats.dropped;
+      queues[id] = queue;
+    }
+
+    return queues;
+  }
+
   namespace session {
     std::atomic_uint running_sessions;
 
@@ -1960,6 +2347,60 @@ namespace stream {
       return session.device_uuid == uuid;
     }
 
+    nlohmann::json latency_stats(session_t &session) {
+      auto to_ms = [](std::chrono::microseconds duration) {
+        return duration.count() / 1000.0;
+      };
+
+      nlohmann::json stats;
+      stats["uuid"] = session.device_uuid;
+      stats["name"] = session.device_name;
+
+      nlohmann::json stages;
+      {
+        auto lg = std::lock_guard(session.latency.mutex);
+        if (session.latency.time_to_first_frame) {
+          stats["time_to_first_frame_ms"] = to_ms(std::chrono::duration_cast<std::chrono::microseconds>(*session.latency.time_to_first_frame));
+        } else {
+          stats["time_to_first_frame_ms"] = nullptr;
+        }
+        stats["warm_resume"] = session.latency.warm_resume;
+
+        for (int x = 0; x < (int) latency_stage_e::_count; ++x) {
+          auto &histogram = session.latency.stages[x];
+
+          nlohmann::json stage;
+          stage["count"] = histogram.count();
+          stage["avg_ms"] = to_ms(histogram.average());
+          stage["p50_ms"] = to_ms(histogram.percentile(0.50));
+          stage["p95_ms"] = to_ms(histogram.percentile(0.95));
+          stage["p99_ms"] = to_ms(histogram.percentile(0.99));
+          stage["max_ms"] = to_ms(histogram.max());
+          stages[std::string {latency_stage_names[x]}] = stage;
+        }
+      }
+      stats["stages"] = stages;
+
+      return stats;
+    }
+
+    nlohmann::json queue_stats(session_t &session) {
+      nlohmann::json stats;
+      stats["uuid"] = session.device_uuid;
+      stats["name"] = session.device_name;
+      stats["queues"] = stream::queue_stats(*session.mail);
+
+      if (session.input) {
+        auto gamepad_stats = input::gamepad_stats(session.input);
+        stats["gamepad_updates"] = {
+          {"forwarded", gamepad_stats.forwarded},
+          {"suppressed", gamepad_stats.suppressed},
+        };
+      }
+
+      return stats;
+    }
+
     bool update_device_info(session_t& session, const std::string& name, const crypto::PERM& newPerm) {
       session.permission = newPerm;
       if (!(newPerm & crypto::PERM::_allow_view)) {
@@ -2022,6 +2463,131 @@ namespace stream {
       session.controlEnd.raise(true);
     }
 
+    /**
+     * @brief What the last session left running, while its client may still come back.
+     */
+    struct warm_t {
+      grace_period_t period;
+      int app_id;  ///< The app running when the last session ended
+      std::unique_ptr<platf::deinit_t> capture;
+      audio::audio_ctx_ref_t audio;
+      thread_pool_util::ThreadPool::task_id_t expire_task;
+    };
+
+    // Also guards running_sessions going from and to zero, with the callbacks that go along with it
+    std::mutex warm_mutex;
+    warm_t warm {};
+
+    /**
+     * @brief Undo what streaming started, once the last session is gone.
+     */
+    void stop_streaming() {
+      bool revert_display_config {config::video.dd.config_revert_on_disconnect};
+      if (proc::proc.running()) {
+        proc::proc.pause();
+      } else {
+        // We have no app running and also no clients anymore.
+        revert_display_config = true;
+      }
+
+      if (revert_display_config) {
+        display_device::revert_configuration();
+      }
+
+      platf::streaming_will_stop();
+    }
+
+    /**
+     * @brief Release what the last session left running, warm_mutex must be held.
+     */
+    void end_warm() {
+      auto expired = std::move(warm);
+      warm = {};
+
+      // Release the capture before the display configuration is reverted
+      expired.capture.reset();
+      expired.audio = {};
+
+      // Warm is only active while no session is running
+      stop_streaming();
+    }
+
+    void expire_warm() {
+      std::lock_guard lg {warm_mutex};
+      if (!warm.period.expired(std::chrono::steady_clock::now())) {
+        // A new session took over or was launched in the meantime
+        return;
+      }
+
+      BOOST_LOG(info) << "Resume grace period ended"sv;
+      end_warm();
+    }
+
+    launch_settings_t launch_settings(const rtsp_stream::launch_session_t &launch_session) {
+      return {launch_session.unique_id, launch_session.width, launch_session.height, launch_session.fps, launch_session.enable_hdr};
+    }
+
+    void grace_period_t::begin(launch_settings_t settings, std::chrono::steady_clock::time_point expire_time) {
+      this->settings = std::move(settings);
+      this->expire_time = expire_time;
+    }
+
+    bool grace_period_t::claim(const launch_settings_t &settings, std::chrono::steady_clock::time_point expire_time) {
+      if (!matches(settings)) {
+        return false;
+      }
+
+      this->expire_time = expire_time;
+      return true;
+    }
+
+    bool grace_period_t::matches(const launch_settings_t &settings) const {
+      return this->settings && *this->settings == settings;
+    }
+
+    bool grace_period_t::expired(std::chrono::steady_clock::time_point now) const {
+      return settings && now >= expire_time;
+    }
+
+    bool grace_period_t::active() const {
+      return settings.has_value();
+    }
+
+    void grace_period_t::end() {
+      settings.reset();
+    }
+
+    bool claim_warm(const rtsp_stream::launch_session_t &launch_session) {
+      std::lock_guard lg {warm_mutex};
+      if (!warm.period.active()) {
+        return false;
+      }
+
+      // The launched session has as long to start as the launch session itself,
+      // an expire task already running sees the new expire time
+      if (warm.period.claim(launch_settings(launch_session), std::chrono::steady_clock::now() + config::stream.ping_timeout)) {
+        task_pool.cancel(warm.expire_task);
+        warm.expire_task = task_pool.pushDelayed(expire_warm, config::stream.ping_timeout).task_id;
+        return true;
+      }
+
+      // The display is set up for another client or other stream settings
+      BOOST_LOG(info) << "Ending the resume grace period, the stream is launched differently"sv;
+      task_pool.cancel(warm.expire_task);
+      end_warm();
+      return false;
+    }
+
+    void shutdown() {
+      std::lock_guard lg {warm_mutex};
+      if (!warm.period.active()) {
+        return;
+      }
+
+      task_pool.cancel(warm.expire_task);
+      end_warm();
+    }
+
     void join(session_t &session) {
       // Current Nvidia drivers have a bug where NVENC can deadlock the encoder thread with hardware-accelerated
       // GPU scheduling enabled. If this happens, we will terminate ourselves and the service can restart.
@@ -2037,6 +2603,17 @@ namespace stream {
         task_pool.cancel(force_kill);
       });
 
+      // Grab the capture before the video thread lets go of it, in case this is the last session
+      auto grace_period = config::stream.resume_grace_period;
+      std::unique_ptr<platf::deinit_t> capture_hold;
+      audio::audio_ctx_ref_t audio_hold;
+      if (grace_period > 0ms) {
+        capture_hold = video::hold_capture();
+        audio_hold = audio::get_existing_audio_ctx_ref();
+      }
+      session.resumed.capture.reset();
+      session.resumed.audio = {};
+
       BOOST_LOG(debug) << "Waiting for video to end..."sv;
       session.videoThread.join();
       BOOST_LOG(debug) << "Waiting for audio to end..."sv;
@@ -2047,6 +2624,11 @@ namespace stream {
       BOOST_LOG(debug) << "Resetting Input..."sv;
       input::reset(session.input);
 
+      auto gamepad_stats = input::gamepad_stats(session.input);
+      if (gamepad_stats.forwarded || gamepad_stats.suppressed) {
+        BOOST_LOG(debug) << "Gamepad updates forwarded: "sv << gamepad_stats.forwarded << ", suppressed as unchanged: "sv << gamepad_stats.suppressed;
+      }
+
       if (!session.undo_cmds.empty()) {
         auto exec_thread = std::thread([cmd_list = session.undo_cmds]{
           for (auto &cmd : cmd_list) {
@@ -2067,20 +2649,25 @@ namespace stream {
       }
 
       // If this is the last session, invoke the platform callbacks
+      std::lock_guard lg {warm_mutex};
       if (--running_sessions == 0) {
-        bool revert_display_config {config::video.dd.config_revert_on_disconnect};
-        if (proc::proc.running()) {
-          proc::proc.pause();
+        auto app_id = proc::proc.running();
+        if (grace_period > 0ms && app_id) {
+          // Leave the app, the display configuration and the capture as they are for a while,
+          // a client reconnecting in the meantime resumes without setting them up again
+          BOOST_LOG(info) << "Keeping the stream warm for "sv << grace_period.count() << "ms"sv;
+
+          warm.period.begin(session.launch_settings, std::chrono::steady_clock::now() + grace_period);
+          warm.app_id = app_id;
+          warm.capture = std::move(capture_hold);
+          warm.audio = std::move(audio_hold);
+          warm.expire_task = task_pool.pushDelayed(expire_warm, grace_period).task_id;
         } else {
-          // We have no app running and also no clients anymore.
-          revert_display_config = true;
-        }
+          capture_hold.reset();
+          audio_hold = {};
 
-        if (revert_display_config) {
-          display_device::revert_configuration();
+          stop_streaming();
         }
-
-        platf::streaming_will_stop();
       }
 
       BOOST_LOG(debug) << "Session ended"sv;
@@ -2097,12 +2684,6 @@ namespace stream {
       session.control.expected_peer_address = addr_string;
       BOOST_LOG(debug) << "Expecting incoming session connections from "sv << addr_string;
 
-      // Insert this session into the session list
-      {
-        auto lg = session.broadcast_ref->control_server._sessions.lock();
-        session.broadcast_ref->control_server._sessions->push_back(&session);
-      }
-
       auto addr = boost::asio::ip::make_address(addr_string);
       session.video.peer.address(addr);
       session.video.peer.port(0);
@@ -2110,19 +2691,54 @@ namespace stream {
       session.audio.peer.address(addr);
       session.audio.peer.port(0);
 
+      // Before the session is published, the control thread may check it right away
       session.pingTimeout = std::chrono::steady_clock::now() + config::stream.ping_timeout;
 
+      // Insert this session into the session list
+      session.broadcast_ref->control_server.add_session(&session);
+
+      // Take over what the last session left running, the session holds it until it ends
+      warm_t resumed {};
+      {
+        std::lock_guard lg {warm_mutex};
+        if (warm.period.matches(session.launch_settings)) {
+          task_pool.cancel(warm.expire_task);
+          resumed = std::move(warm);
+          warm = {};
+        } else if (warm.period.active()) {
+          // Launched without claiming the grace period first
+          task_pool.cancel(warm.expire_task);
+          end_warm();
+        }
+
+        // If this is the first session, invoke the platform callbacks
+        if (++running_sessions == 1) {
+          if (!resumed.period.active()) {
+            platf::streaming_will_start();
+            proc::proc.resume();
+          } else if (proc::proc.running() != resumed.app_id) {
+            // The app changed during the grace period, the new one has to be resumed
+            proc::proc.resume();
+          } else {
+            BOOST_LOG(info) << "Resuming warm stream"sv;
+          }
+        }
+      }
+
+      {
+        auto lg = std::lock_guard(session.latency.mutex);
+        session.latency.start_time = std::chrono::steady_clock::now();
+        session.latency.warm_resume = resumed.period.active() && resumed.capture;
+      }
+
+      session.resumed.capture = std::move(resumed.capture);
+      session.resumed.audio = std::move(resumed.audio);
+
       session.audioThread = std::thread {audioThread, &session};
       session.videoThread = std::thread {videoThread, &session};
 
       session.state.store(state_e::RUNNING, std::memory_order_relaxed);
 
-      // If this is the first session, invoke the platform callbacks
-      if (++running_sessions == 1) {
-        platf::streaming_will_start();
-        proc::proc.resume();
-      }
-
       if (!session.do_cmds.empty()) {
         auto exec_thread = std::thread([cmd_list = session.do_cmds]{
           for (auto &cmd : cmd_list) {
@@ -2152,6 +2768,7 @@ namespace stream {
 
       session->shutdown_event = mail->event<bool>(mail::shutdown);
       session->launch_session_id = launch_session.id;
+      session->launch_settings = launch_settings(launch_session);
       session->device_name = launch_session.device_name;
       session->device_uuid = launch_session.unique_id;
       session->permission = launch_session.perm;
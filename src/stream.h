@@ -5,16 +5,25 @@
 #pragma once
 
 // standard includes
+#include <chrono>
+#include <optional>
+#include <string>
 #include <utility>
 
 // lib includes
 #include <boost/asio.hpp>
+#include <nlohmann/json.hpp>
 
 // local includes
 #include "audio.h"
 #include "crypto.h"
 #include "video.h"
 
+// forward declarations
+namespace rtsp_stream {
+  struct launch_session_t;
+}
+
 namespace stream {
   constexpr auto VIDEO_STREAM_PORT = 9;
   constexpr auto CONTROL_PORT = 10;
@@ -38,6 +47,13 @@ namespace stream {
     std::optional<int> gcmap;
   };
 
+  /**
+   * @brief Get the counters of the events and queues posted to a mailbox.
+   * @param mail The mailbox, mail::man for the queues shared by all sessions.
+   * @return JSON object with the capacity, size, high watermark, raised and dropped counts, by mail id.
+   */
+  nlohmann::json queue_stats(safe::mail_raw_t &mail);
+
   namespace session {
     enum class state_e : int {
       STOPPED,  ///< The session is stopped
@@ -46,9 +62,97 @@ namespace stream {
       RUNNING,  ///< The session is running
     };
 
+    /**
+     * @brief The client a session was launched for, and the stream settings the display was configured with.
+     */
+    struct launch_settings_t {
+      std::string client_uuid;
+      int width;
+      int height;
+      int fps;
+      bool enable_hdr;
+
+      bool operator==(const launch_settings_t &) const = default;
+    };
+
+    /**
+     * @brief Get the settings a session is launched with.
+     * @param launch_session The launch session.
+     * @return The client and the stream settings of the launch session.
+     */
+    launch_settings_t launch_settings(const rtsp_stream::launch_session_t &launch_session);
+
+    /**
+     * @brief The resume grace period, in which a session launched like the last one may take over what it left running.
+     */
+    class grace_period_t {
+    public:
+      /**
+       * @brief Start the grace period after the last session ended.
+       * @param settings The settings the last session was launched with.
+       * @param expire_time When the grace period ends unless claimed.
+       */
+      void begin(launch_settings_t settings, std::chrono::steady_clock::time_point expire_time);
+
+      /**
+       * @brief Keep the grace period running for a session about to be launched.
+       * @param settings The settings the session is launched with.
+       * @param expire_time When the grace period ends if the session doesn't start.
+       * @return True if the grace period is running and the settings are the same as the last session's.
+       */
+      bool claim(const launch_settings_t &settings, std::chrono::steady_clock::time_point expire_time);
+
+      /**
+       * @brief Check if a session launched with the given settings may take over the grace period.
+       */
+      bool matches(const launch_settings_t &settings) const;
+
+      /**
+       * @brief Check if the grace period is running, but no longer should.
+       */
+      bool expired(std::chrono::steady_clock::time_point now) const;
+
+      bool active() const;
+      void end();
+
+    private:
+      std::optional<launch_settings_t> settings;
+      std::chrono::steady_clock::time_point expire_time;
+    };
+
     std::shared_ptr<session_t> alloc(config_t &config, rtsp_stream::launch_session_t &launch_session);
     std::string uuid(const session_t& session);
     bool uuid_match(const session_t& session, const std::string_view& uuid);
+
+    /**
+     * @brief Get per-stage frame latency percentiles collected over the lifetime of the session.
+     * @param session The session to report on.
+     * @return JSON object with the session identity, the time to the first frame and count/avg/p50/p95/p99/max per stage.
+     */
+    nlohmann::json latency_stats(session_t &session);
+
+    /**
+     * @brief Get the counters of the queues between the capture and encode threads of the session.
+     * @param session The session to report on.
+     * @return JSON object with the session identity and the counters of its queues, by mail id.
+     */
+    nlohmann::json queue_stats(session_t &session);
+
+    /**
+     * @brief Keep what the last session left running for a session about to be launched.
+     * @details Within the resume grace period, the app, the display configuration and the capture
+     *          are kept as the last session left them until the launched session starts or times out.
+     *          A session launched by another client or with other stream settings ends the grace period.
+     * @param launch_session The session about to be launched.
+     * @return True if the last session ended within the resume grace period, and was launched the same way.
+     */
+    bool claim_warm(const rtsp_stream::launch_session_t &launch_session);
+
+    /**
+     * @brief End the resume grace period now, as Sunshine exits.
+     * @note Must be called before the task pool is stopped, it would otherwise never end.
+     */
+    void shutdown();
     bool update_device_info(session_t& session, const std::string& name, const crypto::PERM& newPerm);
     int start(session_t &session, const std::string &addr_string);
     void stop(session_t &session);
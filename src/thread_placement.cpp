@@ -0,0 +1,132 @@
+/**
+ * @file src/thread_placement.cpp
+ * @brief Definitions for placing the threads of the media pipeline on CPUs.
+ */
+// standard includes
+#include <list>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// local includes
+#include "config.h"
+#include "logging.h"
+#include "thread_placement.h"
+
+using namespace std::literals;
+
+namespace thread_placement {
+  namespace {
+    struct placement_t {
+      role_e role;
+      platf::thread_priority_e priority;
+      std::string thread_id;
+      std::string scheduling;
+      std::vector<int> cpus;
+      std::optional<int> numa_node;
+    };
+
+    std::mutex placements_mutex;
+    std::list<placement_t> placements;
+
+    const std::vector<int> &configured_cpus(role_e role) {
+      switch (role) {
+        case role_e::capture:
+          return config::sunshine.capture_cpus;
+        case role_e::encode:
+          return config::sunshine.encode_cpus;
+        case role_e::audio:
+          return config::sunshine.audio_cpus;
+        case role_e::network:
+        default:
+          return config::sunshine.network_cpus;
+      }
+    }
+
+    std::string_view to_string(platf::thread_priority_e priority) {
+      switch (priority) {
+        case platf::thread_priority_e::low:
+          return "low"sv;
+        case platf::thread_priority_e::normal:
+          return "normal"sv;
+        case platf::thread_priority_e::high:
+          return "high"sv;
+        case platf::thread_priority_e::critical:
+        default:
+          return "critical"sv;
+      }
+    }
+
+    class registration_t: public platf::deinit_t {
+    public:
+      explicit registration_t(std::list<placement_t>::iterator placement):
+          placement {placement} {
+      }
+
+      ~registration_t() override {
+        std::lock_guard lg {placements_mutex};
+        placements.erase(placement);
+      }
+
+      std::list<placement_t>::iterator placement;
+    };
+  }  // namespace
+
+  std::string_view to_string(role_e role) {
+    switch (role) {
+      case role_e::capture:
+        return "capture"sv;
+      case role_e::encode:
+        return "encode"sv;
+      case role_e::audio:
+        return "audio"sv;
+      case role_e::network:
+      default:
+        return "network"sv;
+    }
+  }
+
+  std::unique_ptr<platf::deinit_t> apply(role_e role, platf::thread_priority_e priority) {
+    placement_t placement {role, priority};
+
+    std::ostringstream thread_id;
+    thread_id << std::this_thread::get_id();
+    placement.thread_id = thread_id.str();
+
+    placement.scheduling = platf::adjust_thread_priority(priority);
+
+    // The memory policy follows the affinity, so buffers allocated by the thread afterwards stay close to it
+    auto &cpus = configured_cpus(role);
+    if (!cpus.empty() && platf::set_thread_affinity(cpus)) {
+      placement.cpus = cpus;
+      placement.numa_node = platf::prefer_local_memory(cpus);
+    }
+
+    BOOST_LOG(debug) << "Placed "sv << to_string(role) << " thread "sv << placement.thread_id << ": "sv
+                     << placement.scheduling << ", "sv << placement.cpus.size() << " CPUs"sv;
+
+    std::lock_guard lg {placements_mutex};
+    return std::make_unique<registration_t>(placements.insert(std::end(placements), std::move(placement)));
+  }
+
+  nlohmann::json report() {
+    nlohmann::json threads = nlohmann::json::array();
+
+    std::lock_guard lg {placements_mutex};
+    for (auto &placement : placements) {
+      nlohmann::json thread;
+      thread["role"] = to_string(placement.role);
+      thread["thread_id"] = placement.thread_id;
+      thread["priority"] = to_string(placement.priority);
+      thread["scheduling"] = placement.scheduling;
+      thread["cpus"] = placement.cpus;
+      thread["numa_node"] = placement.numa_node ? nlohmann::json(*placement.numa_node) : nlohmann::json();
+      threads.push_back(thread);
+    }
+
+    return threads;
+  }
+}  // namespace thread_placement
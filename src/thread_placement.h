@@ -0,0 +1,54 @@
+/**
+ * @file src/thread_placement.h
+ * @brief Declarations for placing the threads of the media pipeline on CPUs.
+ */
+#pragma once
+
+// standard includes
+#include <memory>
+#include <string_view>
+
+// lib includes
+#include <nlohmann/json.hpp>
+
+// local includes
+#include "platform/common.h"
+
+namespace thread_placement {
+  /**
+   * @brief The part of the media pipeline a thread belongs to.
+   */
+  enum class role_e : int {
+    capture,  ///< Video capture
+    encode,  ///< Video encoding, and capture when both take place on the same thread
+    audio,  ///< Audio capture and encoding
+    network,  ///< Sending video and audio, and the control stream
+  };
+
+  /**
+   * @brief Get the name of a role, as used in the configuration and the troubleshooting API.
+   * @param role The role.
+   * @return The name of the role.
+   */
+  std::string_view to_string(role_e role);
+
+  /**
+   * @brief Apply the priority and the CPUs configured for a role to the calling thread.
+   * @details With `realtime_threads` enabled, the thread is scheduled with SCHED_FIFO when permitted.
+   *          A thread restricted to CPUs of a single NUMA node prefers the memory of that node,
+   *          so the buffers it allocates afterwards are local to it.
+   * @param role The role of the calling thread.
+   * @param priority The priority of the calling thread.
+   * @return The placement is reported until the returned object is destroyed, it must not outlive the thread.
+   * @examples
+   * auto placement = thread_placement::apply(thread_placement::role_e::capture, platf::thread_priority_e::critical);
+   * @examples_end
+   */
+  [[nodiscard]] std::unique_ptr<platf::deinit_t> apply(role_e role, platf::thread_priority_e priority);
+
+  /**
+   * @brief Get the placement of the threads currently running.
+   * @return An array with the role, scheduling, CPUs and NUMA node of every thread.
+   */
+  nlohmann::json report();
+}  // namespace thread_placement
@@ -9,14 +9,28 @@
 #include <atomic>
 #include <condition_variable>
 #include <functional>
+#include <bit>
 #include <map>
+#include <memory>
 #include <mutex>
+#include <optional>
 #include <vector>
 
 // local includes
 #include "utility.h"
 
 namespace safe {
+  /**
+   * @brief Counters of the elements passed through an event or a queue, since it was created.
+   */
+  struct queue_stats_t {
+    std::size_t capacity;
+    std::size_t size;  ///< Elements waiting to be popped
+    std::size_t high_watermark;  ///< Largest size so far
+    std::uint64_t raised;
+    std::uint64_t dropped;  ///< Raised elements that were discarded before anyone popped them
+  };
+
   template<class T>
   class event_t {
   public:
@@ -29,6 +43,12 @@ namespace safe {
         return;
       }
 
+      ++_raised;
+      if (_status && !_viewed) {
+        ++_dropped;
+      }
+      _viewed = false;
+
       if constexpr (std::is_same_v<std::optional<T>, status_t>) {
         _status = std::make_optional<T>(std::forward<Args>(args)...);
       } else {
@@ -95,6 +115,7 @@ namespace safe {
         }
       }
 
+      _viewed = true;
       return _status;
     }
 
@@ -113,6 +134,7 @@ namespace safe {
         }
       }
 
+      _viewed = true;
       return _status;
     }
 
@@ -140,10 +162,20 @@ namespace safe {
       return _continue;
     }
 
+    queue_stats_t stats() {
+      std::lock_guard lg {_lock};
+
+      return {1, _status ? 1u : 0u, _raised ? 1u : 0u, _raised, _dropped};
+    }
+
   private:
     bool _continue {true};
     status_t _status {util::false_v<status_t>};
 
+    bool _viewed {false};  ///< Replacing a status that was viewed doesn't count as dropping it
+    std::uint64_t _raised {0};
+    std::uint64_t _dropped {0};
+
     std::condition_variable _cv;
     std::mutex _lock;
   };
@@ -266,11 +298,14 @@ namespace safe {
         return;
       }
 
+      ++_raised;
       if (_queue.size() == _max_elements) {
+        _dropped += _queue.size();
         _queue.clear();
       }
 
       _queue.emplace_back(std::forward<Args>(args)...);
+      _high_watermark = std::max(_high_watermark, _queue.size());
 
       _cv.notify_all();
     }
@@ -336,6 +371,12 @@ namespace safe {
       return _continue;
     }
 
+    queue_stats_t stats() {
+      std::lock_guard lg {_lock};
+
+      return {_max_elements, _queue.size(), _high_watermark, _raised, _dropped};
+    }
+
   private:
     bool _continue {true};
     std::uint32_t _max_elements;
@@ -344,6 +385,291 @@ namespace safe {
     std::condition_variable _cv;
 
     std::vector<T> _queue;
+
+    std::size_t _high_watermark {0};
+    std::uint64_t _raised {0};
+    std::uint64_t _dropped {0};
+  };
+
+  /**
+   * @brief What a full queue does with a newly raised element.
+   */
+  enum class overflow_e {
+    drop_oldest,  ///< Discard the oldest queued element to make room
+    drop_newest,  ///< Discard the raised element
+    block,  ///< Wait until a consumer made room, or until the queue is stopped
+  };
+
+  /**
+   * @brief Bounded queue on a lock-free ring buffer, for elements passed between the threads of the media pipeline.
+   * @details Same interface as queue_t, but raising and popping only take a lock to put a thread to sleep or to wake it.
+   *          Any number of threads may raise and pop concurrently.
+   *          Each slot carries a sequence number that tells producers and consumers whose turn it is.
+   */
+  template<class T>
+  class ring_queue_t {
+  public:
+    using status_t = util::optional_t<T>;
+    using keep_f = std::function<bool(const T &)>;
+
+    /**
+     * @param max_elements The capacity, rounded up to a power of two.
+     * @param overflow What raising an element does while the queue is full.
+     * @param keep Elements it returns true for are never dropped when raised, raising them into a full queue blocks instead.
+     *             Combine it with overflow_e::drop_newest, so queued elements are never dropped either.
+     */
+    explicit ring_queue_t(std::uint32_t max_elements = 32, overflow_e overflow = overflow_e::drop_oldest, keep_f keep = nullptr):
+        _overflow {overflow},
+        _keep {std::move(keep)},
+        _mask {std::bit_ceil(std::max<std::size_t>(max_elements, 2)) - 1},
+        _slots {std::make_unique<slot_t[]>(_mask + 1)} {
+      for (std::size_t x = 0; x <= _mask; ++x) {
+        _slots[x].sequence.store(x, std::memory_order_relaxed);
+      }
+    }
+
+    /**
+     * @return true if the element was queued, false if it was dropped or the queue is stopped.
+     */
+    template<class... Args>
+    bool raise(Args &&...args) {
+      T val(std::forward<Args>(args)...);
+
+      auto overflow = _keep && _keep(val) ? overflow_e::block : _overflow;
+      while (_continue.load(std::memory_order_acquire)) {
+        if (try_push(val)) {
+          _raised.fetch_add(1, std::memory_order_relaxed);
+          update_high_watermark();
+          wake(_popping, _pop_cv);
+          return true;
+        }
+
+        switch (overflow) {
+          case overflow_e::drop_newest:
+            _raised.fetch_add(1, std::memory_order_relaxed);
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+          case overflow_e::drop_oldest:
+            if (try_pop()) {
+              _dropped.fetch_add(1, std::memory_order_relaxed);
+            }
+            continue;
+          case overflow_e::block:
+            wait(_raising, _raise_cv, [this]() {
+              return !full();
+            });
+            continue;
+        }
+      }
+
+      return false;
+    }
+
+    bool peek() {
+      return _continue.load(std::memory_order_acquire) && ready();
+    }
+
+    template<class Rep, class Period>
+    status_t pop(std::chrono::duration<Rep, Period> delay) {
+      auto deadline = std::chrono::steady_clock::now() + delay;
+
+      while (_continue.load(std::memory_order_acquire)) {
+        if (auto val = try_pop()) {
+          wake(_raising, _raise_cv);
+          return val;
+        }
+
+        if (!wait(_popping, _pop_cv, [this]() { return ready(); }, deadline)) {
+          break;
+        }
+      }
+
+      return util::false_v<status_t>;
+    }
+
+    status_t pop() {
+      while (_continue.load(std::memory_order_acquire)) {
+        if (auto val = try_pop()) {
+          wake(_raising, _raise_cv);
+          return val;
+        }
+
+        wait(_popping, _pop_cv, [this]() {
+          return ready();
+        });
+      }
+
+      return util::false_v<status_t>;
+    }
+
+    void stop() {
+      std::lock_guard lg {_lock};
+
+      _continue.store(false, std::memory_order_release);
+
+      _pop_cv.notify_all();
+      _raise_cv.notify_all();
+    }
+
+    [[nodiscard]] bool running() const {
+      return _continue.load(std::memory_order_acquire);
+    }
+
+    [[nodiscard]] std::size_t capacity() const {
+      return _mask + 1;
+    }
+
+    queue_stats_t stats() const {
+      return {
+        capacity(),
+        size(),
+        _high_watermark.load(std::memory_order_relaxed),
+        _raised.load(std::memory_order_relaxed),
+        _dropped.load(std::memory_order_relaxed),
+      };
+    }
+
+  private:
+    struct slot_t {
+      std::atomic_size_t sequence;
+      std::optional<T> value;
+    };
+
+    /**
+     * @brief Moves from val only if there is room for it.
+     */
+    bool try_push(T &val) {
+      auto pos = _tail.load(std::memory_order_relaxed);
+      while (true) {
+        auto &slot = _slots[pos & _mask];
+        auto diff = (std::ptrdiff_t) (slot.sequence.load(std::memory_order_acquire) - pos);
+
+        if (diff == 0) {
+          if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+            slot.value.emplace(std::move(val));
+            slot.sequence.store(pos + 1, std::memory_order_release);
+
+            return true;
+          }
+        } else if (diff < 0) {
+          // The slot still holds the element raised one lap ago
+          return false;
+        } else {
+          pos = _tail.load(std::memory_order_relaxed);
+        }
+      }
+    }
+
+    status_t try_pop() {
+      auto pos = _head.load(std::memory_order_relaxed);
+      while (true) {
+        auto &slot = _slots[pos & _mask];
+        auto diff = (std::ptrdiff_t) (slot.sequence.load(std::memory_order_acquire) - (pos + 1));
+
+        if (diff == 0) {
+          if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+            status_t val = std::move(*slot.value);
+            slot.value.reset();
+            slot.sequence.store(pos + _mask + 1, std::memory_order_release);
+
+            return val;
+          }
+        } else if (diff < 0) {
+          // Empty, or the element in this slot isn't fully raised yet
+          return util::false_v<status_t>;
+        } else {
+          pos = _head.load(std::memory_order_relaxed);
+        }
+      }
+    }
+
+    /**
+     * @brief Check if the next element to pop has been raised.
+     */
+    bool ready() const {
+      auto pos = _head.load(std::memory_order_acquire);
+      return _slots[pos & _mask].sequence.load(std::memory_order_acquire) == pos + 1;
+    }
+
+    /**
+     * @brief Get the number of raised elements that weren't popped yet, including ones still being raised.
+     */
+    std::size_t size() const {
+      auto head = _head.load(std::memory_order_acquire);
+      auto tail = _tail.load(std::memory_order_acquire);
+
+      return tail > head ? std::min(tail - head, capacity()) : 0;
+    }
+
+    void update_high_watermark() {
+      auto current = size();
+      auto high_watermark = _high_watermark.load(std::memory_order_relaxed);
+      while (current > high_watermark && !_high_watermark.compare_exchange_weak(high_watermark, current, std::memory_order_relaxed)) {}
+    }
+
+    /**
+     * @brief Check if the next slot to raise into is still taken.
+     */
+    bool full() const {
+      auto pos = _tail.load(std::memory_order_acquire);
+      return _slots[pos & _mask].sequence.load(std::memory_order_acquire) != pos;
+    }
+
+    /**
+     * @brief Sleep until the condition holds, the queue is stopped or the deadline passed.
+     * @return false if the deadline passed.
+     */
+    template<class F>
+    bool wait(std::atomic_uint &waiting, std::condition_variable &cv, F &&condition, std::optional<std::chrono::steady_clock::time_point> deadline = std::nullopt) {
+      std::unique_lock ul {_lock};
+
+      // Announce the sleeper before checking the condition, a thread changing it afterwards sees it and wakes us
+      waiting.fetch_add(1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      auto fg = util::fail_guard([&waiting]() {
+        waiting.fetch_sub(1, std::memory_order_relaxed);
+      });
+
+      auto done = [&]() {
+        return !_continue.load(std::memory_order_acquire) || condition();
+      };
+
+      if (!deadline) {
+        cv.wait(ul, done);
+        return true;
+      }
+
+      return cv.wait_until(ul, *deadline, done);
+    }
+
+    void wake(std::atomic_uint &waiting, std::condition_variable &cv) {
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (waiting.load(std::memory_order_relaxed)) {
+        std::lock_guard lg {_lock};
+        cv.notify_all();
+      }
+    }
+
+    std::atomic_bool _continue {true};
+    overflow_e _overflow;
+    keep_f _keep;
+
+    std::size_t _mask;
+    std::unique_ptr<slot_t[]> _slots;
+
+    // Kept on separate cache lines, producers and consumers update them from different threads
+    alignas(64) std::atomic_size_t _tail {0};
+    alignas(64) std::atomic_size_t _head {0};
+
+    std::mutex _lock;
+    std::atomic_uint _popping {0};
+    std::atomic_uint _raising {0};
+    std::condition_variable _pop_cv;
+    std::condition_variable _raise_cv;
+
+    std::atomic_size_t _high_watermark {0};
+    std::atomic_uint64_t _raised {0};
+    std::atomic_uint64_t _dropped {0};
   };
 
   template<class T>
@@ -451,6 +777,22 @@ namespace safe {
       return ptr_t {this};
     }
 
+    /**
+     * @brief Get another reference to the object, without constructing it if nobody holds one.
+     * @return The reference, empty if the object doesn't exist.
+     */
+    [[nodiscard]] ptr_t ref_existing() {
+      std::lock_guard lg {_lock};
+
+      if (!_count) {
+        return ptr_t {nullptr};
+      }
+
+      ++_count;
+
+      return ptr_t {this};
+    }
+
   private:
     construct_f _construct;
     destruct_f _destruct;
@@ -506,33 +848,54 @@ namespace safe {
     using queue_t = std::shared_ptr<post_t<queue_t<T>>>;
 
     template<class T>
-    event_t<T> event(const std::string_view &id) {
-      std::lock_guard lg {mutex};
-
-      auto it = id_to_post.find(id);
-      if (it != std::end(id_to_post)) {
-        return lock<event_t<T>>(it->second);
-      }
-
-      auto post = std::make_shared<typename event_t<T>::element_type>(shared_from_this());
-      id_to_post.emplace(std::pair<std::string, std::weak_ptr<void>> {std::string {id}, post});
+    using ring_queue_t = std::shared_ptr<post_t<ring_queue_t<T>>>;
 
-      return post;
+    template<class T>
+    event_t<T> event(const std::string_view &id) {
+      return post<event_t<T>>(id);
     }
 
+    /**
+     * @brief Get the queue posted under an id, creating it on first use.
+     * @param id The id of the queue.
+     * @param max_elements The capacity of the queue, if it gets created.
+     */
     template<class T>
-    queue_t<T> queue(const std::string_view &id) {
-      std::lock_guard lg {mutex};
+    queue_t<T> queue(const std::string_view &id, std::uint32_t max_elements = 32) {
+      return post<queue_t<T>>(id, max_elements);
+    }
 
-      auto it = id_to_post.find(id);
-      if (it != std::end(id_to_post)) {
-        return lock<queue_t<T>>(it->second);
+    /**
+     * @brief Get the lock-free queue posted under an id, creating it on first use.
+     * @param id The id of the queue.
+     * @param max_elements The capacity of the queue, if it gets created.
+     * @param overflow What raising into the full queue does, if it gets created.
+     * @param keep The elements that are never dropped when raised, if it gets created.
+     */
+    template<class T>
+    ring_queue_t<T> ring_queue(const std::string_view &id, std::uint32_t max_elements = 32, overflow_e overflow = overflow_e::drop_oldest, typename safe::ring_queue_t<T>::keep_f keep = nullptr) {
+      return post<ring_queue_t<T>>(id, max_elements, overflow, std::move(keep));
+    }
+
+    /**
+     * @brief Get the counters of every event and queue currently posted, by id.
+     */
+    std::map<std::string, queue_stats_t, std::less<>> stats() {
+      std::vector<std::pair<std::string, std::function<std::optional<queue_stats_t>()>>> posts;
+      {
+        std::lock_guard lg {mutex};
+        posts.assign(std::begin(id_to_stats), std::end(id_to_stats));
       }
 
-      auto post = std::make_shared<typename queue_t<T>::element_type>(shared_from_this(), 32);
-      id_to_post.emplace(std::pair<std::string, std::weak_ptr<void>> {std::string {id}, post});
+      // Outside the lock, the last reference to a post may be released in here, which calls cleanup()
+      std::map<std::string, queue_stats_t, std::less<>> result;
+      for (auto &[id, stats] : posts) {
+        if (auto post_stats = stats()) {
+          result.emplace(std::move(id), *post_stats);
+        }
+      }
 
-      return post;
+      return result;
     }
 
     void cleanup() {
@@ -542,6 +905,9 @@ namespace safe {
         auto &weak = it->second;
 
         if (weak.expired()) {
+          if (auto stats = id_to_stats.find(it->first); stats != std::end(id_to_stats)) {
+            id_to_stats.erase(stats);
+          }
           id_to_post.erase(it);
 
           return;
@@ -549,9 +915,34 @@ namespace safe {
       }
     }
 
+  private:
+    template<class P, class... Args>
+    P post(const std::string_view &id, Args &&...args) {
+      std::lock_guard lg {mutex};
+
+      auto it = id_to_post.find(id);
+      if (it != std::end(id_to_post)) {
+        return lock<P>(it->second);
+      }
+
+      auto post = std::make_shared<typename P::element_type>(shared_from_this(), std::forward<Args>(args)...);
+      id_to_post.emplace(std::pair<std::string, std::weak_ptr<void>> {std::string {id}, post});
+      id_to_stats.emplace(std::string {id}, [weak = std::weak_ptr {post}]() -> std::optional<queue_stats_t> {
+        auto post = weak.lock();
+        if (!post) {
+          return std::nullopt;
+        }
+
+        return post->stats();
+      });
+
+      return post;
+    }
+
     std::mutex mutex;
 
     std::map<std::string, std::weak_ptr<void>, std::less<>> id_to_post;
+    std::map<std::string, std::function<std::optional<queue_stats_t>()>, std::less<>> id_to_stats;
   };
 
   inline void cleanup(mail_raw_t *mail) {
@@ -5,7 +5,11 @@
 // standard includes
 #include <atomic>
 #include <bitset>
+#include <filesystem>
+#include <fstream>
 #include <list>
+#include <map>
+#include <mutex>
 #include <thread>
 
 // lib includes
@@ -28,7 +32,9 @@ extern "C" {
 #include "logging.h"
 #include "nvenc/nvenc_base.h"
 #include "platform/common.h"
+#include "rtsp.h"
 #include "sync.h"
+#include "thread_placement.h"
 #include "video.h"
 
 #ifdef _WIN32
@@ -432,7 +438,7 @@ namespace video {
   struct sync_session_ctx_t {
     safe::signal_t *join_event;
     safe::mail_raw_t::event_t<bool> shutdown_event;
-    safe::mail_raw_t::queue_t<packet_t> packets;
+    safe::mail_raw_t::ring_queue_t<packet_t> packets;
     safe::mail_raw_t::event_t<bool> idr_events;
     safe::mail_raw_t::event_t<hdr_info_t> hdr_events;
     safe::mail_raw_t::event_t<input::touch_port_t> touch_port_events;
@@ -1041,6 +1047,10 @@ namespace video {
   };
 
   static encoder_t *chosen_encoder;
+  static std::mutex probe_mutex;
+  static bool force_reprobe = false;
+  // The codec modes the last encoder loaded from the capability cache was validated with
+  static std::pair<int, int> cached_validation_modes;
   int active_hevc_mode;
   int active_av1_mode;
   bool last_encoder_probe_supported_ref_frames_invalidation = false;
@@ -1156,6 +1166,9 @@ namespace video {
     }
     capture_ctxs.emplace_back(std::move(*initial_capture_ctx));
 
+    // The capture may outlive all sessions during the resume grace period, reinitialize with the last known config then
+    auto display_config = capture_ctxs.front().config;
+
     std::vector<std::string> display_names;
     int display_p = -1;
     std::shared_ptr<platf::display_t> disp;
@@ -1274,7 +1287,7 @@ namespace video {
     };
 
     // Capture takes place on this thread
-    platf::adjust_thread_priority(platf::thread_priority_e::critical);
+    auto placement = thread_placement::apply(thread_placement::role_e::capture, platf::thread_priority_e::critical);
 
     while (capture_ctx_queue->running()) {
       bool artificial_reinit = false;
@@ -1365,8 +1378,12 @@ namespace video {
                 display_p = std::clamp(*switch_display_event->pop(), 0, (int) display_names.size() - 1);
               }
 
+              if (!capture_ctxs.empty()) {
+                display_config = capture_ctxs.front().config;
+              }
+
               // reset_display() will sleep between retries
-              reset_display(disp, encoder.platform_formats->dev_type, display_names[display_p], capture_ctxs.front().config);
+              reset_display(disp, encoder.platform_formats->dev_type, display_names[display_p], display_config);
               if (disp) {
                 proc::proc.display_name = display_names[display_p];
                 break;
@@ -1393,12 +1410,14 @@ namespace video {
     }
   }
 
-  int encode_avcodec(int64_t frame_nr, avcodec_encode_session_t &session, safe::mail_raw_t::queue_t<packet_t> &packets, void *channel_data, std::optional<std::chrono::steady_clock::time_point> frame_timestamp) {
+  int encode_avcodec(int64_t frame_nr, avcodec_encode_session_t &session, safe::mail_raw_t::ring_queue_t<packet_t> &packets, void *channel_data, std::optional<std::chrono::steady_clock::time_point> frame_timestamp, frame_timing_t timing) {
     auto &frame = session.device->frame;
     frame->pts = frame_nr;
 
     auto &ctx = session.avcodec_ctx;
 
+    timing.encode_start = std::chrono::steady_clock::now();
+
     auto &sps = session.sps;
     auto &vps = session.vps;
 
@@ -1411,13 +1430,14 @@ namespace video {
       return -1;
     }
 
+    bool dropped = false;
     while (ret >= 0) {
       auto packet = std::make_unique<packet_raw_avcodec>();
       auto av_packet = packet.get()->av_packet;
 
       ret = avcodec_receive_packet(ctx.get(), av_packet);
       if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
-        return 0;
+        return dropped ? 1 : 0;
       } else if (ret < 0) {
         return ret;
       }
@@ -1457,18 +1477,24 @@ namespace video {
 
       if (av_packet && av_packet->pts == frame_nr) {
         packet->frame_timestamp = frame_timestamp;
+        packet->timing = timing;
+        packet->timing.encode_end = std::chrono::steady_clock::now();
       }
 
       packet->replacements = &session.replacements;
       packet->channel_data = channel_data;
-      packets->raise(std::move(packet));
+      if (!packets->raise(std::move(packet))) {
+        dropped = true;
+      }
     }
 
-    return 0;
+    return dropped ? 1 : 0;
   }
 
-  int encode_nvenc(int64_t frame_nr, nvenc_encode_session_t &session, safe::mail_raw_t::queue_t<packet_t> &packets, void *channel_data, std::optional<std::chrono::steady_clock::time_point> frame_timestamp) {
+  int encode_nvenc(int64_t frame_nr, nvenc_encode_session_t &session, safe::mail_raw_t::ring_queue_t<packet_t> &packets, void *channel_data, std::optional<std::chrono::steady_clock::time_point> frame_timestamp, frame_timing_t timing) {
+    timing.encode_start = std::chrono::steady_clock::now();
     auto encoded_frame = session.encode_frame(frame_nr);
+    timing.encode_end = std::chrono::steady_clock::now();
     if (encoded_frame.data.empty()) {
       BOOST_LOG(error) << "NvENC returned empty packet";
       return -1;
@@ -1482,16 +1508,23 @@ namespace video {
     packet->channel_data = channel_data;
     packet->after_ref_frame_invalidation = encoded_frame.after_ref_frame_invalidation;
     packet->frame_timestamp = frame_timestamp;
-    packets->raise(std::move(packet));
+    packet->timing = timing;
+    if (!packets->raise(std::move(packet))) {
+      return 1;
+    }
 
     return 0;
   }
 
-  int encode(int64_t frame_nr, encode_session_t &session, safe::mail_raw_t::queue_t<packet_t> &packets, void *channel_data, std::optional<std::chrono::steady_clock::time_point> frame_timestamp) {
+  /**
+   * @brief Encode the current frame of a session and raise its packets.
+   * @return 0 on success, 1 if the packet queue was full and dropped a packet, -1 on error.
+   */
+  int encode(int64_t frame_nr, encode_session_t &session, safe::mail_raw_t::ring_queue_t<packet_t> &packets, void *channel_data, std::optional<std::chrono::steady_clock::time_point> frame_timestamp, frame_timing_t timing = {}) {
     if (auto avcodec_session = dynamic_cast<avcodec_encode_session_t *>(&session)) {
-      return encode_avcodec(frame_nr, *avcodec_session, packets, channel_data, frame_timestamp);
+      return encode_avcodec(frame_nr, *avcodec_session, packets, channel_data, frame_timestamp, timing);
     } else if (auto nvenc_session = dynamic_cast<nvenc_encode_session_t *>(&session)) {
-      return encode_nvenc(frame_nr, *nvenc_session, packets, channel_data, frame_timestamp);
+      return encode_nvenc(frame_nr, *nvenc_session, packets, channel_data, frame_timestamp, timing);
     }
 
     return -1;
@@ -1929,7 +1962,7 @@ namespace video {
     BOOST_LOG(info) << "Encoding Frame threshold: "sv << encode_frame_threshold;
 
     auto shutdown_event = mail->event<bool>(mail::shutdown);
-    auto packets = mail::man->queue<packet_t>(mail::video_packets);
+    auto packets = mail::man->ring_queue<packet_t>(mail::video_packets);
     auto idr_events = mail->event<bool>(mail::idr);
     auto invalidate_ref_frames_events = mail->event<std::pair<int64_t, int64_t>>(mail::invalidate_ref_frames);
 
@@ -1948,7 +1981,7 @@ namespace video {
       BOOST_LOG(info) << "Input only session, video will not be captured."sv;
 
       // Encode the dummy img only once
-      if (encode(frame_nr++, *session, packets, channel_data, std::chrono::steady_clock::now())) {
+      if (encode(frame_nr++, *session, packets, channel_data, std::chrono::steady_clock::now()) < 0) {
         BOOST_LOG(error) << "Could not encode dummy video packet"sv;
         return;
       }
@@ -1994,6 +2027,7 @@ namespace video {
       }
 
       std::optional<std::chrono::steady_clock::time_point> frame_timestamp;
+      frame_timing_t timing;
 
       // Encode at a minimum FPS to avoid image quality issues with static content
       if (!requested_idr_frame || images->peek()) {
@@ -2003,10 +2037,12 @@ namespace video {
           if (*frame_timestamp < (next_frame_start - frame_variation_threshold)) {
             continue;
           }
+          timing.convert_start = std::chrono::steady_clock::now();
           if (session->convert(*img)) {
             BOOST_LOG(error) << "Could not convert image"sv;
             break;
           }
+          timing.convert_end = std::chrono::steady_clock::now();
 
           next_frame_start = *frame_timestamp + encode_frame_threshold;
         } else if (!images->running()) {
@@ -2014,10 +2050,15 @@ namespace video {
         }
       }
 
-      if (encode(frame_nr++, *session, packets, channel_data, frame_timestamp)) {
+      auto status = encode(frame_nr++, *session, packets, channel_data, frame_timestamp, timing);
+      if (status < 0) {
         BOOST_LOG(error) << "Could not encode video packet"sv;
         break;
       }
+      if (status > 0) {
+        // The client can't decode the frames referencing the dropped one, resync with a keyframe instead of waiting for it to ask
+        idr_events->raise(true);
+      }
 
       session->request_normal_frame();
     }
@@ -2243,11 +2284,16 @@ namespace video {
             ctx->idr_events->pop();
           }
 
-          if (frame_captured && pos->session->convert(*img)) {
-            BOOST_LOG(error) << "Could not convert image"sv;
-            ctx->shutdown_event->raise(true);
+          frame_timing_t timing;
+          if (frame_captured) {
+            timing.convert_start = std::chrono::steady_clock::now();
+            if (pos->session->convert(*img)) {
+              BOOST_LOG(error) << "Could not convert image"sv;
+              ctx->shutdown_event->raise(true);
 
-            continue;
+              continue;
+            }
+            timing.convert_end = std::chrono::steady_clock::now();
           }
 
           std::optional<std::chrono::steady_clock::time_point> frame_timestamp;
@@ -2255,12 +2301,16 @@ namespace video {
             frame_timestamp = img->frame_timestamp;
           }
 
-          if (encode(ctx->frame_nr++, *pos->session, ctx->packets, ctx->channel_data, frame_timestamp)) {
+          auto status = encode(ctx->frame_nr++, *pos->session, ctx->packets, ctx->channel_data, frame_timestamp, timing);
+          if (status < 0) {
             BOOST_LOG(error) << "Could not encode video packet"sv;
             ctx->shutdown_event->raise(true);
 
             continue;
           }
+          if (status > 0) {
+            ctx->idr_events->raise(true);
+          }
 
           pos->session->request_normal_frame();
 
@@ -2316,7 +2366,7 @@ namespace video {
     });
 
     // Encoding and capture takes place on this thread
-    platf::adjust_thread_priority(platf::thread_priority_e::high);
+    auto placement = thread_placement::apply(thread_placement::role_e::encode, platf::thread_priority_e::high);
 
     std::vector<std::string> display_names;
     int display_p = -1;
@@ -2330,7 +2380,7 @@ namespace video {
   ) {
     auto shutdown_event = mail->event<bool>(mail::shutdown);
 
-    auto images = std::make_shared<img_event_t::element_type>();
+    img_event_t images = mail->event<std::shared_ptr<platf::img_t>>(mail::video_images);
     auto lg = util::fail_guard([&]() {
       images->stop();
       shutdown_event->raise(true);
@@ -2353,7 +2403,7 @@ namespace video {
     auto hdr_event = mail->event<hdr_info_t>(mail::hdr);
 
     // Encoding takes place on this thread
-    platf::adjust_thread_priority(platf::thread_priority_e::high);
+    auto placement = thread_placement::apply(thread_placement::role_e::encode, platf::thread_priority_e::high);
 
     while (!shutdown_event->peek() && images->running()) {
       // Wait for the main capture event when the display is being reinitialized
@@ -2423,7 +2473,7 @@ namespace video {
       ref->encode_session_ctx_queue.raise(sync_session_ctx_t {
         &join_event,
         mail->event<bool>(mail::shutdown),
-        mail::man->queue<packet_t>(mail::video_packets),
+        mail::man->ring_queue<packet_t>(mail::video_packets),
         std::move(idr_events),
         mail->event<hdr_info_t>(mail::hdr),
         mail->event<input::touch_port_t>(mail::touch_port),
@@ -2437,6 +2487,24 @@ namespace video {
     }
   }
 
+  class capture_hold_t: public platf::deinit_t {
+  public:
+    explicit capture_hold_t(decltype(capture_thread_async)::ptr_t ref):
+        ref {std::move(ref)} {
+    }
+
+    decltype(capture_thread_async)::ptr_t ref;
+  };
+
+  std::unique_ptr<platf::deinit_t> hold_capture() {
+    auto ref = capture_thread_async.ref_existing();
+    if (!ref) {
+      return nullptr;
+    }
+
+    return std::make_unique<capture_hold_t>(std::move(ref));
+  }
+
   enum validate_flag_e {
     VUI_PARAMS = 0x01,  ///< VUI parameters
   };
@@ -2462,9 +2530,9 @@ namespace video {
 
     session->request_idr_frame();
 
-    auto packets = mail::man->queue<packet_t>(mail::video_packets);
+    auto packets = mail::man->ring_queue<packet_t>(mail::video_packets);
     while (!packets->peek()) {
-      if (encode(1, *session, packets, nullptr, {})) {
+      if (encode(1, *session, packets, nullptr, {}) < 0) {
         return -1;
       }
     }
@@ -2674,19 +2742,233 @@ namespace video {
     return true;
   }
 
+  namespace encoder_cache {
+    namespace fs = std::filesystem;
+
+    fs::path file() {
+      return platf::appdata() / "encoder_cache.json";
+    }
+
+    /**
+     * @brief Build the string identifying the environment an encoder was validated in.
+     * @param encoder The encoder to fingerprint.
+     * @return The fingerprint, or an empty string if the GPU/driver state is unknown.
+     */
+    std::string fingerprint(const encoder_t &encoder) {
+      auto gpu = platf::gpu_fingerprint();
+      if (gpu.empty()) {
+        return {};
+      }
+
+      // Any configuration change may alter encoder options used during validation.
+      // The configured codec modes are used, probing resolves the automatic ones only after validation.
+      std::map<std::string, std::string> settings {std::begin(config::modified_config_settings), std::end(config::modified_config_settings)};
+      std::stringstream settings_ss;
+      for (auto &[name, val] : settings) {
+        settings_ss << name << '=' << val << '\n';
+      }
+
+      std::stringstream ss;
+      ss << PROJECT_VERSION << '|'
+         << avcodec_version() << '|'
+         << gpu << '|'
+         << encoder.name << '|'
+         << encoder.flags << '|'
+         << config::video.hevc_mode << '|'
+         << config::video.av1_mode << '|'
+         << config::sunshine.flags[config::flag::FORCE_VIDEO_HEADER_REPLACE] << '|'
+         << util::hex(std::hash<std::string> {}(settings_ss.str())).to_string_view();
+
+      return ss.str();
+    }
+
+    nlohmann::json read() {
+      nlohmann::json root = nlohmann::json::object();
+
+      std::error_code ec;
+      if (!fs::exists(file(), ec)) {
+        return root;
+      }
+
+      try {
+        std::ifstream in {file()};
+        in >> root;
+      } catch (std::exception &e) {
+        BOOST_LOG(warning) << "Couldn't read encoder cache: "sv << e.what();
+        return nlohmann::json::object();
+      }
+
+      return root.is_object() ? root : nlohmann::json::object();
+    }
+
+    void write(const nlohmann::json &root) {
+      try {
+        std::ofstream out {file()};
+        out << root.dump(2);
+      } catch (std::exception &e) {
+        BOOST_LOG(warning) << "Couldn't write encoder cache: "sv << e.what();
+      }
+    }
+
+    /**
+     * @brief Restore the capabilities of an encoder from the cache.
+     * @param encoder The encoder to restore.
+     * @return `true` if a matching entry was found and applied.
+     */
+    bool load(encoder_t &encoder) {
+      if (!config::video.encoder_cache) {
+        return false;
+      }
+
+      auto key = fingerprint(encoder);
+      if (key.empty()) {
+        return false;
+      }
+
+      auto root = read();
+      auto entry = root.find(std::string {encoder.name});
+      if (entry == std::end(root) || entry->value("fingerprint", ""s) != key) {
+        return false;
+      }
+
+      std::array<std::pair<encoder_t::codec_t *, const char *>, 3> codecs {{
+        {&encoder.h264, "h264"},
+        {&encoder.hevc, "hevc"},
+        {&encoder.av1, "av1"},
+      }};
+
+      // Validate the whole entry before touching the encoder
+      for (auto &[codec, name] : codecs) {
+        auto caps = entry->value(name, ""s);
+        if (caps.size() != encoder_t::MAX_FLAGS || caps.find_first_not_of("01") != std::string::npos) {
+          return false;
+        }
+      }
+
+      for (auto &[codec, name] : codecs) {
+        codec->capabilities = std::bitset<encoder_t::MAX_FLAGS> {entry->value(name, ""s)};
+      }
+
+      return true;
+    }
+
+    void store(const encoder_t &encoder) {
+      if (!config::video.encoder_cache) {
+        return;
+      }
+
+      auto key = fingerprint(encoder);
+      if (key.empty()) {
+        return;
+      }
+
+      auto root = read();
+      root[std::string {encoder.name}] = {
+        {"fingerprint", key},
+        {"h264", encoder.h264.capabilities.to_string()},
+        {"hevc", encoder.hevc.capabilities.to_string()},
+        {"av1", encoder.av1.capabilities.to_string()},
+      };
+
+      write(root);
+    }
+
+    void invalidate(const encoder_t &encoder) {
+      auto root = read();
+      if (root.erase(std::string {encoder.name})) {
+        write(root);
+      }
+    }
+  }  // namespace encoder_cache
+
+  /**
+   * @brief Validate an encoder, using the capability cache when possible.
+   * Only successful validations are cached, so encoders that failed are always probed again.
+   * @param encoder The encoder to validate.
+   * @param expect_failure Passed to `validate_encoder()` on a cache miss.
+   * @param from_cache Set to `true` if the result came from the cache.
+   * @return `true` if the encoder is usable.
+   */
+  bool validate_encoder_cached(encoder_t &encoder, bool expect_failure, bool &from_cache) {
+    if (encoder_cache::load(encoder)) {
+      BOOST_LOG(info) << "Using cached capabilities for encoder ["sv << encoder.name << ']';
+      cached_validation_modes = {active_hevc_mode, active_av1_mode};
+      from_cache = true;
+      return true;
+    }
+
+    if (!validate_encoder(encoder, expect_failure)) {
+      return false;
+    }
+
+    encoder_cache::store(encoder);
+    return true;
+  }
+
+  /**
+   * @brief Validate the cached capabilities of the chosen encoder on a background thread.
+   * If the real capabilities differ, the cache entry is replaced and the next call to
+   * `probe_encoders()` performs a full probe.
+   */
+  void revalidate_encoder_cache() {
+    std::thread {[]() {
+      std::lock_guard lg {probe_mutex};
+
+      // Probing is only safe while nobody is streaming
+      if (!chosen_encoder || rtsp_stream::session_count() != 0 || !allow_encoder_probing()) {
+        return;
+      }
+
+      auto &encoder = *chosen_encoder;
+      std::array<std::bitset<encoder_t::MAX_FLAGS>, 3> cached {
+        encoder.h264.capabilities,
+        encoder.hevc.capabilities,
+        encoder.av1.capabilities,
+      };
+
+      // Test the same codecs as the validation that was cached, not the ones probing settled on
+      auto resolved_modes = std::pair {active_hevc_mode, active_av1_mode};
+      std::tie(active_hevc_mode, active_av1_mode) = cached_validation_modes;
+      auto fg = util::fail_guard([&]() {
+        std::tie(active_hevc_mode, active_av1_mode) = resolved_modes;
+      });
+
+      BOOST_LOG(info) << "Revalidating cached capabilities for encoder ["sv << encoder.name << ']';
+      if (!validate_encoder(encoder, false)) {
+        BOOST_LOG(warning) << "Encoder ["sv << encoder.name << "] no longer passes validation, it will be probed again"sv;
+        encoder_cache::invalidate(encoder);
+        force_reprobe = true;
+        return;
+      }
+
+      encoder_cache::store(encoder);
+      if (cached[0] != encoder.h264.capabilities || cached[1] != encoder.hevc.capabilities || cached[2] != encoder.av1.capabilities) {
+        BOOST_LOG(warning) << "Cached capabilities for encoder ["sv << encoder.name << "] were stale, it will be probed again"sv;
+        force_reprobe = true;
+      } else {
+        BOOST_LOG(info) << "Cached capabilities for encoder ["sv << encoder.name << "] are up to date"sv;
+      }
+    }}.detach();
+  }
+
   int probe_encoders() {
     if (!allow_encoder_probing()) {
       // Error already logged
       return -1;
     }
 
+    std::lock_guard lg {probe_mutex};
+
     auto encoder_list = encoders;
 
     // If we already have a good encoder, check to see if another probe is required
-    if (chosen_encoder && !(chosen_encoder->flags & ALWAYS_REPROBE) && !platf::needs_encoder_reenumeration()) {
+    if (chosen_encoder && !force_reprobe && !(chosen_encoder->flags & ALWAYS_REPROBE) && !platf::needs_encoder_reenumeration()) {
       return 0;
     }
 
+    force_reprobe = false;
+    bool from_cache = false;
+
     // Restart encoder selection
     auto previous_encoder = chosen_encoder;
     chosen_encoder = nullptr;
@@ -2720,7 +3002,7 @@ namespace video {
 
         if (encoder->name == config::video.encoder) {
           // Remove the encoder from the list entirely if it fails validation
-          if (!validate_encoder(*encoder, previous_encoder && previous_encoder != encoder)) {
+          if (!validate_encoder_cached(*encoder, previous_encoder && previous_encoder != encoder, from_cache)) {
             pos = encoder_list.erase(pos);
             break;
           }
@@ -2748,7 +3030,7 @@ namespace video {
         auto encoder = *pos;
 
         // Remove the encoder from the list entirely if it fails validation
-        if (!validate_encoder(*encoder, previous_encoder && previous_encoder != encoder)) {
+        if (!validate_encoder_cached(*encoder, previous_encoder && previous_encoder != encoder, from_cache)) {
           pos = encoder_list.erase(pos);
           continue;
         }
@@ -2785,7 +3067,7 @@ namespace video {
         // If we've used a previous encoder and it's not this one, we expect this encoder to
         // fail to validate. It will use a slightly different order of checks to more quickly
         // eliminate failing encoders.
-        if (!validate_encoder(*encoder, previous_encoder && previous_encoder != encoder)) {
+        if (!validate_encoder_cached(*encoder, previous_encoder && previous_encoder != encoder, from_cache)) {
           pos = encoder_list.erase(pos);
           continue;
         }
@@ -2861,6 +3143,10 @@ namespace video {
       active_av1_mode = encoder.av1[encoder_t::PASSED] ? (encoder.av1[encoder_t::DYNAMIC_RANGE] ? 3 : 2) : 1;
     }
 
+    if (from_cache && config::video.encoder_cache_revalidate) {
+      revalidate_encoder_cache();
+    }
+
     return 0;
   }
 
@@ -235,6 +235,16 @@ namespace video {
   extern encoder_t videotoolbox;
 #endif
 
+  /**
+   * @brief Host-side timestamps of the stages a frame went through before packetization.
+   */
+  struct frame_timing_t {
+    std::optional<std::chrono::steady_clock::time_point> convert_start;
+    std::optional<std::chrono::steady_clock::time_point> convert_end;
+    std::optional<std::chrono::steady_clock::time_point> encode_start;
+    std::optional<std::chrono::steady_clock::time_point> encode_end;
+  };
+
   struct packet_raw_t {
     virtual ~packet_raw_t() = default;
 
@@ -262,6 +272,7 @@ namespace video {
     void *channel_data = nullptr;
     bool after_ref_frame_invalidation = false;
     std::optional<std::chrono::steady_clock::time_point> frame_timestamp;
+    frame_timing_t timing;
   };
 
   struct packet_raw_avcodec: packet_raw_t {
@@ -347,6 +358,14 @@ namespace video {
     void *channel_data
   );
 
+  /**
+   * @brief Keep the display capture of the current sessions running after they end.
+   * @return A guard holding the capture until destroyed, nullptr if there is no capture to hold.
+   * @note Only the capture shared by encoders with parallel encoding support can be held,
+   *       the encoders themselves are always recreated for every session.
+   */
+  std::unique_ptr<platf::deinit_t> hold_capture();
+
   bool validate_encoder(encoder_t &encoder, bool expect_failure);
 
   /**
@@ -3,6 +3,8 @@
  * @brief Common declarations.
  */
 #pragma once
+#include <filesystem>
+#include <fstream>
 #include <gtest/gtest.h>
 #include <src/globals.h>
 #include <src/logging.h>
@@ -25,3 +27,32 @@ struct PlatformTestSuite: testing::Test {
 private:
   inline static std::unique_ptr<platf::deinit_t> platf_deinit;
 };
+
+/**
+ * @brief A directory named after the test suite, created before each test and removed with its contents after.
+ */
+struct TempDirTest: testing::Test {
+  void SetUp() override {
+    root = platf::appdata() / "tests" / testing::UnitTest::GetInstance()->current_test_info()->test_suite_name();
+    std::filesystem::create_directories(root);
+  }
+
+  void TearDown() override {
+    std::filesystem::remove_all(root);
+  }
+
+  /**
+   * @brief Create or replace a file in the directory.
+   * @param name The path of the file, relative to the directory.
+   * @param content The content of the file.
+   * @return The full path of the file.
+   */
+  std::filesystem::path write(const std::filesystem::path &name, const std::string &content) {
+    auto path = root / name;
+    std::filesystem::create_directories(path.parent_path());
+    std::ofstream {path, std::ios::binary | std::ios::trunc} << content;
+    return path;
+  }
+
+  std::filesystem::path root;
+};
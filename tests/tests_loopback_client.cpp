@@ -0,0 +1,871 @@
+/**
+ * @file tests/tests_loopback_client.cpp
+ * @brief Definitions for a headless client that streams from a local host over loopback.
+ */
+// standard includes
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <random>
+#include <sstream>
+
+// lib includes
+#include <boost/asio.hpp>
+#include <boost/endian/arithmetic.hpp>
+#include <openssl/rand.h>
+
+extern "C" {
+  // clang-format off
+#include <moonlight-common-c/src/Limelight-internal.h>
+#include <src/rswrapper.h>
+  // clang-format on
+}
+
+// local includes
+#include "tests_loopback_client.h"
+#include <src/config.h>
+#include <src/crypto.h>
+#include <src/globals.h>
+#include <src/logging.h>
+#include <src/network.h>
+#include <src/process.h>
+#include <src/stream.h>
+#include <src/utility.h>
+#include <src/video.h>
+
+using namespace std::literals;
+namespace asio = boost::asio;
+using asio::ip::tcp;
+using asio::ip::udp;
+
+namespace loopback {
+  // The wire format below must match the one in src/stream.cpp
+#pragma pack(push, 1)
+
+  struct video_short_frame_header_t {
+    std::uint8_t headerType;
+    boost::endian::little_uint16_at frame_processing_latency;
+    std::uint8_t frameType;
+    boost::endian::little_uint16_at lastPayloadLen;
+    std::uint8_t unknown[2];
+  };
+
+  static_assert(sizeof(video_short_frame_header_t) == 8, "Short frame header must be 8 bytes");
+
+  struct video_packet_raw_t {
+    RTP_PACKET rtp;
+    char reserved[4];
+    NV_VIDEO_PACKET packet;
+  };
+
+  struct video_packet_enc_prefix_t {
+    std::uint8_t iv[12];
+    std::uint32_t frameNumber;
+    std::uint8_t tag[16];
+  };
+
+#pragma pack(pop)
+
+  constexpr std::uint16_t periodic_ping_type = 0x0200;
+  constexpr std::uint16_t request_idr_frame_type = 0x0302;
+  constexpr std::uint16_t termination_type = 0x0109;
+
+  constexpr auto max_fec_blocks = 4;
+
+  double report_t::goodput_mbps() const {
+    if (elapsed.count() <= 0) {
+      return 0;
+    }
+
+    return payload_bytes * 8 / elapsed.count() / 1000000;
+  }
+
+  double report_t::recovery_rate() const {
+    auto damaged = blocks_recovered + blocks_lost;
+    if (!damaged) {
+      return 1;
+    }
+
+    return (double) blocks_recovered / damaged;
+  }
+
+  void report_t::print(std::ostream &os) const {
+    auto seconds = elapsed.count();
+    auto to_ms = [](std::chrono::microseconds duration) {
+      return duration.count() / 1000.0;
+    };
+
+    os << std::fixed << std::setprecision(2);
+    os << "frames: "sv << frames_complete << " complete, "sv << frames_lost << " lost, "sv << frames_malformed << " malformed in "sv
+       << seconds << "s ("sv << (seconds > 0 ? frames_complete / seconds : 0) << " fps, "sv << goodput_mbps() << " Mbps goodput)"sv << std::endl;
+    os << "packets: "sv << packets_received << " received, "sv << packets_dropped << " dropped, "sv
+       << decrypt_failures << " failed to decrypt"sv << std::endl;
+    os << "fec blocks: "sv << blocks_recovered << " recovered, "sv << blocks_lost << " lost ("sv
+       << recovery_rate() * 100 << "% recovery rate)"sv << std::endl;
+    os << std::left << std::setw(20) << "latency (ms)"sv << std::right
+       << std::setw(10) << "avg"sv << std::setw(10) << "p50"sv << std::setw(10) << "p95"sv
+       << std::setw(10) << "p99"sv << std::setw(10) << "max"sv << std::endl;
+
+    auto print_histogram = [&](std::string_view name, const stat_trackers::latency_histogram &histogram) {
+      os << std::left << std::setw(20) << name << std::right
+         << std::setw(10) << to_ms(histogram.average())
+         << std::setw(10) << to_ms(histogram.percentile(0.50))
+         << std::setw(10) << to_ms(histogram.percentile(0.95))
+         << std::setw(10) << to_ms(histogram.percentile(0.99))
+         << std::setw(10) << to_ms(histogram.max()) << std::endl;
+    };
+
+    print_histogram("frame completion"sv, completion_latency);
+    print_histogram("host processing"sv, host_latency);
+  }
+
+  struct host_t::saved_config_t {
+    config::video_t video;
+    config::audio_t audio;
+    config::stream_t stream;
+  };
+
+  /**
+   * @brief Write a clip with a moving gradient and a noisy patch, so the encoder produces non-trivial P-frames.
+   */
+  static int generate_clip(const std::filesystem::path &path, const options_t &options) {
+    constexpr auto frame_count = 12;
+    constexpr auto patch_size = 64;
+
+    std::ofstream file {path, std::ios::binary | std::ios::trunc};
+    if (!file) {
+      BOOST_LOG(error) << "Loopback: couldn't create ["sv << path.string() << ']';
+      return -1;
+    }
+
+    std::minstd_rand rng {1};
+    std::vector<std::uint8_t> frame((std::size_t) options.width * options.height * 4);
+    for (int f = 0; f < frame_count; ++f) {
+      auto patch_x = (f * patch_size / 2) % std::max(options.width - patch_size, 1);
+      auto patch_y = options.height / 3;
+
+      for (int y = 0; y < options.height; ++y) {
+        for (int x = 0; x < options.width; ++x) {
+          auto pixel = &frame[((std::size_t) y * options.width + x) * 4];
+
+          bool in_patch = x >= patch_x && x < patch_x + patch_size && y >= patch_y && y < patch_y + patch_size;
+          if (in_patch) {
+            pixel[0] = pixel[1] = pixel[2] = (std::uint8_t) rng();
+          } else {
+            pixel[0] = (std::uint8_t) (x + f * 4);
+            pixel[1] = (std::uint8_t) (y + f * 2);
+            pixel[2] = (std::uint8_t) (x + y);
+          }
+          pixel[3] = 0;
+        }
+      }
+
+      file.write((const char *) frame.data(), frame.size());
+    }
+
+    return file ? 0 : -1;
+  }
+
+  host_t::~host_t() {
+    if (rtsp_thread.joinable()) {
+      auto shutdown_event = mail::man->event<bool>(mail::shutdown);
+      shutdown_event->raise(true);
+      rtsp_thread.join();
+
+      // Other users of the global mailbox shouldn't observe the shutdown
+      shutdown_event->reset();
+    }
+
+    platf_deinit.reset();
+
+    if (saved_config) {
+      config::video = std::move(saved_config->video);
+      config::audio = std::move(saved_config->audio);
+      config::stream = std::move(saved_config->stream);
+    }
+
+    if (!generated_clip.empty()) {
+      std::error_code ec;
+      std::filesystem::remove(generated_clip, ec);
+    }
+  }
+
+  std::unique_ptr<host_t> host_t::start(const std::filesystem::path &clip, const options_t &options) {
+#ifndef __linux__
+    BOOST_LOG(error) << "Loopback: the replay capture backend is only available on Linux"sv;
+    return nullptr;
+#endif
+
+    static std::atomic_bool started;
+    if (started.exchange(true)) {
+      BOOST_LOG(error) << "Loopback: the RTSP server can only be started once per process"sv;
+      return nullptr;
+    }
+
+    auto host = std::unique_ptr<host_t> {new host_t};
+    host->saved_config = std::make_unique<saved_config_t>(saved_config_t {config::video, config::audio, config::stream});
+
+    auto clip_path = clip;
+    if (clip_path.empty()) {
+      clip_path = std::filesystem::temp_directory_path() / ("sunshine-loopback-"s + std::to_string(std::random_device {}()) + ".raw"s);
+      host->generated_clip = clip_path;
+
+      if (generate_clip(clip_path, options)) {
+        return nullptr;
+      }
+    }
+
+    config::video.capture = "replay";
+    config::video.encoder = "software";
+    config::video.encoder_cache = false;
+    config::video.replay.file = clip_path.string();
+    config::video.replay.width = options.width;
+    config::video.replay.height = options.height;
+    config::video.replay.framerate = options.fps;
+    config::video.replay.fast = false;
+
+    // Audio capture depends on the host's audio setup, so only video is streamed
+    config::audio.stream = false;
+
+    reed_solomon_init();
+
+    host->platf_deinit = platf::init();
+    if (!host->platf_deinit) {
+      return nullptr;
+    }
+
+    if (video::probe_encoders()) {
+      BOOST_LOG(error) << "Loopback: no working encoder found"sv;
+      return nullptr;
+    }
+
+    host->rtsp_thread = std::thread {rtsp_stream::start};
+
+    return host;
+  }
+
+  std::shared_ptr<rtsp_stream::launch_session_t> host_t::launch(const options_t &options) {
+    static std::uint32_t session_id_counter;
+
+    // The control stream is torn down as soon as no app is running
+    proc::proc.launch_input_only();
+
+    auto launch_session = std::make_shared<rtsp_stream::launch_session_t>();
+    launch_session->id = ++session_id_counter;
+
+    launch_session->gcm_key.resize(16);
+    launch_session->iv.resize(16);
+    RAND_bytes(launch_session->gcm_key.data(), launch_session->gcm_key.size());
+    RAND_bytes(launch_session->iv.data(), launch_session->iv.size());
+
+    unsigned char raw_payload[8];
+    RAND_bytes(raw_payload, sizeof(raw_payload));
+    launch_session->av_ping_payload = util::hex_vec(raw_payload);
+    RAND_bytes((unsigned char *) &launch_session->control_connect_data, sizeof(launch_session->control_connect_data));
+
+    launch_session->device_name = "loopback";
+    launch_session->unique_id = "loopback-"s + std::to_string(launch_session->id);
+    launch_session->perm = crypto::PERM::_all;
+    launch_session->width = options.width;
+    launch_session->height = options.height;
+    launch_session->fps = options.fps * 1000;
+    launch_session->surround_info = 196610;
+    launch_session->scale_factor = 100;
+    launch_session->rtsp_url_scheme = "rtsp://"s;
+
+    rtsp_stream::launch_session_raise(launch_session);
+
+    return launch_session;
+  }
+
+  struct client_t::impl_t {
+    /**
+     * @brief A FEC block of a frame, indexed by shard.
+     */
+    struct block_t {
+      std::vector<std::vector<std::uint8_t>> shards;
+      std::size_t data_shards = 0;
+      std::size_t received = 0;
+      bool complete = false;
+    };
+
+    struct frame_t {
+      std::array<block_t, max_fec_blocks> blocks;
+      int last_block = 0;
+      std::chrono::steady_clock::time_point first_packet;
+    };
+
+    impl_t(std::shared_ptr<rtsp_stream::launch_session_t> launch_session, const options_t &options):
+        launch_session {std::move(launch_session)},
+        options {options},
+        blocksize {(std::size_t) options.packet_size + MAX_RTP_HEADER_SIZE} {
+      if (options.encrypt_video) {
+        cipher = crypto::cipher::gcm_t {this->launch_session->gcm_key, false};
+      }
+    }
+
+    ~impl_t() {
+      stop_control();
+    }
+
+    /**
+     * @brief Send a single plaintext RTSP request and read the response.
+     * @return The response status code, or -1 if the request couldn't be sent.
+     */
+    int rtsp_request(std::string_view command, std::string_view target, const std::string &payload, std::map<std::string, std::string> &headers) {
+      boost::system::error_code ec;
+      tcp::socket sock {io_context};
+      tcp::endpoint endpoint {asio::ip::make_address("127.0.0.1"), net::map_port(rtsp_stream::RTSP_SETUP_PORT)};
+
+      // The RTSP server may still be binding its socket
+      auto deadline = std::chrono::steady_clock::now() + 2s;
+      while (sock.connect(endpoint, ec)) {
+        sock.close();
+        if (std::chrono::steady_clock::now() > deadline) {
+          BOOST_LOG(error) << "Loopback: couldn't connect to RTSP server: "sv << ec.message();
+          return -1;
+        }
+        std::this_thread::sleep_for(50ms);
+      }
+
+      std::stringstream ss;
+      ss << command << ' ' << target << " RTSP/1.0\r\n"sv;
+      ss << "CSeq: "sv << ++rtsp_sequence_number << "\r\n"sv;
+      if (!payload.empty()) {
+        ss << "Content-type: application/sdp\r\n"sv;
+        ss << "Content-length: "sv << payload.size() << "\r\n"sv;
+      }
+      ss << "\r\n"sv << payload;
+
+      asio::write(sock, asio::buffer(ss.str()), ec);
+      if (ec) {
+        BOOST_LOG(error) << "Loopback: couldn't send RTSP "sv << command << ": "sv << ec.message();
+        return -1;
+      }
+
+      // The server closes the connection after each response
+      std::string response;
+      asio::read(sock, asio::dynamic_buffer(response), ec);
+      if (ec && ec != asio::error::eof) {
+        BOOST_LOG(error) << "Loopback: couldn't read RTSP "sv << command << " response: "sv << ec.message();
+        return -1;
+      }
+
+      std::istringstream lines {response};
+      std::string line;
+      std::string protocol;
+      int status = -1;
+
+      std::getline(lines, line);
+      std::istringstream {line} >> protocol >> status;
+
+      while (std::getline(lines, line) && line != "\r"sv && !line.empty()) {
+        auto colon = line.find(':');
+        if (colon == std::string::npos) {
+          continue;
+        }
+
+        auto value = line.substr(colon + 1);
+        value.erase(0, value.find_first_not_of(' '));
+        if (!value.empty() && value.back() == '\r') {
+          value.pop_back();
+        }
+        headers[line.substr(0, colon)] = std::move(value);
+      }
+
+      if (status != 200) {
+        BOOST_LOG(error) << "Loopback: RTSP "sv << command << " failed with status "sv << status;
+      }
+
+      return status;
+    }
+
+    /**
+     * @brief SETUP a stream and return the port the host reports for it.
+     */
+    std::optional<std::uint16_t> setup(std::string_view type) {
+      std::map<std::string, std::string> headers;
+      if (rtsp_request("SETUP"sv, "streamid="s + std::string {type} + "/0/0"s, {}, headers) != 200) {
+        return std::nullopt;
+      }
+
+      // The identifiers handed out by /launch are echoed back by the RTSP server
+      if (type == "control"sv) {
+        if (headers["X-SS-Connect-Data"] != std::to_string(launch_session->control_connect_data)) {
+          BOOST_LOG(error) << "Loopback: unexpected connect data ["sv << headers["X-SS-Connect-Data"] << ']';
+          return std::nullopt;
+        }
+      } else if (headers["X-SS-Ping-Payload"] != launch_session->av_ping_payload) {
+        BOOST_LOG(error) << "Loopback: unexpected ping payload ["sv << headers["X-SS-Ping-Payload"] << ']';
+        return std::nullopt;
+      }
+
+      auto &transport = headers["Transport"];
+      auto pos = transport.find("server_port="sv);
+      if (pos == std::string::npos) {
+        BOOST_LOG(error) << "Loopback: no server port in ["sv << transport << ']';
+        return std::nullopt;
+      }
+
+      return (std::uint16_t) std::stoi(transport.substr(pos + "server_port="sv.size()));
+    }
+
+    std::string announce_payload() {
+      std::stringstream ss;
+
+      ss << "v=0\r\n"sv;
+      ss << "o=android 0 14 IN IPv4 127.0.0.1\r\n"sv;
+      ss << "s=127.0.0.1\r\n"sv;
+      ss << "a=x-nv-video[0].clientViewportWd:"sv << options.width << " \r\n"sv;
+      ss << "a=x-nv-video[0].clientViewportHt:"sv << options.height << " \r\n"sv;
+      ss << "a=x-nv-video[0].maxFPS:"sv << options.fps << " \r\n"sv;
+      ss << "a=x-nv-video[0].packetSize:"sv << options.packet_size << " \r\n"sv;
+      ss << "a=x-nv-video[0].videoEncoderSlicesPerFrame:1 \r\n"sv;
+      ss << "a=x-nv-video[0].maxNumReferenceFrames:1 \r\n"sv;
+      ss << "a=x-nv-vqos[0].bw.maximumBitrateKbps:"sv << options.bitrate << " \r\n"sv;
+      ss << "a=x-nv-vqos[0].bitStreamFormat:0 \r\n"sv;
+      ss << "a=x-nv-audio.surround.numChannels:2 \r\n"sv;
+      ss << "a=x-nv-audio.surround.channelMask:3 \r\n"sv;
+      ss << "a=x-nv-audio.surround.AudioQuality:0 \r\n"sv;
+      ss << "a=x-ml-general.featureFlags:"sv << ML_FF_SESSION_ID_V1 << " \r\n"sv;
+      ss << "a=x-ss-general.encryptionEnabled:"sv << (options.encrypt_video ? SS_ENC_VIDEO : 0) << " \r\n"sv;
+      ss << "t=0 0\r\n"sv;
+      ss << "m=video "sv << video_port << "  \r\n"sv;
+
+      return ss.str();
+    }
+
+    int connect() {
+      std::map<std::string, std::string> headers;
+      auto url = "rtsp://127.0.0.1:"s + std::to_string(net::map_port(rtsp_stream::RTSP_SETUP_PORT));
+
+      if (rtsp_request("OPTIONS"sv, url, {}, headers) != 200 ||
+          rtsp_request("DESCRIBE"sv, url, {}, headers) != 200) {
+        return -1;
+      }
+
+      auto audio = setup("audio"sv);
+      auto video = setup("video"sv);
+      auto control = setup("control"sv);
+      if (!audio || !video || !control) {
+        return -1;
+      }
+
+      audio_port = *audio;
+      video_port = *video;
+      control_port = *control;
+
+      if (rtsp_request("ANNOUNCE"sv, "streamid=control/13/0"sv, announce_payload(), headers) != 200 ||
+          rtsp_request("PLAY"sv, url, {}, headers) != 200) {
+        return -1;
+      }
+
+      auto localhost = asio::ip::make_address("127.0.0.1");
+      video_sock.open(udp::v4());
+      video_sock.bind(udp::endpoint {localhost, 0});
+      video_sock.set_option(udp::socket::receive_buffer_size {4 * 1024 * 1024});
+      audio_sock.open(udp::v4());
+      audio_sock.bind(udp::endpoint {localhost, 0});
+
+      video_endpoint = udp::endpoint {localhost, video_port};
+      audio_endpoint = udp::endpoint {localhost, audio_port};
+
+      enet_host = net::host_t {enet_host_create(AF_INET, nullptr, 1, 1, 0, 0)};
+      if (!enet_host) {
+        BOOST_LOG(error) << "Loopback: couldn't create ENet host"sv;
+        return -1;
+      }
+
+      ENetAddress address;
+      enet_address_set_host(&address, "127.0.0.1");
+      enet_address_set_port(&address, control_port);
+
+      peer = enet_host_connect(enet_host.get(), &address, 1, launch_session->control_connect_data);
+      if (!peer) {
+        BOOST_LOG(error) << "Loopback: couldn't connect the control stream"sv;
+        return -1;
+      }
+
+      ENetEvent event;
+      auto deadline = std::chrono::steady_clock::now() + 5s;
+      while (std::chrono::steady_clock::now() < deadline) {
+        if (enet_host_service(enet_host.get(), &event, 100) > 0 && event.type == ENET_EVENT_TYPE_CONNECT) {
+          control_thread = std::thread {&impl_t::control_loop, this};
+          return 0;
+        }
+      }
+
+      BOOST_LOG(error) << "Loopback: control stream connection timed out"sv;
+      return -1;
+    }
+
+    void send_control(std::uint16_t type) {
+      auto packet = enet_packet_create(&type, sizeof(type), ENET_PACKET_FLAG_RELIABLE);
+      if (enet_peer_send(peer, 0, packet)) {
+        enet_packet_destroy(packet);
+      }
+    }
+
+    void send_ping(udp::socket &sock, const udp::endpoint &endpoint) {
+      SS_PING ping {};
+      std::copy_n(launch_session->av_ping_payload.data(), std::min(sizeof(ping.payload), launch_session->av_ping_payload.size()), ping.payload);
+      ping.sequenceNumber = util::endian::big<std::uint32_t>(++ping_sequence_number);
+
+      boost::system::error_code ec;
+      sock.send_to(asio::buffer(&ping, sizeof(ping)), endpoint, 0, ec);
+    }
+
+    /**
+     * @brief Keep the control stream alive, ping the audio stream and forward IDR requests.
+     * The ENet host and the audio socket are only used from this thread once connected.
+     */
+    void control_loop() {
+      auto next_ping = std::chrono::steady_clock::now();
+
+      while (!control_stop) {
+        ENetEvent event;
+        while (enet_host_service(enet_host.get(), &event, 10) > 0) {
+          if (event.type == ENET_EVENT_TYPE_RECEIVE) {
+            net::packet_t packet {event.packet};
+            if (packet->dataLength >= sizeof(std::uint16_t) && *(std::uint16_t *) packet->data == termination_type) {
+              BOOST_LOG(info) << "Loopback: host terminated the stream"sv;
+              terminated = true;
+            }
+          } else if (event.type == ENET_EVENT_TYPE_DISCONNECT) {
+            terminated = true;
+            peer = nullptr;
+            return;
+          }
+        }
+
+        if (idr_requested.exchange(false)) {
+          send_control(request_idr_frame_type);
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (now >= next_ping) {
+          send_control(periodic_ping_type);
+          send_ping(audio_sock, audio_endpoint);
+          next_ping = now + 250ms;
+        }
+      }
+
+      enet_peer_disconnect(peer, 0);
+
+      ENetEvent event;
+      auto deadline = std::chrono::steady_clock::now() + 1s;
+      while (std::chrono::steady_clock::now() < deadline) {
+        if (enet_host_service(enet_host.get(), &event, 50) > 0) {
+          if (event.type == ENET_EVENT_TYPE_RECEIVE) {
+            enet_packet_destroy(event.packet);
+          } else if (event.type == ENET_EVENT_TYPE_DISCONNECT) {
+            peer = nullptr;
+            return;
+          }
+        }
+      }
+
+      enet_peer_reset(peer);
+      peer = nullptr;
+    }
+
+    void stop_control() {
+      control_stop = true;
+      if (control_thread.joinable()) {
+        control_thread.join();
+      }
+    }
+
+    /**
+     * @brief Reconstruct the missing data shards of a block.
+     * @return `true` if all data shards are available.
+     */
+    bool recover(block_t &block, report_t &report) {
+      auto nr_shards = block.shards.size();
+      auto missing = std::count_if(std::begin(block.shards), std::begin(block.shards) + block.data_shards, [](auto &shard) {
+        return shard.empty();
+      });
+
+      if (!missing) {
+        return true;
+      }
+
+      std::vector<std::uint8_t *> shards_p(nr_shards);
+      std::vector<std::uint8_t> marks(nr_shards);
+      for (std::size_t x = 0; x < nr_shards; ++x) {
+        if (block.shards[x].empty()) {
+          block.shards[x].resize(blocksize);
+          marks[x] = 1;
+        }
+        shards_p[x] = block.shards[x].data();
+      }
+
+      auto rs = reed_solomon_new(block.data_shards, nr_shards - block.data_shards);
+      auto status = reed_solomon_decode(rs, shards_p.data(), marks.data(), nr_shards, blocksize);
+      reed_solomon_release(rs);
+
+      // The block is counted as lost once a later frame completes
+      if (status) {
+        return false;
+      }
+
+      ++report.blocks_recovered;
+      return true;
+    }
+
+    /**
+     * @brief Reassemble a frame whose blocks are all complete.
+     */
+    void complete_frame(std::uint32_t frame_index, frame_t &frame, std::chrono::steady_clock::time_point now, report_t &report) {
+      auto shard_payload_size = blocksize - sizeof(video_packet_raw_t);
+
+      std::vector<std::uint8_t> payload;
+      std::size_t data_shards = 0;
+      for (int x = 0; x <= frame.last_block; ++x) {
+        auto &block = frame.blocks[x];
+        for (std::size_t y = 0; y < block.data_shards; ++y) {
+          auto &shard = block.shards[y];
+          payload.insert(std::end(payload), std::begin(shard) + sizeof(video_packet_raw_t), std::end(shard));
+        }
+        data_shards += block.data_shards;
+      }
+
+      auto header = (video_short_frame_header_t *) payload.data();
+      auto length = payload.size() >= sizeof(*header) ? (data_shards - 1) * shard_payload_size + header->lastPayloadLen : 0;
+
+      // H.264 frames start with an Annex B start code right after the frame header
+      std::string_view bitstream;
+      if (length >= sizeof(*header) && length <= payload.size() && header->headerType == 0x01) {
+        bitstream = std::string_view {(char *) payload.data() + sizeof(*header), length - sizeof(*header)};
+      }
+
+      if (bitstream.starts_with("\0\0\1"sv) || bitstream.starts_with("\0\0\0\1"sv)) {
+        ++report.frames_complete;
+        report.payload_bytes += bitstream.size();
+        report.completion_latency.collect(now - frame.first_packet);
+        report.host_latency.collect(std::chrono::microseconds {header->frame_processing_latency * 100});
+      } else {
+        ++report.frames_malformed;
+      }
+
+      // Frames before this one can no longer complete
+      if (last_complete_frame && frame_index - *last_complete_frame > 1) {
+        report.frames_lost += frame_index - *last_complete_frame - 1;
+        idr_requested = true;
+      }
+
+      for (auto it = std::begin(frames); it != std::end(frames) && it->first < frame_index;) {
+        for (auto &block : it->second.blocks) {
+          if (!block.shards.empty() && !block.complete) {
+            ++report.blocks_lost;
+          }
+        }
+
+        it = frames.erase(it);
+      }
+
+      last_complete_frame = frame_index;
+      frames.erase(frame_index);
+    }
+
+    void process(std::uint8_t *data, std::size_t bytes, std::chrono::steady_clock::time_point now, report_t &report) {
+      std::uint8_t *shard = data;
+      if (cipher) {
+        if (bytes != sizeof(video_packet_enc_prefix_t) + blocksize) {
+          ++report.decrypt_failures;
+          return;
+        }
+
+        auto prefix = (video_packet_enc_prefix_t *) data;
+        crypto::aes_t iv {std::begin(prefix->iv), std::end(prefix->iv)};
+
+        // The tag is directly followed by the ciphertext
+        if (cipher->decrypt(std::string_view {(char *) prefix->tag, sizeof(prefix->tag) + blocksize}, plaintext, &iv)) {
+          ++report.decrypt_failures;
+          return;
+        }
+
+        shard = plaintext.data();
+      } else if (bytes != blocksize) {
+        return;
+      }
+
+      auto header = (video_packet_raw_t *) shard;
+      std::uint32_t frame_index = header->packet.frameIndex;
+
+      // Late parity shards of frames that are already complete
+      if (last_complete_frame && frame_index <= *last_complete_frame) {
+        return;
+      }
+
+      auto fec_info = header->packet.fecInfo;
+      std::size_t shard_index = (fec_info >> 12) & 0x3FF;
+      std::size_t data_shards = (fec_info >> 22) & 0x3FF;
+      std::size_t percentage = (fec_info >> 4) & 0xFF;
+      std::size_t parity_shards = (data_shards * percentage + 99) / 100;
+
+      auto block_index = (header->packet.multiFecBlocks >> 4) & 0x3;
+      auto last_block = (header->packet.multiFecBlocks >> 6) & 0x3;
+
+      auto [it, inserted] = frames.try_emplace(frame_index);
+      auto &frame = it->second;
+      if (inserted) {
+        frame.first_packet = now;
+        frame.last_block = last_block;
+      }
+
+      auto &block = frame.blocks[block_index];
+      if (block.shards.empty()) {
+        block.data_shards = data_shards;
+        block.shards.resize(data_shards + parity_shards);
+      }
+
+      if (block.complete || shard_index >= block.shards.size() || !block.shards[shard_index].empty()) {
+        return;
+      }
+
+      block.shards[shard_index].assign(shard, shard + blocksize);
+      if (++block.received < block.data_shards || !recover(block, report)) {
+        return;
+      }
+
+      block.complete = true;
+      for (int x = 0; x <= frame.last_block; ++x) {
+        if (!frame.blocks[x].complete) {
+          return;
+        }
+      }
+
+      complete_frame(frame_index, frame, now, report);
+    }
+
+    report_t receive(std::chrono::milliseconds duration) {
+      report_t report;
+
+      std::mt19937 rng {options.seed};
+      std::bernoulli_distribution drop {options.loss};
+
+      std::array<std::uint8_t, 4096> buf;
+      udp::endpoint sender;
+      asio::steady_timer ping_timer {io_context};
+
+      std::optional<std::chrono::steady_clock::time_point> first_packet;
+      auto deadline = std::chrono::steady_clock::now() + config::stream.ping_timeout;
+
+      // Keep pinging until the host starts sending video to us
+      std::function<void()> ping = [&]() {
+        send_ping(video_sock, video_endpoint);
+
+        ping_timer.expires_after(first_packet ? 500ms : 100ms);
+        ping_timer.async_wait([&](const boost::system::error_code &ec) {
+          if (!ec) {
+            ping();
+          }
+        });
+      };
+
+      std::function<void(const boost::system::error_code &, std::size_t)> on_receive = [&](const boost::system::error_code &ec, std::size_t bytes) {
+        if (ec == asio::error::operation_aborted) {
+          return;
+        }
+
+        if (!ec) {
+          auto now = std::chrono::steady_clock::now();
+          if (!first_packet) {
+            first_packet = now;
+            deadline = now + duration;
+          }
+
+          ++report.packets_received;
+          if (drop(rng)) {
+            ++report.packets_dropped;
+          } else {
+            process(buf.data(), bytes, now, report);
+          }
+        }
+
+        video_sock.async_receive_from(asio::buffer(buf), sender, on_receive);
+      };
+
+      io_context.restart();
+      ping();
+      video_sock.async_receive_from(asio::buffer(buf), sender, on_receive);
+
+      for (auto now = std::chrono::steady_clock::now(); now < deadline && !terminated; now = std::chrono::steady_clock::now()) {
+        io_context.run_for(std::min<std::chrono::steady_clock::duration>(deadline - now, 100ms));
+      }
+
+      report.elapsed = first_packet ? std::chrono::steady_clock::now() - *first_packet : 0s;
+
+      // Let the pending handlers complete before the state they reference goes out of scope
+      ping_timer.cancel();
+      video_sock.cancel();
+      io_context.restart();
+      io_context.run();
+
+      if (!first_packet) {
+        BOOST_LOG(error) << "Loopback: no video received"sv;
+      }
+
+      frames.clear();
+      last_complete_frame.reset();
+
+      return report;
+    }
+
+    std::shared_ptr<rtsp_stream::launch_session_t> launch_session;
+    options_t options;
+    std::size_t blocksize;
+
+    std::optional<crypto::cipher::gcm_t> cipher;
+    std::vector<std::uint8_t> plaintext;
+
+    asio::io_context io_context;
+    udp::socket video_sock {io_context};
+    udp::socket audio_sock {io_context};
+    udp::endpoint video_endpoint;
+    udp::endpoint audio_endpoint;
+
+    std::uint16_t audio_port = 0;
+    std::uint16_t video_port = 0;
+    std::uint16_t control_port = 0;
+    int rtsp_sequence_number = 0;
+    std::uint32_t ping_sequence_number = 0;
+
+    net::host_t enet_host;
+    ENetPeer *peer = nullptr;
+    std::thread control_thread;
+    std::atomic_bool control_stop = false;
+    std::atomic_bool terminated = false;
+    std::atomic_bool idr_requested = false;
+
+    std::map<std::uint32_t, frame_t> frames;
+    std::optional<std::uint32_t> last_complete_frame;
+  };
+
+  client_t::client_t(std::shared_ptr<rtsp_stream::launch_session_t> launch_session, const options_t &options):
+      impl {std::make_unique<impl_t>(std::move(launch_session), options)} {
+  }
+
+  client_t::~client_t() = default;
+
+  int client_t::connect() {
+    return impl->connect();
+  }
+
+  report_t client_t::receive(std::chrono::milliseconds duration) {
+    return impl->receive(duration);
+  }
+
+  void client_t::disconnect() {
+    impl->stop_control();
+
+    // Wait for the host to join the session, so the next one starts from a clean slate
+    auto deadline = std::chrono::steady_clock::now() + 10s;
+    while (rtsp_stream::session_count() > 0 && std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(50ms);
+    }
+  }
+}  // namespace loopback
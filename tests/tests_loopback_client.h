@@ -0,0 +1,143 @@
+/**
+ * @file tests/tests_loopback_client.h
+ * @brief Declarations for a headless client that streams from a local host over loopback.
+ */
+#pragma once
+
+// standard includes
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <thread>
+
+// local includes
+#include <src/platform/common.h>
+#include <src/rtsp.h>
+#include <src/stat_trackers.h>
+
+namespace loopback {
+  /**
+   * @brief Stream parameters requested by the client.
+   */
+  struct options_t {
+    int width = 640;
+    int height = 360;
+    int fps = 60;
+    int bitrate = 10000;  ///< Kbps
+    int packet_size = 1024;
+    bool encrypt_video = false;
+
+    double loss = 0;  ///< Probability of dropping each received video packet before it's processed
+    std::uint32_t seed = 1;  ///< Seed for the synthetic loss, so runs are reproducible
+  };
+
+  /**
+   * @brief Statistics collected by the client while receiving video.
+   */
+  struct report_t {
+    std::chrono::duration<double> elapsed {};
+
+    std::uint64_t packets_received = 0;
+    std::uint64_t packets_dropped = 0;  ///< Dropped by the synthetic loss
+    std::uint64_t decrypt_failures = 0;
+
+    std::uint64_t frames_complete = 0;
+    std::uint64_t frames_lost = 0;
+    std::uint64_t frames_malformed = 0;  ///< Reassembled, but not starting with a valid frame header and start code
+
+    std::uint64_t blocks_recovered = 0;  ///< FEC blocks with missing data shards that were reconstructed
+    std::uint64_t blocks_lost = 0;  ///< FEC blocks with missing data shards that couldn't be reconstructed
+
+    std::uint64_t payload_bytes = 0;  ///< Video bitstream bytes of the complete frames
+
+    stat_trackers::latency_histogram completion_latency;  ///< From the first packet of a frame until it's complete
+    stat_trackers::latency_histogram host_latency;  ///< Host processing latency reported in the frame header
+
+    /**
+     * @brief Video bitstream throughput of the complete frames, in megabits per second.
+     */
+    double goodput_mbps() const;
+
+    /**
+     * @brief Fraction of FEC blocks with missing data shards that could be reconstructed.
+     * @return 1 if no block needed recovery.
+     */
+    double recovery_rate() const;
+
+    void print(std::ostream &os) const;
+  };
+
+  /**
+   * @brief Host side of the loopback: the RTSP server fed by the replay capture backend.
+   * @note The RTSP server can only be started once per process, so only one host may ever be created.
+   */
+  class host_t {
+  public:
+    host_t(const host_t &) = delete;
+    host_t &operator=(const host_t &) = delete;
+
+    ~host_t();
+
+    /**
+     * @brief Configure the replay capture and software encoder, then start the RTSP server.
+     * @param clip Raw BGRX clip to replay. A synthetic clip is generated if it's empty.
+     * @param options Resolution and framerate of the clip.
+     * @return nullptr if the host couldn't be started, e.g. because no encoder works.
+     */
+    static std::unique_ptr<host_t> start(const std::filesystem::path &clip, const options_t &options);
+
+    /**
+     * @brief Prepare a launch session like `/launch` does, and raise it to the RTSP server.
+     */
+    std::shared_ptr<rtsp_stream::launch_session_t> launch(const options_t &options);
+
+  private:
+    host_t() = default;
+
+    struct saved_config_t;
+
+    std::unique_ptr<saved_config_t> saved_config;
+    std::filesystem::path generated_clip;
+    std::unique_ptr<platf::deinit_t> platf_deinit;
+    std::thread rtsp_thread;
+  };
+
+  /**
+   * @brief Headless client performing the RTSP handshake, the control stream connection
+   * and the video reception with FEC recovery and decryption.
+   */
+  class client_t {
+  public:
+    client_t(std::shared_ptr<rtsp_stream::launch_session_t> launch_session, const options_t &options);
+    client_t(const client_t &) = delete;
+    client_t &operator=(const client_t &) = delete;
+
+    ~client_t();
+
+    /**
+     * @brief Perform the RTSP handshake and connect the control stream.
+     * @return 0 on success.
+     */
+    int connect();
+
+    /**
+     * @brief Receive and reassemble video.
+     * @param duration Time to receive for, measured from the first video packet.
+     * @return Statistics for the received video.
+     */
+    report_t receive(std::chrono::milliseconds duration);
+
+    /**
+     * @brief Disconnect the control stream and wait for the host to tear the session down.
+     */
+    void disconnect();
+
+  private:
+    struct impl_t;
+
+    std::unique_ptr<impl_t> impl;
+  };
+}  // namespace loopback
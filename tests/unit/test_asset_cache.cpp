@@ -0,0 +1,162 @@
+/**
+ * @file tests/unit/test_asset_cache.cpp
+ * @brief Test src/asset_cache.*.
+ */
+#include "../tests_common.h"
+
+#include <src/asset_cache.h>
+#include <zlib.h>
+
+using namespace asset_cache;
+
+namespace {
+  std::string gunzip(const std::string &data) {
+    z_stream stream {};
+    if (inflateInit2(&stream, 15 + 16) != Z_OK) {
+      return {};
+    }
+
+    std::string result(64 * 1024, '\0');
+    stream.next_in = (Bytef *) data.data();
+    stream.avail_in = (uInt) data.size();
+    stream.next_out = (Bytef *) result.data();
+    stream.avail_out = (uInt) result.size();
+
+    auto status = inflate(&stream, Z_FINISH);
+    result.resize(stream.total_out);
+    inflateEnd(&stream);
+
+    return status == Z_STREAM_END ? result : std::string {};
+  }
+}  // namespace
+
+struct AssetCacheTest: TempDirTest {
+  void SetUp() override {
+    TempDirTest::SetUp();
+    web = root / "web";
+
+    script.clear();
+    for (int x = 0; x < 200; ++x) {
+      script += "console.log('asset cache line " + std::to_string(x) + "');\n";
+    }
+    write("web/app.js", script);
+  }
+
+  std::filesystem::path web;
+  std::string script;
+};
+
+TEST_F(AssetCacheTest, LoadsAndCompressesAFile) {
+  cache_t cache {web};
+
+  auto lookup = cache.get("/app.js");
+  ASSERT_EQ(lookup.status, status_e::ok);
+  ASSERT_TRUE(lookup.asset);
+
+  auto &asset = *lookup.asset;
+  EXPECT_EQ(asset.content, script);
+  EXPECT_EQ(asset.content_type, "application/javascript");
+  EXPECT_TRUE(asset.etag.starts_with('"') && asset.etag.ends_with('"'));
+  ASSERT_FALSE(asset.gzip_content.empty());
+  EXPECT_LT(asset.gzip_content.size(), asset.content.size());
+  EXPECT_EQ(gunzip(asset.gzip_content), script);
+  EXPECT_NE(asset.gzip_etag, asset.etag);
+}
+
+TEST_F(AssetCacheTest, HitsShareTheAsset) {
+  cache_t cache {web};
+
+  auto first = cache.get("app.js");
+  for (auto path : {"/app.js", "//app.js", "./app.js", "nested/../app.js", "/./nested/.././app.js"}) {
+    EXPECT_EQ(cache.get(path).asset, first.asset) << path;
+  }
+}
+
+TEST_F(AssetCacheTest, SmallAndBinaryFilesAreNotCompressed) {
+  write("web/small.css", "body { margin: 0; }");
+  write("web/image.png", std::string(4096, '\0'));
+  cache_t cache {web};
+
+  auto css = cache.get("small.css");
+  ASSERT_EQ(css.status, status_e::ok);
+  EXPECT_TRUE(css.asset->gzip_content.empty());
+
+  auto png = cache.get("image.png");
+  ASSERT_EQ(png.status, status_e::ok);
+  EXPECT_EQ(png.asset->content.size(), 4096);
+  EXPECT_TRUE(png.asset->gzip_content.empty());
+}
+
+TEST_F(AssetCacheTest, RejectsInvalidPaths) {
+  write("secret.txt", "secret");
+  write("web/program.exe", "MZ");
+  cache_t cache {web};
+
+  EXPECT_EQ(cache.get("../secret.txt").status, status_e::outside_root);
+  EXPECT_EQ(cache.get("/nested/../../secret.txt").status, status_e::outside_root);
+  EXPECT_EQ(cache.get("missing.js").status, status_e::not_found);
+  EXPECT_EQ(cache.get("program.exe").status, status_e::unsupported_type);
+  EXPECT_FALSE(cache.get("../secret.txt").asset);
+}
+
+TEST_F(AssetCacheTest, ReloadsModifiedFiles) {
+  cache_t cache {web, std::chrono::milliseconds {0}};
+  auto before = cache.get("app.js").asset;
+
+  write("web/app.js", "console.log('changed');");
+  std::filesystem::last_write_time(web / "app.js", before->last_write_time + std::chrono::seconds {1});
+
+  auto after = cache.get("app.js").asset;
+  ASSERT_TRUE(after);
+  EXPECT_NE(before, after);
+  EXPECT_EQ(after->content, "console.log('changed');");
+  EXPECT_NE(before->etag, after->etag);
+
+  std::filesystem::remove(web / "app.js");
+  EXPECT_EQ(cache.get("app.js").status, status_e::not_found);
+}
+
+struct AcceptsEncodingTest: testing::TestWithParam<std::tuple<std::string_view, bool>> {};
+
+INSTANTIATE_TEST_SUITE_P(
+  AssetCacheTests,
+  AcceptsEncodingTest,
+  testing::Values(
+    std::make_tuple("gzip", true),
+    std::make_tuple("gzip, deflate, br, zstd", true),
+    std::make_tuple("deflate, GZIP;q=0.5", true),
+    std::make_tuple("br", false),
+    std::make_tuple("", false),
+    std::make_tuple("gzip;q=0", false),
+    std::make_tuple("gzip; q=0.0, identity", false),
+    std::make_tuple("*", true),
+    std::make_tuple("*;q=0", false),
+    std::make_tuple("gzip;q=0, *", false)
+  )
+);
+
+TEST_P(AcceptsEncodingTest, Run) {
+  auto [header, expected] = GetParam();
+  EXPECT_EQ(accepts_encoding(header, "gzip"), expected);
+}
+
+struct EtagMatchesTest: testing::TestWithParam<std::tuple<std::string_view, bool>> {};
+
+INSTANTIATE_TEST_SUITE_P(
+  AssetCacheTests,
+  EtagMatchesTest,
+  testing::Values(
+    std::make_tuple("\"abc\"", true),
+    std::make_tuple("W/\"abc\"", true),
+    std::make_tuple("\"xyz\", \"abc\"", true),
+    std::make_tuple("*", true),
+    std::make_tuple("\"abc-gzip\"", false),
+    std::make_tuple("abc", false),
+    std::make_tuple("", false)
+  )
+);
+
+TEST_P(EtagMatchesTest, Run) {
+  auto [header, expected] = GetParam();
+  EXPECT_EQ(etag_matches(header, "\"abc\""), expected);
+}
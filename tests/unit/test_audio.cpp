@@ -45,12 +45,12 @@ TEST_P(AudioTest, TestEncode) {
     // Terminate the audio capture after 5 seconds.
     std::this_thread::sleep_for(5s);
     auto shutdown_event = m_mail->event<bool>(mail::shutdown);
-    auto audio_packets = m_mail->queue<packet_t>(mail::audio_packets);
+    auto audio_packets = m_mail->ring_queue<packet_t>(mail::audio_packets);
     shutdown_event->raise(true);
     audio_packets->stop();
   });
   std::thread capture([&] {
-    auto packets = m_mail->queue<packet_t>(mail::audio_packets);
+    auto packets = m_mail->ring_queue<packet_t>(mail::audio_packets);
     auto shutdown_event = m_mail->event<bool>(mail::shutdown);
     while (auto packet = packets->pop()) {
       if (shutdown_event->peek()) {
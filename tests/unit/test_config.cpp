@@ -0,0 +1,119 @@
+/**
+ * @file tests/unit/test_config.cpp
+ * @brief Test src/config.*.
+ */
+#include "../tests_common.h"
+
+#include <src/config.h>
+
+namespace config {
+  void cpu_list_f(std::unordered_map<std::string, std::string> &vars, const std::string &name, std::vector<int> &input);
+}
+
+struct ConfigReloadTest: TempDirTest {
+  void SetUp() override {
+    TempDirTest::SetUp();
+    saved_config_file = config::sunshine.config_file;
+    default_fec_percentage = config::stream.fec_percentage;
+    default_port = config::sunshine.port;
+
+    config::sunshine.config_file = (root / "reload.conf").string();
+    write("");
+    config::reload();
+  }
+
+  void TearDown() override {
+    write("");
+    config::reload();
+
+    config::sunshine.config_file = saved_config_file;
+    TempDirTest::TearDown();
+  }
+
+  void write(const std::string &content) {
+    TempDirTest::write("reload.conf", content);
+  }
+
+  std::string saved_config_file;
+  int default_fec_percentage;
+  std::uint16_t default_port;
+};
+
+TEST_F(ConfigReloadTest, AppliesLiveOptions) {
+  write("fec_percentage = 35\nmouse = disabled\n");
+
+  auto result = config::reload();
+  EXPECT_EQ(result.applied, (std::vector<std::string> {"fec_percentage", "mouse"}));
+  EXPECT_TRUE(result.restart_required.empty());
+  EXPECT_EQ(config::stream.fec_percentage, 35);
+  EXPECT_FALSE(config::input.mouse);
+
+  // Nothing changed since
+  result = config::reload();
+  EXPECT_TRUE(result.applied.empty());
+  EXPECT_TRUE(result.restart_required.empty());
+
+  // Removed options return to their defaults
+  write("mouse = disabled\n");
+  result = config::reload();
+  EXPECT_EQ(result.applied, (std::vector<std::string> {"fec_percentage"}));
+  EXPECT_EQ(config::stream.fec_percentage, default_fec_percentage);
+  EXPECT_FALSE(config::input.mouse);
+}
+
+TEST_F(ConfigReloadTest, ReportsOptionsThatRequireARestart) {
+  write("port = 48000\nfec_percentage = 35\n");
+
+  auto result = config::reload();
+  EXPECT_EQ(result.applied, (std::vector<std::string> {"fec_percentage"}));
+  EXPECT_EQ(result.restart_required, (std::vector<std::string> {"port"}));
+  EXPECT_EQ(config::sunshine.port, default_port);
+
+  // Still pending until the restart
+  result = config::reload();
+  EXPECT_TRUE(result.applied.empty());
+  EXPECT_EQ(result.restart_required, (std::vector<std::string> {"port"}));
+}
+
+TEST_F(ConfigReloadTest, ChangesTheLogLevel) {
+  auto min_level = logging::min_level.load();
+
+  write("min_log_level = fatal\n");
+  auto result = config::reload();
+  EXPECT_EQ(result.applied, (std::vector<std::string> {"min_log_level"}));
+  EXPECT_EQ(config::sunshine.min_log_level, 5);
+  EXPECT_EQ(logging::min_level, 5);
+
+  write("min_log_level = " + std::to_string(min_level) + "\n");
+  config::reload();
+  EXPECT_EQ(logging::min_level, min_level);
+}
+
+struct CpuListTest: testing::TestWithParam<std::tuple<std::string, std::vector<int>>> {};
+
+TEST_P(CpuListTest, Run) {
+  auto [value, expected] = GetParam();
+
+  // Invalid lists leave the previous value
+  std::vector<int> cpus {42};
+  std::unordered_map<std::string, std::string> vars {{"capture_cpus", value}};
+  config::cpu_list_f(vars, "capture_cpus", cpus);
+  EXPECT_EQ(cpus, expected);
+}
+
+INSTANTIATE_TEST_SUITE_P(
+  ConfigTests,
+  CpuListTest,
+  testing::Values(
+    std::make_tuple("0-3,8", std::vector<int> {0, 1, 2, 3, 8}),
+    std::make_tuple("8, 2 - 3 ,0", std::vector<int> {0, 2, 3, 8}),
+    std::make_tuple("1-2,2-3,1", std::vector<int> {1, 2, 3}),
+    std::make_tuple("5", std::vector<int> {5}),
+    std::make_tuple("3-0", std::vector<int> {42}),
+    std::make_tuple("0-", std::vector<int> {42}),
+    std::make_tuple("0,,1", std::vector<int> {42}),
+    std::make_tuple("0-3x", std::vector<int> {42}),
+    std::make_tuple("cpu0", std::vector<int> {42}),
+    std::make_tuple("1023-2000", std::vector<int> {1023})
+  )
+);
@@ -0,0 +1,160 @@
+/**
+ * @file tests/unit/test_cover_cache.cpp
+ * @brief Test src/cover_cache.*.
+ */
+#include "../tests_common.h"
+
+#include <src/cover_cache.h>
+
+using namespace cover_cache;
+using namespace std::literals;
+
+namespace {
+  image_t gradient(int width, int height, bool transparent = false) {
+    image_t image {width, height, std::vector<std::uint8_t>((std::size_t) width * height * 4)};
+
+    for (int y = 0; y < height; ++y) {
+      for (int x = 0; x < width; ++x) {
+        auto pixel = &image.pixels[((std::size_t) y * width + x) * 4];
+        pixel[0] = (std::uint8_t) (x * 255 / width);
+        pixel[1] = (std::uint8_t) (y * 255 / height);
+        pixel[2] = 128;
+        pixel[3] = transparent ? (std::uint8_t) ((x + y) % 256) : 255;
+      }
+    }
+
+    return image;
+  }
+}  // namespace
+
+TEST(CoverCachePngTest, RoundTripsOpaqueAndTransparentImages) {
+  for (auto transparent : {false, true}) {
+    auto image = gradient(37, 23, transparent);
+
+    auto png = encode_png(image);
+    ASSERT_FALSE(png.empty());
+    EXPECT_EQ(sniff_content_type(png), "image/png");
+
+    auto decoded = decode_png(png);
+    ASSERT_TRUE(decoded);
+    EXPECT_EQ(decoded->width, image.width);
+    EXPECT_EQ(decoded->height, image.height);
+    EXPECT_EQ(decoded->pixels, image.pixels);
+  }
+}
+
+TEST(CoverCachePngTest, RejectsInvalidData) {
+  auto png = encode_png(gradient(16, 16));
+
+  EXPECT_FALSE(decode_png(""));
+  EXPECT_FALSE(decode_png("\xFF\xD8\xFF\xE0 not a png"));
+  EXPECT_FALSE(decode_png(png.substr(0, png.size() / 2)));
+}
+
+TEST(CoverCachePngTest, RejectsImagesOverThePixelBudget) {
+  // Just over 4 megapixels, a single row keeps encoding it cheap
+  EXPECT_FALSE(decode_png(encode_png(gradient(2048 * 2048 + 1, 1))));
+}
+
+TEST(CoverCacheFitTest, KeepsTheAspectRatio) {
+  auto scaled = fit(gradient(1200, 1200), 600, 800);
+  EXPECT_EQ(scaled.width, 600);
+  EXPECT_EQ(scaled.height, 600);
+
+  scaled = fit(gradient(1000, 2000), 600, 800);
+  EXPECT_EQ(scaled.width, 400);
+  EXPECT_EQ(scaled.height, 800);
+
+  auto small = gradient(300, 400);
+  EXPECT_EQ(fit(small, 600, 800).pixels, small.pixels);
+}
+
+TEST(CoverCacheFitTest, AveragesTheCoveredArea) {
+  // Opaque red next to fully transparent green, the green must not bleed into the result
+  image_t image {2, 1, {255, 0, 0, 255, 0, 255, 0, 0}};
+
+  auto scaled = fit(image, 1, 1);
+  ASSERT_EQ(scaled.pixels.size(), 4);
+  EXPECT_EQ(scaled.pixels[0], 255);
+  EXPECT_EQ(scaled.pixels[1], 0);
+  EXPECT_EQ(scaled.pixels[2], 0);
+  EXPECT_EQ(scaled.pixels[3], 128);
+}
+
+struct CoverCacheTest: TempDirTest {};
+
+TEST_F(CoverCacheTest, ScalesLargeCoversAndKeepsThemOnDisk) {
+  auto image = write("large.png", encode_png(gradient(1200, 1600)));
+
+  cache_t cache {root / "cache"};
+  auto cover = cache.get(image);
+  ASSERT_TRUE(cover);
+  EXPECT_EQ(cover->content_type, "image/png");
+  EXPECT_TRUE(cover->etag.starts_with('"') && cover->etag.ends_with('"'));
+
+  auto decoded = decode_png(cover->content);
+  ASSERT_TRUE(decoded);
+  EXPECT_EQ(decoded->width, cache_t::MAX_WIDTH);
+  EXPECT_EQ(decoded->height, cache_t::MAX_HEIGHT);
+
+  EXPECT_EQ(cache.get(image), cover);
+
+  // Another cache finds the scaled cover on disk
+  ASSERT_EQ(std::distance(std::filesystem::directory_iterator {root / "cache"}, {}), 1);
+  cache_t restarted {root / "cache"};
+  EXPECT_EQ(restarted.get(image)->etag, cover->etag);
+}
+
+TEST_F(CoverCacheTest, ServesOtherFormatsUnchanged) {
+  auto jpeg = "\xFF\xD8\xFF\xE0 jpeg data"s;
+  auto small = encode_png(gradient(300, 400));
+  cache_t cache {root / "cache"};
+
+  auto cover = cache.get(write("cover.png", jpeg));
+  ASSERT_TRUE(cover);
+  EXPECT_EQ(cover->content_type, "image/jpeg");
+  EXPECT_EQ(cover->content, jpeg);
+
+  cover = cache.get(write("small.png", small));
+  ASSERT_TRUE(cover);
+  EXPECT_EQ(cover->content, small);
+
+  EXPECT_FALSE(cache.get(root / "missing.png"));
+  EXPECT_FALSE(std::filesystem::exists(root / "cache"));
+}
+
+TEST_F(CoverCacheTest, ReloadsReplacedCovers) {
+  auto image = write("cover.png", encode_png(gradient(30, 40)));
+  cache_t cache {{}};
+  auto before = cache.get(image);
+
+  // Replaced within the resolution of the modification time
+  auto last_write_time = std::filesystem::last_write_time(image);
+  write("cover.png", encode_png(gradient(40, 30)));
+  std::filesystem::last_write_time(image, last_write_time);
+
+  cache.invalidate(image);
+  auto after = cache.get(image);
+  ASSERT_TRUE(after);
+  EXPECT_NE(after->etag, before->etag);
+  EXPECT_EQ(decode_png(after->content)->width, 40);
+}
+
+TEST_F(CoverCacheTest, EvictsTheLeastRecentlyUsedCovers) {
+  auto first = write("first.png", encode_png(gradient(100, 100)));
+  auto second = write("second.png", encode_png(gradient(100, 100, true)));
+  auto third = write("third.png", encode_png(gradient(50, 50)));
+
+  auto size = std::filesystem::file_size(first) + std::filesystem::file_size(second);
+  cache_t cache {{}, size};
+
+  auto first_cover = cache.get(first);
+  cache.get(second);
+  EXPECT_EQ(cache.get(first), first_cover);
+  EXPECT_EQ(cache.memory_usage(), size);
+
+  // Makes room by evicting the second cover, it was used longest ago
+  cache.get(third);
+  EXPECT_LE(cache.memory_usage(), size);
+  EXPECT_EQ(cache.get(first), first_cover);
+}
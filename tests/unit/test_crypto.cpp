@@ -0,0 +1,64 @@
+/**
+ * @file tests/unit/test_crypto.cpp
+ * @brief Test src/crypto.*.
+ */
+#include "../tests_common.h"
+
+#include <src/crypto.h>
+
+TEST(CertChainTest, VerifiedCertificatesAreForgottenOnClear) {
+  crypto::cert_chain_t chain;
+
+  auto creds = crypto::gen_creds("Paired", 2048);
+  auto paired = std::make_shared<crypto::named_cert_t>();
+  paired->cert = creds.x509;
+  chain.add(paired);
+
+  auto x509 = crypto::x509(creds.x509);
+  crypto::p_named_cert_t verified;
+
+  // The second verification is answered from the fingerprint cache
+  for (int x = 0; x < 2; ++x) {
+    verified.reset();
+    ASSERT_EQ(chain.verify(x509.get(), verified), nullptr);
+    ASSERT_EQ(verified, paired);
+  }
+
+  auto stranger = crypto::gen_creds("Stranger", 2048);
+  verified.reset();
+  ASSERT_NE(chain.verify(crypto::x509(stranger.x509).get(), verified), nullptr);
+  ASSERT_FALSE(verified);
+
+  // Unpairing clears the chain, which must also revoke the cached verification
+  chain.clear();
+  verified.reset();
+  ASSERT_NE(chain.verify(x509.get(), verified), nullptr);
+  ASSERT_FALSE(verified);
+}
+
+TEST(GcmTest, DecryptsIntoACallerProvidedBuffer) {
+  crypto::aes_t key(16, 0x42);
+  crypto::aes_t iv(12, 0x07);
+  crypto::cipher::gcm_t encrypter {key, false};
+  crypto::cipher::gcm_t decrypter {key, false};
+
+  std::string_view plaintext {"\x06\x02 relative mouse move"};
+  std::vector<std::uint8_t> tagged_cipher(crypto::cipher::round_to_pkcs7_padded(plaintext.size()) + crypto::cipher::tag_size);
+  auto len = encrypter.encrypt(plaintext, tagged_cipher.data(), &iv);
+  ASSERT_GT(len, 0);
+  std::string_view message {(char *) tagged_cipher.data(), crypto::cipher::tag_size + len};
+
+  std::vector<std::uint8_t> buffer(crypto::cipher::round_to_pkcs7_padded(message.size() - crypto::cipher::tag_size));
+  ASSERT_EQ(decrypter.decrypt(message, buffer.data(), &iv), plaintext.size());
+  EXPECT_EQ(std::string_view((char *) buffer.data(), plaintext.size()), plaintext);
+
+  // The vector overload returns the same plaintext
+  std::vector<std::uint8_t> decrypted;
+  ASSERT_EQ(decrypter.decrypt(message, decrypted, &iv), 0);
+  EXPECT_EQ(std::string_view((char *) decrypted.data(), decrypted.size()), plaintext);
+
+  // Tampered and truncated messages fail verification
+  tagged_cipher[crypto::cipher::tag_size] ^= 1;
+  EXPECT_EQ(decrypter.decrypt(message, buffer.data(), &iv), -1);
+  EXPECT_EQ(decrypter.decrypt(message.substr(0, crypto::cipher::tag_size - 1), buffer.data(), &iv), -1);
+}
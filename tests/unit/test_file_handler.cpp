@@ -5,6 +5,7 @@
 #include "../tests_common.h"
 
 #include <src/file_handler.h>
+#include <thread>
 
 struct FileHandlerParentDirectoryTest: testing::TestWithParam<std::tuple<std::string, std::string>> {};
 
@@ -93,3 +94,102 @@ TEST(FileHandlerTests, ReadMissingFileTest) {
   // read missing file
   EXPECT_EQ(file_handler::read_file("non-existing-file.txt"), "");
 }
+
+struct FileHandlerAtomicWriteTest: TempDirTest {
+  void SetUp() override {
+    TempDirTest::SetUp();
+    path = write("state.json", "old contents").string();
+  }
+
+  // The number of entries in the directory, temporary files included
+  std::size_t files() {
+    return std::distance(std::filesystem::directory_iterator {root}, std::filesystem::directory_iterator {});
+  }
+
+  std::string path;
+};
+
+TEST_F(FileHandlerAtomicWriteTest, ReplacesTheFile) {
+  EXPECT_EQ(file_handler::write_file_atomic(path.c_str(), "new contents"), 0);
+  EXPECT_EQ(file_handler::read_file(path.c_str()), "new contents");
+  EXPECT_EQ(files(), 1);
+}
+
+TEST_F(FileHandlerAtomicWriteTest, RecoversFromATornWrite) {
+  // A crash in the middle of a write leaves a truncated temporary file behind, but the file intact
+  auto torn_path = path + ".1234.tmp";
+  file_handler::write_file(torn_path.c_str(), "{\"root\": {\"uniq");
+  EXPECT_EQ(file_handler::read_file(path.c_str()), "old contents");
+
+  EXPECT_EQ(file_handler::write_file_atomic(path.c_str(), "new contents"), 0);
+  EXPECT_EQ(file_handler::read_file(path.c_str()), "new contents");
+  EXPECT_EQ(files(), 2);
+}
+
+TEST_F(FileHandlerAtomicWriteTest, KeepsTheFileOnFailure) {
+  // The temporary file is written, but can't replace a directory
+  auto occupied = root / "occupied";
+  write("occupied/file", "contents");
+
+  EXPECT_EQ(file_handler::write_file_atomic(occupied.string().c_str(), "new contents"), -1);
+  EXPECT_TRUE(std::filesystem::is_directory(occupied));
+  EXPECT_EQ(files(), 2);
+}
+
+TEST_F(FileHandlerAtomicWriteTest, ConcurrentUpdatesAreSerialized) {
+  constexpr int threads = 8;
+  constexpr int updates = 16;
+
+  std::vector<std::thread> updaters;
+  for (int x = 0; x < threads; ++x) {
+    updaters.emplace_back([&]() {
+      for (int y = 0; y < updates; ++y) {
+        file_handler::update_file_atomic(path, [](const std::string &current) {
+          return current + '.';
+        });
+      }
+    });
+  }
+  for (auto &updater : updaters) {
+    updater.join();
+  }
+
+  EXPECT_EQ(file_handler::read_file(path.c_str()), "old contents" + std::string(threads * updates, '.'));
+  EXPECT_EQ(files(), 1);
+}
+
+TEST_F(FileHandlerAtomicWriteTest, DeferredWritesAreCoalesced) {
+  file_handler::deferred_writer_t writer {std::chrono::hours {1}};
+
+  int updates = 0;
+  writer.write(path, [&](const std::string &current) {
+    ++updates;
+    return current + " first";
+  });
+  writer.write(path, [&](const std::string &current) {
+    ++updates;
+    return current + " second";
+  });
+  EXPECT_EQ(file_handler::read_file(path.c_str()), "old contents");
+
+  // Changes made by others in the meantime are the base of the update
+  file_handler::write_file(path.c_str(), "other contents");
+
+  EXPECT_EQ(writer.flush(), 0);
+  EXPECT_EQ(updates, 1);
+  EXPECT_EQ(file_handler::read_file(path.c_str()), "other contents second");
+
+  EXPECT_EQ(writer.flush(), 0);
+  EXPECT_EQ(updates, 1);
+}
+
+TEST_F(FileHandlerAtomicWriteTest, DeferredWritesAreFlushedOnDestruction) {
+  {
+    file_handler::deferred_writer_t writer {std::chrono::hours {1}};
+    writer.write(path, [](const std::string &current) {
+      return current + " pending";
+    });
+  }
+
+  EXPECT_EQ(file_handler::read_file(path.c_str()), "old contents pending");
+}
@@ -71,3 +71,31 @@ INSTANTIATE_TEST_SUITE_P(
     std::make_tuple(URL_2, "hello-redirect.txt")
   )
 );
+
+using byte_range_t = std::optional<std::pair<std::uint64_t, std::uint64_t>>;
+
+struct ParseByteRangeTest: testing::TestWithParam<std::tuple<std::string, std::uint64_t, byte_range_t>> {};
+
+TEST_P(ParseByteRangeTest, Run) {
+  const auto &[header, size, expected] = GetParam();
+  ASSERT_EQ(http::parse_byte_range(header, size), expected);
+}
+
+INSTANTIATE_TEST_SUITE_P(
+  ParseByteRangeTests,
+  ParseByteRangeTest,
+  testing::Values(
+    std::make_tuple("bytes=0-", 1000, std::make_pair(0, 1000)),
+    std::make_tuple("bytes=100-", 1000, std::make_pair(100, 1000)),
+    std::make_tuple("bytes=100-199", 1000, std::make_pair(100, 200)),
+    std::make_tuple("bytes=900-5000", 1000, std::make_pair(900, 1000)),
+    std::make_tuple("bytes=-200", 1000, std::make_pair(800, 1000)),
+    std::make_tuple("bytes=-5000", 1000, std::make_pair(0, 1000)),
+    std::make_tuple("bytes=1000-", 1000, std::nullopt),
+    std::make_tuple("bytes=200-100", 1000, std::nullopt),
+    std::make_tuple("bytes=-0", 1000, std::nullopt),
+    std::make_tuple("bytes=0-99,200-299", 1000, std::nullopt),
+    std::make_tuple("lines=0-10", 1000, std::nullopt),
+    std::make_tuple("bytes=abc-", 1000, std::nullopt)
+  )
+);
@@ -7,6 +7,9 @@
 
 #include <random>
 #include <src/logging.h>
+#include <thread>
+
+using namespace std::literals;
 
 namespace {
   std::array log_levels = {
@@ -44,3 +47,89 @@ TEST_P(LogLevelsTest, PutMessage) {
 
   ASSERT_TRUE(log_checker::line_contains(log_file, test_message));
 }
+
+TEST(LogTailTest, ReturnsNewRecordsFromMemory) {
+  logging::log_flush();
+  auto start = logging::tail(0, 0, 0).last_sequence;
+
+  BOOST_LOG(debug) << "tail debug record"sv;
+  BOOST_LOG(warning) << "tail warning record"sv;
+  logging::log_flush();
+
+  auto all = logging::tail(start, 0, 100);
+  ASSERT_EQ(all.records.size(), 2);
+  EXPECT_EQ(all.records[0].level, 1);
+  EXPECT_NE(all.records[0].text.find("Debug: tail debug record"), std::string::npos);
+  EXPECT_EQ(all.records[1].level, 3);
+  EXPECT_EQ(all.last_sequence, all.records[1].sequence);
+  EXPECT_FALSE(all.truncated);
+
+  auto warnings = logging::tail(start, 3, 100);
+  ASSERT_EQ(warnings.records.size(), 1);
+  EXPECT_NE(warnings.records[0].text.find("tail warning record"), std::string::npos);
+
+  auto resumed = logging::tail(all.last_sequence, 0, 100);
+  EXPECT_TRUE(resumed.records.empty());
+}
+
+TEST(LogTailTest, LimitKeepsTheNewestRecords) {
+  logging::log_flush();
+  auto start = logging::tail(0, 0, 0).last_sequence;
+
+  for (int x = 0; x < 5; ++x) {
+    BOOST_LOG(info) << "tail record "sv << x;
+  }
+  logging::log_flush();
+
+  auto tail = logging::tail(start, 0, 2);
+  ASSERT_EQ(tail.records.size(), 2);
+  EXPECT_TRUE(tail.truncated);
+  EXPECT_NE(tail.records[0].text.find("tail record 3"), std::string::npos);
+  EXPECT_NE(tail.records[1].text.find("tail record 4"), std::string::npos);
+}
+
+TEST(LogWriterTest, KeepsTheOrderOfEachThread) {
+  logging::log_flush();
+  auto start = logging::tail(0, 0, 0).last_sequence;
+
+  std::vector<std::thread> threads;
+  for (int x = 0; x < 4; ++x) {
+    threads.emplace_back([x]() {
+      for (int y = 0; y < 100; ++y) {
+        BOOST_LOG(info) << "writer thread "sv << x << " record "sv << y;
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  logging::log_flush();
+
+  auto tail = logging::tail(start, 0, 1000);
+  ASSERT_EQ(tail.records.size(), 400);
+  EXPECT_EQ(logging::dropped_records(), 0);
+
+  std::array<int, 4> next {};
+  for (auto &record : tail.records) {
+    int thread = 0;
+    int count = 0;
+    ASSERT_EQ(std::sscanf(record.text.substr(record.text.find("writer thread")).c_str(), "writer thread %d record %d", &thread, &count), 2);
+    EXPECT_EQ(count, next[thread]++);
+  }
+}
+
+TEST(LogLevelGateTest, FilteredRecordsAreNotFormatted) {
+  auto previous = logging::min_level.exchange(3);
+
+  int formatted = 0;
+  auto format = [&formatted]() {
+    ++formatted;
+    return "gated record"sv;
+  };
+  BOOST_LOG(debug) << format();
+  BOOST_LOG(warning) << format();
+
+  logging::min_level = previous;
+
+  EXPECT_EQ(formatted, 1);
+}
@@ -0,0 +1,109 @@
+/**
+ * @file tests/unit/test_nvhttp_response_cache.cpp
+ * @brief Test the cached serverinfo and applist responses of src/nvhttp.cpp.
+ */
+#include "../tests_common.h"
+
+#include <src/file_handler.h>
+#include <src/nvhttp.h>
+#include <src/process.h>
+#include <src/uuid.h>
+
+using namespace nvhttp;
+
+struct NvhttpResponseCacheTest: testing::Test {
+  void SetUp() override {
+    apps_file = platf::appdata().string() + "/tests/apps_response_cache.json";
+    file_handler::make_directory(file_handler::get_parent_directory(apps_file));
+    write_apps({"Desktop", "Steam"});
+  }
+
+  void TearDown() override {
+    std::filesystem::remove(apps_file);
+    proc::refresh(apps_file, false);
+  }
+
+  void write_apps(const std::vector<std::string> &names) {
+    nlohmann::json tree;
+    tree["version"] = 2;
+    tree["env"] = nlohmann::json::object();
+    tree["apps"] = nlohmann::json::array();
+    for (const auto &name : names) {
+      tree["apps"].push_back({{"name", name}, {"uuid", uuid_util::uuid_t::generate().string()}});
+    }
+    file_handler::write_file(apps_file.c_str(), tree.dump());
+  }
+
+  static applist_key_t listing_key() {
+    applist_key_t key;
+    key.perm = crypto::PERM::_all;
+    return key;
+  }
+
+  std::string apps_file;
+};
+
+TEST_F(NvhttpResponseCacheTest, RepeatedRequestsShareTheBuffer) {
+  proc::refresh(apps_file, false);
+
+  auto first = get_applist(listing_key());
+  auto second = get_applist(listing_key());
+
+  EXPECT_EQ(first, second);
+  EXPECT_NE(first->find("<AppTitle>Steam</AppTitle>"), std::string::npos);
+}
+
+TEST_F(NvhttpResponseCacheTest, RefreshInvalidatesTheAppList) {
+  proc::refresh(apps_file, false);
+  auto before = get_applist(listing_key());
+
+  write_apps({"Desktop", "Steam", "Retroarch"});
+  proc::refresh(apps_file, false);
+  auto after = get_applist(listing_key());
+
+  EXPECT_NE(before, after);
+  EXPECT_EQ(before->find("<AppTitle>Retroarch</AppTitle>"), std::string::npos);
+  EXPECT_NE(after->find("<AppTitle>Retroarch</AppTitle>"), std::string::npos);
+}
+
+TEST_F(NvhttpResponseCacheTest, PermissionsAreKeyedSeparately) {
+  proc::refresh(apps_file, false);
+
+  auto denied_key = listing_key();
+  denied_key.perm = crypto::PERM::_no;
+
+  auto allowed = get_applist(listing_key());
+  auto denied = get_applist(denied_key);
+
+  EXPECT_NE(allowed, denied);
+  EXPECT_NE(denied->find("Permission Denied"), std::string::npos);
+  EXPECT_EQ(allowed->find("Permission Denied"), std::string::npos);
+}
+
+TEST_F(NvhttpResponseCacheTest, ServerinfoFollowsTheRunningApp) {
+  serverinfo_key_t key;
+  key.https = true;
+  key.perm = crypto::PERM::_all;
+  key.local_address = "192.168.1.2";
+
+  auto idle = get_serverinfo(key);
+  EXPECT_EQ(idle, get_serverinfo(key));
+  EXPECT_NE(idle->find("SUNSHINE_SERVER_FREE"), std::string::npos);
+
+  key.current_appid = 1234;
+  auto busy = get_serverinfo(key);
+  EXPECT_NE(busy->find("SUNSHINE_SERVER_BUSY"), std::string::npos);
+
+  invalidate_response_cache();
+  EXPECT_NE(busy, get_serverinfo(key));
+}
+
+TEST_F(NvhttpResponseCacheTest, ServerinfoHidesIPv6LocalAddress) {
+  serverinfo_key_t key;
+  key.local_address = "fe80::1";
+
+  auto response = get_serverinfo(key);
+
+  EXPECT_NE(response->find("<LocalIP>127.0.0.1</LocalIP>"), std::string::npos);
+  EXPECT_NE(response->find("<mac>00:00:00:00:00:00</mac>"), std::string::npos);
+}
@@ -0,0 +1,49 @@
+/**
+ * @file tests/unit/test_process.cpp
+ * @brief Test src/process.*.
+ */
+#include "../tests_common.h"
+
+#include <src/process.h>
+
+struct ProcessImageHashTest: TempDirTest {};
+
+TEST_F(ProcessImageHashTest, MatchesTheFileHash) {
+  auto image = write("image.png", "image data").string();
+
+  auto hash = proc::calculate_image_hash(image);
+  ASSERT_TRUE(hash);
+  EXPECT_EQ(hash, proc::calculate_sha256(image));
+  EXPECT_EQ(proc::calculate_image_hash(image), hash);
+
+  EXPECT_FALSE(proc::calculate_image_hash((root / "missing.png").string()));
+}
+
+TEST_F(ProcessImageHashTest, RehashesModifiedFiles) {
+  auto image = write("image.png", "image data").string();
+  auto before = proc::calculate_image_hash(image);
+
+  // Same size, only the modification time tells the files apart
+  auto last_write_time = std::filesystem::last_write_time(image);
+  write("image.png", "other data");
+  std::filesystem::last_write_time(image, last_write_time + std::chrono::seconds {1});
+
+  auto after = proc::calculate_image_hash(image);
+  ASSERT_TRUE(after);
+  EXPECT_NE(after, before);
+  EXPECT_EQ(after, proc::calculate_sha256(image));
+}
+
+TEST_F(ProcessImageHashTest, CalculatesTheIdsOfAllApps) {
+  std::vector<proc::ctx_t> apps(20);
+  for (std::size_t x = 0; x < apps.size(); ++x) {
+    apps[x].name = "App " + std::to_string(x % 10);
+    apps[x].image_path = write("app" + std::to_string(x % 5) + ".png", "image " + std::to_string(x % 5)).string();
+  }
+
+  auto possible_ids = proc::calculate_app_ids(apps);
+  ASSERT_EQ(possible_ids.size(), apps.size());
+  for (std::size_t x = 0; x < apps.size(); ++x) {
+    EXPECT_EQ(possible_ids[x], proc::calculate_app_id(apps[x].name, apps[x].image_path, (int) x));
+  }
+}
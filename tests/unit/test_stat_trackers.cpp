@@ -0,0 +1,75 @@
+/**
+ * @file tests/unit/test_stat_trackers.cpp
+ * @brief Test src/stat_trackers.*.
+ */
+#include "../tests_common.h"
+
+#include <src/stat_trackers.h>
+
+using namespace std::literals;
+
+TEST(LatencyHistogramTest, EmptyHistogramReportsZero) {
+  stat_trackers::latency_histogram histogram;
+
+  EXPECT_EQ(histogram.count(), 0);
+  EXPECT_EQ(histogram.percentile(0.5), 0us);
+  EXPECT_EQ(histogram.average(), 0us);
+  EXPECT_EQ(histogram.max(), 0us);
+}
+
+TEST(LatencyHistogramTest, PercentilesFollowDistribution) {
+  stat_trackers::latency_histogram histogram;
+
+  // 1ms, 2ms, ..., 100ms
+  for (int x = 1; x <= 100; ++x) {
+    histogram.collect(std::chrono::milliseconds {x});
+  }
+
+  EXPECT_EQ(histogram.count(), 100);
+  EXPECT_EQ(histogram.percentile(0.50), 50050us);
+  EXPECT_EQ(histogram.percentile(0.95), 95050us);
+  EXPECT_EQ(histogram.percentile(0.99), 99050us);
+  EXPECT_EQ(histogram.percentile(1.0), 100ms);
+  EXPECT_EQ(histogram.average(), 50500us);
+  EXPECT_EQ(histogram.max(), 100ms);
+}
+
+TEST(LatencyHistogramTest, PercentileIsBucketUpperBound) {
+  stat_trackers::latency_histogram histogram;
+
+  histogram.collect(120us);
+  histogram.collect(130us);
+  histogram.collect(10ms);
+
+  EXPECT_EQ(histogram.percentile(0.5), 150us);
+  EXPECT_EQ(histogram.percentile(1.0), 10ms);
+}
+
+TEST(LatencyHistogramTest, OverflowReportsMax) {
+  stat_trackers::latency_histogram histogram;
+
+  histogram.collect(1ms);
+  histogram.collect(250ms);
+
+  EXPECT_EQ(histogram.percentile(0.99), 250ms);
+  EXPECT_EQ(histogram.max(), 250ms);
+}
+
+TEST(LatencyHistogramTest, NegativeSamplesClampToZero) {
+  stat_trackers::latency_histogram histogram;
+
+  histogram.collect(-5ms);
+
+  EXPECT_EQ(histogram.count(), 1);
+  EXPECT_EQ(histogram.percentile(1.0), 0us);
+}
+
+TEST(LatencyHistogramTest, Reset) {
+  stat_trackers::latency_histogram histogram;
+
+  histogram.collect(3ms);
+  histogram.reset();
+
+  EXPECT_EQ(histogram.count(), 0);
+  EXPECT_EQ(histogram.percentile(0.5), 0us);
+}
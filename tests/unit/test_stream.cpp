@@ -37,3 +37,63 @@ TEST(ConcatAndInsertTests, ConcatSmallStrideTest) {
   auto expected = std::vector<uint8_t> {0, 'a', 0, 'b', 0, 'c', 0, 'd', 0, 'e'};
   ASSERT_EQ(res, expected);
 }
+
+#include <src/stream.h>
+
+using stream::session::grace_period_t;
+using stream::session::launch_settings_t;
+
+struct GracePeriodTest: testing::Test {
+  launch_settings_t settings {"client", 1920, 1080, 60000, false};
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+};
+
+TEST_F(GracePeriodTest, IsClaimedByTheSameLaunch) {
+  grace_period_t period;
+  EXPECT_FALSE(period.claim(settings, now + std::chrono::seconds {10}));
+
+  period.begin(settings, now + std::chrono::seconds {1});
+  EXPECT_TRUE(period.active());
+  EXPECT_TRUE(period.claim(settings, now + std::chrono::seconds {10}));
+
+  // The claim pushed the end of the grace period out
+  EXPECT_FALSE(period.expired(now + std::chrono::seconds {5}));
+  EXPECT_TRUE(period.expired(now + std::chrono::seconds {10}));
+}
+
+TEST_F(GracePeriodTest, IsNotClaimedByAnotherLaunch) {
+  grace_period_t period;
+  period.begin(settings, now + std::chrono::seconds {1});
+
+  auto other_client = settings;
+  other_client.client_uuid = "other client";
+  auto other_resolution = settings;
+  other_resolution.width = 2560;
+  auto other_fps = settings;
+  other_fps.fps = 120000;
+  auto hdr = settings;
+  hdr.enable_hdr = true;
+
+  for (auto &other : {other_client, other_resolution, other_fps, hdr}) {
+    EXPECT_FALSE(period.matches(other));
+    EXPECT_FALSE(period.claim(other, now + std::chrono::seconds {10}));
+  }
+
+  // A failed claim leaves the grace period as it was
+  EXPECT_TRUE(period.matches(settings));
+  EXPECT_TRUE(period.expired(now + std::chrono::seconds {1}));
+}
+
+TEST_F(GracePeriodTest, Expires) {
+  grace_period_t period;
+  EXPECT_FALSE(period.expired(now));
+
+  period.begin(settings, now + std::chrono::seconds {1});
+  EXPECT_FALSE(period.expired(now));
+  EXPECT_TRUE(period.expired(now + std::chrono::seconds {1}));
+
+  period.end();
+  EXPECT_FALSE(period.active());
+  EXPECT_FALSE(period.expired(now + std::chrono::seconds {1}));
+  EXPECT_FALSE(period.claim(settings, now + std::chrono::seconds {10}));
+}
@@ -0,0 +1,80 @@
+/**
+ * @file tests/unit/test_stream_loopback.cpp
+ * @brief Test full streaming sessions against a headless loopback client.
+ */
+#include "../tests_common.h"
+#include "../tests_loopback_client.h"
+
+#include <sstream>
+
+using namespace std::literals;
+
+struct StreamLoopbackTest: testing::Test {
+  static void SetUpTestSuite() {
+    host = loopback::host_t::start({}, loopback::options_t {});
+  }
+
+  static void TearDownTestSuite() {
+    host.reset();
+  }
+
+  void SetUp() override {
+    if (!host) {
+      GTEST_SKIP() << "Loopback host couldn't be started";
+    }
+  }
+
+  static loopback::report_t stream(const loopback::options_t &options, std::chrono::milliseconds duration) {
+    loopback::client_t client {host->launch(options), options};
+    if (client.connect()) {
+      ADD_FAILURE() << "Couldn't connect to the loopback host";
+      return {};
+    }
+
+    auto report = client.receive(duration);
+    client.disconnect();
+
+    std::stringstream ss;
+    report.print(ss);
+    BOOST_LOG(tests) << "Loopback report:\n"sv << ss.str();
+
+    return report;
+  }
+
+  inline static std::unique_ptr<loopback::host_t> host;
+};
+
+TEST_F(StreamLoopbackTest, CleanStreamDeliversAllFrames) {
+  loopback::options_t options;
+
+  auto report = stream(options, 2s);
+
+  EXPECT_GT(report.frames_complete, 0);
+  EXPECT_EQ(report.frames_lost, 0);
+  EXPECT_EQ(report.frames_malformed, 0);
+  EXPECT_EQ(report.blocks_lost, 0);
+  EXPECT_GT(report.goodput_mbps(), 0);
+}
+
+TEST_F(StreamLoopbackTest, EncryptedStreamDecrypts) {
+  loopback::options_t options;
+  options.encrypt_video = true;
+
+  auto report = stream(options, 2s);
+
+  EXPECT_GT(report.frames_complete, 0);
+  EXPECT_EQ(report.decrypt_failures, 0);
+  EXPECT_EQ(report.frames_malformed, 0);
+}
+
+TEST_F(StreamLoopbackTest, FecRecoversSyntheticLoss) {
+  loopback::options_t options;
+  options.loss = 0.05;
+
+  auto report = stream(options, 3s);
+
+  EXPECT_GT(report.packets_dropped, 0);
+  EXPECT_GT(report.blocks_recovered, 0);
+  EXPECT_GT(report.recovery_rate(), 0.9);
+  EXPECT_EQ(report.frames_malformed, 0);
+}
@@ -0,0 +1,45 @@
+/**
+ * @file tests/unit/test_thread_placement.cpp
+ * @brief Test src/thread_placement.*.
+ */
+#include "../tests_common.h"
+
+#include <src/config.h>
+#include <src/thread_placement.h>
+#include <thread>
+
+using namespace thread_placement;
+
+TEST(ThreadPlacementTest, ReportsThreadsUntilTheyEnd) {
+  nlohmann::json during;
+  std::thread {[&]() {
+    auto placement = apply(role_e::audio, platf::thread_priority_e::normal);
+    during = report();
+  }}.join();
+
+  ASSERT_EQ(during.size(), 1);
+  EXPECT_EQ(during[0]["role"], "audio");
+  EXPECT_EQ(during[0]["priority"], "normal");
+  EXPECT_FALSE(during[0]["scheduling"].get<std::string>().empty());
+  EXPECT_TRUE(during[0]["cpus"].empty());
+
+  EXPECT_TRUE(report().empty());
+}
+
+#ifdef __linux__
+TEST(ThreadPlacementTest, RestrictsThreadsToTheConfiguredCpus) {
+  auto saved_cpus = config::sunshine.capture_cpus;
+  config::sunshine.capture_cpus = {0};
+
+  nlohmann::json during;
+  std::thread {[&]() {
+    auto placement = apply(role_e::capture, platf::thread_priority_e::normal);
+    during = report();
+  }}.join();
+  config::sunshine.capture_cpus = saved_cpus;
+
+  ASSERT_EQ(during.size(), 1);
+  EXPECT_EQ(during[0]["role"], "capture");
+  EXPECT_EQ(during[0]["cpus"], nlohmann::json::array({0}));
+}
+#endif
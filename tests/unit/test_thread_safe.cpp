@@ -0,0 +1,228 @@
+/**
+ * @file tests/unit/test_thread_safe.cpp
+ * @brief Test src/thread_safe.h.
+ */
+#include "../tests_common.h"
+
+#include <src/thread_safe.h>
+#include <thread>
+
+using namespace std::literals;
+
+TEST(RingQueueTest, PopsInOrder) {
+  safe::ring_queue_t<int> queue {5};
+  EXPECT_EQ(queue.capacity(), 8);
+  EXPECT_FALSE(queue.peek());
+
+  for (int x = 0; x < 20; ++x) {
+    queue.raise(x);
+    queue.raise(x + 100);
+    EXPECT_TRUE(queue.peek());
+    EXPECT_EQ(queue.pop(), x);
+    EXPECT_EQ(queue.pop(), x + 100);
+  }
+
+  EXPECT_FALSE(queue.pop(1ms));
+}
+
+TEST(RingQueueTest, DropsTheOldestElements) {
+  safe::ring_queue_t<int> queue {4, safe::overflow_e::drop_oldest};
+  for (int x = 0; x < 6; ++x) {
+    queue.raise(x);
+  }
+
+  for (int x = 2; x < 6; ++x) {
+    EXPECT_EQ(queue.pop(), x);
+  }
+  EXPECT_FALSE(queue.peek());
+}
+
+TEST(RingQueueTest, DropsTheNewestElements) {
+  safe::ring_queue_t<int> queue {4, safe::overflow_e::drop_newest};
+  for (int x = 0; x < 6; ++x) {
+    queue.raise(x);
+  }
+
+  for (int x = 0; x < 4; ++x) {
+    EXPECT_EQ(queue.pop(), x);
+  }
+  EXPECT_FALSE(queue.peek());
+}
+
+TEST(RingQueueTest, BlocksUntilThereIsRoom) {
+  safe::ring_queue_t<int> queue {2, safe::overflow_e::block};
+  queue.raise(0);
+  queue.raise(1);
+
+  std::atomic_bool raised = false;
+  std::thread producer {[&]() {
+    queue.raise(2);
+    raised = true;
+  }};
+
+  std::this_thread::sleep_for(50ms);
+  EXPECT_FALSE(raised);
+
+  EXPECT_EQ(queue.pop(), 0);
+  producer.join();
+  EXPECT_TRUE(raised);
+  EXPECT_EQ(queue.pop(), 1);
+  EXPECT_EQ(queue.pop(), 2);
+}
+
+TEST(RingQueueTest, StopWakesWaitingThreads) {
+  safe::ring_queue_t<std::unique_ptr<int>> queue {1, safe::overflow_e::block};
+  queue.raise(std::make_unique<int>(0));
+
+  std::thread producer {[&]() {
+    queue.raise(std::make_unique<int>(1));
+  }};
+
+  std::this_thread::sleep_for(10ms);
+  queue.stop();
+  producer.join();
+
+  EXPECT_FALSE(queue.running());
+  EXPECT_FALSE(queue.peek());
+  EXPECT_EQ(queue.pop(), nullptr);
+
+  // Raising into a stopped queue is ignored
+  queue.raise(std::make_unique<int>(2));
+  EXPECT_EQ(queue.pop(1ms), nullptr);
+}
+
+TEST(RingQueueTest, PassesEveryElementBetweenThreads) {
+  constexpr int producers = 4;
+  constexpr int elements = 20000;
+
+  safe::ring_queue_t<int> queue {16, safe::overflow_e::block};
+  std::vector<std::thread> threads;
+  for (int x = 0; x < producers; ++x) {
+    threads.emplace_back([&queue, x]() {
+      for (int y = 0; y < elements; ++y) {
+        queue.raise(x * elements + y);
+      }
+    });
+  }
+
+  // Elements of each producer must arrive in the order they were raised
+  std::vector<int> next(producers, 0);
+  for (int x = 0; x < producers * elements; ++x) {
+    auto val = queue.pop(5s);
+    ASSERT_TRUE(val);
+
+    auto producer = *val / elements;
+    ASSERT_EQ(*val % elements, next[producer]++);
+  }
+
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_FALSE(queue.peek());
+}
+
+TEST(RingQueueTest, CountsDroppedElements) {
+  safe::ring_queue_t<int> oldest {4, safe::overflow_e::drop_oldest};
+  safe::ring_queue_t<int> newest {4, safe::overflow_e::drop_newest};
+  for (int x = 0; x < 6; ++x) {
+    EXPECT_TRUE(oldest.raise(x));
+    EXPECT_EQ(newest.raise(x), x < 4);
+  }
+  oldest.pop();
+
+  auto stats = oldest.stats();
+  EXPECT_EQ(stats.capacity, 4);
+  EXPECT_EQ(stats.size, 3);
+  EXPECT_EQ(stats.high_watermark, 4);
+  EXPECT_EQ(stats.raised, 6);
+  EXPECT_EQ(stats.dropped, 2);
+
+  stats = newest.stats();
+  EXPECT_EQ(stats.size, 4);
+  EXPECT_EQ(stats.raised, 6);
+  EXPECT_EQ(stats.dropped, 2);
+}
+
+TEST(RingQueueTest, NeverDropsKeptElements) {
+  // Negative elements stand in for keyframes
+  auto is_keyframe = [](const int &x) {
+    return x < 0;
+  };
+  safe::ring_queue_t<int> queue {2, safe::overflow_e::drop_newest, is_keyframe};
+  queue.raise(1);
+  queue.raise(2);
+  EXPECT_FALSE(queue.raise(3));
+
+  std::atomic_bool raised = false;
+  std::thread producer {[&]() {
+    EXPECT_TRUE(queue.raise(-1));
+    raised = true;
+  }};
+
+  std::this_thread::sleep_for(50ms);
+  EXPECT_FALSE(raised);
+
+  EXPECT_EQ(queue.pop(), 1);
+  producer.join();
+  EXPECT_EQ(queue.pop(), 2);
+  EXPECT_EQ(queue.pop(), -1);
+  EXPECT_EQ(queue.stats().dropped, 1);
+}
+
+TEST(QueueTest, CountsDroppedElements) {
+  safe::queue_t<int> queue {4};
+  for (int x = 0; x < 6; ++x) {
+    queue.raise(x);
+  }
+
+  // The full queue is cleared to make room
+  auto stats = queue.stats();
+  EXPECT_EQ(stats.capacity, 4);
+  EXPECT_EQ(stats.size, 2);
+  EXPECT_EQ(stats.high_watermark, 4);
+  EXPECT_EQ(stats.raised, 6);
+  EXPECT_EQ(stats.dropped, 4);
+}
+
+TEST(EventTest, CountsReplacedStatuses) {
+  safe::event_t<int> event;
+  event.raise(1);
+  event.raise(2);
+  EXPECT_EQ(event.pop(), 2);
+
+  // A status that was viewed wasn't dropped
+  event.raise(3);
+  EXPECT_EQ(event.view(), 3);
+  event.raise(4);
+
+  auto stats = event.stats();
+  EXPECT_EQ(stats.size, 1);
+  EXPECT_EQ(stats.raised, 4);
+  EXPECT_EQ(stats.dropped, 1);
+}
+
+TEST(MailTest, ReportsTheStatsOfPostedQueues) {
+  auto mail = std::make_shared<safe::mail_raw_t>();
+
+  auto queue = mail->queue<int>("queue"sv, 8);
+  auto ring_queue = mail->ring_queue<int>("ring_queue"sv, 2, safe::overflow_e::drop_newest);
+  for (int x = 0; x < 3; ++x) {
+    queue->raise(x);
+    ring_queue->raise(x);
+  }
+
+  // Getting a posted queue doesn't change its capacity
+  EXPECT_EQ(mail->queue<int>("queue"sv, 16), queue);
+
+  auto stats = mail->stats();
+  ASSERT_EQ(stats.size(), 2);
+  EXPECT_EQ(stats["queue"].capacity, 8);
+  EXPECT_EQ(stats["queue"].size, 3);
+  EXPECT_EQ(stats["ring_queue"].dropped, 1);
+
+  // Only queues still in use are reported
+  queue.reset();
+  stats = mail->stats();
+  ASSERT_EQ(stats.size(), 1);
+  EXPECT_TRUE(stats.contains("ring_queue"));
+}